@@ -28,6 +28,18 @@ typedef struct AdHandle {
 	size_t size;
 } AdHandle_t;
 
+typedef struct AdElement {
+	uint8_t *pPayload;
+	uint8_t type;
+	uint8_t size;
+} AdElement_t;
+
+/* Index of the elements in an advertisement */
+typedef struct AdTable {
+	AdElement_t elements[CONFIG_LCZ_AD_PARSE_MAX_ELEMENTS];
+	uint8_t count;
+} AdTable_t;
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -59,6 +71,31 @@ AdHandle_t AdFind_Name(uint8_t *pAdv, size_t Length);
  */
 bool AdFind_MatchName(uint8_t *pAdv, size_t Length, char *Name, size_t NameLength);
 
+/**
+ * @brief Index all TLVs in an advertisement in a single pass so that
+ * multiple types can be found without walking the advertisement again.
+ *
+ * @param pAdv pointer to advertisement data
+ * @param Length length of the data
+ * @param pTable filled with the elements (in advertisement order).
+ * Elements after the first CONFIG_LCZ_AD_PARSE_MAX_ELEMENTS are ignored.
+ *
+ * @retval number of elements in the table
+ */
+size_t ad_parse(uint8_t *pAdv, size_t Length, AdTable_t *pTable);
+
+/**
+ * @brief Finds a TLV in a table made by ad_parse
+ *
+ * @param pTable table of elements
+ * @param Type1 type of TLV to find
+ * @param Type2 second type of tlv to find, set to BT_DATA_INVALID when not used.
+ *
+ * @retval AdHandle_t - pointer to payload of the first matching element if
+ * found otherwise NULL
+ */
+AdHandle_t ad_parse_find(const AdTable_t *pTable, uint8_t Type1, uint8_t Type2);
+
 #ifdef __cplusplus
 }
 #endif
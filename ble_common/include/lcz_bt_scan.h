@@ -19,10 +19,105 @@
 #include <stddef.h>
 #include <bluetooth/bluetooth.h>
 
+#include "ad_find.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/**
+ * @brief Advertisement after it has been parsed by the scan module.
+ * Only valid for the duration of the callback.
+ *
+ * @param addr advertiser address
+ * @param rssi signal strength
+ * @param type advertisement type (BT_GAP_ADV_TYPE_*)
+ * @param ad advertisement data
+ * @param table all elements of the advertisement (see ad_parse_find)
+ * @param msd payload of the manufacturer specific data (NULL if not present)
+ * @param name payload of the short or complete name (NULL if not present)
+ * @param company_id company ID from the manufacturer specific data
+ * (0xFFFF if not present)
+ * @param protocol_id 16-bit value that follows the company ID (0 if not
+ * present)
+ * @param duplicate true when a repeated advertisement is only given to a user
+ * because the RSSI changed (CONFIG_LCZ_BT_SCAN_DEDUP)
+ */
+struct lcz_bt_scan_adv {
+	const bt_addr_le_t *addr;
+	int8_t rssi;
+	uint8_t type;
+	struct net_buf_simple *ad;
+	AdTable_t table;
+	AdHandle_t msd;
+	AdHandle_t name;
+	uint16_t company_id;
+	uint16_t protocol_id;
+	bool duplicate;
+};
+
+typedef void lcz_bt_scan_adv_cb_t(const struct lcz_bt_scan_adv *adv);
+
+/**
+ * @brief Filter evaluated by the scan module before an advertisement is given
+ * to a user. A list with a count of zero matches everything.
+ * The lists must remain valid while the user is registered.
+ *
+ * @param company_ids allowed company IDs
+ * @param num_company_ids number of entries in company_ids
+ * @param protocol_ids allowed protocol IDs
+ * @param num_protocol_ids number of entries in protocol_ids
+ * @param addrs allowed advertiser addresses
+ * @param num_addrs number of entries in addrs
+ * @param use_rssi_min enable the RSSI floor
+ * @param rssi_min advertisements below this signal strength are dropped
+ * @param dedup drop repeats of advertisements already given to this user
+ * (CONFIG_LCZ_BT_SCAN_DEDUP)
+ * @param dedup_id_offset offset of the record ID in the manufacturer specific
+ * data (for example offsetof(LczSensorAdEvent_t, id))
+ * @param dedup_id_size size of the record ID (for example id and epoch).
+ * When zero the whole manufacturer specific data is used.
+ * @param dedup_rssi_delta give a repeat to the user when the RSSI has changed
+ * by at least this much since the last RSSI reported to this user (0 to
+ * disable)
+ * @param deferred call the user from the scan worker thread instead of the
+ * Bluetooth RX thread (CONFIG_LCZ_BT_SCAN_DEFERRED)
+ */
+struct lcz_bt_scan_filter {
+	const uint16_t *company_ids;
+	size_t num_company_ids;
+	const uint16_t *protocol_ids;
+	size_t num_protocol_ids;
+	const bt_addr_le_t *addrs;
+	size_t num_addrs;
+	bool use_rssi_min;
+	int8_t rssi_min;
+	bool dedup;
+	uint8_t dedup_id_offset;
+	uint8_t dedup_id_size;
+	uint8_t dedup_rssi_delta;
+	bool deferred;
+};
+
+/**
+ * @param queued advertisements copied into the ring
+ * @param dropped_full advertisements dropped because the ring was full
+ * @param dropped_size advertisements dropped because they were larger than
+ * CONFIG_LCZ_BT_SCAN_DEFERRED_AD_SIZE
+ * @param high_water largest number of slots in use
+ * @param batches number of batches processed by the worker
+ */
+struct lcz_bt_scan_deferred_stats {
+	uint32_t queued;
+	uint32_t dropped_full;
+	uint32_t dropped_size;
+	uint32_t high_water;
+	uint32_t batches;
+};
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -45,6 +140,19 @@ bool lcz_bt_scan_set_parameters(const struct bt_le_scan_param *param);
  */
 bool lcz_bt_scan_register(int *pId, bt_le_scan_cb_t *cb);
 
+/**
+ * @brief Register user of scan module that is only given advertisements
+ * that match its filter. Each advertisement is parsed once for all users.
+ *
+ * @param pId user id
+ * @param cb advertisement handler callback
+ * @param filter copied by the scan module, NULL to receive all advertisements
+ *
+ * @retval true if new user was registered, false otherwise.
+ */
+bool lcz_bt_scan_register_filtered(int *pId, lcz_bt_scan_adv_cb_t *cb,
+				   const struct lcz_bt_scan_filter *filter);
+
 /**
  * @brief Start scanning (if there aren't any stop requests).
  *
@@ -105,6 +213,21 @@ uint32_t lcz_bt_scan_get_num_starts(void);
  */
 uint32_t lcz_bt_scan_get_num_stops(void);
 
+/**
+ * @brief Accessor function
+ *
+ * @retval number of repeated advertisements that weren't given to a user
+ */
+uint32_t lcz_bt_scan_get_num_duplicates(void);
+
+/**
+ * @brief Get the counters of the deferred processing ring
+ * (CONFIG_LCZ_BT_SCAN_DEFERRED).
+ *
+ * @param stats copy of the counters
+ */
+void lcz_bt_scan_get_deferred_stats(struct lcz_bt_scan_deferred_stats *stats);
+
 /**
  * @brief Stop scanning, update parameters, restart scanning
  *
@@ -39,6 +39,20 @@ extern "C" {
 uint16_t lcz_sensor_adv_match(struct net_buf_simple *ad, bool match_rsp,
 			      bool match_coded);
 
+/**
+ * @brief Classify manufacturer specific data that has already been found
+ * (for example with ad_parse). The company ID and protocol ID are looked up
+ * as one word in a sorted table.
+ *
+ * @param handle payload of manufacturer specific ad
+ * @param match_rsp enable scan response matching
+ * @param match_coded enabled coded PHY matching
+ * @return uint16_t RESERVED_AD_PROTOCOL_ID (0) if ad doesn't match,
+ * AD_PROTOCOL_ID otherwise.
+ */
+uint16_t lcz_sensor_adv_match_msd(AdHandle_t *handle, bool match_rsp,
+				  bool match_coded);
+
 /**
  * @brief Match BT510 or BT6xx 1M advertisement
  *
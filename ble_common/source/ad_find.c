@@ -34,7 +34,7 @@ AdHandle_t AdFind_Type(uint8_t *pAdv, size_t Length, uint8_t Type1,
 		/* Quasi-validate the length so the code can't get stuck. */
 		result.size = pAdv[i];
 		if ((result.size >= MIN_VALUE_INDEX) &&
-		    ((i + result.size) <= Length)) {
+		    ((i + result.size) < Length)) {
 			uint8_t elementType = pAdv[i + 1];
 			if ((elementType == Type1) &&
 			    (Type1 != BT_DATA_INVALID)) {
@@ -77,3 +77,47 @@ bool AdFind_MatchName(uint8_t *pAdv, size_t Length, char *Name,
 	}
 	return false;
 }
+
+size_t ad_parse(uint8_t *pAdv, size_t Length, AdTable_t *pTable)
+{
+	AdElement_t *element;
+	size_t i = 0;
+	uint8_t size;
+
+	pTable->count = 0;
+	while (i < Length && pTable->count < ARRAY_SIZE(pTable->elements)) {
+		/* Quasi-validate the length so the code can't get stuck. */
+		size = pAdv[i];
+		if ((size < MIN_VALUE_INDEX) || ((i + size) >= Length)) {
+			break;
+		}
+
+		element = &pTable->elements[pTable->count++];
+		element->type = pAdv[i + 1];
+		element->pPayload = pAdv + i + MIN_VALUE_INDEX;
+		/* subtract length of type field. */
+		element->size = size - 1;
+
+		/* skip one extra byte because length field not included in length */
+		i += size + 1;
+	}
+
+	return pTable->count;
+}
+
+AdHandle_t ad_parse_find(const AdTable_t *pTable, uint8_t Type1, uint8_t Type2)
+{
+	AdHandle_t result = { NULL, 0 };
+	size_t i;
+
+	for (i = 0; i < pTable->count; i++) {
+		if ((pTable->elements[i].type == Type1 && Type1 != BT_DATA_INVALID) ||
+		    (pTable->elements[i].type == Type2 && Type2 != BT_DATA_INVALID)) {
+			result.pPayload = pTable->elements[i].pPayload;
+			result.size = pTable->elements[i].size;
+			break;
+		}
+	}
+
+	return result;
+}
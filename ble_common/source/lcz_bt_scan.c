@@ -15,9 +15,78 @@ LOG_MODULE_REGISTER(lcz_bt_scan, CONFIG_LCZ_BT_SCAN_LOG_LEVEL);
 /******************************************************************************/
 #include <kernel.h>
 #include <stddef.h>
+#include <string.h>
+#include <sys/byteorder.h>
 
 #include "lcz_bt_scan.h"
 
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define NO_COMPANY_ID 0xFFFF
+
+#ifdef CONFIG_LCZ_BT_SCAN_DEDUP
+#define DEDUP_BUCKET_MASK (CONFIG_LCZ_BT_SCAN_DEDUP_BUCKETS - 1)
+BUILD_ASSERT((CONFIG_LCZ_BT_SCAN_DEDUP_BUCKETS & DEDUP_BUCKET_MASK) == 0,
+	     "Number of buckets must be a power of 2");
+
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+
+#define DEDUP_ID_SIZE CONFIG_LCZ_BT_SCAN_DEDUP_ID_SIZE
+
+/* The start of the record ID is kept so that only IDs longer than
+ * DEDUP_ID_SIZE rely on the hash alone. The RSSI is the last one reported to
+ * each user.
+ */
+struct dedup_entry {
+	bt_addr_le_t addr;
+	bool used;
+	uint8_t id_len;
+	uint16_t protocol_id;
+	uint32_t id_hash;
+	uint32_t first_ms;
+	uint32_t last_ms;
+	uint32_t users;
+	int8_t rssi[CONFIG_LCZ_BT_SCAN_MAX_USERS];
+	uint8_t id[DEDUP_ID_SIZE];
+};
+
+/* What dedup_drop changed for a user, so that it can be undone when the
+ * advertisement isn't delivered.
+ */
+struct dedup_mark {
+	struct dedup_entry *entry;
+	bool first;
+	int8_t rssi;
+};
+#endif
+
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+#define DEFERRED_MASK (CONFIG_LCZ_BT_SCAN_DEFERRED_SLOTS - 1)
+BUILD_ASSERT((CONFIG_LCZ_BT_SCAN_DEFERRED_SLOTS & DEFERRED_MASK) == 0,
+	     "Number of slots must be a power of 2");
+
+struct deferred_slot {
+	bt_addr_le_t addr;
+	int8_t rssi;
+	uint8_t type;
+	uint8_t len;
+	uint32_t users;
+	uint32_t duplicate_users;
+	uint8_t data[CONFIG_LCZ_BT_SCAN_DEFERRED_AD_SIZE];
+};
+
+/* Updated by both the scan callback and the worker */
+struct deferred_counters {
+	atomic_t queued;
+	atomic_t dropped_full;
+	atomic_t dropped_size;
+	atomic_t high_water;
+	atomic_t batches;
+};
+#endif
+
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
@@ -26,6 +95,25 @@ static bool valid_user_id(int id);
 static bool valid_scan_param_user_id(int id);
 static void lcz_bt_scan_adv_handler(const bt_addr_le_t *addr, int8_t rssi,
 				    uint8_t type, struct net_buf_simple *ad);
+static void parse_adv(struct lcz_bt_scan_adv *adv, const bt_addr_le_t *addr,
+		      int8_t rssi, uint8_t type, struct net_buf_simple *ad);
+static bool filter_match(const struct lcz_bt_scan_filter *filter,
+			 const struct lcz_bt_scan_adv *adv);
+static bool id_in_list(uint16_t id, const uint16_t *list, size_t count);
+#ifdef CONFIG_LCZ_BT_SCAN_DEDUP
+static bool dedup_drop(size_t user, struct lcz_bt_scan_adv *adv,
+		       struct dedup_mark *mark);
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+static void dedup_unmark(size_t user, const struct dedup_mark *mark);
+#endif
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t size);
+#endif
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+static int deferred_put(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			struct net_buf_simple *ad, uint32_t users,
+			uint32_t duplicate_users);
+static void deferred_thread(void *arg1, void *arg2, void *arg3);
+#endif
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
@@ -36,11 +124,35 @@ static struct {
 	atomic_t stop_requests;
 	atomic_t start_requests;
 	bt_le_scan_cb_t *adv_handlers[CONFIG_LCZ_BT_SCAN_MAX_USERS];
+	lcz_bt_scan_adv_cb_t *filtered_handlers[CONFIG_LCZ_BT_SCAN_MAX_USERS];
+	struct lcz_bt_scan_filter filters[CONFIG_LCZ_BT_SCAN_MAX_USERS];
 
 	uint32_t num_stops;
 	uint32_t num_starts;
+	uint32_t num_duplicates;
 } bts;
 
+#ifdef CONFIG_LCZ_BT_SCAN_DEDUP
+/* Only accessed from the scan callback (BT RX thread) */
+static struct dedup_entry dedup_cache[CONFIG_LCZ_BT_SCAN_DEDUP_BUCKETS]
+				     [CONFIG_LCZ_BT_SCAN_DEDUP_WAYS];
+#endif
+
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+/* Single producer (scan callback), single consumer (worker) ring.
+ * Slots between tail and head belong to the worker.
+ */
+static struct deferred_slot deferred_slots[CONFIG_LCZ_BT_SCAN_DEFERRED_SLOTS];
+static atomic_t deferred_head;
+static atomic_t deferred_tail;
+static struct deferred_counters deferred_stats;
+static K_SEM_DEFINE(deferred_sem, 0, 1);
+
+K_THREAD_DEFINE(lcz_bt_scan_deferred, CONFIG_LCZ_BT_SCAN_DEFERRED_THREAD_STACK_SIZE,
+		deferred_thread, NULL, NULL, NULL,
+		CONFIG_LCZ_BT_SCAN_DEFERRED_THREAD_PRIORITY, 0, 0);
+#endif
+
 static int scan_param_id = -1;
 
 static struct bt_le_scan_param scan_parameters = BT_LE_SCAN_PARAM_INIT(
@@ -72,6 +184,24 @@ bool lcz_bt_scan_register(int *pId, bt_le_scan_cb_t *cb)
 	}
 }
 
+bool lcz_bt_scan_register_filtered(int *pId, lcz_bt_scan_adv_cb_t *cb,
+				   const struct lcz_bt_scan_filter *filter)
+{
+	*pId = (int)atomic_inc(&bts.users);
+
+	if (valid_user_id(*pId)) {
+		if (filter != NULL) {
+			bts.filters[*pId] = *filter;
+		} else {
+			memset(&bts.filters[*pId], 0, sizeof(bts.filters[*pId]));
+		}
+		bts.filtered_handlers[*pId] = cb;
+		return true;
+	} else {
+		return false;
+	}
+}
+
 int lcz_bt_scan_start(int id)
 {
 	int r = -EPERM;
@@ -145,6 +275,24 @@ uint32_t lcz_bt_scan_get_num_stops(void)
 	return bts.num_stops;
 }
 
+uint32_t lcz_bt_scan_get_num_duplicates(void)
+{
+	return bts.num_duplicates;
+}
+
+void lcz_bt_scan_get_deferred_stats(struct lcz_bt_scan_deferred_stats *stats)
+{
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+	stats->queued = (uint32_t)atomic_get(&deferred_stats.queued);
+	stats->dropped_full = (uint32_t)atomic_get(&deferred_stats.dropped_full);
+	stats->dropped_size = (uint32_t)atomic_get(&deferred_stats.dropped_size);
+	stats->high_water = (uint32_t)atomic_get(&deferred_stats.high_water);
+	stats->batches = (uint32_t)atomic_get(&deferred_stats.batches);
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif
+}
+
 int lcz_bt_scan_update_parameters(int id, const struct bt_le_scan_param *param)
 {
 	int r = -EPERM;
@@ -238,10 +386,368 @@ static void lcz_bt_scan_adv_handler(const bt_addr_le_t *addr, int8_t rssi,
 	LOG_HEXDUMP_DBG(ad->data, ad->len, "Data:");
 #endif
 
+	struct lcz_bt_scan_adv adv;
+	bool parsed = false;
 	size_t i;
+#ifdef CONFIG_LCZ_BT_SCAN_DEDUP
+	struct dedup_mark marks[CONFIG_LCZ_BT_SCAN_MAX_USERS];
+#endif
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+	uint32_t deferred_users = 0;
+	uint32_t duplicate_users = 0;
+#endif
+
 	for (i = 0; i < CONFIG_LCZ_BT_SCAN_MAX_USERS; i++) {
 		if (bts.adv_handlers[i] != NULL) {
 			bts.adv_handlers[i](addr, rssi, type, ad);
+		} else if (bts.filtered_handlers[i] != NULL) {
+			/* Parse once for all filtered users */
+			if (!parsed) {
+				parse_adv(&adv, addr, rssi, type, ad);
+				parsed = true;
+			}
+			if (!filter_match(&bts.filters[i], &adv)) {
+				continue;
+			}
+			adv.duplicate = false;
+#ifdef CONFIG_LCZ_BT_SCAN_DEDUP
+			if (bts.filters[i].dedup &&
+			    dedup_drop(i, &adv, &marks[i])) {
+				continue;
+			}
+#endif
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+			if (bts.filters[i].deferred) {
+				deferred_users |= BIT(i);
+				if (adv.duplicate) {
+					duplicate_users |= BIT(i);
+				}
+				continue;
+			}
+#endif
+			bts.filtered_handlers[i](&adv);
+		}
+	}
+
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+	if (deferred_users != 0 &&
+	    deferred_put(addr, rssi, type, ad, deferred_users,
+			 duplicate_users) != 0) {
+#ifdef CONFIG_LCZ_BT_SCAN_DEDUP
+		/* The users didn't get it so a repeat mustn't be dropped */
+		for (i = 0; i < CONFIG_LCZ_BT_SCAN_MAX_USERS; i++) {
+			if ((deferred_users & BIT(i)) != 0 &&
+			    bts.filters[i].dedup) {
+				dedup_unmark(i, &marks[i]);
+			}
+		}
+#endif
+	}
+#endif
+}
+
+/* Index the elements in a single pass for all filtered users */
+static void parse_adv(struct lcz_bt_scan_adv *adv, const bt_addr_le_t *addr,
+		      int8_t rssi, uint8_t type, struct net_buf_simple *ad)
+{
+	adv->addr = addr;
+	adv->rssi = rssi;
+	adv->type = type;
+	adv->ad = ad;
+
+	ad_parse(ad->data, ad->len, &adv->table);
+	adv->msd = ad_parse_find(&adv->table, BT_DATA_MANUFACTURER_DATA,
+				 BT_DATA_INVALID);
+	adv->name = ad_parse_find(&adv->table, BT_DATA_NAME_SHORTENED,
+				  BT_DATA_NAME_COMPLETE);
+
+	adv->company_id = NO_COMPANY_ID;
+	adv->protocol_id = 0;
+	if (adv->msd.size >= sizeof(uint16_t)) {
+		adv->company_id = sys_get_le16(adv->msd.pPayload);
+	}
+	if (adv->msd.size >= (2 * sizeof(uint16_t))) {
+		adv->protocol_id = sys_get_le16(&adv->msd.pPayload[2]);
+	}
+}
+
+/* Cheapest checks first */
+static bool filter_match(const struct lcz_bt_scan_filter *filter,
+			 const struct lcz_bt_scan_adv *adv)
+{
+	size_t i;
+
+	if (filter->use_rssi_min && adv->rssi < filter->rssi_min) {
+		return false;
+	}
+
+	if (!id_in_list(adv->company_id, filter->company_ids,
+			filter->num_company_ids)) {
+		return false;
+	}
+
+	if (!id_in_list(adv->protocol_id, filter->protocol_ids,
+			filter->num_protocol_ids)) {
+		return false;
+	}
+
+	if (filter->num_addrs == 0) {
+		return true;
+	}
+
+	for (i = 0; i < filter->num_addrs; i++) {
+		if (bt_addr_le_cmp(adv->addr, &filter->addrs[i]) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool id_in_list(uint16_t id, const uint16_t *list, size_t count)
+{
+	size_t i;
+
+	if (count == 0) {
+		return true;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (list[i] == id) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+#ifdef CONFIG_LCZ_BT_SCAN_DEDUP
+/* Each bucket is searched in constant time. Expired entries are reused
+ * first, then the least recently seen entry is replaced.
+ * When the advertisement isn't dropped mark records how to undo the update.
+ */
+static bool dedup_drop(size_t user, struct lcz_bt_scan_adv *adv,
+		       struct dedup_mark *mark)
+{
+	const struct lcz_bt_scan_filter *filter = &bts.filters[user];
+	struct dedup_entry *bucket;
+	struct dedup_entry *entry = NULL;
+	struct dedup_entry *victim = NULL;
+	struct dedup_entry *e;
+	uint32_t now = k_uptime_get_32();
+	const uint8_t *id;
+	size_t id_size;
+	uint32_t id_hash;
+	uint32_t hash;
+	size_t id_len;
+	int delta;
+	size_t w;
+
+	mark->entry = NULL;
+
+	if (adv->msd.pPayload == NULL) {
+		id = adv->ad->data;
+		id_size = adv->ad->len;
+	} else if (filter->dedup_id_size == 0) {
+		id = adv->msd.pPayload;
+		id_size = adv->msd.size;
+	} else if ((filter->dedup_id_offset + filter->dedup_id_size) <=
+		   adv->msd.size) {
+		id = &adv->msd.pPayload[filter->dedup_id_offset];
+		id_size = filter->dedup_id_size;
+	} else {
+		return false;
+	}
+
+	id_len = MIN(id_size, DEDUP_ID_SIZE);
+	id_hash = fnv1a(FNV_OFFSET_BASIS, id, id_size);
+	hash = fnv1a(id_hash, adv->addr, sizeof(*adv->addr));
+	hash = fnv1a(hash, &adv->protocol_id, sizeof(adv->protocol_id));
+	bucket = dedup_cache[hash & DEDUP_BUCKET_MASK];
+
+	for (w = 0; w < CONFIG_LCZ_BT_SCAN_DEDUP_WAYS; w++) {
+		e = &bucket[w];
+		if (e->used &&
+		    (now - e->first_ms) >= CONFIG_LCZ_BT_SCAN_DEDUP_TIMEOUT_MS) {
+			e->used = false;
+		}
+
+		if (!e->used) {
+			if (victim == NULL || victim->used) {
+				victim = e;
+			}
+		} else if (e->id_hash == id_hash && e->id_len == id_len &&
+			   e->protocol_id == adv->protocol_id &&
+			   memcmp(e->id, id, id_len) == 0 &&
+			   bt_addr_le_cmp(&e->addr, adv->addr) == 0) {
+			entry = e;
+			break;
+		} else if (victim == NULL ||
+			   (victim->used &&
+			    (int32_t)(e->last_ms - victim->last_ms) < 0)) {
+			victim = e;
+		}
+	}
+
+	if (entry == NULL) {
+		entry = victim;
+		bt_addr_le_copy(&entry->addr, adv->addr);
+		entry->used = true;
+		entry->protocol_id = adv->protocol_id;
+		entry->id_hash = id_hash;
+		entry->id_len = id_len;
+		memcpy(entry->id, id, id_len);
+		entry->first_ms = now;
+		entry->users = 0;
+	}
+	entry->last_ms = now;
+
+	mark->entry = entry;
+	mark->rssi = entry->rssi[user];
+	mark->first = (entry->users & BIT(user)) == 0;
+	if (mark->first) {
+		entry->users |= BIT(user);
+		entry->rssi[user] = adv->rssi;
+		return false;
+	}
+
+	if (filter->dedup_rssi_delta != 0) {
+		delta = adv->rssi - entry->rssi[user];
+		if (delta < 0) {
+			delta = -delta;
+		}
+		if (delta >= filter->dedup_rssi_delta) {
+			entry->rssi[user] = adv->rssi;
+			adv->duplicate = true;
+			return false;
 		}
 	}
+
+	mark->entry = NULL;
+	bts.num_duplicates += 1;
+	return true;
+}
+
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+/* The entry may have been reused by another user in the meantime, which only
+ * lets a repeat through.
+ */
+static void dedup_unmark(size_t user, const struct dedup_mark *mark)
+{
+	if (mark->entry == NULL) {
+		return;
+	}
+
+	if (mark->first) {
+		mark->entry->users &= ~BIT(user);
+	} else {
+		mark->entry->rssi[user] = mark->rssi;
+	}
 }
+#endif
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+
+	while (size-- > 0) {
+		hash ^= *p++;
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+#endif
+
+#ifdef CONFIG_LCZ_BT_SCAN_DEFERRED
+/* Runs in the Bluetooth RX context, only copies the advertisement.
+ * Returns 0 if the advertisement was queued.
+ */
+static int deferred_put(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			struct net_buf_simple *ad, uint32_t users,
+			uint32_t duplicate_users)
+{
+	uint32_t head = (uint32_t)atomic_get(&deferred_head);
+	uint32_t used = head - (uint32_t)atomic_get(&deferred_tail);
+	struct deferred_slot *slot;
+
+	if (ad->len > sizeof(slot->data)) {
+		atomic_inc(&deferred_stats.dropped_size);
+		return -EMSGSIZE;
+	}
+
+	if (used >= CONFIG_LCZ_BT_SCAN_DEFERRED_SLOTS) {
+		atomic_inc(&deferred_stats.dropped_full);
+		return -ENOSPC;
+	}
+
+	slot = &deferred_slots[head & DEFERRED_MASK];
+	bt_addr_le_copy(&slot->addr, addr);
+	slot->rssi = rssi;
+	slot->type = type;
+	slot->len = ad->len;
+	slot->users = users;
+	slot->duplicate_users = duplicate_users;
+	memcpy(slot->data, ad->data, ad->len);
+
+	/* Publish the slot to the worker */
+	atomic_set(&deferred_head, head + 1);
+
+	atomic_inc(&deferred_stats.queued);
+	/* Only the producer updates the high water mark */
+	if ((used + 1) > (uint32_t)atomic_get(&deferred_stats.high_water)) {
+		atomic_set(&deferred_stats.high_water, used + 1);
+	}
+	k_sem_give(&deferred_sem);
+
+	return 0;
+}
+
+static void deferred_thread(void *arg1, void *arg2, void *arg3)
+{
+	struct lcz_bt_scan_adv adv;
+	struct net_buf_simple ad;
+	struct deferred_slot *slot;
+	uint32_t tail;
+	uint32_t count;
+	uint32_t i;
+	size_t user;
+
+	ARG_UNUSED(arg1);
+	ARG_UNUSED(arg2);
+	ARG_UNUSED(arg3);
+
+	while (true) {
+		k_sem_take(&deferred_sem, K_FOREVER);
+
+		tail = (uint32_t)atomic_get(&deferred_tail);
+		count = (uint32_t)atomic_get(&deferred_head) - tail;
+		while (count > 0) {
+			count = MIN(count, CONFIG_LCZ_BT_SCAN_DEFERRED_BATCH_SIZE);
+			for (i = 0; i < count; i++) {
+				slot = &deferred_slots[(tail + i) & DEFERRED_MASK];
+				net_buf_simple_init_with_data(&ad, slot->data,
+							      slot->len);
+				parse_adv(&adv, &slot->addr, slot->rssi,
+					  slot->type, &ad);
+				for (user = 0; user < CONFIG_LCZ_BT_SCAN_MAX_USERS;
+				     user++) {
+					if ((slot->users & BIT(user)) != 0) {
+						adv.duplicate =
+							(slot->duplicate_users &
+							 BIT(user)) != 0;
+						bts.filtered_handlers[user](&adv);
+					}
+				}
+			}
+
+			/* Release the batch to the producer */
+			tail += count;
+			atomic_set(&deferred_tail, tail);
+			atomic_inc(&deferred_stats.batches);
+
+			count = (uint32_t)atomic_get(&deferred_head) - tail;
+		}
+	}
+}
+#endif
@@ -10,10 +10,81 @@
 /**************************************************************************************************/
 /* Includes                                                                                       */
 /**************************************************************************************************/
+#include <sys/byteorder.h>
+
 #include "lcz_bluetooth.h"
 #include "lcz_sensor_adv_format.h"
 #include "lcz_sensor_adv_match.h"
 
+/**************************************************************************************************/
+/* Local Constant, Macro and Type Definitions                                                     */
+/**************************************************************************************************/
+/* The first 4 bytes of the manufacturer specific data (company ID and protocol ID) read as a
+ * little endian word.
+ */
+#define HEADER_WORD(company, protocol) (((uint32_t)(protocol) << 16) | (company))
+
+#define LAIRD_ID1 LAIRD_CONNECTIVITY_MANUFACTURER_SPECIFIC_COMPANY_ID1
+#define LAIRD_ID2 LAIRD_CONNECTIVITY_MANUFACTURER_SPECIFIC_COMPANY_ID2
+#define LYNKZ_ID1 LYNKZ_INSTRUMENT_MANUFACTURER_SPECIFIC_COMPANY_ID1
+
+#define BTXXX_AD_WORD HEADER_WORD(LAIRD_ID1, BTXXX_1M_PHY_AD_PROTOCOL_ID)
+#define BTXXX_CODED_WORD HEADER_WORD(LAIRD_ID1, BTXXX_CODED_PHY_AD_PROTOCOL_ID)
+#define BT6XX_RSP_WORD HEADER_WORD(LAIRD_ID1, BTXXX_1M_PHY_RSP_PROTOCOL_ID)
+#define BT5XX_RSP_WORD HEADER_WORD(LAIRD_ID2, BTXXX_1M_PHY_RSP_PROTOCOL_ID)
+#define BTXXX_DM_1M_WORD HEADER_WORD(LAIRD_ID1, BTXXX_DM_1M_PHY_AD_PROTOCOL_ID)
+#define BTXXX_DM_CODED_WORD HEADER_WORD(LAIRD_ID1, BTXXX_DM_CODED_PHY_AD_PROTOCOL_ID)
+#define BTXXX_DM_ENC_CODED_WORD HEADER_WORD(LAIRD_ID1, BTXXX_DM_ENC_CODED_PHY_AD_PROTOCOL_ID)
+#define LYNKZ_AD_WORD HEADER_WORD(LYNKZ_ID1, LYNKZ_1M_PHY_AD_PROTOCOL_ID)
+#define LYNKZ_RSP_WORD HEADER_WORD(LYNKZ_ID1, LYNKZ_1M_PHY_RSP_PROTOCOL_ID)
+
+/* The table is searched with a binary search */
+BUILD_ASSERT(BTXXX_AD_WORD < BTXXX_CODED_WORD, "Header table isn't sorted");
+BUILD_ASSERT(BTXXX_CODED_WORD < BT6XX_RSP_WORD, "Header table isn't sorted");
+BUILD_ASSERT(BT6XX_RSP_WORD < BT5XX_RSP_WORD, "Header table isn't sorted");
+BUILD_ASSERT(BT5XX_RSP_WORD < BTXXX_DM_1M_WORD, "Header table isn't sorted");
+BUILD_ASSERT(BTXXX_DM_1M_WORD < BTXXX_DM_CODED_WORD, "Header table isn't sorted");
+BUILD_ASSERT(BTXXX_DM_CODED_WORD < BTXXX_DM_ENC_CODED_WORD, "Header table isn't sorted");
+BUILD_ASSERT(BTXXX_DM_ENC_CODED_WORD < LYNKZ_AD_WORD, "Header table isn't sorted");
+BUILD_ASSERT(LYNKZ_AD_WORD < LYNKZ_RSP_WORD, "Header table isn't sorted");
+
+enum match_class { MATCH_1M = 0, MATCH_RSP, MATCH_CODED };
+
+/* A size of zero allows any payload that contains the header */
+struct header_entry {
+	uint32_t word;
+	uint8_t class;
+	uint8_t size;
+	uint16_t protocol_id;
+};
+
+/**************************************************************************************************/
+/* Local Function Prototypes                                                                      */
+/**************************************************************************************************/
+static uint16_t match(AdHandle_t *handle, bool match_1m, bool match_rsp, bool match_coded);
+
+/**************************************************************************************************/
+/* Local Data Definitions                                                                         */
+/**************************************************************************************************/
+static const struct header_entry HEADER_TABLE[] = {
+	{ BTXXX_AD_WORD, MATCH_1M, LCZ_SENSOR_MSD_AD_PAYLOAD_LENGTH,
+	  BTXXX_1M_PHY_AD_PROTOCOL_ID },
+	{ BTXXX_CODED_WORD, MATCH_CODED, LCZ_SENSOR_MSD_CODED_PAYLOAD_LENGTH,
+	  BTXXX_CODED_PHY_AD_PROTOCOL_ID },
+	{ BT6XX_RSP_WORD, MATCH_RSP, LCZ_SENSOR_MSD_RSP_PAYLOAD_LENGTH,
+	  BTXXX_1M_PHY_RSP_PROTOCOL_ID },
+	{ BT5XX_RSP_WORD, MATCH_RSP, LCZ_SENSOR_MSD_RSP_PAYLOAD_LENGTH,
+	  BTXXX_1M_PHY_RSP_PROTOCOL_ID },
+	{ BTXXX_DM_1M_WORD, MATCH_1M, LCZ_SENSOR_MSD_DM_UNENCR_PAYLOAD_LENGTH,
+	  BTXXX_DM_1M_PHY_AD_PROTOCOL_ID },
+	{ BTXXX_DM_CODED_WORD, MATCH_CODED, LCZ_SENSOR_MSD_DM_UNENCR_PAYLOAD_LENGTH,
+	  BTXXX_DM_CODED_PHY_AD_PROTOCOL_ID },
+	{ BTXXX_DM_ENC_CODED_WORD, MATCH_CODED, LCZ_SENSOR_MSD_DM_ENCR_PAYLOAD_LENGTH,
+	  BTXXX_DM_ENC_CODED_PHY_AD_PROTOCOL_ID },
+	{ LYNKZ_AD_WORD, MATCH_1M, 0, LYNKZ_1M_PHY_AD_PROTOCOL_ID },
+	{ LYNKZ_RSP_WORD, MATCH_RSP, 0, LYNKZ_1M_PHY_RSP_PROTOCOL_ID },
+};
+
 /**************************************************************************************************/
 /* Global Function Definitions                                                                    */
 /**************************************************************************************************/
@@ -21,32 +92,13 @@ uint16_t lcz_sensor_adv_match(struct net_buf_simple *ad, bool match_rsp, bool ma
 {
 	AdHandle_t handle =
 		AdFind_Type(ad->data, ad->len, BT_DATA_MANUFACTURER_DATA, BT_DATA_INVALID);
-	uint16_t type;
-
-	if (handle.pPayload == NULL) {
-		return RESERVED_AD_PROTOCOL_ID;
-	}
 
-	type = lcz_sensor_adv_match_1m(&handle);
-	if (type != 0) {
-		return type;
-	}
-
-	if (match_rsp) {
-		type = lcz_sensor_adv_match_rsp(&handle);
-		if (type != 0) {
-			return type;
-		}
-	}
-
-	if (match_coded) {
-		type = lcz_sensor_adv_match_coded(&handle);
-		if (type != 0) {
-			return type;
-		}
-	}
+	return lcz_sensor_adv_match_msd(&handle, match_rsp, match_coded);
+}
 
-	return RESERVED_AD_PROTOCOL_ID;
+uint16_t lcz_sensor_adv_match_msd(AdHandle_t *handle, bool match_rsp, bool match_coded)
+{
+	return match(handle, true, match_rsp, match_coded);
 }
 
 /* The BT510 and BT6xx advertisement can be recognized by the manufacturer
@@ -56,69 +108,56 @@ uint16_t lcz_sensor_adv_match(struct net_buf_simple *ad, bool match_rsp, bool ma
  */
 uint16_t lcz_sensor_adv_match_1m(AdHandle_t *handle)
 {
-	if (handle->pPayload != NULL) {
-		if ((handle->size == LCZ_SENSOR_MSD_AD_PAYLOAD_LENGTH)) {
-			if (memcmp(handle->pPayload, BTXXX_AD_HEADER, sizeof(BTXXX_AD_HEADER)) ==
-			    0) {
-				return BTXXX_1M_PHY_AD_PROTOCOL_ID;
-			}
-		} else if ((handle->size == LCZ_SENSOR_MSD_DM_UNENCR_PAYLOAD_LENGTH)) {
-			if (memcmp(handle->pPayload, BTXXX_DM_1M_HEADER,
-				   sizeof(BTXXX_DM_1M_HEADER)) == 0) {
-				return BTXXX_DM_1M_PHY_AD_PROTOCOL_ID;
-			}
-		} else if ((handle->size >= 5 - 1)) {
-			if (memcmp(handle->pPayload, LYNKZ_AD_HEADER,
-				   sizeof(LYNKZ_AD_HEADER)) == 0) {
-				return LYNKZ_1M_PHY_AD_PROTOCOL_ID;
-			}
-		} 
-	}
-	return 0;
+	return match(handle, true, false, false);
 }
 
 uint16_t lcz_sensor_adv_match_rsp(AdHandle_t *handle)
 {
-	if (handle->pPayload != NULL) {
-		if ((handle->size == LCZ_SENSOR_MSD_RSP_PAYLOAD_LENGTH)) {
-			if (memcmp(handle->pPayload, BT5XX_RSP_HEADER, sizeof(BT5XX_RSP_HEADER)) ==
-			    0) {
-				return BTXXX_1M_PHY_RSP_PROTOCOL_ID;
-			}
-			if (memcmp(handle->pPayload, BT6XX_RSP_HEADER, sizeof(BT6XX_RSP_HEADER)) ==
-			    0) {
-				return BTXXX_1M_PHY_RSP_PROTOCOL_ID;
-			}
-		}
-		else if ((handle->size >= 5 - 1)) {
-			if (memcmp(handle->pPayload, LYNKZ_RSP_HEADER,
-				   sizeof(LYNKZ_RSP_HEADER)) == 0) {
-				return LYNKZ_1M_PHY_RSP_PROTOCOL_ID;
-			}
-		}
-	}
-	return 0;
+	return match(handle, false, true, false);
 }
 
 uint16_t lcz_sensor_adv_match_coded(AdHandle_t *handle)
 {
-	if (handle->pPayload != NULL) {
-		if ((handle->size == LCZ_SENSOR_MSD_CODED_PAYLOAD_LENGTH)) {
-			if (memcmp(handle->pPayload, BTXXX_CODED_HEADER,
-				   sizeof(BTXXX_CODED_HEADER)) == 0) {
-				return BTXXX_CODED_PHY_AD_PROTOCOL_ID;
-			}
-		} else if ((handle->size == LCZ_SENSOR_MSD_DM_UNENCR_PAYLOAD_LENGTH)) {
-			if (memcmp(handle->pPayload, BTXXX_DM_CODED_HEADER,
-				   sizeof(BTXXX_DM_CODED_HEADER)) == 0) {
-				return BTXXX_DM_CODED_PHY_AD_PROTOCOL_ID;
-			}
-		} else if ((handle->size == LCZ_SENSOR_MSD_DM_ENCR_PAYLOAD_LENGTH)) {
-			if (memcmp(handle->pPayload, BTXXX_DM_ENC_CODED_HEADER,
-				   sizeof(BTXXX_DM_ENC_CODED_HEADER)) == 0) {
-				return BTXXX_DM_ENC_CODED_PHY_AD_PROTOCOL_ID;
-			}
+	return match(handle, false, false, true);
+}
+
+/**************************************************************************************************/
+/* Local Function Definitions                                                                     */
+/**************************************************************************************************/
+/* Each header word belongs to one format, so one lookup classifies the payload */
+static uint16_t match(AdHandle_t *handle, bool match_1m, bool match_rsp, bool match_coded)
+{
+	const struct header_entry *entry = NULL;
+	size_t lo = 0;
+	size_t hi = ARRAY_SIZE(HEADER_TABLE);
+	size_t mid;
+	uint32_t word;
+
+	if (handle->pPayload == NULL || handle->size < LCZ_SENSOR_AD_HEADER_SIZE) {
+		return RESERVED_AD_PROTOCOL_ID;
+	}
+
+	word = sys_get_le32(handle->pPayload);
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (HEADER_TABLE[mid].word < word) {
+			lo = mid + 1;
+		} else if (HEADER_TABLE[mid].word > word) {
+			hi = mid;
+		} else {
+			entry = &HEADER_TABLE[mid];
+			break;
 		}
 	}
-	return 0;
+
+	if (entry == NULL || (entry->size != 0 && entry->size != handle->size)) {
+		return RESERVED_AD_PROTOCOL_ID;
+	}
+
+	if ((entry->class == MATCH_1M && match_1m) || (entry->class == MATCH_RSP && match_rsp) ||
+	    (entry->class == MATCH_CODED && match_coded)) {
+		return entry->protocol_id;
+	}
+
+	return RESERVED_AD_PROTOCOL_ID;
 }
@@ -0,0 +1,51 @@
+/**
+ * @file lcz_flash_wear.h
+ * @brief Keeps QSPI flash erase counts across resets
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_FLASH_WEAR_H__
+#define __LCZ_FLASH_WEAR_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Get erase counts of the QSPI flash.
+ * Counts saved by previous boots are included once the file system is
+ * mounted. The size of each region is given by
+ * lcz_nrf_qspi_nor_get_wear_units().
+ *
+ * @param first index of first region
+ * @param counts filled in
+ * @param count maximum number of counts
+ *
+ * @retval number of counts copied, negative errno on error
+ */
+int lcz_flash_wear_get(uint32_t first, uint32_t *counts, size_t count);
+
+/**
+ * @brief Save erase counts now instead of waiting for the next period.
+ *
+ * @retval 0 on success (or if nothing has changed), -EAGAIN if the file
+ * system isn't mounted, negative errno otherwise
+ */
+int lcz_flash_wear_save(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_FLASH_WEAR_H__ */
@@ -0,0 +1,164 @@
+/**
+ * @file lcz_no_init_ram_ring.h
+ *
+ * @brief Ring buffer of variable length records in non-initialized RAM.
+ * The contents survive a warm reset (watchdog, software reset, fault) so
+ * that records can be staged in RAM and written to flash in large batches.
+ *
+ * The control block is kept twice, each copy protected by a
+ * no_init_ram_header_t, and the copies are updated alternately. Each record
+ * has its own CRC. After a reset the newest valid control block is used and
+ * records are checked in order; the ring is truncated at the first record
+ * that fails.
+ *
+ * Records are removed only when the consumer has finished with them, so a
+ * reset while a batch is being written to flash gives the batch again
+ * (at-least-once).
+ *
+ * @example
+ * static uint8_t log_ring_mem[LCZ_NO_INIT_RAM_RING_MEM_SIZE(2048)]
+ *	__noinit __aligned(4);
+ * static struct lcz_no_init_ram_ring log_ring;
+ *
+ * lcz_no_init_ram_ring_init(&log_ring, log_ring_mem, sizeof(log_ring_mem));
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_NO_INIT_RAM_RING_H__
+#define __LCZ_NO_INIT_RAM_RING_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <zephyr/types.h>
+#include <stddef.h>
+
+#include "lcz_no_init_ram_var.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Each record is a 4 byte header (length and CRC16) and 32-bit aligned data */
+#define LCZ_NO_INIT_RAM_RING_RECORD_HEADER_SIZE 4
+#define LCZ_NO_INIT_RAM_RING_MAX_RECORD_SIZE UINT16_MAX
+
+typedef struct lcz_no_init_ram_ring_ctrl {
+	no_init_ram_header_t header;
+	uint32_t seq;
+	uint32_t size;
+	uint32_t tail;
+	uint32_t used;
+	uint32_t count;
+} lcz_no_init_ram_ring_ctrl_t;
+
+/* Memory required for a ring with data_size bytes of record storage */
+#define LCZ_NO_INIT_RAM_RING_MEM_SIZE(data_size)                               \
+	((2 * sizeof(lcz_no_init_ram_ring_ctrl_t)) + ROUND_UP(data_size, 4))
+
+struct lcz_no_init_ram_ring {
+	struct k_spinlock lock;
+	lcz_no_init_ram_ring_ctrl_t *ctrl;
+	uint8_t *data;
+	lcz_no_init_ram_ring_ctrl_t state;
+};
+
+/* Position of the consumer while reading a batch */
+struct lcz_no_init_ram_ring_cursor {
+	uint32_t offset;
+	uint32_t records;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Attach a ring to non-initialized memory and recover the records
+ * that were in it before the reset. The ring is emptied if the memory
+ * doesn't contain a valid ring (power on reset).
+ *
+ * @param ring ring to initialize
+ * @param mem 32-bit aligned memory, see LCZ_NO_INIT_RAM_RING_MEM_SIZE
+ * @param size size of mem in bytes
+ *
+ * @retval number of records recovered, -EINVAL if the memory is too small
+ * or isn't aligned.
+ */
+int lcz_no_init_ram_ring_init(struct lcz_no_init_ram_ring *ring, void *mem,
+			      size_t size);
+
+/**
+ * @brief Add a record. Can be called from an ISR.
+ *
+ * @param ring ring
+ * @param data record
+ * @param length size of record in bytes
+ *
+ * @retval 0 on success, -ENOSPC if the ring is full, -EINVAL if length is
+ * zero or can never fit.
+ */
+int lcz_no_init_ram_ring_put(struct lcz_no_init_ram_ring *ring,
+			     const void *data, size_t length);
+
+/**
+ * @brief Copy the record at the cursor without removing it and advance the
+ * cursor. Start with a zeroed cursor; use lcz_no_init_ram_ring_consume to
+ * remove the records that have been read.
+ *
+ * @param ring ring
+ * @param cursor read position
+ * @param buf destination
+ * @param size size of buf
+ *
+ * @retval length of the record, -ENODATA if there are no more records,
+ * -ENOMEM if the record doesn't fit in buf (cursor isn't advanced).
+ */
+int lcz_no_init_ram_ring_peek(struct lcz_no_init_ram_ring *ring,
+			      struct lcz_no_init_ram_ring_cursor *cursor,
+			      void *buf, size_t size);
+
+/**
+ * @brief Remove the records before the cursor.
+ *
+ * @param ring ring
+ * @param cursor read position from lcz_no_init_ram_ring_peek
+ */
+void lcz_no_init_ram_ring_consume(struct lcz_no_init_ram_ring *ring,
+				  const struct lcz_no_init_ram_ring_cursor *cursor);
+
+/**
+ * @brief Copy and remove the oldest record.
+ *
+ * @retval length of the record, -ENODATA if the ring is empty, -ENOMEM if
+ * the record doesn't fit in buf.
+ */
+int lcz_no_init_ram_ring_get(struct lcz_no_init_ram_ring *ring, void *buf,
+			     size_t size);
+
+/**
+ * @brief Remove all records.
+ */
+void lcz_no_init_ram_ring_reset(struct lcz_no_init_ram_ring *ring);
+
+/**
+ * @retval number of records in the ring
+ */
+uint32_t lcz_no_init_ram_ring_count(struct lcz_no_init_ram_ring *ring);
+
+/**
+ * @retval number of bytes of record storage in use (including headers and
+ * padding)
+ */
+uint32_t lcz_no_init_ram_ring_used(struct lcz_no_init_ram_ring *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_NO_INIT_RAM_RING_H__ */
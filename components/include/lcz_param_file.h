@@ -33,8 +33,27 @@ typedef struct param_kvp {
 	param_id_t id;
 	char *keystr;
 	int length;
+	/* Value is binary data (not hex) from a binary parameter file. Only set when
+	 * CONFIG_LCZ_PARAM_FILE_BIN_RAW_VALUES is enabled; otherwise values are text.
+	 */
+	bool raw;
 } param_kvp_t;
 
+/* Binary parameter files start with the CBOR self-described tag (55799). The tag is followed
+ * by a map of parameter id (unsigned) to value (byte string for PARAM_BIN or text string
+ * for PARAM_STR).
+ */
+#define LCZ_PARAM_FILE_BIN_MAGIC "\xD9\xD9\xF7"
+#define LCZ_PARAM_FILE_BIN_MAGIC_SIZE (sizeof(LCZ_PARAM_FILE_BIN_MAGIC) - 1)
+
+/* Collects parameter and feedback updates so they can be committed together */
+typedef struct lcz_param_file_txn {
+	char *params;
+	char *feedback;
+	int count;
+	bool encrypted;
+} lcz_param_file_txn_t;
+
 /**************************************************************************************************/
 /* Global Function Prototypes                                                                     */
 /**************************************************************************************************/
@@ -95,6 +114,14 @@ ssize_t lcz_param_file_enc_read(char *name, void *data, size_t size);
  */
 int lcz_param_file_delete(char *name);
 
+/**
+ * @brief Get the parameter file generation. It changes after every write or
+ * delete of a parameter file using this module, including ones that fail.
+ *
+ * @retval generation counter
+ */
+uint32_t lcz_param_file_generation(void);
+
 /**
  * @brief Override weak implementation in application to use a
  * different mount point than the one used by the FSU module.
@@ -106,6 +133,10 @@ int lcz_param_file_mount_fs(void);
 /**
  * @brief Parses a parameter text file.  Data is in hex with least
  * significant byte first.
+ * Binary parameter files (see LCZ_PARAM_FILE_BIN_MAGIC) are also accepted.
+ * Their PARAM_BIN values are hex encoded so that they have the same form as in a
+ * text file, unless CONFIG_LCZ_PARAM_FILE_BIN_RAW_VALUES is enabled (then they
+ * are passed through and marked raw).
  *
  * @note Example File:
  * 0000=0A00\n
@@ -131,6 +162,8 @@ int lcz_param_file_parse_from_file(const char *fname, size_t *fsize, char **fstr
 /**
  * @brief Parses an encrypted parameter text file.  Data is in hex with least
  * significant byte first.
+ * Binary parameter files (see LCZ_PARAM_FILE_BIN_MAGIC) are also accepted and
+ * are returned as for lcz_param_file_parse_from_file().
  *
  * @note Example File:
  * 0000=0A00\n
@@ -182,6 +215,35 @@ int lcz_param_file_validate_file(const char *str, size_t size);
 int lcz_param_file_generate_file(param_id_t id, param_t type, const void *data, size_t dsize,
 				 char **fstr);
 
+/**
+ * @brief Generates a binary parameter file. Allocates buffer on first call and
+ * appends to buffer on subsequent calls.
+ *
+ * @param id The id of the parameter to add.
+ * @param type The type of the parameter.
+ * @param data pointer
+ * @param dsize size of the data in bytes. The hex form of PARAM_BIN data (two
+ * characters per byte) must fit in CONFIG_LCZ_PARAM_FILE_MAX_VALUE_LENGTH.
+ * @param fbin pointer to buffer. Allocated by this function when pointing to NULL.
+ * @param length pointer to length of file in buffer (updated by this function).
+ *
+ * @note Caller is responsible for freeing fbin.
+ *
+ * @retval negative on error, otherwise number of bytes added to file.
+ */
+int lcz_param_file_generate_bin(param_id_t id, param_t type, const void *data, size_t dsize,
+				uint8_t **fbin, size_t *length);
+
+/**
+ * @brief Validate a binary parameter file.
+ *
+ * @param data binary parameter file (starting with LCZ_PARAM_FILE_BIN_MAGIC)
+ * @param size length of file.
+ *
+ * @retval negative on error, otherwise number of key-value pairs.
+ */
+int lcz_param_file_validate_bin(const uint8_t *data, size_t size);
+
 /**
  * @brief Appends parameter load error information to the passed string
  * buffer.
@@ -194,6 +256,65 @@ int lcz_param_file_generate_file(param_id_t id, param_t type, const void *data,
  */
 int lcz_param_file_append_feedback(param_id_t id, uint8_t error_code, uint8_t *write_data);
 
+/**
+ * @brief Start a transaction.
+ *
+ * @param txn pointer to transaction
+ * @param encrypted true if the parameter file should be written encrypted
+ *
+ * @retval negative error code, 0 on success
+ */
+int lcz_param_file_txn_begin(lcz_param_file_txn_t *txn, bool encrypted);
+
+/**
+ * @brief Add a parameter to a transaction.
+ *
+ * @param txn pointer to transaction
+ * @param id The id of the parameter to add.
+ * @param type The type of the parameter.
+ * @param data pointer
+ * @param dsize size of the data in bytes
+ *
+ * @retval negative on error, otherwise number of bytes added to parameter file.
+ */
+int lcz_param_file_txn_add(lcz_param_file_txn_t *txn, param_id_t id, param_t type,
+			   const void *data, size_t dsize);
+
+/**
+ * @brief Add parameter load error information to a transaction.
+ *
+ * @param txn pointer to transaction
+ * @param id The id of the parameter.
+ * @param error_code The error code to add.
+ *
+ * @retval negative on error, otherwise number of bytes added to feedback file.
+ */
+int lcz_param_file_txn_feedback(lcz_param_file_txn_t *txn, param_id_t id, uint8_t error_code);
+
+/**
+ * @brief Write the parameters and the feedback in one write each and free the transaction.
+ *
+ * The new parameter file replaces the old one atomically. A cleartext file is written
+ * to a temporary file and renamed. An encrypted file can't be renamed (its name is part
+ * of its authentication data) so a journal is written first and replayed on the next
+ * boot if the commit was interrupted.
+ *
+ * @param txn pointer to transaction
+ * @param name parameter file name (prepended with CONFIG_LCZ_PARAM_FILE_MOUNT_POINT)
+ * @param feedback_name cleartext feedback file name (prepended with
+ * CONFIG_LCZ_PARAM_FILE_MOUNT_POINT). Not written if NULL or if there isn't any feedback.
+ *
+ * @retval negative error code, otherwise number of parameters committed.
+ */
+int lcz_param_file_txn_commit(lcz_param_file_txn_t *txn, char *name, char *feedback_name);
+
+/**
+ * @brief Discard a transaction.
+ *
+ * @param txn pointer to transaction
+ */
+void lcz_param_file_txn_abort(lcz_param_file_txn_t *txn);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,99 @@
+/**
+ * @file lcz_param_file_store.h
+ * @brief Resident parameter store. A parameter file is parsed once and kept in RAM
+ * with a hash index so that a parameter can be looked up without scanning the
+ * file or touching the filesystem.
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_PARAM_FILE_STORE_H__
+#define __LCZ_PARAM_FILE_STORE_H__
+
+/**************************************************************************************************/
+/* Includes                                                                                       */
+/**************************************************************************************************/
+#include <zephyr.h>
+#include <zephyr/types.h>
+#include <stddef.h>
+
+#include "file_system_utilities.h"
+#include "lcz_param_file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************/
+/* Global Constants, Macros and Type Definitions                                                  */
+/**************************************************************************************************/
+struct lcz_param_file_store {
+	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	bool encrypted;
+	bool loaded;
+	uint32_t generation;
+	ssize_t file_size;
+	size_t fsize;
+	char *fstr;
+	param_kvp_t *kv;
+	int pairs;
+	uint16_t *index;
+	size_t index_size;
+	struct k_mutex lock;
+};
+
+/**************************************************************************************************/
+/* Global Function Prototypes                                                                     */
+/**************************************************************************************************/
+/**
+ * @brief Initialize a store. The file isn't read until the first lookup.
+ *
+ * @param store pointer to store
+ * @param abs_path absolute path of the parameter file
+ * @param encrypted true if the file is encrypted
+ *
+ * @retval negative error code, 0 on success
+ */
+int lcz_param_file_store_init(struct lcz_param_file_store *store, const char *abs_path,
+			      bool encrypted);
+
+/**
+ * @brief Copy the value of a parameter as it appears in a text parameter file
+ * (byte arrays are hex, also when the file is binary). The file is only (re)loaded if it hasn't been loaded yet or if
+ * a parameter file has been written since it was loaded.
+ *
+ * @param store pointer to store
+ * @param id parameter id
+ * @param data buffer for value
+ * @param size size of buffer
+ *
+ * @retval -ENOENT if parameter isn't in file, negative error code,
+ * otherwise the length of the value (which may be larger than size).
+ */
+ssize_t lcz_param_file_store_read(struct lcz_param_file_store *store, param_id_t id, void *data,
+				  size_t size);
+
+/**
+ * @brief Reload the file if the parameter file generation or the size of the file
+ * has changed. This should be called after the file may have been changed
+ * without using the parameter file module (for example, by a file transfer).
+ *
+ * @param store pointer to store
+ *
+ * @retval negative error code, otherwise the number of parameters in the store
+ */
+int lcz_param_file_store_refresh(struct lcz_param_file_store *store);
+
+/**
+ * @brief Free the memory used by a store. The next lookup reloads the file.
+ *
+ * @param store pointer to store
+ */
+void lcz_param_file_store_free(struct lcz_param_file_store *store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_PARAM_FILE_STORE_H__ */
@@ -13,11 +13,33 @@
 /* Includes                                                                   */
 /******************************************************************************/
 #include <zephyr/types.h>
+#include <stddef.h>
+#include <fs/fs.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#ifdef CONFIG_LCZ_RAMDISK_BACKEND_TMPFS
+/* File system type registered by the tmpfs backend */
+#define LCZ_RAMDISK_FS_TYPE                                                    \
+	(FS_TYPE_EXTERNAL_BASE + CONFIG_LCZ_RAMDISK_TMPFS_FS_TYPE_OFFSET)
+#endif
+
+/**
+ * @param data start of the contents
+ * @param size number of contiguous bytes at data
+ * @param priv file the contents belong to (used by lcz_ramdisk_unmap)
+ */
+struct lcz_ramdisk_map {
+	const uint8_t *data;
+	size_t size;
+	void *priv;
+};
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -28,6 +50,32 @@ extern "C" {
  */
 int ramfs_mount(void);
 
+/**
+ * @brief Get a pointer into the contents of a file on the RAMDISK without
+ * copying them (CONFIG_LCZ_RAMDISK_BACKEND_TMPFS).
+ *
+ * The contents of a file are stored in extents, so the map covers the bytes
+ * from offset to the end of the extent (or file). Map the next offset to
+ * continue. While a file is mapped data can be appended to it, but it can't
+ * be overwritten, truncated to a smaller size or deleted (-EBUSY).
+ *
+ * @param abs_path file name including the mount point
+ * @param offset offset into the file
+ * @param map filled with the location of the contents
+ *
+ * @retval 0 on success, -ENOENT if the file doesn't exist, -EINVAL if
+ * offset isn't within the file, -ENOTSUP if the backend isn't tmpfs.
+ */
+int lcz_ramdisk_map(const char *abs_path, off_t offset,
+		    struct lcz_ramdisk_map *map);
+
+/**
+ * @brief Release a map obtained with lcz_ramdisk_map.
+ *
+ * @param map map to release
+ */
+void lcz_ramdisk_unmap(struct lcz_ramdisk_map *map);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,284 @@
+/**
+ * @file lcz_flash_wear.c
+ * @brief Keeps QSPI flash erase counts across resets
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(lcz_flash_wear, CONFIG_LCZ_FLASH_WEAR_LOG_LEVEL);
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+#include <zephyr.h>
+#include <device.h>
+#include <init.h>
+#include <fs/fs.h>
+
+#include "file_system_utilities.h"
+#include "lcz_nrf_qspi_nor.h"
+#include "lcz_flash_wear.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define QSPI_NOR_NODE DT_INST(0, nordic_qspi_nor)
+
+#define WEAR_UNIT CONFIG_LCZ_NRF_QSPI_NOR_TELEMETRY_WEAR_UNIT
+#define WEAR_UNITS ((DT_PROP(QSPI_NOR_NODE, size) / 8) / WEAR_UNIT)
+#define WEAR_FILE_MAGIC 0x52415751
+#define WEAR_TMP_FILE CONFIG_LCZ_FLASH_WEAR_FILE ".tmp"
+
+/* Counts are read from the driver in chunks to limit stack use */
+#define WEAR_CHUNK 16
+
+/* Seconds between attempts to load the counts until the file system is mounted */
+#define WEAR_LOAD_RETRY 5
+
+/* The file is the header followed by a count for each unit */
+struct wear_header {
+	uint32_t magic;
+	uint32_t unit;
+	uint32_t units;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const struct device *flash_dev = DEVICE_DT_GET(QSPI_NOR_NODE);
+
+static K_MUTEX_DEFINE(wear_lock);
+
+static struct k_work_delayable wear_work;
+
+/* Counts saved by previous boots */
+static uint32_t wear_base[WEAR_UNITS];
+
+static bool wear_loaded;
+
+/* Sum of the driver's counts when the file was last written */
+static uint64_t wear_saved;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int wear_load(void);
+static int wear_write(struct fs_file_t *f);
+static uint64_t erases_since_boot(void);
+static void wear_handler(struct k_work *item);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int lcz_flash_wear_get(uint32_t first, uint32_t *counts, size_t count)
+{
+	int n;
+	int i;
+
+	k_mutex_lock(&wear_lock, K_FOREVER);
+	(void)wear_load();
+	n = lcz_nrf_qspi_nor_get_wear(flash_dev, first, counts, count);
+	if (wear_loaded) {
+		for (i = 0; i < n; i++) {
+			counts[i] += wear_base[first + i];
+		}
+	}
+	k_mutex_unlock(&wear_lock);
+
+	return n;
+}
+
+int lcz_flash_wear_save(void)
+{
+	struct fs_file_t f;
+	uint64_t erases;
+	int r;
+	int r2;
+
+	k_mutex_lock(&wear_lock, K_FOREVER);
+	do {
+		r = wear_load();
+		if (r < 0) {
+			break;
+		}
+
+		erases = erases_since_boot();
+		if (erases == wear_saved) {
+			break;
+		}
+
+		fs_file_t_init(&f);
+		r = fs_open(&f, WEAR_TMP_FILE, FS_O_CREATE | FS_O_WRITE);
+		if (r < 0) {
+			LOG_ERR("Unable to open %s: %d", WEAR_TMP_FILE, r);
+			break;
+		}
+
+		r = wear_write(&f);
+		r2 = fs_close(&f);
+		if (r == 0) {
+			r = r2;
+		}
+
+		if (r == 0) {
+			r = fsu_rename_abs(WEAR_TMP_FILE, CONFIG_LCZ_FLASH_WEAR_FILE);
+		}
+
+		if (r < 0) {
+			LOG_ERR("Unable to save erase counts: %d", r);
+		} else {
+			/* Erases caused by the save are included in the next one */
+			wear_saved = erases_since_boot();
+		}
+	} while (0);
+	k_mutex_unlock(&wear_lock);
+
+	return r;
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* Lock must be held */
+static int wear_load(void)
+{
+	struct wear_header header;
+	struct fs_statvfs stat;
+	ssize_t size;
+
+	if (wear_loaded) {
+		return 0;
+	}
+
+	/* A missing file only means there are no saved counts if the
+	 * file system is mounted.
+	 */
+	if (fs_statvfs(CONFIG_FSU_MOUNT_POINT, &stat) < 0) {
+		return -EAGAIN;
+	}
+
+	size = fsu_get_file_size_abs(CONFIG_LCZ_FLASH_WEAR_FILE);
+	if (size == (sizeof(header) + sizeof(wear_base))) {
+		size = fsu_read_abs_block(CONFIG_LCZ_FLASH_WEAR_FILE, 0, &header,
+					  sizeof(header));
+		if (size != sizeof(header)) {
+			LOG_ERR("Unable to read erase counts: %d", (int)size);
+			return (size < 0) ? (int)size : -EIO;
+		}
+
+		if (header.magic == WEAR_FILE_MAGIC && header.unit == WEAR_UNIT &&
+		    header.units == WEAR_UNITS) {
+			size = fsu_read_abs_block(CONFIG_LCZ_FLASH_WEAR_FILE,
+						  sizeof(header), wear_base,
+						  sizeof(wear_base));
+			if (size != sizeof(wear_base)) {
+				LOG_ERR("Unable to read erase counts: %d", (int)size);
+				memset(wear_base, 0, sizeof(wear_base));
+				return (size < 0) ? (int)size : -EIO;
+			}
+		} else {
+			LOG_WRN("Discarding erase counts with a different layout");
+		}
+	} else if (size >= 0) {
+		LOG_WRN("Discarding erase counts with a different layout");
+	}
+
+	wear_loaded = true;
+	return 0;
+}
+
+/* Write the header and the total of the saved and current counts */
+static int wear_write(struct fs_file_t *f)
+{
+	struct wear_header header = {
+		.magic = WEAR_FILE_MAGIC,
+		.unit = WEAR_UNIT,
+		.units = WEAR_UNITS,
+	};
+	uint32_t counts[WEAR_CHUNK];
+	uint32_t first;
+	ssize_t size;
+	int n;
+	int i;
+	int r;
+
+	/* The file is left behind by a save that was interrupted */
+	r = fs_truncate(f, 0);
+	if (r < 0) {
+		return r;
+	}
+
+	size = fs_write(f, &header, sizeof(header));
+	if (size != sizeof(header)) {
+		return (size < 0) ? (int)size : -ENOSPC;
+	}
+
+	for (first = 0; first < WEAR_UNITS; first += n) {
+		n = lcz_nrf_qspi_nor_get_wear(flash_dev, first, counts,
+					      ARRAY_SIZE(counts));
+		if (n <= 0) {
+			return (n < 0) ? n : -EIO;
+		}
+
+		for (i = 0; i < n; i++) {
+			counts[i] += wear_base[first + i];
+		}
+		size = fs_write(f, counts, n * sizeof(uint32_t));
+		if (size != (n * sizeof(uint32_t))) {
+			return (size < 0) ? (int)size : -ENOSPC;
+		}
+	}
+
+	return 0;
+}
+
+static uint64_t erases_since_boot(void)
+{
+	uint32_t counts[WEAR_CHUNK];
+	uint64_t total = 0;
+	uint32_t first;
+	int n;
+	int i;
+
+	for (first = 0; first < WEAR_UNITS; first += n) {
+		n = lcz_nrf_qspi_nor_get_wear(flash_dev, first, counts,
+					      ARRAY_SIZE(counts));
+		if (n <= 0) {
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			total += counts[i];
+		}
+	}
+
+	return total;
+}
+
+/* Load the counts soon after the file system is mounted, then save them
+ * periodically.
+ */
+static void wear_handler(struct k_work *item)
+{
+	(void)lcz_flash_wear_save();
+	k_work_schedule(&wear_work,
+			K_SECONDS(wear_loaded ? CONFIG_LCZ_FLASH_WEAR_SAVE_PERIOD :
+						WEAR_LOAD_RETRY));
+}
+
+static int lcz_flash_wear_init(const struct device *device)
+{
+	ARG_UNUSED(device);
+
+	/* The file system isn't mounted yet */
+	k_work_init_delayable(&wear_work, wear_handler);
+	(void)k_work_schedule(&wear_work, K_SECONDS(WEAR_LOAD_RETRY));
+
+	return 0;
+}
+
+SYS_INIT(lcz_flash_wear_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,302 @@
+/**
+ * @file lcz_no_init_ram_ring.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+#include <sys/crc.h>
+
+#include "lcz_no_init_ram_ring.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define REC_HDR_SIZE LCZ_NO_INIT_RAM_RING_RECORD_HEADER_SIZE
+#define CTRL_DATA_SIZE                                                         \
+	(sizeof(lcz_no_init_ram_ring_ctrl_t) - NO_INIT_RAM_HEADER_SIZE)
+#define RECORD_SPACE(length) (REC_HDR_SIZE + ROUND_UP(length, 4))
+
+BUILD_ASSERT(sizeof(no_init_ram_header_t) == NO_INIT_RAM_HEADER_SIZE,
+	     "Unexpected header size");
+
+struct rec_hdr {
+	uint16_t length;
+	uint16_t crc;
+};
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void copy_in(struct lcz_no_init_ram_ring *ring, uint32_t offset,
+		    const void *src, size_t size);
+static void copy_out(struct lcz_no_init_ram_ring *ring, uint32_t offset,
+		     void *dest, size_t size);
+static uint16_t record_crc(struct lcz_no_init_ram_ring *ring, uint32_t offset,
+			   uint16_t length);
+static bool read_hdr(struct lcz_no_init_ram_ring *ring, uint32_t offset,
+		     uint32_t limit, struct rec_hdr *hdr);
+static bool ctrl_is_valid(lcz_no_init_ram_ring_ctrl_t *ctrl, uint32_t size);
+static void commit(struct lcz_no_init_ram_ring *ring);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int lcz_no_init_ram_ring_init(struct lcz_no_init_ram_ring *ring, void *mem,
+			      size_t size)
+{
+	lcz_no_init_ram_ring_ctrl_t *ctrl = mem;
+	lcz_no_init_ram_ring_ctrl_t *newest = NULL;
+	struct rec_hdr hdr;
+	uint32_t data_size;
+	uint32_t offset = 0;
+	uint32_t count = 0;
+	int i;
+
+	if (ring == NULL || mem == NULL || ((uintptr_t)mem % 4) != 0 ||
+	    size < LCZ_NO_INIT_RAM_RING_MEM_SIZE(REC_HDR_SIZE + 4)) {
+		return -EINVAL;
+	}
+
+	data_size = ROUND_DOWN(size - (2 * sizeof(*ctrl)), 4);
+
+	memset(ring, 0, sizeof(*ring));
+	ring->ctrl = ctrl;
+	ring->data = (uint8_t *)&ctrl[2];
+
+	/* Use the most recently written control block */
+	for (i = 0; i < 2; i++) {
+		if (ctrl_is_valid(&ctrl[i], data_size) &&
+		    (newest == NULL || (int32_t)(ctrl[i].seq - newest->seq) > 0)) {
+			newest = &ctrl[i];
+		}
+	}
+
+	if (newest == NULL) {
+		ring->state.size = data_size;
+		commit(ring);
+		return 0;
+	}
+
+	ring->state = *newest;
+
+	/* Keep the records up to the first one that is corrupt */
+	while (count < ring->state.count &&
+	       read_hdr(ring, offset, ring->state.used, &hdr) &&
+	       record_crc(ring, offset, hdr.length) == hdr.crc) {
+		offset += RECORD_SPACE(hdr.length);
+		count += 1;
+	}
+
+	if (count != ring->state.count || offset != ring->state.used) {
+		ring->state.count = count;
+		ring->state.used = offset;
+		commit(ring);
+	}
+
+	return count;
+}
+
+int lcz_no_init_ram_ring_put(struct lcz_no_init_ram_ring *ring,
+			     const void *data, size_t length)
+{
+	struct rec_hdr hdr;
+	k_spinlock_key_t key;
+	uint32_t head;
+	int r = 0;
+
+	if (length == 0 || length > LCZ_NO_INIT_RAM_RING_MAX_RECORD_SIZE ||
+	    RECORD_SPACE(length) > ring->state.size) {
+		return -EINVAL;
+	}
+
+	hdr.length = length;
+	hdr.crc = crc16_ccitt(0xFFFF, (const uint8_t *)&hdr.length,
+			      sizeof(hdr.length));
+	hdr.crc = crc16_ccitt(hdr.crc, data, length);
+
+	key = k_spin_lock(&ring->lock);
+
+	if (RECORD_SPACE(length) > (ring->state.size - ring->state.used)) {
+		r = -ENOSPC;
+	} else {
+		head = ring->state.tail + ring->state.used;
+		copy_in(ring, head, &hdr, sizeof(hdr));
+		copy_in(ring, head + REC_HDR_SIZE, data, length);
+		ring->state.used += RECORD_SPACE(length);
+		ring->state.count += 1;
+		commit(ring);
+	}
+
+	k_spin_unlock(&ring->lock, key);
+
+	return r;
+}
+
+int lcz_no_init_ram_ring_peek(struct lcz_no_init_ram_ring *ring,
+			      struct lcz_no_init_ram_ring_cursor *cursor,
+			      void *buf, size_t size)
+{
+	struct rec_hdr hdr;
+	k_spinlock_key_t key;
+	uint32_t offset;
+	int r;
+
+	key = k_spin_lock(&ring->lock);
+
+	offset = ring->state.tail + cursor->offset;
+	if (cursor->records >= ring->state.count) {
+		r = -ENODATA;
+	} else {
+		copy_out(ring, offset, &hdr, sizeof(hdr));
+		if (hdr.length > size) {
+			r = -ENOMEM;
+		} else {
+			copy_out(ring, offset + REC_HDR_SIZE, buf, hdr.length);
+			cursor->offset += RECORD_SPACE(hdr.length);
+			cursor->records += 1;
+			r = hdr.length;
+		}
+	}
+
+	k_spin_unlock(&ring->lock, key);
+
+	return r;
+}
+
+void lcz_no_init_ram_ring_consume(struct lcz_no_init_ram_ring *ring,
+				  const struct lcz_no_init_ram_ring_cursor *cursor)
+{
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&ring->lock);
+
+	if (cursor->records > 0 && cursor->records <= ring->state.count &&
+	    cursor->offset <= ring->state.used) {
+		ring->state.tail =
+			(ring->state.tail + cursor->offset) % ring->state.size;
+		ring->state.used -= cursor->offset;
+		ring->state.count -= cursor->records;
+		commit(ring);
+	}
+
+	k_spin_unlock(&ring->lock, key);
+}
+
+int lcz_no_init_ram_ring_get(struct lcz_no_init_ram_ring *ring, void *buf,
+			     size_t size)
+{
+	struct lcz_no_init_ram_ring_cursor cursor = { 0 };
+	int r;
+
+	/* There is a single consumer so the record can't change in between */
+	r = lcz_no_init_ram_ring_peek(ring, &cursor, buf, size);
+	if (r >= 0) {
+		lcz_no_init_ram_ring_consume(ring, &cursor);
+	}
+
+	return r;
+}
+
+void lcz_no_init_ram_ring_reset(struct lcz_no_init_ram_ring *ring)
+{
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&ring->lock);
+	ring->state.tail = 0;
+	ring->state.used = 0;
+	ring->state.count = 0;
+	commit(ring);
+	k_spin_unlock(&ring->lock, key);
+}
+
+uint32_t lcz_no_init_ram_ring_count(struct lcz_no_init_ram_ring *ring)
+{
+	return ring->state.count;
+}
+
+uint32_t lcz_no_init_ram_ring_used(struct lcz_no_init_ram_ring *ring)
+{
+	return ring->state.used;
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* The data area is a multiple of 4 so a record header never wraps */
+static void copy_in(struct lcz_no_init_ram_ring *ring, uint32_t offset,
+		    const void *src, size_t size)
+{
+	uint32_t start = offset % ring->state.size;
+	size_t first = MIN(size, ring->state.size - start);
+
+	memcpy(&ring->data[start], src, first);
+	memcpy(ring->data, (const uint8_t *)src + first, size - first);
+}
+
+static void copy_out(struct lcz_no_init_ram_ring *ring, uint32_t offset,
+		     void *dest, size_t size)
+{
+	uint32_t start = offset % ring->state.size;
+	size_t first = MIN(size, ring->state.size - start);
+
+	memcpy(dest, &ring->data[start], first);
+	memcpy((uint8_t *)dest + first, ring->data, size - first);
+}
+
+/* offset is relative to the tail */
+static uint16_t record_crc(struct lcz_no_init_ram_ring *ring, uint32_t offset,
+			   uint16_t length)
+{
+	uint32_t start = (ring->state.tail + offset + REC_HDR_SIZE) %
+			 ring->state.size;
+	size_t first = MIN(length, ring->state.size - start);
+	uint16_t crc;
+
+	crc = crc16_ccitt(0xFFFF, (const uint8_t *)&length, sizeof(length));
+	crc = crc16_ccitt(crc, &ring->data[start], first);
+	return crc16_ccitt(crc, ring->data, length - first);
+}
+
+/* Read the header of the record at offset (relative to the tail) and check
+ * that the record fits within limit.
+ */
+static bool read_hdr(struct lcz_no_init_ram_ring *ring, uint32_t offset,
+		     uint32_t limit, struct rec_hdr *hdr)
+{
+	if ((limit - offset) < (REC_HDR_SIZE + 4)) {
+		return false;
+	}
+
+	copy_out(ring, ring->state.tail + offset, hdr, sizeof(*hdr));
+
+	return hdr->length > 0 &&
+	       RECORD_SPACE(hdr->length) <= (limit - offset);
+}
+
+static bool ctrl_is_valid(lcz_no_init_ram_ring_ctrl_t *ctrl, uint32_t size)
+{
+	return lcz_no_init_ram_var_is_valid(ctrl, CTRL_DATA_SIZE) &&
+	       ctrl->size == size && ctrl->tail < size &&
+	       (ctrl->tail % 4) == 0 && ctrl->used <= size &&
+	       (ctrl->used % 4) == 0;
+}
+
+/* Write the state to the older control block so that a reset part way
+ * through leaves the previous state intact.
+ */
+static void commit(struct lcz_no_init_ram_ring *ring)
+{
+	lcz_no_init_ram_ring_ctrl_t *ctrl;
+
+	ring->state.seq += 1;
+	ctrl = &ring->ctrl[ring->state.seq % 2];
+	*ctrl = ring->state;
+	lcz_no_init_ram_var_update_header(ctrl, CTRL_DATA_SIZE);
+}
@@ -22,6 +22,9 @@ LOG_MODULE_REGISTER(lcz_param_file, CONFIG_LCZ_PARAM_FILE_LOG_LEVEL);
 #include <zephyr.h>
 #include <fs/fs.h>
 #include <sys/util.h>
+#include <sys/atomic.h>
+#include <sys/byteorder.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <stdio.h>
@@ -55,11 +58,34 @@ LOG_MODULE_REGISTER(lcz_param_file, CONFIG_LCZ_PARAM_FILE_LOG_LEVEL);
 
 #define PARAMS_PATH CONFIG_LCZ_PARAM_FILE_MOUNT_POINT "/" CONFIG_LCZ_PARAM_FILE_PATH
 
+/* A transaction writes the new file to <name>.txn. For encrypted files <name>.txc marks
+ * the journal as complete until the parameter file has been rewritten.
+ */
+#define TXN_JOURNAL_SUFFIX ".txn"
+#define TXN_COMMIT_SUFFIX ".txc"
+
+/* Subset of CBOR used by binary parameter files */
+#define CBOR_MAJOR_UINT 0
+#define CBOR_MAJOR_BSTR 2
+#define CBOR_MAJOR_TSTR 3
+#define CBOR_MAJOR_MAP 5
+#define CBOR_AI_1_BYTE 24
+#define CBOR_AI_2_BYTES 25
+#define CBOR_AI_4_BYTES 26
+#define CBOR_MAX_HEAD_SIZE 5
+
+/* The map count is always encoded in two bytes so it can be updated in place */
+#define BIN_MAP_OFFSET LCZ_PARAM_FILE_BIN_MAGIC_SIZE
+#define BIN_HEADER_SIZE (LCZ_PARAM_FILE_BIN_MAGIC_SIZE + 3)
+
 /**************************************************************************************************/
 /* Local Data Definitions                                                                         */
 /**************************************************************************************************/
 static bool params_ready;
 
+/* Incremented after a parameter file is written or deleted (whether or not that succeeded) */
+static atomic_t params_generation;
+
 BUILD_ASSERT(sizeof(PARAMS_PATH) <= CONFIG_FSU_MAX_PATH_SIZE, "Params path too long");
 
 /**************************************************************************************************/
@@ -78,6 +104,24 @@ static int append_parameter(param_id_t id, param_t type, const void *data, size_
 static int append_id(char *str, size_t *length, param_id_t id);
 static int append_value(char *str, size_t *length, param_t type, const void *data, size_t dsize);
 
+static int txn_path(char *result, size_t max_size, const char *name, const char *suffix);
+static int commit_file(const char *name, char *data, size_t size);
+#if defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+static int commit_enc_file(const char *name, char *data, size_t size);
+static int replay_journal(const char *name);
+#endif
+static void recover_transactions(void);
+static bool has_suffix(const char *str, const char *suffix);
+
+static int is_bin_file(const char *fname, bool encrypted, size_t fsize);
+static int parse_bin_file(const char *fname, bool encrypted, size_t fsize, char **fstr,
+			  size_t *str_size, param_kvp_t **kv);
+static int bin_values_to_text(char **fstr, size_t *str_size, param_kvp_t *kv, int pairs);
+static int parse_bin(const uint8_t *data, size_t size, param_kvp_t *kv);
+static size_t cbor_head_encode(uint8_t *out, uint8_t major, uint32_t value);
+static int cbor_head_decode(const uint8_t *data, size_t size, size_t *pos, uint8_t *major,
+			    uint32_t *value);
+
 static bool room_for_id(size_t current_length);
 static bool room_for_value(size_t current_length, size_t dsize);
 
@@ -89,8 +133,13 @@ SYS_INIT(lcz_param_file_init, APPLICATION, CONFIG_LCZ_PARAM_FILE_INIT_PRIORITY);
 
 ssize_t lcz_param_file_write(char *name, void *data, size_t size)
 {
+	ssize_t r;
+
 	if (params_ready) {
-		return fsu_write(PARAMS_PATH, name, data, size);
+		r = fsu_write(PARAMS_PATH, name, data, size);
+		/* A failed write may have changed the file too */
+		atomic_inc(&params_generation);
+		return r;
 	} else {
 		return -EPERM;
 	}
@@ -100,9 +149,12 @@ ssize_t lcz_param_file_write(char *name, void *data, size_t size)
 ssize_t lcz_param_file_enc_write(char *name, void *data, size_t size)
 {
 	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	ssize_t r;
 	(void)fsu_build_full_name(abs_path, sizeof(abs_path), PARAMS_PATH, name);
 	if (params_ready) {
-		return efs_write(abs_path, data, size);
+		r = efs_write(abs_path, data, size);
+		atomic_inc(&params_generation);
+		return r;
 	} else {
 		return -EPERM;
 	}
@@ -133,13 +185,22 @@ ssize_t lcz_param_file_enc_read(char *name, void *data, size_t size)
 
 int lcz_param_file_delete(char *name)
 {
+	int r;
+
 	if (params_ready) {
-		return fsu_delete(PARAMS_PATH, name);
+		r = fsu_delete(PARAMS_PATH, name);
+		atomic_inc(&params_generation);
+		return r;
 	} else {
 		return -EPERM;
 	}
 }
 
+uint32_t lcz_param_file_generation(void)
+{
+	return (uint32_t)atomic_get(&params_generation);
+}
+
 int lcz_param_file_parse_from_file(const char *fname, size_t *fsize, char **fstr, param_kvp_t **kv)
 {
 	int r = -EPERM;
@@ -167,6 +228,13 @@ int lcz_param_file_parse_from_file(const char *fname, size_t *fsize, char **fstr
 			break;
 		}
 
+		r = is_bin_file(fname, false, entry->size);
+		BREAK_ON_ERROR(r);
+		if (r > 0) {
+			r = parse_bin_file(fname, false, entry->size, fstr, &entry->size, kv);
+			break;
+		}
+
 		r = read_text(fname, fstr, entry->size);
 		BREAK_ON_ERROR(r);
 
@@ -207,6 +275,7 @@ int lcz_param_file_enc_parse_from_file(const char *fname, size_t *fsize, char **
 {
 	int r = -EPERM;
 	ssize_t file_size;
+	size_t str_size;
 
 	*fsize = 0;
 	*fstr = NULL;
@@ -228,6 +297,14 @@ int lcz_param_file_enc_parse_from_file(const char *fname, size_t *fsize, char **
 			break;
 		}
 
+		r = is_bin_file(fname, true, file_size);
+		BREAK_ON_ERROR(r);
+		if (r > 0) {
+			r = parse_bin_file(fname, true, file_size, fstr, &str_size, kv);
+			file_size = str_size;
+			break;
+		}
+
 		r = read_text_enc(fname, fstr, file_size);
 		BREAK_ON_ERROR(r);
 		file_size = r;
@@ -340,6 +417,78 @@ int lcz_param_file_validate_file(const char *str, size_t length)
 	return (r < 0) ? r : delimiters;
 }
 
+int lcz_param_file_generate_bin(param_id_t id, param_t type, const void *data, size_t dsize,
+				uint8_t **fbin, size_t *length)
+{
+	int r = 0;
+	uint8_t *buf;
+	uint8_t major;
+	size_t start;
+	uint16_t count;
+
+	do {
+		if (fbin == NULL || length == NULL || (data == NULL && dsize != 0)) {
+			r = -EPERM;
+			break;
+		}
+
+		if (*fbin == NULL) {
+			*fbin = k_malloc(PARAMS_MAX_FILE_SIZE);
+			if (*fbin == NULL) {
+				r = -ENOMEM;
+				break;
+			}
+			memcpy(*fbin, LCZ_PARAM_FILE_BIN_MAGIC, LCZ_PARAM_FILE_BIN_MAGIC_SIZE);
+			(*fbin)[BIN_MAP_OFFSET] = (CBOR_MAJOR_MAP << 5) | CBOR_AI_2_BYTES;
+			sys_put_be16(0, &(*fbin)[BIN_MAP_OFFSET + 1]);
+			*length = BIN_HEADER_SIZE;
+		}
+		buf = *fbin;
+
+		if (type == PARAM_BIN) {
+			major = CBOR_MAJOR_BSTR;
+		} else if (type == PARAM_STR) {
+			major = CBOR_MAJOR_TSTR;
+		} else {
+			LOG_ERR("Unknown parameter type");
+			r = -EINVAL;
+			break;
+		}
+
+		/* The maximum value length is of the hex/string form */
+		count = sys_get_be16(&buf[BIN_MAP_OFFSET + 1]);
+		if (*length < BIN_HEADER_SIZE || count == UINT16_MAX ||
+		    ((type == PARAM_BIN) ? (2 * dsize) : dsize) >
+			    CONFIG_LCZ_PARAM_FILE_MAX_VALUE_LENGTH ||
+		    (*length + (2 * CBOR_MAX_HEAD_SIZE) + dsize) > PARAMS_MAX_FILE_SIZE) {
+			LOG_ERR("Unable to append id: %d binary size: %d data size: %d", id,
+				*length, dsize);
+			r = -ENOMEM;
+			break;
+		}
+
+		start = *length;
+		*length += cbor_head_encode(&buf[*length], CBOR_MAJOR_UINT, id);
+		*length += cbor_head_encode(&buf[*length], major, dsize);
+		memcpy(&buf[*length], data, dsize);
+		*length += dsize;
+		sys_put_be16(count + 1, &buf[BIN_MAP_OFFSET + 1]);
+
+		r = *length - start;
+	} while (0);
+
+	return r;
+}
+
+int lcz_param_file_validate_bin(const uint8_t *data, size_t size)
+{
+	if (data == NULL) {
+		return -EINVAL;
+	}
+
+	return parse_bin(data, size, NULL);
+}
+
 int lcz_param_file_append_feedback(param_id_t id, uint8_t error_code, uint8_t *write_data)
 {
 	int result;
@@ -351,9 +500,596 @@ int lcz_param_file_append_feedback(param_id_t id, uint8_t error_code, uint8_t *w
 	return result;
 }
 
+int lcz_param_file_txn_begin(lcz_param_file_txn_t *txn, bool encrypted)
+{
+	if (txn == NULL) {
+		return -EINVAL;
+	}
+
+#if !defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+	if (encrypted) {
+		return -ENOTSUP;
+	}
+#endif
+
+	memset(txn, 0, sizeof(*txn));
+	txn->encrypted = encrypted;
+
+	return 0;
+}
+
+int lcz_param_file_txn_add(lcz_param_file_txn_t *txn, param_id_t id, param_t type,
+			   const void *data, size_t dsize)
+{
+	int r;
+
+	if (txn == NULL) {
+		return -EINVAL;
+	}
+
+	r = lcz_param_file_generate_file(id, type, data, dsize, &txn->params);
+	if (r >= 0) {
+		txn->count += 1;
+	}
+
+	return r;
+}
+
+int lcz_param_file_txn_feedback(lcz_param_file_txn_t *txn, param_id_t id, uint8_t error_code)
+{
+	if (txn == NULL) {
+		return -EINVAL;
+	}
+
+	if (txn->feedback == NULL) {
+		txn->feedback = k_calloc(PARAMS_MAX_FILE_SIZE, sizeof(char));
+		if (txn->feedback == NULL) {
+			return -ENOMEM;
+		}
+	}
+
+	return lcz_param_file_append_feedback(id, error_code, (uint8_t *)txn->feedback);
+}
+
+int lcz_param_file_txn_commit(lcz_param_file_txn_t *txn, char *name, char *feedback_name)
+{
+	int r = -EPERM;
+
+	if (txn == NULL || name == NULL) {
+		return -EINVAL;
+	}
+
+	do {
+		if (!params_ready) {
+			break;
+		}
+
+		if (txn->params == NULL) {
+			LOG_ERR("Empty parameter transaction");
+			r = -ENODATA;
+			break;
+		}
+
+#if defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+		if (txn->encrypted) {
+			r = commit_enc_file(name, txn->params, strlen(txn->params));
+		} else
+#endif
+		{
+			r = commit_file(name, txn->params, strlen(txn->params));
+		}
+		/* Readers reload even if the commit failed part way through */
+		atomic_inc(&params_generation);
+		BREAK_ON_ERROR(r);
+
+		if (feedback_name != NULL && txn->feedback != NULL) {
+			r = commit_file(feedback_name, txn->feedback, strlen(txn->feedback));
+			BREAK_ON_ERROR(r);
+		}
+
+		r = txn->count;
+		LOG_DBG("Committed %d parameters to %s", r, name);
+	} while (0);
+
+	lcz_param_file_txn_abort(txn);
+
+	return r;
+}
+
+void lcz_param_file_txn_abort(lcz_param_file_txn_t *txn)
+{
+	if (txn == NULL) {
+		return;
+	}
+
+	/* Clear (possibly secret) parameter values */
+	if (txn->params != NULL) {
+		memset(txn->params, 0, PARAMS_MAX_FILE_SIZE);
+	}
+	k_free(txn->params);
+	k_free(txn->feedback);
+	txn->params = NULL;
+	txn->feedback = NULL;
+	txn->count = 0;
+}
+
 /**************************************************************************************************/
 /* Local Function Definitions                                                                     */
 /**************************************************************************************************/
+static int txn_path(char *result, size_t max_size, const char *name, const char *suffix)
+{
+	int r;
+
+	r = fsu_build_full_name(result, max_size, PARAMS_PATH, name);
+	if (r >= 0) {
+		if ((r + strlen(suffix)) < max_size) {
+			strcat(result, suffix);
+		} else {
+			r = -ENAMETOOLONG;
+		}
+	}
+
+	return r;
+}
+
+/* Write to a journal file and then rename it so that the parameter file is
+ * either the old or the new version after a power loss.
+ */
+static int commit_file(const char *name, char *data, size_t size)
+{
+	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	char journal[FSU_MAX_ABS_PATH_SIZE];
+	int r;
+
+	do {
+		r = txn_path(abs_path, sizeof(abs_path), name, "");
+		BREAK_ON_ERROR(r);
+
+		r = txn_path(journal, sizeof(journal), name, TXN_JOURNAL_SUFFIX);
+		BREAK_ON_ERROR(r);
+
+		r = fsu_write_abs(journal, data, size);
+		if (r < 0) {
+			(void)fsu_delete_abs(journal);
+			break;
+		}
+
+		/* Replaces the existing file */
+		r = fsu_rename_abs(journal, abs_path);
+		if (r < 0) {
+			LOG_ERR("Unable to rename %s: %d", journal, r);
+		}
+	} while (0);
+
+	return r;
+}
+
+#if defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+/* Encrypted files can't be renamed because the authentication data of each block includes
+ * a hash of the file name. The journal is marked complete before the parameter file
+ * is rewritten so that an interrupted rewrite can be replayed.
+ */
+static int commit_enc_file(const char *name, char *data, size_t size)
+{
+	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	char journal[FSU_MAX_ABS_PATH_SIZE];
+	char marker[FSU_MAX_ABS_PATH_SIZE];
+	int r;
+
+	do {
+		r = txn_path(abs_path, sizeof(abs_path), name, "");
+		BREAK_ON_ERROR(r);
+
+		r = txn_path(journal, sizeof(journal), name, TXN_JOURNAL_SUFFIX);
+		BREAK_ON_ERROR(r);
+
+		r = txn_path(marker, sizeof(marker), name, TXN_COMMIT_SUFFIX);
+		BREAK_ON_ERROR(r);
+
+		r = efs_write(journal, data, size);
+		if (r < 0) {
+			(void)fsu_delete_abs(journal);
+			break;
+		}
+
+		r = fsu_write_abs(marker, data, 0);
+		if (r < 0) {
+			(void)fsu_delete_abs(journal);
+			break;
+		}
+
+		r = efs_write(abs_path, data, size);
+		BREAK_ON_ERROR(r);
+
+		(void)fsu_delete_abs(marker);
+		(void)fsu_delete_abs(journal);
+	} while (0);
+
+	return r;
+}
+
+static int replay_journal(const char *name)
+{
+	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	char journal[FSU_MAX_ABS_PATH_SIZE];
+	char *str = NULL;
+	ssize_t size = 0;
+	int r;
+
+	do {
+		r = txn_path(abs_path, sizeof(abs_path), name, "");
+		BREAK_ON_ERROR(r);
+
+		r = txn_path(journal, sizeof(journal), name, TXN_JOURNAL_SUFFIX);
+		BREAK_ON_ERROR(r);
+
+		r = size = efs_get_file_size(journal);
+		BREAK_ON_ERROR(r);
+
+		/* Parameter files are never empty, so there is nothing to replay */
+		if (size == 0) {
+			LOG_WRN("Skipping empty parameter journal for %s", name);
+			return 0;
+		}
+
+		str = k_malloc(size);
+		if (str == NULL) {
+			r = -ENOMEM;
+			break;
+		}
+
+		r = efs_read(journal, str, size);
+		if (r != size) {
+			r = (r < 0) ? r : -EIO;
+			break;
+		}
+
+		r = efs_write(abs_path, str, size);
+	} while (0);
+
+	if (str != NULL) {
+		memset(str, 0, size);
+		k_free(str);
+	}
+
+	LOG_WRN("Replayed parameter transaction for %s: %d", name, r);
+
+	return r;
+}
+#endif
+
+/* Finish encrypted commits that were interrupted and remove journals of commits
+ * that didn't complete (the old file is still intact). If a replay fails, then the
+ * marker and journal are kept so that it is tried again at the next boot.
+ */
+static void recover_transactions(void)
+{
+	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	char marker[FSU_MAX_ABS_PATH_SIZE];
+	struct fs_dirent *entries;
+	size_t count;
+	size_t i;
+
+#if defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+	entries = fsu_find(PARAMS_PATH, TXN_COMMIT_SUFFIX, &count, FS_DIR_ENTRY_FILE);
+	for (i = 0; i < count && entries != NULL; i++) {
+		if (has_suffix(entries[i].name, TXN_COMMIT_SUFFIX)) {
+			/* Remove the suffix to get the name of the parameter file */
+			entries[i].name[strlen(entries[i].name) - strlen(TXN_COMMIT_SUFFIX)] = '\0';
+			if (replay_journal(entries[i].name) < 0) {
+				LOG_ERR("Unable to replay parameter transaction for %s",
+					entries[i].name);
+			} else if (txn_path(abs_path, sizeof(abs_path), entries[i].name,
+					    TXN_COMMIT_SUFFIX) >= 0) {
+				(void)fsu_delete_abs(abs_path);
+			}
+		}
+	}
+	fsu_free_found(entries);
+#endif
+
+	/* Only journals that definitely don't have a commit marker are incomplete */
+	entries = fsu_find(PARAMS_PATH, TXN_JOURNAL_SUFFIX, &count, FS_DIR_ENTRY_FILE);
+	for (i = 0; i < count && entries != NULL; i++) {
+		if (!has_suffix(entries[i].name, TXN_JOURNAL_SUFFIX) ||
+		    fsu_build_full_name(abs_path, sizeof(abs_path), PARAMS_PATH,
+					entries[i].name) < 0) {
+			continue;
+		}
+
+		entries[i].name[strlen(entries[i].name) - strlen(TXN_JOURNAL_SUFFIX)] = '\0';
+		if (txn_path(marker, sizeof(marker), entries[i].name, TXN_COMMIT_SUFFIX) < 0 ||
+		    fsu_get_file_size_abs(marker) != -ENOENT) {
+			continue;
+		}
+
+		LOG_WRN("Removing incomplete parameter transaction %s", abs_path);
+		(void)fsu_delete_abs(abs_path);
+	}
+	fsu_free_found(entries);
+}
+
+/**
+ * @retval negative on error, 1 if file starts with binary magic, otherwise 0
+ */
+static int is_bin_file(const char *fname, bool encrypted, size_t fsize)
+{
+	uint8_t magic[LCZ_PARAM_FILE_BIN_MAGIC_SIZE];
+	ssize_t r;
+
+	if (fsize < BIN_HEADER_SIZE) {
+		return 0;
+	}
+
+#if defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+	if (encrypted) {
+		r = efs_read_block(fname, 0, magic, sizeof(magic));
+	} else
+#endif
+	{
+		r = fsu_read_abs_block(fname, 0, magic, sizeof(magic));
+	}
+
+	if (r != sizeof(magic)) {
+		LOG_ERR("Unable to read parameter file %s: %d", fname, r);
+		return (r < 0) ? r : -EIO;
+	}
+
+	return (memcmp(magic, LCZ_PARAM_FILE_BIN_MAGIC, sizeof(magic)) == 0) ? 1 : 0;
+}
+
+/**
+ * @retval negative on error, otherwise number of key-value pairs.
+ */
+static int parse_bin_file(const char *fname, bool encrypted, size_t fsize, char **fstr,
+			  size_t *str_size, param_kvp_t **kv)
+{
+	ssize_t r;
+
+	*str_size = fsize;
+
+	do {
+		*fstr = k_malloc(fsize);
+		if (*fstr == NULL) {
+			r = -ENOMEM;
+			LOG_ERR("Unable to allocate parameter buffer");
+			break;
+		}
+
+#if defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+		if (encrypted) {
+			r = efs_read(fname, *fstr, fsize);
+		} else
+#endif
+		{
+			r = fsu_read_abs(fname, *fstr, fsize);
+		}
+		if (r != fsize) {
+			LOG_ERR("Unable to read parameter file %s: %d", fname, r);
+			r = (r < 0) ? r : -EIO;
+			break;
+		}
+
+		r = parse_bin((uint8_t *)*fstr, fsize, NULL);
+		if (r <= 0) {
+			break;
+		}
+
+		*kv = k_calloc(r, sizeof(param_kvp_t));
+		if (*kv == NULL) {
+			r = -ENOMEM;
+			break;
+		}
+
+		r = parse_bin((uint8_t *)*fstr, fsize, *kv);
+		if (r > 0 && !IS_ENABLED(CONFIG_LCZ_PARAM_FILE_BIN_RAW_VALUES)) {
+			r = bin_values_to_text(fstr, str_size, *kv, r);
+		}
+	} while (0);
+
+	return r;
+}
+
+/**
+ * @brief Replace the file buffer with one that only holds the values, with byte strings
+ * hex encoded, so that consumers get the same values as from a text file.
+ *
+ * @retval negative on error (the buffer is unchanged), otherwise number of pairs.
+ */
+static int bin_values_to_text(char **fstr, size_t *str_size, param_kvp_t *kv, int pairs)
+{
+	size_t size = SIZE_OF_NUL;
+	size_t pos = 0;
+	char *str;
+	int i;
+
+	for (i = 0; i < pairs; i++) {
+		size += kv[i].raw ? (2 * kv[i].length) : kv[i].length;
+	}
+
+	str = k_malloc(size);
+	if (str == NULL) {
+		LOG_ERR("Unable to allocate parameter buffer");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < pairs; i++) {
+		if (kv[i].raw) {
+			(void)bin2hex((const uint8_t *)kv[i].keystr, kv[i].length, &str[pos],
+				      size - pos);
+			kv[i].length *= 2;
+			kv[i].raw = false;
+		} else {
+			memcpy(&str[pos], kv[i].keystr, kv[i].length);
+		}
+		kv[i].keystr = &str[pos];
+		pos += kv[i].length;
+	}
+	str[pos] = '\0';
+
+	/* Clear (possibly secret) binary values */
+	memset(*fstr, 0, *str_size);
+	k_free(*fstr);
+	*fstr = str;
+	*str_size = size;
+
+	return pairs;
+}
+
+/**
+ * @brief Walk a binary parameter file. Every length is checked against the size
+ * of the file before it is used.
+ *
+ * @param kv array of key-value pairs to fill in. May be NULL to only validate.
+ *
+ * @retval negative on error, otherwise number of key-value pairs.
+ */
+static int parse_bin(const uint8_t *data, size_t size, param_kvp_t *kv)
+{
+	size_t pos = LCZ_PARAM_FILE_BIN_MAGIC_SIZE;
+	uint32_t count;
+	uint32_t id;
+	uint32_t len;
+	uint8_t major;
+	uint32_t i;
+	int r;
+
+	if (size < BIN_HEADER_SIZE ||
+	    memcmp(data, LCZ_PARAM_FILE_BIN_MAGIC, LCZ_PARAM_FILE_BIN_MAGIC_SIZE) != 0) {
+		LOG_ERR("Invalid binary parameter file header");
+		return -EINVAL;
+	}
+
+	r = cbor_head_decode(data, size, &pos, &major, &count);
+	if (r < 0 || major != CBOR_MAJOR_MAP || count > INT_MAX) {
+		LOG_ERR("Invalid binary parameter map");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < count; i++) {
+		r = cbor_head_decode(data, size, &pos, &major, &id);
+		if (r < 0 || major != CBOR_MAJOR_UINT || id > UINT16_MAX) {
+			LOG_ERR("Invalid id at %u", pos);
+			return -EINVAL;
+		}
+
+		r = cbor_head_decode(data, size, &pos, &major, &len);
+		if (r < 0 || (major != CBOR_MAJOR_BSTR && major != CBOR_MAJOR_TSTR) ||
+		    len > (size - pos)) {
+			LOG_ERR("Invalid value for id %u at %u", id, pos);
+			return -EINVAL;
+		}
+
+		/* The maximum value length is of the hex/string form */
+		if (((major == CBOR_MAJOR_BSTR) ? (2 * len) : len) >
+		    CONFIG_LCZ_PARAM_FILE_MAX_VALUE_LENGTH) {
+			LOG_ERR("Invalid Size of %d at %u", len, pos);
+			return -EINVAL;
+		}
+
+		if (kv != NULL) {
+			kv[i].id = id;
+			kv[i].keystr = (char *)&data[pos];
+			kv[i].length = len;
+			kv[i].raw = (major == CBOR_MAJOR_BSTR);
+			if (len == 0) {
+				LOG_ZLP("Zero Length Parameter (possible empty string)");
+			}
+		}
+		pos += len;
+	}
+
+	if (pos != size) {
+		LOG_ERR("Unexpected data after %u binary parameters", count);
+		return -EINVAL;
+	}
+
+	LOG_DBG("Found %d pairs", count);
+	return count;
+}
+
+/**
+ * @retval size of head (initial byte and argument)
+ */
+static size_t cbor_head_encode(uint8_t *out, uint8_t major, uint32_t value)
+{
+	major <<= 5;
+
+	if (value < CBOR_AI_1_BYTE) {
+		out[0] = major | value;
+		return 1;
+	} else if (value <= UINT8_MAX) {
+		out[0] = major | CBOR_AI_1_BYTE;
+		out[1] = value;
+		return 2;
+	} else if (value <= UINT16_MAX) {
+		out[0] = major | CBOR_AI_2_BYTES;
+		sys_put_be16(value, &out[1]);
+		return 3;
+	} else {
+		out[0] = major | CBOR_AI_4_BYTES;
+		sys_put_be32(value, &out[1]);
+		return 5;
+	}
+}
+
+/**
+ * @brief Decode the head of a data item at pos and advance pos past it.
+ * Indefinite lengths and 64-bit arguments aren't used by parameter files.
+ *
+ * @retval negative on error, otherwise 0
+ */
+static int cbor_head_decode(const uint8_t *data, size_t size, size_t *pos, uint8_t *major,
+			    uint32_t *value)
+{
+	uint8_t ai;
+	size_t arg_size;
+
+	if (*pos >= size) {
+		return -EINVAL;
+	}
+
+	*major = data[*pos] >> 5;
+	ai = data[*pos] & 0x1F;
+	*pos += 1;
+
+	if (ai < CBOR_AI_1_BYTE) {
+		*value = ai;
+		return 0;
+	} else if (ai == CBOR_AI_1_BYTE) {
+		arg_size = 1;
+	} else if (ai == CBOR_AI_2_BYTES) {
+		arg_size = 2;
+	} else if (ai == CBOR_AI_4_BYTES) {
+		arg_size = 4;
+	} else {
+		return -EINVAL;
+	}
+
+	if (arg_size > (size - *pos)) {
+		return -EINVAL;
+	}
+
+	if (arg_size == 1) {
+		*value = data[*pos];
+	} else if (arg_size == 2) {
+		*value = sys_get_be16(&data[*pos]);
+	} else {
+		*value = sys_get_be32(&data[*pos]);
+	}
+	*pos += arg_size;
+
+	return 0;
+}
+
+static bool has_suffix(const char *str, const char *suffix)
+{
+	size_t len = strlen(str);
+	size_t suffix_len = strlen(suffix);
+
+	return (len > suffix_len) && (strcmp(&str[len - suffix_len], suffix) == 0);
+}
+
 /**
  * @retval negative on error, otherwise number of key-value pairs.
  */
@@ -648,6 +1384,8 @@ static int lcz_param_file_init(const struct device *device)
 			BREAK_ON_ERROR(r);
 		}
 
+		recover_transactions();
+
 		params_ready = true;
 		r = 0;
 	} while (0);
@@ -0,0 +1,288 @@
+/**
+ * @file lcz_param_file_store.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(lcz_param_file_store, CONFIG_LCZ_PARAM_FILE_LOG_LEVEL);
+
+/**************************************************************************************************/
+/* Includes                                                                                       */
+/**************************************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <sys/util.h>
+
+#include "file_system_utilities.h"
+#if defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+#include "encrypted_file_storage.h"
+#endif
+#include "lcz_param_file.h"
+#include "lcz_param_file_store.h"
+
+/**************************************************************************************************/
+/* Local Constant, Macro and Type Definitions                                                     */
+/**************************************************************************************************/
+#define INDEX_EMPTY UINT16_MAX
+#define INDEX_MIN_SIZE 8
+
+/* Fibonacci hashing spreads sequential ids across the table */
+#define HASH_MULTIPLIER 2654435769U
+
+/**************************************************************************************************/
+/* Local Function Prototypes                                                                      */
+/**************************************************************************************************/
+static ssize_t get_file_size(struct lcz_param_file_store *store);
+static int load(struct lcz_param_file_store *store);
+static void unload(struct lcz_param_file_store *store);
+static int build_index(struct lcz_param_file_store *store);
+static int find(struct lcz_param_file_store *store, param_id_t id);
+static size_t slot(struct lcz_param_file_store *store, param_id_t id);
+static size_t copy_value(const param_kvp_t *kv, char *out, size_t size);
+
+/**************************************************************************************************/
+/* Global Function Definitions                                                                    */
+/**************************************************************************************************/
+int lcz_param_file_store_init(struct lcz_param_file_store *store, const char *abs_path,
+			      bool encrypted)
+{
+	if (store == NULL || abs_path == NULL || strlen(abs_path) >= sizeof(store->abs_path)) {
+		return -EINVAL;
+	}
+
+#if !defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+	if (encrypted) {
+		return -ENOTSUP;
+	}
+#endif
+
+	memset(store, 0, sizeof(*store));
+	strcpy(store->abs_path, abs_path);
+	store->encrypted = encrypted;
+	k_mutex_init(&store->lock);
+
+	return 0;
+}
+
+ssize_t lcz_param_file_store_read(struct lcz_param_file_store *store, param_id_t id, void *data,
+				  size_t size)
+{
+	ssize_t r = 0;
+	int i;
+
+	if (store == NULL || data == NULL) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&store->lock, K_FOREVER);
+
+	if (!store->loaded || store->generation != lcz_param_file_generation()) {
+		r = load(store);
+	}
+
+	if (r >= 0) {
+		i = find(store, id);
+		if (i < 0) {
+			r = -ENOENT;
+		} else {
+			r = copy_value(&store->kv[i], data, size);
+		}
+	}
+
+	k_mutex_unlock(&store->lock);
+
+	return r;
+}
+
+int lcz_param_file_store_refresh(struct lcz_param_file_store *store)
+{
+	int r;
+
+	if (store == NULL) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&store->lock, K_FOREVER);
+
+	if (!store->loaded || store->generation != lcz_param_file_generation() ||
+	    store->file_size != get_file_size(store)) {
+		r = load(store);
+	} else {
+		r = store->pairs;
+	}
+
+	k_mutex_unlock(&store->lock);
+
+	return r;
+}
+
+void lcz_param_file_store_free(struct lcz_param_file_store *store)
+{
+	if (store != NULL) {
+		k_mutex_lock(&store->lock, K_FOREVER);
+		unload(store);
+		k_mutex_unlock(&store->lock);
+	}
+}
+
+/**************************************************************************************************/
+/* Local Function Definitions                                                                     */
+/**************************************************************************************************/
+static ssize_t get_file_size(struct lcz_param_file_store *store)
+{
+#if defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+	if (store->encrypted) {
+		return efs_get_file_size(store->abs_path);
+	}
+#endif
+	return fsu_get_file_size_abs(store->abs_path);
+}
+
+/**
+ * @retval negative error code, otherwise number of parameters loaded
+ */
+static int load(struct lcz_param_file_store *store)
+{
+	int r;
+
+	unload(store);
+
+	/* Read before parsing so that a write during the load causes another one */
+	store->generation = lcz_param_file_generation();
+
+	r = store->file_size = get_file_size(store);
+	if (r >= 0) {
+#if defined(CONFIG_LCZ_PARAM_FILE_ENCRYPTED)
+		if (store->encrypted) {
+			r = lcz_param_file_enc_parse_from_file(store->abs_path, &store->fsize,
+							       &store->fstr, &store->kv);
+		} else
+#endif
+		{
+			r = lcz_param_file_parse_from_file(store->abs_path, &store->fsize,
+							   &store->fstr, &store->kv);
+		}
+	}
+
+	if (r >= 0) {
+		store->pairs = r;
+		r = build_index(store);
+	}
+
+	if (r >= 0) {
+		store->loaded = true;
+		r = store->pairs;
+		LOG_DBG("Loaded %d parameters from %s", r, store->abs_path);
+	} else {
+		LOG_ERR("Unable to load parameter store %s: %d", store->abs_path, r);
+		unload(store);
+	}
+
+	return r;
+}
+
+static void unload(struct lcz_param_file_store *store)
+{
+	/* Clear (possibly encrypted) file data */
+	if (store->fstr != NULL) {
+		memset(store->fstr, 0, store->fsize);
+	}
+	k_free(store->fstr);
+	k_free(store->kv);
+	k_free(store->index);
+	store->fstr = NULL;
+	store->kv = NULL;
+	store->index = NULL;
+	store->fsize = 0;
+	store->pairs = 0;
+	store->index_size = 0;
+	store->loaded = false;
+}
+
+/**
+ * @brief Open addressing index into the key-value pair array.
+ * The table is at least twice the number of pairs so probe sequences stay short.
+ * If an id occurs more than once in the file, then the last occurrence is used.
+ */
+static int build_index(struct lcz_param_file_store *store)
+{
+	size_t size = INDEX_MIN_SIZE;
+	size_t s;
+	int i;
+
+	if (store->pairs >= INDEX_EMPTY) {
+		return -E2BIG;
+	}
+
+	while (size < (store->pairs * 2)) {
+		size *= 2;
+	}
+
+	store->index = k_malloc(size * sizeof(uint16_t));
+	if (store->index == NULL) {
+		LOG_ERR("Unable to allocate parameter index");
+		return -ENOMEM;
+	}
+	store->index_size = size;
+	memset(store->index, 0xFF, size * sizeof(uint16_t));
+
+	for (i = 0; i < store->pairs; i++) {
+		s = slot(store, store->kv[i].id);
+		store->index[s] = i;
+	}
+
+	return 0;
+}
+
+/**
+ * @retval slot that contains id or the empty slot where it should be placed
+ */
+static size_t slot(struct lcz_param_file_store *store, param_id_t id)
+{
+	size_t mask = store->index_size - 1;
+	uint32_t bits = find_lsb_set(store->index_size) - 1;
+	size_t s = ((uint32_t)id * HASH_MULTIPLIER) >> (32 - bits);
+
+	while (store->index[s] != INDEX_EMPTY && store->kv[store->index[s]].id != id) {
+		s = (s + 1) & mask;
+	}
+
+	return s;
+}
+
+/**
+ * @retval negative if not found, otherwise index into key-value pair array
+ */
+static int find(struct lcz_param_file_store *store, param_id_t id)
+{
+	size_t s = slot(store, id);
+
+	return (store->index[s] == INDEX_EMPTY) ? -ENOENT : store->index[s];
+}
+
+/**
+ * @brief Values are returned as they appear in a text parameter file, so the
+ * byte strings of a binary file are hex encoded.
+ *
+ * @retval length of the value
+ */
+static size_t copy_value(const param_kvp_t *kv, char *out, size_t size)
+{
+	const uint8_t *value = (const uint8_t *)kv->keystr;
+	size_t i;
+
+	if (!kv->raw) {
+		memcpy(out, kv->keystr, MIN(size, kv->length));
+		return kv->length;
+	}
+
+	for (i = 0; i < (2 * kv->length) && i < size; i++) {
+		(void)hex2char((i & 1) ? (value[i / 2] & 0x0F) : (value[i / 2] >> 4), &out[i]);
+	}
+
+	return 2 * kv->length;
+}
@@ -17,11 +17,16 @@ LOG_MODULE_REGISTER(ramdisk, CONFIG_LCZ_RAMDISK_LOG_LEVEL);
 #include <zephyr.h>
 #include <device.h>
 #include <fs/fs.h>
+#ifdef CONFIG_LCZ_RAMDISK_BACKEND_LITTLEFS
 #include <fs/littlefs.h>
+#endif
+
+#include "lcz_ramdisk.h"
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
 /******************************************************************************/
+#ifdef CONFIG_LCZ_RAMDISK_BACKEND_LITTLEFS
 FS_LITTLEFS_DECLARE_DEFAULT_CONFIG(ramfs);
 
 static struct fs_mount_t ramfs_mnt = { .type = FS_LITTLEFS,
@@ -30,6 +35,12 @@ static struct fs_mount_t ramfs_mnt = { .type = FS_LITTLEFS,
 					       (void *)FLASH_AREA_ID(ramfs),
 				       .mnt_point =
 					       CONFIG_LCZ_RAMDISK_MOUNT_POINT };
+#else
+/* tmpfs keeps its state in lcz_ramdisk_tmpfs.c */
+static struct fs_mount_t ramfs_mnt = { .type = LCZ_RAMDISK_FS_TYPE,
+				       .mnt_point =
+					       CONFIG_LCZ_RAMDISK_MOUNT_POINT };
+#endif
 
 static K_MUTEX_DEFINE(ramfs_init_mutex);
 
@@ -75,6 +86,19 @@ int ramfs_mount(void)
 	return rc;
 }
 
+#ifdef CONFIG_LCZ_RAMDISK_BACKEND_LITTLEFS
+int lcz_ramdisk_map(const char *abs_path, off_t offset,
+		    struct lcz_ramdisk_map *map)
+{
+	return -ENOTSUP;
+}
+
+void lcz_ramdisk_unmap(struct lcz_ramdisk_map *map)
+{
+	ARG_UNUSED(map);
+}
+#endif
+
 /******************************************************************************/
 /* Local Function Definitions                                                 */
 /******************************************************************************/
@@ -0,0 +1,1066 @@
+/**
+ * @file lcz_ramdisk_tmpfs.c
+ * @brief RAM file system for the RAMDISK
+ *
+ * File contents are kept in a static arena that is divided into blocks of
+ * CONFIG_LCZ_RAMDISK_TMPFS_BLOCK_SIZE bytes. Each file holds a short list of
+ * extents (runs of contiguous blocks). A file grows by extending its last
+ * extent in place when the following blocks are free, otherwise a new extent
+ * is taken from the first free run that is large enough (or the largest
+ * one). Data is never moved, so a pointer into a file stays valid while data
+ * is appended.
+ *
+ * Files and directories are nodes that hold their path relative to the mount
+ * point. Directory listings scan the node table.
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(ramdisk_tmpfs, CONFIG_LCZ_RAMDISK_LOG_LEVEL);
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <init.h>
+#include <string.h>
+#include <fs/fs.h>
+#include <fs/fs_sys.h>
+
+#include "lcz_ramdisk.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define TMPFS_BLOCK_SIZE CONFIG_LCZ_RAMDISK_TMPFS_BLOCK_SIZE
+#define TMPFS_BLOCKS (CONFIG_LCZ_RAMDISK_TMPFS_SIZE / TMPFS_BLOCK_SIZE)
+#define TMPFS_MAP_WORDS DIV_ROUND_UP(TMPFS_BLOCKS, 32)
+#define TMPFS_MAX_PATH CONFIG_LCZ_RAMDISK_TMPFS_MAX_PATH
+
+BUILD_ASSERT((CONFIG_LCZ_RAMDISK_TMPFS_SIZE % TMPFS_BLOCK_SIZE) == 0,
+	     "Block size must divide the arena size");
+BUILD_ASSERT(TMPFS_BLOCKS <= UINT16_MAX, "Too many blocks for an extent");
+
+struct tmpfs_extent {
+	uint16_t start;
+	uint16_t count;
+};
+
+struct tmpfs_node {
+	bool used;
+	bool dir;
+	uint8_t extents;
+	uint8_t open;
+	uint16_t maps;
+	size_t size;
+	struct tmpfs_extent extent[CONFIG_LCZ_RAMDISK_TMPFS_MAX_EXTENTS];
+	char path[TMPFS_MAX_PATH];
+};
+
+struct tmpfs_file {
+	struct tmpfs_node *node;
+	fs_mode_t flags;
+	size_t pos;
+};
+
+struct tmpfs_dir {
+	bool used;
+	int next;
+	char path[TMPFS_MAX_PATH];
+};
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int tmpfs_init(const struct device *device);
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static K_MUTEX_DEFINE(tmpfs_lock);
+
+static struct fs_mount_t *tmpfs_mnt;
+
+static uint8_t tmpfs_arena[CONFIG_LCZ_RAMDISK_TMPFS_SIZE] __aligned(4);
+static uint32_t tmpfs_block_map[TMPFS_MAP_WORDS];
+static uint32_t tmpfs_free_blocks;
+
+static struct tmpfs_node tmpfs_nodes[CONFIG_LCZ_RAMDISK_TMPFS_MAX_FILES];
+static struct tmpfs_file tmpfs_files[CONFIG_LCZ_RAMDISK_TMPFS_MAX_OPEN];
+static struct tmpfs_dir tmpfs_dirs[CONFIG_LCZ_RAMDISK_TMPFS_MAX_OPEN_DIRS];
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static inline bool block_used(uint32_t block)
+{
+	return (tmpfs_block_map[block / 32] & BIT(block % 32)) != 0;
+}
+
+static void blocks_set(uint32_t start, uint32_t count, bool used)
+{
+	uint32_t i;
+
+	for (i = start; i < (start + count); i++) {
+		if (used) {
+			tmpfs_block_map[i / 32] |= BIT(i % 32);
+		} else {
+			tmpfs_block_map[i / 32] &= ~BIT(i % 32);
+		}
+	}
+
+	if (used) {
+		tmpfs_free_blocks -= count;
+	} else {
+		tmpfs_free_blocks += count;
+	}
+}
+
+/* Number of free blocks starting at start, up to max */
+static uint32_t blocks_free_run(uint32_t start, uint32_t max)
+{
+	uint32_t count = 0;
+
+	while ((start + count) < TMPFS_BLOCKS && count < max &&
+	       !block_used(start + count)) {
+		count += 1;
+	}
+
+	return count;
+}
+
+/* First free run of at least want blocks, otherwise the largest run */
+static uint32_t blocks_find(uint32_t want, uint32_t *start)
+{
+	uint32_t best = 0;
+	uint32_t run;
+	uint32_t i = 0;
+
+	while (i < TMPFS_BLOCKS) {
+		if (block_used(i)) {
+			i += 1;
+			continue;
+		}
+
+		run = blocks_free_run(i, want);
+		if (run > best) {
+			best = run;
+			*start = i;
+			if (best == want) {
+				break;
+			}
+		}
+		i += run;
+	}
+
+	return best;
+}
+
+static uint32_t node_blocks(const struct tmpfs_node *node)
+{
+	uint32_t count = 0;
+	int i;
+
+	for (i = 0; i < node->extents; i++) {
+		count += node->extent[i].count;
+	}
+
+	return count;
+}
+
+/* Grow the blocks held by a file towards size bytes.
+ * Returns the capacity of the file, which is less than size if the arena or
+ * the extent table is full.
+ */
+static size_t node_reserve(struct tmpfs_node *node, size_t size)
+{
+	uint32_t held = node_blocks(node);
+	uint32_t need = DIV_ROUND_UP(size, TMPFS_BLOCK_SIZE);
+	struct tmpfs_extent *last;
+	uint32_t start = 0;
+	uint32_t got;
+
+	while (held < need) {
+		got = 0;
+
+		/* Extending in place keeps the file contiguous */
+		if (node->extents > 0) {
+			last = &node->extent[node->extents - 1];
+			start = last->start + last->count;
+			got = blocks_free_run(start, MIN(need - held,
+							 UINT16_MAX - last->count));
+			if (got > 0) {
+				blocks_set(start, got, true);
+				last->count += got;
+			}
+		}
+
+		if (got == 0) {
+			if (node->extents >= CONFIG_LCZ_RAMDISK_TMPFS_MAX_EXTENTS) {
+				break;
+			}
+			got = blocks_find(need - held, &start);
+			if (got == 0) {
+				break;
+			}
+			blocks_set(start, got, true);
+			node->extent[node->extents].start = start;
+			node->extent[node->extents].count = got;
+			node->extents += 1;
+		}
+
+		held += got;
+	}
+
+	return (size_t)held * TMPFS_BLOCK_SIZE;
+}
+
+/* Free the blocks that aren't needed to hold size bytes */
+static void node_release(struct tmpfs_node *node, size_t size)
+{
+	uint32_t keep = DIV_ROUND_UP(size, TMPFS_BLOCK_SIZE);
+	uint32_t held = node_blocks(node);
+	struct tmpfs_extent *last;
+	uint32_t drop;
+
+	while (held > keep && node->extents > 0) {
+		last = &node->extent[node->extents - 1];
+		drop = MIN(held - keep, last->count);
+		last->count -= drop;
+		blocks_set(last->start + last->count, drop, false);
+		if (last->count == 0) {
+			node->extents -= 1;
+		}
+		held -= drop;
+	}
+}
+
+/* Location of offset and the number of contiguous bytes that follow it */
+static uint8_t *node_locate(const struct tmpfs_node *node, size_t offset,
+			    size_t *contig)
+{
+	size_t length;
+	int i;
+
+	for (i = 0; i < node->extents; i++) {
+		length = (size_t)node->extent[i].count * TMPFS_BLOCK_SIZE;
+		if (offset < length) {
+			*contig = length - offset;
+			return &tmpfs_arena[((size_t)node->extent[i].start *
+					     TMPFS_BLOCK_SIZE) + offset];
+		}
+		offset -= length;
+	}
+
+	*contig = 0;
+	return NULL;
+}
+
+/* Copy into the (reserved) contents of a file, src NULL fills with zero */
+static void node_copy_in(struct tmpfs_node *node, size_t offset,
+			 const uint8_t *src, size_t size)
+{
+	uint8_t *p;
+	size_t contig;
+	size_t n;
+
+	while (size > 0) {
+		p = node_locate(node, offset, &contig);
+		n = MIN(size, contig);
+		if (src != NULL) {
+			memcpy(p, src, n);
+			src += n;
+		} else {
+			memset(p, 0, n);
+		}
+		offset += n;
+		size -= n;
+	}
+}
+
+static void node_copy_out(const struct tmpfs_node *node, size_t offset,
+			  uint8_t *dest, size_t size)
+{
+	const uint8_t *p;
+	size_t contig;
+	size_t n;
+
+	while (size > 0) {
+		p = node_locate(node, offset, &contig);
+		n = MIN(size, contig);
+		memcpy(dest, p, n);
+		dest += n;
+		offset += n;
+		size -= n;
+	}
+}
+
+/* Path relative to the mount point without leading or trailing slashes */
+static int tmpfs_path(const struct fs_mount_t *mp, const char *fs_path,
+		      char *path)
+{
+	const char *p = fs_path + mp->mountp_len;
+	size_t len;
+
+	while (*p == '/') {
+		p++;
+	}
+
+	len = strlen(p);
+	while (len > 0 && p[len - 1] == '/') {
+		len--;
+	}
+
+	if (len >= TMPFS_MAX_PATH) {
+		return -ENAMETOOLONG;
+	}
+
+	memcpy(path, p, len);
+	path[len] = '\0';
+
+	return 0;
+}
+
+static const char *path_basename(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+
+	return (slash != NULL) ? (slash + 1) : path;
+}
+
+static struct tmpfs_node *node_find(const char *path)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tmpfs_nodes); i++) {
+		if (tmpfs_nodes[i].used && strcmp(tmpfs_nodes[i].path, path) == 0) {
+			return &tmpfs_nodes[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* True if node is directly inside the directory dir ("" for the root) */
+static bool node_in_dir(const struct tmpfs_node *node, const char *dir)
+{
+	size_t len = strlen(dir);
+
+	if (len == 0) {
+		return strchr(node->path, '/') == NULL;
+	}
+
+	return strncmp(node->path, dir, len) == 0 && node->path[len] == '/' &&
+	       strchr(&node->path[len + 1], '/') == NULL;
+}
+
+static bool dir_empty(const char *dir)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tmpfs_nodes); i++) {
+		if (tmpfs_nodes[i].used && node_in_dir(&tmpfs_nodes[i], dir)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* The directory that would hold path must exist */
+static int parent_check(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	char parent[TMPFS_MAX_PATH];
+	struct tmpfs_node *node;
+
+	if (strlen(path_basename(path)) > MAX_FILE_NAME || *path == '\0') {
+		return -ENAMETOOLONG;
+	}
+
+	if (slash == NULL) {
+		return 0;
+	}
+
+	memcpy(parent, path, slash - path);
+	parent[slash - path] = '\0';
+	node = node_find(parent);
+	if (node == NULL) {
+		return -ENOENT;
+	} else if (!node->dir) {
+		return -ENOTDIR;
+	}
+
+	return 0;
+}
+
+static struct tmpfs_node *node_create(const char *path, bool dir)
+{
+	struct tmpfs_node *node;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(tmpfs_nodes); i++) {
+		node = &tmpfs_nodes[i];
+		if (!node->used) {
+			memset(node, 0, sizeof(*node));
+			node->used = true;
+			node->dir = dir;
+			strcpy(node->path, path);
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+static void node_delete(struct tmpfs_node *node)
+{
+	node_release(node, 0);
+	node->used = false;
+}
+
+static int tmpfs_open(struct fs_file_t *filp, const char *fs_path,
+		      fs_mode_t flags)
+{
+	char path[TMPFS_MAX_PATH];
+	struct tmpfs_file *file = NULL;
+	struct tmpfs_node *node;
+	int r;
+	int i;
+
+	r = tmpfs_path(filp->mp, fs_path, path);
+	if (r < 0) {
+		return r;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	for (i = 0; i < ARRAY_SIZE(tmpfs_files); i++) {
+		if (tmpfs_files[i].node == NULL) {
+			file = &tmpfs_files[i];
+			break;
+		}
+	}
+
+	node = node_find(path);
+	if (file == NULL) {
+		r = -ENOMEM;
+	} else if (node != NULL) {
+		r = node->dir ? -EISDIR : 0;
+	} else if ((flags & FS_O_CREATE) == 0) {
+		r = -ENOENT;
+	} else {
+		r = parent_check(path);
+		if (r == 0) {
+			node = node_create(path, false);
+			r = (node != NULL) ? 0 : -ENOSPC;
+		}
+	}
+
+	if (r == 0) {
+		file->node = node;
+		file->flags = flags;
+		file->pos = 0;
+		node->open += 1;
+		filp->filep = file;
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static ssize_t tmpfs_read(struct fs_file_t *filp, void *dest, size_t nbytes)
+{
+	struct tmpfs_file *file = filp->filep;
+	struct tmpfs_node *node = file->node;
+	ssize_t r;
+
+	if ((file->flags & FS_O_READ) == 0) {
+		return -EACCES;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	if (file->pos >= node->size) {
+		r = 0;
+	} else {
+		r = MIN(nbytes, node->size - file->pos);
+		node_copy_out(node, file->pos, dest, r);
+		file->pos += r;
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static ssize_t tmpfs_write(struct fs_file_t *filp, const void *src,
+			   size_t nbytes)
+{
+	struct tmpfs_file *file = filp->filep;
+	struct tmpfs_node *node = file->node;
+	size_t capacity;
+	ssize_t r = 0;
+
+	if ((file->flags & FS_O_WRITE) == 0) {
+		return -EACCES;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	if ((file->flags & FS_O_APPEND) != 0) {
+		file->pos = node->size;
+	}
+
+	if (nbytes == 0) {
+		/* Nothing to do */
+	} else if (node->maps > 0 && file->pos < node->size) {
+		/* Mapped contents can only be appended to */
+		r = -EBUSY;
+	} else {
+		capacity = node_reserve(node, file->pos + nbytes);
+		if (capacity <= file->pos) {
+			node_release(node, node->size);
+			r = -ENOSPC;
+		} else {
+			r = MIN(nbytes, capacity - file->pos);
+			if (file->pos > node->size) {
+				node_copy_in(node, node->size, NULL,
+					     file->pos - node->size);
+			}
+			node_copy_in(node, file->pos, src, r);
+			file->pos += r;
+			node->size = MAX(node->size, file->pos);
+		}
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static int tmpfs_lseek(struct fs_file_t *filp, off_t off, int whence)
+{
+	struct tmpfs_file *file = filp->filep;
+	off_t pos;
+	int r = 0;
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	switch (whence) {
+	case FS_SEEK_SET:
+		pos = off;
+		break;
+	case FS_SEEK_CUR:
+		pos = (off_t)file->pos + off;
+		break;
+	case FS_SEEK_END:
+		pos = (off_t)file->node->size + off;
+		break;
+	default:
+		pos = -1;
+		break;
+	}
+
+	if (pos < 0) {
+		r = -EINVAL;
+	} else {
+		file->pos = pos;
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static off_t tmpfs_tell(struct fs_file_t *filp)
+{
+	struct tmpfs_file *file = filp->filep;
+
+	return file->pos;
+}
+
+static int tmpfs_truncate(struct fs_file_t *filp, off_t length)
+{
+	struct tmpfs_file *file = filp->filep;
+	struct tmpfs_node *node = file->node;
+	int r = 0;
+
+	if ((file->flags & FS_O_WRITE) == 0) {
+		return -EACCES;
+	} else if (length < 0) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	if ((size_t)length < node->size) {
+		if (node->maps > 0) {
+			r = -EBUSY;
+		} else {
+			node->size = length;
+			node_release(node, length);
+		}
+	} else if ((size_t)length > node->size) {
+		if (node_reserve(node, length) < (size_t)length) {
+			node_release(node, node->size);
+			r = -ENOSPC;
+		} else {
+			node_copy_in(node, node->size, NULL, length - node->size);
+			node->size = length;
+		}
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static int tmpfs_sync(struct fs_file_t *filp)
+{
+	ARG_UNUSED(filp);
+
+	return 0;
+}
+
+static int tmpfs_close(struct fs_file_t *filp)
+{
+	struct tmpfs_file *file = filp->filep;
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+	file->node->open -= 1;
+	file->node = NULL;
+	k_mutex_unlock(&tmpfs_lock);
+
+	filp->filep = NULL;
+
+	return 0;
+}
+
+static int tmpfs_opendir(struct fs_dir_t *dirp, const char *fs_path)
+{
+	char path[TMPFS_MAX_PATH];
+	struct tmpfs_dir *dir = NULL;
+	struct tmpfs_node *node;
+	int r;
+	int i;
+
+	r = tmpfs_path(dirp->mp, fs_path, path);
+	if (r < 0) {
+		return r;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	node = node_find(path);
+	if (path[0] != '\0' && node == NULL) {
+		r = -ENOENT;
+	} else if (node != NULL && !node->dir) {
+		r = -ENOTDIR;
+	} else {
+		r = -ENOMEM;
+		for (i = 0; i < ARRAY_SIZE(tmpfs_dirs); i++) {
+			if (!tmpfs_dirs[i].used) {
+				dir = &tmpfs_dirs[i];
+				dir->used = true;
+				dir->next = 0;
+				strcpy(dir->path, path);
+				dirp->dirp = dir;
+				r = 0;
+				break;
+			}
+		}
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static int tmpfs_readdir(struct fs_dir_t *dirp, struct fs_dirent *entry)
+{
+	struct tmpfs_dir *dir = dirp->dirp;
+	struct tmpfs_node *node;
+
+	/* An empty name marks the end of the directory */
+	entry->name[0] = '\0';
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	while (dir->next < ARRAY_SIZE(tmpfs_nodes)) {
+		node = &tmpfs_nodes[dir->next++];
+		if (node->used && node_in_dir(node, dir->path)) {
+			entry->type = node->dir ? FS_DIR_ENTRY_DIR : FS_DIR_ENTRY_FILE;
+			entry->size = node->size;
+			strncpy(entry->name, path_basename(node->path), MAX_FILE_NAME);
+			entry->name[MAX_FILE_NAME] = '\0';
+			break;
+		}
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return 0;
+}
+
+static int tmpfs_closedir(struct fs_dir_t *dirp)
+{
+	struct tmpfs_dir *dir = dirp->dirp;
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+	dir->used = false;
+	k_mutex_unlock(&tmpfs_lock);
+
+	dirp->dirp = NULL;
+
+	return 0;
+}
+
+static int tmpfs_mount(struct fs_mount_t *mountp)
+{
+	int r = 0;
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	if (tmpfs_mnt != NULL) {
+		LOG_ERR("tmpfs is already mounted at %s", tmpfs_mnt->mnt_point);
+		r = -EBUSY;
+	} else {
+		memset(tmpfs_nodes, 0, sizeof(tmpfs_nodes));
+		memset(tmpfs_block_map, 0, sizeof(tmpfs_block_map));
+		tmpfs_free_blocks = TMPFS_BLOCKS;
+		tmpfs_mnt = mountp;
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static int tmpfs_unmount(struct fs_mount_t *mountp)
+{
+	int r = 0;
+	int i;
+
+	ARG_UNUSED(mountp);
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	for (i = 0; i < ARRAY_SIZE(tmpfs_nodes); i++) {
+		if (tmpfs_nodes[i].used &&
+		    (tmpfs_nodes[i].open > 0 || tmpfs_nodes[i].maps > 0)) {
+			r = -EBUSY;
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(tmpfs_dirs); i++) {
+		if (tmpfs_dirs[i].used) {
+			r = -EBUSY;
+		}
+	}
+
+	if (r == 0) {
+		tmpfs_mnt = NULL;
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static int tmpfs_unlink(struct fs_mount_t *mountp, const char *name)
+{
+	char path[TMPFS_MAX_PATH];
+	struct tmpfs_node *node;
+	int r;
+
+	r = tmpfs_path(mountp, name, path);
+	if (r < 0) {
+		return r;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	node = node_find(path);
+	if (node == NULL) {
+		r = -ENOENT;
+	} else if (node->open > 0 || node->maps > 0) {
+		r = -EBUSY;
+	} else if (node->dir && !dir_empty(path)) {
+		r = -ENOTEMPTY;
+	} else {
+		node_delete(node);
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static int tmpfs_rename(struct fs_mount_t *mountp, const char *from,
+			const char *to)
+{
+	char from_path[TMPFS_MAX_PATH];
+	char to_path[TMPFS_MAX_PATH];
+	struct tmpfs_node *node;
+	struct tmpfs_node *existing;
+	size_t from_len;
+	size_t to_len;
+	int r;
+	int i;
+
+	r = tmpfs_path(mountp, from, from_path);
+	if (r == 0) {
+		r = tmpfs_path(mountp, to, to_path);
+	}
+	if (r < 0) {
+		return r;
+	}
+	from_len = strlen(from_path);
+	to_len = strlen(to_path);
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	node = node_find(from_path);
+	existing = node_find(to_path);
+	if (node == NULL) {
+		r = -ENOENT;
+	} else if (node == existing) {
+		r = 0;
+	} else if (node->dir && strncmp(to_path, from_path, from_len) == 0 &&
+		   to_path[from_len] == '/') {
+		/* A directory can't be moved into itself */
+		r = -EINVAL;
+	} else {
+		r = parent_check(to_path);
+	}
+
+	/* An existing file, or empty directory, is replaced */
+	if (r == 0 && node != existing && existing != NULL) {
+		if (existing->dir != node->dir) {
+			r = existing->dir ? -EISDIR : -ENOTDIR;
+		} else if (existing->open > 0 || existing->maps > 0) {
+			r = -EBUSY;
+		} else if (existing->dir && !dir_empty(to_path)) {
+			r = -ENOTEMPTY;
+		}
+	}
+
+	/* The contents of a directory move with it */
+	for (i = 0; r == 0 && node->dir && i < ARRAY_SIZE(tmpfs_nodes); i++) {
+		if (tmpfs_nodes[i].used &&
+		    strncmp(tmpfs_nodes[i].path, from_path, from_len) == 0 &&
+		    tmpfs_nodes[i].path[from_len] == '/' &&
+		    (strlen(tmpfs_nodes[i].path) - from_len + to_len) >= TMPFS_MAX_PATH) {
+			r = -ENAMETOOLONG;
+		}
+	}
+
+	if (r == 0 && node != existing) {
+		if (existing != NULL) {
+			node_delete(existing);
+		}
+		for (i = 0; node->dir && i < ARRAY_SIZE(tmpfs_nodes); i++) {
+			if (tmpfs_nodes[i].used &&
+			    strncmp(tmpfs_nodes[i].path, from_path, from_len) == 0 &&
+			    tmpfs_nodes[i].path[from_len] == '/') {
+				memmove(&tmpfs_nodes[i].path[to_len],
+					&tmpfs_nodes[i].path[from_len],
+					strlen(&tmpfs_nodes[i].path[from_len]) + 1);
+				memcpy(tmpfs_nodes[i].path, to_path, to_len);
+			}
+		}
+		strcpy(node->path, to_path);
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static int tmpfs_mkdir(struct fs_mount_t *mountp, const char *name)
+{
+	char path[TMPFS_MAX_PATH];
+	int r;
+
+	r = tmpfs_path(mountp, name, path);
+	if (r < 0) {
+		return r;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	if (path[0] == '\0' || node_find(path) != NULL) {
+		r = -EEXIST;
+	} else {
+		r = parent_check(path);
+		if (r == 0 && node_create(path, true) == NULL) {
+			r = -ENOSPC;
+		}
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static int tmpfs_stat(struct fs_mount_t *mountp, const char *path,
+		      struct fs_dirent *entry)
+{
+	char rel_path[TMPFS_MAX_PATH];
+	struct tmpfs_node *node;
+	int r;
+
+	r = tmpfs_path(mountp, path, rel_path);
+	if (r < 0) {
+		return r;
+	}
+
+	if (rel_path[0] == '\0') {
+		entry->type = FS_DIR_ENTRY_DIR;
+		entry->size = 0;
+		entry->name[0] = '\0';
+		return 0;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	node = node_find(rel_path);
+	if (node == NULL) {
+		r = -ENOENT;
+	} else {
+		entry->type = node->dir ? FS_DIR_ENTRY_DIR : FS_DIR_ENTRY_FILE;
+		entry->size = node->size;
+		strncpy(entry->name, path_basename(node->path), MAX_FILE_NAME);
+		entry->name[MAX_FILE_NAME] = '\0';
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+static int tmpfs_statvfs(struct fs_mount_t *mountp, const char *path,
+			 struct fs_statvfs *stat)
+{
+	ARG_UNUSED(mountp);
+	ARG_UNUSED(path);
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+	stat->f_bsize = TMPFS_BLOCK_SIZE;
+	stat->f_frsize = TMPFS_BLOCK_SIZE;
+	stat->f_blocks = TMPFS_BLOCKS;
+	stat->f_bfree = tmpfs_free_blocks;
+	k_mutex_unlock(&tmpfs_lock);
+
+	return 0;
+}
+
+static const struct fs_file_system_t tmpfs_fs = {
+	.open = tmpfs_open,
+	.read = tmpfs_read,
+	.write = tmpfs_write,
+	.lseek = tmpfs_lseek,
+	.tell = tmpfs_tell,
+	.truncate = tmpfs_truncate,
+	.sync = tmpfs_sync,
+	.close = tmpfs_close,
+	.opendir = tmpfs_opendir,
+	.readdir = tmpfs_readdir,
+	.closedir = tmpfs_closedir,
+	.mount = tmpfs_mount,
+	.unmount = tmpfs_unmount,
+	.unlink = tmpfs_unlink,
+	.rename = tmpfs_rename,
+	.mkdir = tmpfs_mkdir,
+	.stat = tmpfs_stat,
+	.statvfs = tmpfs_statvfs,
+};
+
+static int tmpfs_init(const struct device *device)
+{
+	int r;
+
+	ARG_UNUSED(device);
+
+	r = fs_register(LCZ_RAMDISK_FS_TYPE, &tmpfs_fs);
+	if (r < 0) {
+		LOG_ERR("Unable to register tmpfs (type %d): %d, check "
+			"CONFIG_FILE_SYSTEM_MAX_TYPES",
+			LCZ_RAMDISK_FS_TYPE, r);
+	}
+
+	return r;
+}
+
+/* After the file system subsystem, before the RAMDISK is mounted */
+SYS_INIT(tmpfs_init, POST_KERNEL, 99);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int lcz_ramdisk_map(const char *abs_path, off_t offset,
+		    struct lcz_ramdisk_map *map)
+{
+	char path[TMPFS_MAX_PATH];
+	struct tmpfs_node *node;
+	size_t contig;
+	int r;
+
+	if (abs_path == NULL || map == NULL || offset < 0) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+
+	if (tmpfs_mnt == NULL ||
+	    strncmp(abs_path, tmpfs_mnt->mnt_point, tmpfs_mnt->mountp_len) != 0 ||
+	    (abs_path[tmpfs_mnt->mountp_len] != '/' &&
+	     abs_path[tmpfs_mnt->mountp_len] != '\0')) {
+		r = -ENOENT;
+	} else {
+		r = tmpfs_path(tmpfs_mnt, abs_path, path);
+	}
+
+	if (r == 0) {
+		node = node_find(path);
+		if (node == NULL || node->dir) {
+			r = -ENOENT;
+		} else if ((size_t)offset >= node->size) {
+			r = -EINVAL;
+		} else {
+			map->data = node_locate(node, offset, &contig);
+			map->size = MIN(contig, node->size - offset);
+			map->priv = node;
+			node->maps += 1;
+		}
+	}
+
+	k_mutex_unlock(&tmpfs_lock);
+
+	return r;
+}
+
+void lcz_ramdisk_unmap(struct lcz_ramdisk_map *map)
+{
+	struct tmpfs_node *node;
+
+	if (map == NULL || map->priv == NULL) {
+		return;
+	}
+
+	k_mutex_lock(&tmpfs_lock, K_FOREVER);
+	node = map->priv;
+	if (node->maps > 0) {
+		node->maps -= 1;
+	}
+	k_mutex_unlock(&tmpfs_lock);
+
+	map->data = NULL;
+	map->size = 0;
+	map->priv = NULL;
+}
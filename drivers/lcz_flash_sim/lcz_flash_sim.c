@@ -0,0 +1,391 @@
+/**
+ * @file lcz_flash_sim.c
+ * @brief RAM backed flash driver that takes as long as the QSPI NOR part.
+ *
+ * Programs are done a page at a time and only clear bits, erases use the
+ * same sector/block/chip selection as lcz_nrf_qspi_nor and the first access
+ * after the cool down period pays the DPM exit time. Times come from the
+ * devicetree node so that a board overlay can describe a different part.
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT lcz_flash_sim
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(lcz_flash_sim, CONFIG_LCZ_FLASH_SIM_LOG_LEVEL);
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <device.h>
+#include <init.h>
+#include <string.h>
+#include <errno.h>
+#include <drivers/flash.h>
+
+#include "lcz_flash_sim.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define FLASH_SIM_PAGE_SIZE 256
+#define FLASH_SIM_SECTOR_SIZE 4096
+#define FLASH_SIM_BLOCK_SIZE 65536
+#define FLASH_SIM_ERASE_VALUE 0xff
+
+#define NS_TO_US_CEIL(ns) (((ns) + 999) / 1000)
+
+struct flash_sim_config {
+	uint8_t *memory;
+	uint32_t size;
+	uint32_t t_enter_dpd;
+	uint32_t t_exit_dpd;
+	uint32_t t_page_program;
+	uint32_t t_sector_erase;
+	uint32_t t_block_erase;
+	uint32_t t_chip_erase;
+	uint32_t read_bandwidth;
+#if defined(CONFIG_FLASH_PAGE_LAYOUT)
+	struct flash_pages_layout layout;
+#endif
+};
+
+struct flash_sim_data {
+	struct k_mutex lock;
+	/* End of the last operation */
+	int64_t idle_start;
+	struct lcz_flash_sim_stats stats;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+/* Same as lcz_nrf_qspi_nor so that storage configurations can be shared */
+static const struct flash_parameters flash_sim_parameters = {
+	.write_block_size = 4,
+	.erase_value = FLASH_SIM_ERASE_VALUE,
+};
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static inline int64_t flash_sim_now(void)
+{
+	return (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static bool flash_sim_range_valid(const struct device *dev, off_t addr,
+				  size_t size)
+{
+	const struct flash_sim_config *cfg = dev->config;
+
+	return (addr >= 0) && ((size_t)addr <= cfg->size) &&
+	       (size <= (cfg->size - (size_t)addr));
+}
+
+/* Lock the part and get the time spent waking it from DPM. The real driver
+ * enters DPM from a work item after the cool down period, an access that
+ * arrives while that is in progress waits for it to finish.
+ */
+static uint32_t flash_sim_begin(const struct device *dev)
+{
+	const struct flash_sim_config *cfg = dev->config;
+	struct flash_sim_data *data = dev->data;
+	int64_t cool_down = (int64_t)CONFIG_LCZ_FLASH_SIM_COOL_DOWN_PERIOD * 1000;
+	int64_t idle;
+	uint32_t wait = 0;
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+
+	idle = flash_sim_now() - data->idle_start;
+	if ((cool_down > 0) && (idle >= cool_down)) {
+		idle -= cool_down;
+		if (idle < cfg->t_enter_dpd) {
+			wait = cfg->t_enter_dpd - (uint32_t)idle;
+		}
+		wait += cfg->t_exit_dpd;
+		data->stats.dpm_wakes += 1;
+	}
+
+	return wait;
+}
+
+/* Wait for the modelled operation time and unlock */
+static void flash_sim_end(const struct device *dev, uint32_t us)
+{
+	struct flash_sim_data *data = dev->data;
+
+	if (IS_ENABLED(CONFIG_LCZ_FLASH_SIM_TIMING) && us > 0) {
+		data->stats.busy_us += us;
+		data->stats.max_us = MAX(data->stats.max_us, us);
+		/* Sleeping rounds up to a tick so short operations spin */
+		if (us >= k_ticks_to_us_ceil32(1)) {
+			k_usleep(us);
+		} else {
+			k_busy_wait(us);
+		}
+	}
+
+	data->idle_start = flash_sim_now();
+	k_mutex_unlock(&data->lock);
+}
+
+static int flash_sim_read(const struct device *dev, off_t addr, void *dest,
+			  size_t size)
+{
+	const struct flash_sim_config *cfg = dev->config;
+	struct flash_sim_data *data = dev->data;
+	uint32_t us;
+
+	if (dest == NULL) {
+		return -EINVAL;
+	}
+
+	if (!flash_sim_range_valid(dev, addr, size)) {
+		LOG_ERR("flash_sim_read: Invalid range 0x%lx size %zu",
+			(long)addr, size);
+		return -EINVAL;
+	}
+
+	us = flash_sim_begin(dev);
+
+	memcpy(dest, &cfg->memory[addr], size);
+
+	/* Kilobytes per second is bytes per millisecond */
+	if (cfg->read_bandwidth > 0) {
+		us += (uint32_t)(((uint64_t)size * 1000) / cfg->read_bandwidth);
+	}
+	data->stats.reads += 1;
+	data->stats.read_bytes += size;
+
+	flash_sim_end(dev, us);
+
+	return 0;
+}
+
+static int flash_sim_write(const struct device *dev, off_t addr,
+			   const void *src, size_t size)
+{
+	const struct flash_sim_config *cfg = dev->config;
+	struct flash_sim_data *data = dev->data;
+	const uint8_t *p = src;
+	uint32_t us;
+	size_t chunk;
+	size_t i;
+
+	if (src == NULL) {
+		return -EINVAL;
+	}
+
+	/* Same restrictions as lcz_nrf_qspi_nor: a word aligned address and a
+	 * non-zero size that is less than 4 or a multiple of 4.
+	 */
+	if (size == 0 || (addr % 4) != 0 || (size > 4 && (size % 4) != 0)) {
+		LOG_ERR("flash_sim_write: Unaligned write 0x%lx size %zu",
+			(long)addr, size);
+		return -EINVAL;
+	}
+
+	if (!flash_sim_range_valid(dev, addr, size)) {
+		LOG_ERR("flash_sim_write: Invalid range 0x%lx size %zu",
+			(long)addr, size);
+		return -EINVAL;
+	}
+
+	us = flash_sim_begin(dev);
+
+	/* A program can't cross a page boundary so each page touched costs a
+	 * page program. NOR flash can only clear bits.
+	 */
+	while (size > 0) {
+		chunk = MIN(size, FLASH_SIM_PAGE_SIZE - (addr % FLASH_SIM_PAGE_SIZE));
+		for (i = 0; i < chunk; i++) {
+			cfg->memory[addr + i] &= p[i];
+		}
+		us += cfg->t_page_program;
+		data->stats.page_programs += 1;
+		data->stats.write_bytes += chunk;
+		addr += chunk;
+		p += chunk;
+		size -= chunk;
+	}
+	data->stats.writes += 1;
+
+	flash_sim_end(dev, us);
+
+	return 0;
+}
+
+static void flash_sim_erase_unit(const struct device *dev, off_t addr,
+				 size_t size)
+{
+	const struct flash_sim_config *cfg = dev->config;
+	struct flash_sim_data *data = dev->data;
+	uint32_t us;
+
+	us = flash_sim_begin(dev);
+
+	memset(&cfg->memory[addr], FLASH_SIM_ERASE_VALUE, size);
+
+	if (size == cfg->size) {
+		us += cfg->t_chip_erase;
+		data->stats.chip_erases += 1;
+	} else if (size == FLASH_SIM_BLOCK_SIZE) {
+		us += cfg->t_block_erase;
+		data->stats.block_erases += 1;
+	} else {
+		us += cfg->t_sector_erase;
+		data->stats.sector_erases += 1;
+	}
+	data->stats.erase_bytes += size;
+
+	flash_sim_end(dev, us);
+}
+
+static int flash_sim_erase(const struct device *dev, off_t addr, size_t size)
+{
+	const struct flash_sim_config *cfg = dev->config;
+	size_t unit;
+
+	/* address must be sector-aligned and size a non-zero multiple of sectors */
+	if (((addr % FLASH_SIM_SECTOR_SIZE) != 0) || (size == 0) ||
+	    ((size % FLASH_SIM_SECTOR_SIZE) != 0)) {
+		return -EINVAL;
+	}
+
+	if (!flash_sim_range_valid(dev, addr, size)) {
+		LOG_ERR("flash_sim_erase: Invalid range 0x%lx size %zu",
+			(long)addr, size);
+		return -EINVAL;
+	}
+
+	/* The part is unlocked between units so that reads can be done
+	 * between them, as in lcz_nrf_qspi_nor.
+	 */
+	while (size > 0) {
+		if (size == cfg->size) {
+			unit = size;
+		} else if ((size >= FLASH_SIM_BLOCK_SIZE) &&
+			   ((addr % FLASH_SIM_BLOCK_SIZE) == 0)) {
+			unit = FLASH_SIM_BLOCK_SIZE;
+		} else {
+			unit = FLASH_SIM_SECTOR_SIZE;
+		}
+
+		flash_sim_erase_unit(dev, addr, unit);
+		addr += unit;
+		size -= unit;
+	}
+
+	return 0;
+}
+
+static const struct flash_parameters *
+flash_sim_get_parameters(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	return &flash_sim_parameters;
+}
+
+#if defined(CONFIG_FLASH_PAGE_LAYOUT)
+static void flash_sim_pages_layout(const struct device *dev,
+				   const struct flash_pages_layout **layout,
+				   size_t *layout_size)
+{
+	const struct flash_sim_config *cfg = dev->config;
+
+	*layout = &cfg->layout;
+	*layout_size = 1;
+}
+#endif
+
+static int flash_sim_init(const struct device *dev)
+{
+	const struct flash_sim_config *cfg = dev->config;
+	struct flash_sim_data *data = dev->data;
+
+	k_mutex_init(&data->lock);
+	memset(cfg->memory, FLASH_SIM_ERASE_VALUE, cfg->size);
+	data->idle_start = flash_sim_now();
+
+	return 0;
+}
+
+static const struct flash_driver_api flash_sim_api = {
+	.read = flash_sim_read,
+	.write = flash_sim_write,
+	.erase = flash_sim_erase,
+	.get_parameters = flash_sim_get_parameters,
+#if defined(CONFIG_FLASH_PAGE_LAYOUT)
+	.page_layout = flash_sim_pages_layout,
+#endif
+};
+
+#if defined(CONFIG_FLASH_PAGE_LAYOUT)
+#define FLASH_SIM_LAYOUT(n)                                                    \
+	.layout = {                                                            \
+		.pages_count = (DT_INST_PROP(n, size) / 8) /                   \
+			       CONFIG_LCZ_FLASH_SIM_LAYOUT_PAGE_SIZE,          \
+		.pages_size = CONFIG_LCZ_FLASH_SIM_LAYOUT_PAGE_SIZE,           \
+	},
+#else
+#define FLASH_SIM_LAYOUT(n)
+#endif
+
+#define FLASH_SIM_DEFINE(n)                                                    \
+	BUILD_ASSERT(((DT_INST_PROP(n, size) / 8) %                            \
+		      CONFIG_LCZ_FLASH_SIM_LAYOUT_PAGE_SIZE) == 0,             \
+		     "LCZ_FLASH_SIM_LAYOUT_PAGE_SIZE incompatible with size"); \
+	static uint8_t flash_sim_memory_##n[DT_INST_PROP(n, size) / 8];        \
+	static struct flash_sim_data flash_sim_data_##n;                       \
+	static const struct flash_sim_config flash_sim_config_##n = {          \
+		.memory = flash_sim_memory_##n,                                \
+		.size = DT_INST_PROP(n, size) / 8,                             \
+		.t_enter_dpd = NS_TO_US_CEIL(DT_INST_PROP(n, t_enter_dpd)),    \
+		.t_exit_dpd = NS_TO_US_CEIL(DT_INST_PROP(n, t_exit_dpd)),      \
+		.t_page_program = DT_INST_PROP(n, t_page_program),             \
+		.t_sector_erase = DT_INST_PROP(n, t_sector_erase),             \
+		.t_block_erase = DT_INST_PROP(n, t_block_erase),               \
+		.t_chip_erase = DT_INST_PROP(n, t_chip_erase) * 1000,          \
+		.read_bandwidth = DT_INST_PROP(n, read_bandwidth),             \
+		FLASH_SIM_LAYOUT(n)                                            \
+	};                                                                     \
+	DEVICE_DT_INST_DEFINE(n, flash_sim_init, NULL, &flash_sim_data_##n,    \
+			      &flash_sim_config_##n, POST_KERNEL,              \
+			      CONFIG_LCZ_FLASH_SIM_INIT_PRIORITY,              \
+			      &flash_sim_api);
+
+DT_INST_FOREACH_STATUS_OKAY(FLASH_SIM_DEFINE)
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int lcz_flash_sim_get_stats(const struct device *dev,
+			    struct lcz_flash_sim_stats *stats)
+{
+	struct flash_sim_data *data = dev->data;
+
+	if (stats == NULL) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+	*stats = data->stats;
+	k_mutex_unlock(&data->lock);
+
+	return 0;
+}
+
+void lcz_flash_sim_reset_stats(const struct device *dev)
+{
+	struct flash_sim_data *data = dev->data;
+
+	k_mutex_lock(&data->lock, K_FOREVER);
+	memset(&data->stats, 0, sizeof(data->stats));
+	k_mutex_unlock(&data->lock);
+}
@@ -22,6 +22,8 @@
 #include <init.h>
 #include <string.h>
 #include <logging/log.h>
+#include <sys/byteorder.h>
+#include <sys/atomic.h>
 
 #include "../../../../zephyr/drivers/flash/spi_nor.h"
 #include "../../../../zephyr/drivers/flash/jesd216.h"
@@ -29,11 +31,24 @@
 #include <nrfx_qspi.h>
 #include <hal/nrf_clock.h>
 
+#include "lcz_nrf_qspi_nor.h"
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD
+#include "lcz_nrf_qspi_nor_erase_ahead.h"
+#endif
+
 #define QSPI_FLASH_DPM_ENTER_DURATION (uint32_t)(MIN(1, DT_INST_PROP(0, t_enter_dpd) / 256 / 62.5)) //Duration required to enter DPM, in units of 16us
 #define QSPI_FLASH_DPM_EXIT_DURATION (uint32_t)(MIN(1, DT_INST_PROP(0, t_exit_dpd) / 256 / 62.5)) //Duration required to enter DPM, in units of 16us
 
 #define SPI_NOR_CMD_RDCR 0x15
 
+/* Erase instructions that always take a 4 byte address */
+#ifndef SPI_NOR_CMD_SE_4B
+#define SPI_NOR_CMD_SE_4B 0x21
+#endif
+#ifndef SPI_NOR_CMD_BE_4B
+#define SPI_NOR_CMD_BE_4B 0xDC
+#endif
+
 #define QSPI_CR_HIGH_PERFORMANCE_BIT ((uint8_t)BIT(1))
 
 typedef enum qspi_configuration_register {
@@ -136,15 +151,38 @@ struct qspi_cmd {
  *
  * @param work - The work queue item.
  * @param isInitialised - Set when the QSPI is running, cleared otherwise.
+ * @param idle_start - Uptime when the QSPI was last unlocked.
+ * @param dpm_start - Uptime when DPM was last entered.
+ * @param predicted_gap - Moving average of the time between accesses (ms).
+ * @param period - Cool down period used when the QSPI was last unlocked.
  */
 #ifdef CONFIG_PM_DEVICE
 struct nrf_qspi_nor_cool_down_t
 {
 	struct k_work_delayable work;
 	bool isInitialised;
+	uint32_t idle_start;
+	uint32_t dpm_start;
+	uint32_t dpm_entries;
+	uint32_t wakes;
+	uint32_t dpm_time;
+	uint32_t predicted_gap;
+	uint32_t period;
 };
 #endif
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_ADAPTIVE_COOL_DOWN
+/* Weight of a new gap in the moving average is 1/8 */
+#define COOL_DOWN_GAP_SHIFT 3
+
+BUILD_ASSERT(CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_MIN_PERIOD <=
+	     CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD,
+	     "Minimum cool down period must not exceed the maximum");
+BUILD_ASSERT(CONFIG_LCZ_NRF_QSPI_NOR_DPM_BREAK_EVEN_TIME <=
+	     CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD,
+	     "DPM break-even time must not exceed the cool down period");
+#endif
+
 /**
  * @brief Structure for defining the QSPI NOR access
  */
@@ -175,6 +213,160 @@ struct qspi_nor_data {
 #endif
 };
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_READ_CACHE
+#define READ_CACHE_LINE_SIZE CONFIG_LCZ_NRF_QSPI_NOR_READ_CACHE_LINE_SIZE
+#define READ_CACHE_LINES CONFIG_LCZ_NRF_QSPI_NOR_READ_CACHE_LINES
+#define READ_AHEAD_LINES CONFIG_LCZ_NRF_QSPI_NOR_READ_AHEAD_LINES
+
+BUILD_ASSERT((READ_CACHE_LINE_SIZE >= 16) &&
+	     ((READ_CACHE_LINE_SIZE & (READ_CACHE_LINE_SIZE - 1)) == 0),
+	     "Read cache line size must be a power of two");
+BUILD_ASSERT(READ_AHEAD_LINES < READ_CACHE_LINES,
+	     "Read ahead must leave a line for the line being read");
+
+/**
+ * @brief Line of flash held in RAM
+ *
+ * @param addr - Flash address of the line (line size aligned).
+ * @param last_use - Use counter value when the line was last accessed.
+ * @param valid - Set when data holds the contents of flash.
+ * @param data - Word aligned so that it can be the target of a QSPI DMA read.
+ */
+struct qspi_read_cache_line {
+	uint32_t addr;
+	uint32_t last_use;
+	bool valid;
+	uint8_t __aligned(WORD_SIZE) data[READ_CACHE_LINE_SIZE];
+};
+
+/**
+ * @brief Read cache
+ * The lock is taken before the QSPI lock on a miss, so a cache hit never
+ * touches the peripheral (or wakes the flash from DPM).
+ * Writes and erases invalidate lines after the flash has been changed.
+ *
+ * @param next_addr - Address following the last read; used to detect
+ * sequential reads.
+ */
+struct qspi_read_cache {
+	struct k_mutex lock;
+	uint32_t use_count;
+	off_t next_addr;
+	uint32_t hits;
+	uint32_t misses;
+	struct qspi_read_cache_line lines[READ_CACHE_LINES];
+};
+
+static struct qspi_read_cache read_cache = {
+	.lock = Z_MUTEX_INITIALIZER(read_cache.lock),
+	.next_addr = -1,
+};
+#endif
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_PREEMPTIBLE_ERASE
+BUILD_ASSERT(CONFIG_LCZ_NRF_QSPI_NOR_ERASE_POLL_PERIOD <
+	     CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD,
+	     "Flash mustn't enter DPM while an erase is in progress");
+
+/* DW12 and DW13 of the SFDP basic flash parameter table (JESD216A) */
+#define SFDP_BFP_SUSPEND_DW 12
+#define SFDP_BFP_DW12_SUSPEND_NOT_SUPPORTED BIT(31)
+#define SFDP_BFP_DW12_RESUME_TO_SUSPEND_POS 20
+#define SFDP_BFP_DW12_RESUME_TO_SUSPEND_MASK 0xF
+#define SFDP_BFP_DW12_RESUME_TO_SUSPEND_UNIT_US 64
+#define SFDP_BFP_DW13_ERASE_SUSPEND_POS 24
+#define SFDP_BFP_DW13_ERASE_RESUME_POS 16
+
+/**
+ * @brief Erase state
+ * Only changed with the QSPI locked.
+ *
+ * @param busy - An erase has been started and the flash hasn't reported
+ * that it has finished.
+ * @param suspended - A reader has suspended the erase.
+ * @param resume_interval_us - Minimum time from resume to the next suspend.
+ * Without this an erase that is continually suspended never finishes.
+ * @param resume_cycles - Cycle count when the erase was last resumed.
+ */
+struct qspi_erase_state {
+	bool suspend_supported;
+	uint8_t suspend_opcode;
+	uint8_t resume_opcode;
+	uint32_t resume_interval_us;
+	bool busy;
+	bool suspended;
+	uint32_t resume_cycles;
+};
+
+static struct qspi_erase_state erase_state;
+#endif
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD
+#define ERASE_AHEAD_SECTORS (INST_0_BYTES / QSPI_SECTOR_SIZE)
+
+/**
+ * @brief Erase-ahead pool
+ * The lock is held for the whole of a write or erase (before the
+ * transaction lock) so that a sector can't be written between being erased
+ * and being marked as erased.
+ *
+ * @param last_access - Uptime of the last read, write or erase request.
+ */
+struct qspi_erase_ahead {
+	const struct device *dev;
+	struct k_mutex lock;
+	struct k_work_delayable work;
+	uint32_t last_access;
+};
+
+static struct qspi_erase_ahead erase_ahead = {
+	.lock = Z_MUTEX_INITIALIZER(erase_ahead.lock),
+};
+
+LCZ_ERASE_AHEAD_MAP_DEFINE(erase_ahead_map, ERASE_AHEAD_SECTORS);
+#endif
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_WRITE_BUFFER
+#define WRITE_BUFFER_SIZE SPI_NOR_PAGE_SIZE
+
+/**
+ * @brief Page buffer for writes that can't be DMA'd from their source
+ * The lock is taken before any of the other driver locks.
+ *
+ * @param data - Page contents; a write to addr starts at offset
+ * (addr % page size).
+ */
+struct qspi_write_buffer {
+	struct k_mutex lock;
+	uint8_t __aligned(WORD_SIZE) data[WRITE_BUFFER_SIZE];
+};
+
+static struct qspi_write_buffer write_buffer = {
+	.lock = Z_MUTEX_INITIALIZER(write_buffer.lock),
+};
+#endif
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_TELEMETRY
+#define WEAR_UNIT CONFIG_LCZ_NRF_QSPI_NOR_TELEMETRY_WEAR_UNIT
+#define WEAR_UNITS (INST_0_BYTES / WEAR_UNIT)
+
+BUILD_ASSERT((WEAR_UNIT % QSPI_SECTOR_SIZE) == 0,
+	     "Wear unit must be a multiple of the sector size");
+
+/**
+ * @brief Telemetry
+ * Counters are updated with interrupts locked.
+ *
+ * @param wear - Erases of each wear unit since boot.
+ */
+struct qspi_telemetry {
+	struct lcz_nrf_qspi_nor_op_stats ops[LCZ_NRF_QSPI_NOR_OP_COUNT];
+	uint32_t wear[WEAR_UNITS];
+};
+
+static struct qspi_telemetry telemetry;
+#endif
+
 static int qspi_nrfx_configure(const struct device *dev);
 
 static int qspi_nor_write_protection_set(const struct device *dev,
@@ -316,6 +508,47 @@ static inline struct qspi_nor_data *get_dev_data(const struct device *dev)
 	return dev->data;
 }
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_ADAPTIVE_COOL_DOWN
+static inline void cool_down_predict(struct nrf_qspi_nor_cool_down_t *cd,
+				     uint32_t gap)
+{
+	/* Long idle periods only need to be known to be long */
+	gap = MIN(gap, 2 * CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD);
+	cd->predicted_gap = cd->predicted_gap - (cd->predicted_gap >> COOL_DOWN_GAP_SHIFT) +
+			    (gap >> COOL_DOWN_GAP_SHIFT);
+}
+
+/* If the next access is expected well after the break-even time, entering
+ * DPM straight away saves the most energy. If it is expected well before,
+ * staying out of DPM avoids the wake latency. Otherwise waiting for the
+ * break-even time costs at most twice the best choice.
+ */
+static inline uint32_t cool_down_period(const struct nrf_qspi_nor_cool_down_t *cd)
+{
+	const uint32_t break_even = CONFIG_LCZ_NRF_QSPI_NOR_DPM_BREAK_EVEN_TIME;
+
+	if (cd->predicted_gap >= (2 * break_even)) {
+		return CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_MIN_PERIOD;
+	} else if (cd->predicted_gap <= (break_even / 2)) {
+		return CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD;
+	} else {
+		return MIN(MAX(break_even, CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_MIN_PERIOD),
+			   CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD);
+	}
+}
+#else
+static inline void cool_down_predict(struct nrf_qspi_nor_cool_down_t *cd,
+				     uint32_t gap)
+{
+	cd->predicted_gap = gap;
+}
+
+static inline uint32_t cool_down_period(const struct nrf_qspi_nor_cool_down_t *cd)
+{
+	return CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD;
+}
+#endif
+
 static inline void qspi_lock(const struct device *dev)
 {
 	key_t qspi_lock_key;
@@ -329,12 +562,23 @@ static inline void qspi_lock(const struct device *dev)
 	/* Immediately stop any pending work requests */
 	k_work_cancel_delayable(&dev_data->nrf_qspi_nor_cool_down.work);
 
+	uint32_t now = k_uptime_get_32();
+
+	/* Only the first lock ends an idle period */
+	if (dev_data->sem.lock_count == 1) {
+		cool_down_predict(&dev_data->nrf_qspi_nor_cool_down,
+				  now - dev_data->nrf_qspi_nor_cool_down.idle_start);
+	}
+
 	/* Did the interface get shut off? */
 	if (!dev_data->nrf_qspi_nor_cool_down.isInitialised) {
 		/* Set the initialised flag here to prevent 
 		 * entering the configure call again.
 		 */
 		dev_data->nrf_qspi_nor_cool_down.isInitialised = true;
+		dev_data->nrf_qspi_nor_cool_down.wakes += 1;
+		dev_data->nrf_qspi_nor_cool_down.dpm_time +=
+			now - dev_data->nrf_qspi_nor_cool_down.dpm_start;
 
 		/* Disable DPM mode */
 		QSPIconfig.phy_if.dpmen = false;
@@ -357,10 +601,14 @@ static inline void qspi_unlock(const struct device *dev)
 	 * last unlock operation.
 	 */
 	if (dev_data->sem.lock_count == 1) {
+		dev_data->nrf_qspi_nor_cool_down.idle_start = k_uptime_get_32();
+		dev_data->nrf_qspi_nor_cool_down.period =
+			cool_down_period(&dev_data->nrf_qspi_nor_cool_down);
+
 		/* OK to request for the QSPI interface to be shut off now */
 		k_work_schedule(
 			&dev_data->nrf_qspi_nor_cool_down.work,
-			K_MSEC(CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD));
+			K_MSEC(dev_data->nrf_qspi_nor_cool_down.period));
 	}
 
 	k_mutex_unlock(&dev_data->sem);
@@ -626,6 +874,300 @@ static int qspi_wait_while_writing(const struct device *dev)
 	return (ret < 0) ? ret : 0;
 }
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_PREEMPTIBLE_ERASE
+/* Start an erase with a custom instruction so that the QSPI isn't busy
+ * polling the flash status, then poll with the QSPI unlocked.
+ */
+static int erase_preemptible(const struct device *dev, uint8_t opcode,
+			     uint32_t addr)
+{
+	uint8_t addr_buf[4];
+	size_t addr_len = 0;
+	bool busy;
+	int rc;
+
+	if (QSPIconfig.prot_if.addrmode == NRF_QSPI_ADDRMODE_32BIT) {
+		opcode = (opcode == SPI_NOR_CMD_BE) ? SPI_NOR_CMD_BE_4B :
+						      SPI_NOR_CMD_SE_4B;
+		addr_buf[addr_len++] = addr >> 24;
+	}
+	addr_buf[addr_len++] = addr >> 16;
+	addr_buf[addr_len++] = addr >> 8;
+	addr_buf[addr_len++] = addr;
+
+	const struct qspi_buf tx_buf = {
+		.buf = addr_buf,
+		.len = addr_len,
+	};
+	const struct qspi_cmd cmd = {
+		.op_code = opcode,
+		.tx_buf = &tx_buf,
+	};
+
+	qspi_lock(dev);
+	rc = qspi_send_cmd(dev, &cmd, true);
+	erase_state.busy = (rc == 0);
+	qspi_unlock(dev);
+
+	while (rc == 0) {
+		k_msleep(CONFIG_LCZ_NRF_QSPI_NOR_ERASE_POLL_PERIOD);
+
+		qspi_lock(dev);
+		/* A reader that couldn't suspend the erase may have
+		 * waited for it to finish.
+		 */
+		if (erase_state.busy) {
+			rc = qspi_rdsr(dev);
+			if (rc >= 0) {
+				erase_state.busy = ((rc & SPI_NOR_WIP_BIT) != 0U);
+				rc = 0;
+			} else {
+				erase_state.busy = false;
+			}
+		}
+		busy = erase_state.busy;
+		qspi_unlock(dev);
+
+		if (!busy) {
+			break;
+		}
+	}
+
+	return rc;
+}
+
+/* QSPI must be locked. Wait until the flash can be read. */
+static int erase_yield(const struct device *dev)
+{
+	uint32_t elapsed;
+	int rc;
+
+	if (!erase_state.busy) {
+		return 0;
+	}
+
+	rc = qspi_rdsr(dev);
+	if (rc < 0) {
+		return rc;
+	}
+
+	if ((rc & SPI_NOR_WIP_BIT) == 0U) {
+		erase_state.busy = false;
+		return 0;
+	}
+
+	if (erase_state.suspend_supported) {
+		elapsed = k_cyc_to_us_floor32(k_cycle_get_32() -
+					      erase_state.resume_cycles);
+		if (elapsed < erase_state.resume_interval_us) {
+			k_busy_wait(erase_state.resume_interval_us - elapsed);
+		}
+
+		const struct qspi_cmd cmd = {
+			.op_code = erase_state.suspend_opcode,
+		};
+
+		rc = qspi_send_cmd(dev, &cmd, false);
+		if (rc == 0) {
+			erase_state.suspended = true;
+		}
+	}
+
+	/* Suspend takes tens of microseconds, otherwise this waits for the
+	 * rest of the sector erase.
+	 */
+	if (rc == 0) {
+		rc = qspi_wait_while_writing(dev);
+	}
+
+	if (rc == 0 && !erase_state.suspended) {
+		erase_state.busy = false;
+	}
+
+	return rc;
+}
+
+/* QSPI must be locked */
+static void erase_resume(const struct device *dev)
+{
+	if (!erase_state.suspended) {
+		return;
+	}
+
+	const struct qspi_cmd cmd = {
+		.op_code = erase_state.resume_opcode,
+	};
+
+	if (qspi_send_cmd(dev, &cmd, false) != 0) {
+		LOG_ERR("erase resume failed");
+	}
+	erase_state.suspended = false;
+	erase_state.resume_cycles = k_cycle_get_32();
+}
+
+static inline bool qspi_erase_by_block(void)
+{
+	return erase_state.suspend_supported;
+}
+#else
+static inline int erase_yield(const struct device *dev)
+{
+	return 0;
+}
+
+static inline void erase_resume(const struct device *dev)
+{
+}
+
+static inline bool qspi_erase_by_block(void)
+{
+	return true;
+}
+#endif
+
+/* Lock the QSPI for a read of the flash array */
+static inline int qspi_read_lock(const struct device *dev)
+{
+	qspi_lock(dev);
+	return erase_yield(dev);
+}
+
+static inline void qspi_read_unlock(const struct device *dev)
+{
+	erase_resume(dev);
+	qspi_unlock(dev);
+}
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_TELEMETRY
+static void telemetry_record(enum lcz_nrf_qspi_nor_op op, uint32_t start,
+			     size_t bytes, int rc)
+{
+	struct lcz_nrf_qspi_nor_op_stats *stats = &telemetry.ops[op];
+	uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+	uint32_t limit = LCZ_NRF_QSPI_NOR_HISTOGRAM_FIRST_US;
+	int bin = 0;
+	key_t key;
+
+	while ((bin < (LCZ_NRF_QSPI_NOR_HISTOGRAM_BINS - 1)) && (us >= limit)) {
+		bin += 1;
+		limit <<= 2;
+	}
+
+	key = irq_lock();
+	stats->count += 1;
+	if (rc == 0) {
+		stats->bytes += bytes;
+	} else {
+		stats->errors += 1;
+	}
+	stats->max_us = MAX(stats->max_us, us);
+	stats->histogram[bin] += 1;
+	irq_unlock(key);
+}
+
+static void telemetry_erased(uint32_t addr, uint32_t size)
+{
+	uint32_t last = MIN((addr + size - 1) / WEAR_UNIT, WEAR_UNITS - 1);
+	uint32_t i;
+	key_t key;
+
+	key = irq_lock();
+	for (i = addr / WEAR_UNIT; i <= last; i++) {
+		telemetry.wear[i] += 1;
+	}
+	irq_unlock(key);
+}
+
+static int qspi_nor_read(const struct device *dev, off_t addr, void *dest,
+			 size_t size);
+static int qspi_nor_write(const struct device *dev, off_t addr,
+			  const void *src, size_t size);
+
+static int qspi_nor_read_telemetry(const struct device *dev, off_t addr,
+				   void *dest, size_t size)
+{
+	uint32_t start = k_cycle_get_32();
+	int rc = qspi_nor_read(dev, addr, dest, size);
+
+	telemetry_record(LCZ_NRF_QSPI_NOR_OP_READ, start, size, rc);
+	return rc;
+}
+
+static int qspi_nor_write_telemetry(const struct device *dev, off_t addr,
+				    const void *src, size_t size)
+{
+	uint32_t start = k_cycle_get_32();
+	int rc = qspi_nor_write(dev, addr, src, size);
+
+	telemetry_record(LCZ_NRF_QSPI_NOR_OP_WRITE, start, size, rc);
+	return rc;
+}
+#endif
+
+/* Erase a sector, a block or the whole chip */
+static int qspi_erase_unit_op(const struct device *dev,
+			      nrf_qspi_erase_len_t len, uint32_t addr)
+{
+	nrfx_err_t res;
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_PREEMPTIBLE_ERASE
+	if (len == NRF_QSPI_ERASE_LEN_64KB) {
+		return erase_preemptible(dev, SPI_NOR_CMD_BE, addr);
+	} else if (len == NRF_QSPI_ERASE_LEN_4KB) {
+		return erase_preemptible(dev, SPI_NOR_CMD_SE, addr);
+	}
+#endif
+
+	qspi_lock(dev);
+	if (len == NRF_QSPI_ERASE_LEN_ALL) {
+		res = nrfx_qspi_chip_erase();
+	} else {
+		res = nrfx_qspi_erase(len, addr);
+	}
+	qspi_wait_for_completion(dev, res);
+	qspi_unlock(dev);
+
+	return qspi_get_zephyr_ret_code(res);
+}
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_TELEMETRY
+static int qspi_erase_unit(const struct device *dev, nrf_qspi_erase_len_t len,
+			   uint32_t addr)
+{
+	const struct qspi_nor_config *params = dev->config;
+	uint32_t start = k_cycle_get_32();
+	enum lcz_nrf_qspi_nor_op op;
+	uint32_t size;
+	int rc;
+
+	if (len == NRF_QSPI_ERASE_LEN_ALL) {
+		op = LCZ_NRF_QSPI_NOR_OP_ERASE_CHIP;
+		addr = 0;
+		size = params->size;
+	} else if (len == NRF_QSPI_ERASE_LEN_64KB) {
+		op = LCZ_NRF_QSPI_NOR_OP_ERASE_BLOCK;
+		size = QSPI_BLOCK_SIZE;
+	} else {
+		op = LCZ_NRF_QSPI_NOR_OP_ERASE_SECTOR;
+		size = QSPI_SECTOR_SIZE;
+	}
+
+	rc = qspi_erase_unit_op(dev, len, addr);
+
+	telemetry_record(op, start, size, rc);
+	/* A failed erase may still have worn the flash */
+	telemetry_erased(addr, size);
+
+	return rc;
+}
+#else
+static inline int qspi_erase_unit(const struct device *dev,
+				  nrf_qspi_erase_len_t len, uint32_t addr)
+{
+	return qspi_erase_unit_op(dev, len, addr);
+}
+#endif
+
 /* QSPI erase */
 static int qspi_erase(const struct device *dev, uint32_t addr, uint32_t size)
 {
@@ -641,6 +1183,8 @@ static int qspi_erase(const struct device *dev, uint32_t addr, uint32_t size)
 
 	int rv = 0;
 	const struct qspi_nor_config *params = dev->config;
+	uint32_t erase_addr = addr;
+	uint32_t erase_size = size;
 
 	rv = ANOMALY_122_INIT(dev);
 	if (rv != 0) {
@@ -648,41 +1192,43 @@ static int qspi_erase(const struct device *dev, uint32_t addr, uint32_t size)
 	}
 	qspi_trans_lock(dev);
 	rv = qspi_nor_write_protection_set(dev, false);
-	qspi_lock(dev);
+	/* The QSPI is locked for each erase so that reads can be done
+	 * between them.
+	 */
 	while ((rv == 0) && (size > 0)) {
-		nrfx_err_t res = !NRFX_SUCCESS;
 		uint32_t adj = 0;
 
 		if (size == params->size) {
 			/* chip erase */
-			res = nrfx_qspi_chip_erase();
+			rv = qspi_erase_unit(dev, NRF_QSPI_ERASE_LEN_ALL, addr);
 			adj = size;
 		} else if ((size >= QSPI_BLOCK_SIZE) &&
-			   QSPI_IS_BLOCK_ALIGNED(addr)) {
+			   QSPI_IS_BLOCK_ALIGNED(addr) && qspi_erase_by_block()) {
 			/* 64 kB block erase */
-			res = nrfx_qspi_erase(NRF_QSPI_ERASE_LEN_64KB, addr);
+			rv = qspi_erase_unit(dev, NRF_QSPI_ERASE_LEN_64KB, addr);
 			adj = QSPI_BLOCK_SIZE;
 		} else if ((size >= QSPI_SECTOR_SIZE) &&
 			   QSPI_IS_SECTOR_ALIGNED(addr)) {
 			/* 4kB sector erase */
-			res = nrfx_qspi_erase(NRF_QSPI_ERASE_LEN_4KB, addr);
+			rv = qspi_erase_unit(dev, NRF_QSPI_ERASE_LEN_4KB, addr);
 			adj = QSPI_SECTOR_SIZE;
 		} else {
 			/* minimal erase size is at least a sector size */
 			LOG_ERR("unsupported at 0x%lx size %zu", (long)addr, size);
 			rv = -EINVAL;
+			break;
 		}
 
-		qspi_wait_for_completion(dev, res);
-		if (res == NRFX_SUCCESS) {
+		if (rv == 0) {
 			addr += adj;
 			size -= adj;
 		} else {
 			LOG_ERR("erase error at 0x%lx size %zu", (long)addr, size);
-			rv = qspi_get_zephyr_ret_code(res);
 		}
 	}
-	qspi_unlock(dev);
+
+	/* Part of the region may have been erased even if there was an error */
+	read_cache_invalidate(erase_addr, erase_size);
 
 	int rv2 = qspi_nor_write_protection_set(dev, true);
 
@@ -944,8 +1490,13 @@ static int qspi_read_jedec_id(const struct device *dev,
 
 	int ret = ANOMALY_122_INIT(dev);
 
+	/* The flash ignores the instruction while it is erasing */
 	if (ret == 0) {
-		ret = qspi_send_cmd(dev, &cmd, false);
+		ret = qspi_read_lock(dev);
+		if (ret == 0) {
+			ret = qspi_send_cmd(dev, &cmd, false);
+		}
+		qspi_read_unlock(dev);
 	}
 	ANOMALY_122_UNINIT(dev);
 
@@ -979,7 +1530,10 @@ static int qspi_sfdp_read(const struct device *dev, off_t offset,
 		goto out;
 	}
 
-	qspi_lock(dev);
+	if (qspi_read_lock(dev) != 0) {
+		res = NRFX_ERROR_TIMEOUT;
+		goto out;
+	}
 	res = nrfx_qspi_lfm_start(&cinstr_cfg);
 	if (res != NRFX_SUCCESS) {
 		LOG_DBG("lfm_start: %x", res);
@@ -999,13 +1553,78 @@ static int qspi_sfdp_read(const struct device *dev, off_t offset,
 	}
 
 out:
-	qspi_unlock(dev);
+	qspi_read_unlock(dev);
 	ANOMALY_122_UNINIT(dev);
 	return qspi_get_zephyr_ret_code(res);
 }
 
 #endif /* CONFIG_FLASH_JESD216_API */
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_PREEMPTIBLE_ERASE
+/* Read the erase suspend/resume instructions from the basic flash
+ * parameter table. Erase is done a sector at a time if they aren't found.
+ */
+static void erase_suspend_probe(const struct device *dev)
+{
+	const uint8_t decl_nph = 2;
+	union {
+		uint8_t raw[JESD216_SFDP_SIZE(decl_nph)];
+		struct jesd216_sfdp_header sfdp;
+	} u;
+	const struct jesd216_sfdp_header *hp = &u.sfdp;
+	const struct jesd216_param_header *php;
+	const struct jesd216_param_header *phpe;
+	uint32_t dw[2];
+	uint32_t interval;
+	int rc;
+
+	rc = qspi_sfdp_read(dev, 0, u.raw, sizeof(u.raw));
+	if (rc != 0 || jesd216_sfdp_magic(hp) != JESD216_SFDP_MAGIC) {
+		LOG_WRN("SFDP not available, erase suspend disabled");
+		return;
+	}
+
+	php = hp->phdr;
+	phpe = php + MIN(decl_nph, 1 + hp->nph);
+	for (; php < phpe; php++) {
+		if (jesd216_param_id(php) != JESD216_SFDP_PARAM_ID_BFP) {
+			continue;
+		}
+		if (php->len_dw < (SFDP_BFP_SUSPEND_DW + 1)) {
+			break;
+		}
+
+		rc = qspi_sfdp_read(dev,
+				    jesd216_param_addr(php) +
+					    ((SFDP_BFP_SUSPEND_DW - 1) * sizeof(uint32_t)),
+				    dw, sizeof(dw));
+		if (rc != 0) {
+			break;
+		}
+
+		dw[0] = sys_le32_to_cpu(dw[0]);
+		dw[1] = sys_le32_to_cpu(dw[1]);
+		if ((dw[0] & SFDP_BFP_DW12_SUSPEND_NOT_SUPPORTED) != 0) {
+			break;
+		}
+
+		interval = (dw[0] >> SFDP_BFP_DW12_RESUME_TO_SUSPEND_POS) &
+			   SFDP_BFP_DW12_RESUME_TO_SUSPEND_MASK;
+		erase_state.resume_interval_us =
+			(interval + 1) * SFDP_BFP_DW12_RESUME_TO_SUSPEND_UNIT_US;
+		erase_state.suspend_opcode =
+			(uint8_t)(dw[1] >> SFDP_BFP_DW13_ERASE_SUSPEND_POS);
+		erase_state.resume_opcode =
+			(uint8_t)(dw[1] >> SFDP_BFP_DW13_ERASE_RESUME_POS);
+		erase_state.suspend_supported = true;
+		break;
+	}
+
+	LOG_INF("Erase suspend %s", erase_state.suspend_supported ?
+					    "supported" : "not supported");
+}
+#endif
+
 /**
  * @brief Retrieve the Flash JEDEC ID and compare it with the one expected
  *
@@ -1105,6 +1724,171 @@ static inline nrfx_err_t read_non_aligned(const struct device *dev,
 	return res;
 }
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_READ_CACHE
+static struct qspi_read_cache_line *read_cache_find(uint32_t line_addr)
+{
+	size_t i;
+
+	for (i = 0; i < READ_CACHE_LINES; i++) {
+		if (read_cache.lines[i].valid &&
+		    read_cache.lines[i].addr == line_addr) {
+			return &read_cache.lines[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Invalid line if there is one, otherwise the least recently used line */
+static struct qspi_read_cache_line *read_cache_victim(void)
+{
+	struct qspi_read_cache_line *victim = &read_cache.lines[0];
+	size_t i;
+
+	for (i = 0; i < READ_CACHE_LINES; i++) {
+		if (!read_cache.lines[i].valid) {
+			return &read_cache.lines[i];
+		}
+		if ((read_cache.use_count - read_cache.lines[i].last_use) >
+		    (read_cache.use_count - victim->last_use)) {
+			victim = &read_cache.lines[i];
+		}
+	}
+
+	return victim;
+}
+
+/* QSPI must be locked */
+static nrfx_err_t read_cache_fill(const struct device *dev,
+				  struct qspi_read_cache_line *line,
+				  uint32_t line_addr)
+{
+	nrfx_err_t res;
+
+	line->valid = false;
+	res = nrfx_qspi_read(line->data, READ_CACHE_LINE_SIZE, line_addr);
+	qspi_wait_for_completion(dev, res);
+	if (res == NRFX_SUCCESS) {
+		line->addr = line_addr;
+		line->last_use = ++read_cache.use_count;
+		line->valid = true;
+	}
+
+	return res;
+}
+
+/* Read through the cache; the region has already been checked */
+static int read_cache_read(const struct device *dev, off_t addr,
+			   uint8_t *dest, size_t size)
+{
+	const struct qspi_nor_config *params = dev->config;
+	struct qspi_read_cache_line *line;
+	nrfx_err_t res = NRFX_SUCCESS;
+	bool locked = false;
+	bool sequential;
+	uint32_t line_addr;
+	uint32_t ahead;
+	size_t offset;
+	size_t len;
+	int rc = 0;
+	int i;
+
+	k_mutex_lock(&read_cache.lock, K_FOREVER);
+
+	sequential = (addr == read_cache.next_addr);
+
+	while ((size > 0) && (res == NRFX_SUCCESS)) {
+		line_addr = ROUND_DOWN(addr, READ_CACHE_LINE_SIZE);
+		line = read_cache_find(line_addr);
+		if (line != NULL) {
+			read_cache.hits += 1;
+			line->last_use = ++read_cache.use_count;
+		} else {
+			read_cache.misses += 1;
+			if (!locked) {
+				rc = ANOMALY_122_INIT(dev);
+				if (rc != 0) {
+					break;
+				}
+				rc = qspi_read_lock(dev);
+				locked = true;
+				if (rc != 0) {
+					break;
+				}
+			}
+
+			line = read_cache_victim();
+			res = read_cache_fill(dev, line, line_addr);
+			if (res != NRFX_SUCCESS) {
+				break;
+			}
+
+			/* The line just read is the most recently used so it isn't
+			 * replaced by the lines read ahead.
+			 */
+			for (i = 1; sequential && i <= READ_AHEAD_LINES; i++) {
+				ahead = line_addr + (i * READ_CACHE_LINE_SIZE);
+				if ((ahead + READ_CACHE_LINE_SIZE) > params->size) {
+					break;
+				}
+				if (read_cache_find(ahead) == NULL) {
+					res = read_cache_fill(dev, read_cache_victim(),
+							      ahead);
+					if (res != NRFX_SUCCESS) {
+						break;
+					}
+				}
+			}
+			/* Line may have been replaced if read ahead failed */
+			if (res != NRFX_SUCCESS) {
+				break;
+			}
+		}
+
+		offset = addr - line_addr;
+		len = MIN(size, READ_CACHE_LINE_SIZE - offset);
+		memcpy(dest, &line->data[offset], len);
+		addr += len;
+		dest += len;
+		size -= len;
+	}
+
+	read_cache.next_addr = addr;
+
+	if (locked) {
+		qspi_read_unlock(dev);
+	}
+
+	k_mutex_unlock(&read_cache.lock);
+
+	if (locked || rc != 0) {
+		ANOMALY_122_UNINIT(dev);
+	}
+
+	return (rc != 0) ? rc : qspi_get_zephyr_ret_code(res);
+}
+
+/* Called after flash has been changed */
+static void read_cache_invalidate(uint32_t addr, size_t size)
+{
+	size_t i;
+
+	k_mutex_lock(&read_cache.lock, K_FOREVER);
+	for (i = 0; i < READ_CACHE_LINES; i++) {
+		if (read_cache.lines[i].valid &&
+		    read_cache.lines[i].addr < (addr + size) &&
+		    (read_cache.lines[i].addr + READ_CACHE_LINE_SIZE) > addr) {
+			read_cache.lines[i].valid = false;
+		}
+	}
+	k_mutex_unlock(&read_cache.lock);
+}
+#else
+static inline void read_cache_invalidate(uint32_t addr, size_t size)
+{
+}
+#endif
+
 static int qspi_nor_read(const struct device *dev, off_t addr, void *dest,
 			 size_t size)
 {
@@ -1128,19 +1912,27 @@ static int qspi_nor_read(const struct device *dev, off_t addr, void *dest,
 		return -EINVAL;
 	}
 
+	erase_ahead_touch();
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_READ_CACHE
+	/* Large reads are DMA'd directly into the destination */
+	if (size < (2 * READ_CACHE_LINE_SIZE)) {
+		return read_cache_read(dev, addr, dest, size);
+	}
+#endif
+
 	int rc = ANOMALY_122_INIT(dev);
 
 	if (rc != 0) {
 		goto out;
 	}
 
-	qspi_lock(dev);
-
-	nrfx_err_t res = read_non_aligned(dev, addr, dest, size);
-
-	qspi_unlock(dev);
+	rc = qspi_read_lock(dev);
+	if (rc == 0) {
+		rc = qspi_get_zephyr_ret_code(read_non_aligned(dev, addr, dest, size));
+	}
 
-	rc = qspi_get_zephyr_ret_code(res);
+	qspi_read_unlock(dev);
 
 out:
 	ANOMALY_122_UNINIT(dev);
@@ -1207,6 +1999,142 @@ static inline nrfx_err_t write_from_nvmc(const struct device *dev, off_t addr,
 	return res;
 }
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD
+static inline void erase_ahead_touch(void)
+{
+	erase_ahead.last_access = k_uptime_get_32();
+}
+
+static bool erase_ahead_region_valid(const struct device *dev, off_t addr,
+				     size_t size)
+{
+	const struct qspi_nor_config *params = dev->config;
+
+	return (addr >= 0) && (size > 0) && ((addr + size) <= params->size) &&
+	       QSPI_IS_SECTOR_ALIGNED(addr) && QSPI_IS_SECTOR_ALIGNED(size);
+}
+
+static int erase_ahead_erase_sectors(void *context, uint32_t first,
+				     uint32_t count)
+{
+	return qspi_erase(context, first * QSPI_SECTOR_SIZE,
+			  count * QSPI_SECTOR_SIZE);
+}
+
+/* Erase one free sector each time the flash has been idle long enough */
+static void erase_ahead_handler(struct k_work *item)
+{
+	int32_t idle = k_uptime_get_32() - erase_ahead.last_access;
+	int sector;
+	int rc;
+
+	if (idle < CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD_IDLE_PERIOD) {
+		k_work_schedule(&erase_ahead.work,
+				K_MSEC(CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD_IDLE_PERIOD -
+				       idle));
+		return;
+	}
+
+	k_mutex_lock(&erase_ahead.lock, K_FOREVER);
+	sector = lcz_erase_ahead_take_free(&erase_ahead_map);
+	if (sector >= 0) {
+		rc = lcz_erase_ahead_erase(&erase_ahead_map, sector, 1,
+					   erase_ahead_erase_sectors,
+					   (void *)erase_ahead.dev);
+		if (rc != 0) {
+			LOG_ERR("erase ahead of sector %d failed: %d", sector, rc);
+		}
+	}
+	k_mutex_unlock(&erase_ahead.lock);
+
+	if (sector >= 0) {
+		k_work_schedule(&erase_ahead.work, K_NO_WAIT);
+	}
+}
+
+/* Only erase sectors that aren't known to be erased */
+static int erase_ahead_erase(const struct device *dev, off_t addr, size_t size)
+{
+	int rc;
+
+	if (!erase_ahead_region_valid(dev, addr, size)) {
+		return qspi_erase(dev, addr, size);
+	}
+
+	k_mutex_lock(&erase_ahead.lock, K_FOREVER);
+	rc = lcz_erase_ahead_erase(&erase_ahead_map, addr / QSPI_SECTOR_SIZE,
+				   size / QSPI_SECTOR_SIZE,
+				   erase_ahead_erase_sectors, (void *)dev);
+	k_mutex_unlock(&erase_ahead.lock);
+
+	return rc;
+}
+
+/* Remove sectors from the pool; the lock is held until the write is done */
+static void erase_ahead_write_begin(off_t addr, size_t size)
+{
+	uint32_t first = addr / QSPI_SECTOR_SIZE;
+
+	k_mutex_lock(&erase_ahead.lock, K_FOREVER);
+	lcz_erase_ahead_mark_written(&erase_ahead_map, first,
+				     ((addr + size - 1) / QSPI_SECTOR_SIZE) -
+					     first + 1);
+}
+
+static inline void erase_ahead_write_end(void)
+{
+	k_mutex_unlock(&erase_ahead.lock);
+}
+#else
+static inline void erase_ahead_touch(void)
+{
+}
+
+static inline void erase_ahead_write_begin(off_t addr, size_t size)
+{
+}
+
+static inline void erase_ahead_write_end(void)
+{
+}
+#endif
+
+static int qspi_nor_write_direct(const struct device *dev, off_t addr,
+				 const void *src, size_t size);
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_WRITE_BUFFER
+/* The QSPI can only DMA from word aligned RAM. Other sources are copied a
+ * page at a time so that each page is one program instead of one for each
+ * stack buffer. The data is programmed before returning so that a file
+ * system sync is durable.
+ */
+static int write_buffer_write(const struct device *dev, off_t addr,
+			      const void *src, size_t size)
+{
+	const uint8_t *sp = src;
+	size_t len;
+	int rc = 0;
+
+	if ((size < WORD_SIZE) ||
+	    (nrfx_is_in_ram(src) && nrfx_is_word_aligned(src))) {
+		return qspi_nor_write_direct(dev, addr, src, size);
+	}
+
+	k_mutex_lock(&write_buffer.lock, K_FOREVER);
+	while ((size > 0) && (rc == 0)) {
+		len = MIN(size, WRITE_BUFFER_SIZE - (addr % WRITE_BUFFER_SIZE));
+		memcpy(write_buffer.data, sp, len);
+		rc = qspi_nor_write_direct(dev, addr, write_buffer.data, len);
+		size -= len;
+		sp += len;
+		addr += len;
+	}
+	k_mutex_unlock(&write_buffer.lock);
+
+	return rc;
+}
+#endif
+
 static int qspi_nor_write(const struct device *dev, off_t addr,
 			  const void *src,
 			  size_t size)
@@ -1236,8 +2164,23 @@ static int qspi_nor_write(const struct device *dev, off_t addr,
 		return -EINVAL;
 	}
 
+	erase_ahead_touch();
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_WRITE_BUFFER
+	return write_buffer_write(dev, addr, src, size);
+#else
+	return qspi_nor_write_direct(dev, addr, src, size);
+#endif
+}
+
+/* Program flash; the parameters have already been checked */
+static int qspi_nor_write_direct(const struct device *dev, off_t addr,
+				 const void *src, size_t size)
+{
 	nrfx_err_t res = NRFX_SUCCESS;
 
+	erase_ahead_write_begin(addr, size);
+
 	int rc = ANOMALY_122_INIT(dev);
 
 	if (rc != 0) {
@@ -1259,6 +2202,8 @@ static int qspi_nor_write(const struct device *dev, off_t addr,
 	}
 	qspi_unlock(dev);
 
+	read_cache_invalidate(addr, size);
+
 	int res2 = qspi_nor_write_protection_set(dev, true);
 
 	qspi_trans_unlock(dev);
@@ -1269,6 +2214,7 @@ static int qspi_nor_write(const struct device *dev, off_t addr,
 	rc = qspi_get_zephyr_ret_code(res);
 out:
 	ANOMALY_122_UNINIT(dev);
+	erase_ahead_write_end();
 	return rc;
 }
 
@@ -1285,7 +2231,12 @@ static int qspi_nor_erase(const struct device *dev, off_t addr, size_t size)
 		return -EINVAL;
 	}
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD
+	erase_ahead_touch();
+	int ret = erase_ahead_erase(dev, addr, size);
+#else
 	int ret = qspi_erase(dev, addr, size);
+#endif
 
 	return ret;
 }
@@ -1329,6 +2280,10 @@ static int qspi_nor_configure(const struct device *dev)
 		return -ENODEV;
 	}
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_PREEMPTIBLE_ERASE
+	erase_suspend_probe(dev);
+#endif
+
 	return 0;
 }
 
@@ -1339,11 +2294,22 @@ static void qspi_nor_workq_handler(struct k_work *item)
 
 	key_t qspi_lock_key;
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_PREEMPTIBLE_ERASE
+	/* Wait for the erase to finish */
+	if (erase_state.busy) {
+		k_work_schedule(&nrf_qspi_nor_cool_down->work,
+				K_MSEC(nrf_qspi_nor_cool_down->period));
+		return;
+	}
+#endif
+
 	/* Hold off any interrupts or context switches during this check */
 	qspi_lock_key = irq_lock();
 
 	/* Now clear the initialised flag */
 	nrf_qspi_nor_cool_down->isInitialised = false;
+	nrf_qspi_nor_cool_down->dpm_entries += 1;
+	nrf_qspi_nor_cool_down->dpm_start = k_uptime_get_32();
 
 	/* Enter DPM mode */
 	QSPIconfig.phy_if.dpmen = true;
@@ -1384,6 +2350,8 @@ static int qspi_nor_init(const struct device *dev)
 
 	/* The interface is initialised at start-up */
 	driver_data->nrf_qspi_nor_cool_down.isInitialised = true;
+	driver_data->nrf_qspi_nor_cool_down.period =
+		CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD;
 
 	/* Build the delayed work structure used to shut the QSPI off */
 	k_work_init_delayable(&driver_data->nrf_qspi_nor_cool_down.work,
@@ -1393,6 +2361,11 @@ static int qspi_nor_init(const struct device *dev)
 	(void)k_work_schedule(&driver_data->nrf_qspi_nor_cool_down.work,
 			      K_MSEC(CONFIG_LCZ_NRF_QSPI_NOR_COOL_DOWN_PERIOD));
 
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD
+	erase_ahead.dev = dev;
+	k_work_init_delayable(&erase_ahead.work, erase_ahead_handler);
+#endif
+
 	return qspi_nor_configure(dev);
 }
 
@@ -1431,8 +2404,13 @@ qspi_flash_get_parameters(const struct device *dev)
 }
 
 static const struct flash_driver_api qspi_nor_api = {
+#if defined(CONFIG_LCZ_NRF_QSPI_NOR_TELEMETRY)
+	.read = qspi_nor_read_telemetry,
+	.write = qspi_nor_write_telemetry,
+#else
 	.read = qspi_nor_read,
 	.write = qspi_nor_write,
+#endif
 	.erase = qspi_nor_erase,
 	.get_parameters = qspi_flash_get_parameters,
 #if defined(CONFIG_FLASH_PAGE_LAYOUT)
@@ -1454,3 +2432,143 @@ DEVICE_DT_INST_DEFINE(0, &qspi_nor_init, NULL,
 		&qspi_nor_memory_data, &flash_id,
 		POST_KERNEL, CONFIG_NORDIC_QSPI_NOR_INIT_PRIORITY,
 		&qspi_nor_api);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int lcz_nrf_qspi_nor_get_dpm_stats(const struct device *dev,
+				   struct lcz_nrf_qspi_nor_dpm_stats *stats)
+{
+	struct qspi_nor_data *dev_data;
+	struct nrf_qspi_nor_cool_down_t *cd;
+	key_t key;
+
+	if (dev == NULL || stats == NULL) {
+		return -EINVAL;
+	}
+
+	dev_data = get_dev_data(dev);
+	cd = &dev_data->nrf_qspi_nor_cool_down;
+
+	key = irq_lock();
+	stats->entries = cd->dpm_entries;
+	stats->wakes = cd->wakes;
+	stats->time = cd->dpm_time;
+	if (!cd->isInitialised) {
+		stats->time += k_uptime_get_32() - cd->dpm_start;
+	}
+	stats->predicted_gap = cd->predicted_gap;
+	stats->cool_down_period = cd->period;
+	irq_unlock(key);
+
+	return 0;
+}
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD
+int lcz_nrf_qspi_nor_mark_free(const struct device *dev, off_t addr,
+			       size_t size)
+{
+	if (dev != erase_ahead.dev) {
+		return -ENODEV;
+	}
+
+	if (!erase_ahead_region_valid(dev, addr, size)) {
+		return -EINVAL;
+	}
+
+	/* A sector that is being written can't also be queued for erase */
+	k_mutex_lock(&erase_ahead.lock, K_FOREVER);
+	lcz_erase_ahead_mark_free(&erase_ahead_map, addr / QSPI_SECTOR_SIZE,
+				  size / QSPI_SECTOR_SIZE);
+	k_mutex_unlock(&erase_ahead.lock);
+
+	k_work_schedule(&erase_ahead.work,
+			K_MSEC(CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD_IDLE_PERIOD));
+
+	return 0;
+}
+#else
+int lcz_nrf_qspi_nor_mark_free(const struct device *dev, off_t addr,
+			       size_t size)
+{
+	return -ENOTSUP;
+}
+#endif
+
+#ifdef CONFIG_LCZ_NRF_QSPI_NOR_TELEMETRY
+int lcz_nrf_qspi_nor_get_op_stats(const struct device *dev,
+				  enum lcz_nrf_qspi_nor_op op,
+				  struct lcz_nrf_qspi_nor_op_stats *stats)
+{
+	key_t key;
+
+	if (op >= LCZ_NRF_QSPI_NOR_OP_COUNT || stats == NULL) {
+		return -EINVAL;
+	}
+
+	key = irq_lock();
+	memcpy(stats, &telemetry.ops[op], sizeof(*stats));
+	irq_unlock(key);
+
+	return 0;
+}
+
+void lcz_nrf_qspi_nor_reset_op_stats(const struct device *dev)
+{
+	key_t key;
+
+	key = irq_lock();
+	memset(telemetry.ops, 0, sizeof(telemetry.ops));
+	irq_unlock(key);
+}
+
+uint32_t lcz_nrf_qspi_nor_get_wear_units(const struct device *dev,
+					 uint32_t *unit_size)
+{
+	if (unit_size != NULL) {
+		*unit_size = WEAR_UNIT;
+	}
+
+	return WEAR_UNITS;
+}
+
+int lcz_nrf_qspi_nor_get_wear(const struct device *dev, uint32_t first,
+			      uint32_t *counts, size_t count)
+{
+	key_t key;
+
+	if (counts == NULL || first >= WEAR_UNITS) {
+		return -EINVAL;
+	}
+
+	count = MIN(count, WEAR_UNITS - first);
+	key = irq_lock();
+	memcpy(counts, &telemetry.wear[first], count * sizeof(uint32_t));
+	irq_unlock(key);
+
+	return count;
+}
+#else
+int lcz_nrf_qspi_nor_get_op_stats(const struct device *dev,
+				  enum lcz_nrf_qspi_nor_op op,
+				  struct lcz_nrf_qspi_nor_op_stats *stats)
+{
+	return -ENOTSUP;
+}
+
+void lcz_nrf_qspi_nor_reset_op_stats(const struct device *dev)
+{
+}
+
+uint32_t lcz_nrf_qspi_nor_get_wear_units(const struct device *dev,
+					 uint32_t *unit_size)
+{
+	return 0;
+}
+
+int lcz_nrf_qspi_nor_get_wear(const struct device *dev, uint32_t first,
+			      uint32_t *counts, size_t count)
+{
+	return -ENOTSUP;
+}
+#endif
@@ -0,0 +1,104 @@
+/**
+ * @file lcz_nrf_qspi_nor_erase_ahead.c
+ * @brief Free and erased sector bookkeeping for the QSPI NOR erase-ahead
+ * pool
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+#include <sys/util.h>
+
+#include "lcz_nrf_qspi_nor_erase_ahead.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void lcz_erase_ahead_mark_free(struct lcz_erase_ahead_map *map, uint32_t first,
+			       uint32_t count)
+{
+	uint32_t i;
+
+	for (i = first; i < MIN(first + count, map->sectors); i++) {
+		if (!atomic_test_bit(map->erased, i)) {
+			atomic_set_bit(map->free, i);
+		}
+	}
+}
+
+int lcz_erase_ahead_take_free(struct lcz_erase_ahead_map *map)
+{
+	atomic_val_t bits;
+	uint32_t sector;
+	size_t i;
+
+	for (i = 0; i < ATOMIC_BITMAP_SIZE(map->sectors); i++) {
+		bits = atomic_get(&map->free[i]);
+		if (bits != 0) {
+			sector = (i * ATOMIC_BITS) + find_lsb_set(bits) - 1;
+			if (sector >= map->sectors) {
+				break;
+			}
+			atomic_clear_bit(map->free, sector);
+			return sector;
+		}
+	}
+
+	return -ENOENT;
+}
+
+void lcz_erase_ahead_mark_erased(struct lcz_erase_ahead_map *map,
+				 uint32_t first, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = first; i < MIN(first + count, map->sectors); i++) {
+		atomic_clear_bit(map->free, i);
+		atomic_set_bit(map->erased, i);
+	}
+}
+
+void lcz_erase_ahead_mark_written(struct lcz_erase_ahead_map *map,
+				  uint32_t first, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = first; i < MIN(first + count, map->sectors); i++) {
+		atomic_clear_bit(map->free, i);
+		atomic_clear_bit(map->erased, i);
+	}
+}
+
+int lcz_erase_ahead_erase(struct lcz_erase_ahead_map *map, uint32_t first,
+			  uint32_t count, lcz_erase_ahead_erase_t erase,
+			  void *context)
+{
+	uint32_t run = 0;
+	uint32_t i;
+	int rc = 0;
+
+	if ((first + count) > map->sectors) {
+		return -EINVAL;
+	}
+
+	for (i = 0; (i <= count) && (rc == 0); i++) {
+		if ((i < count) && !atomic_test_bit(map->erased, first + i)) {
+			run += 1;
+		} else if (run > 0) {
+			rc = erase(context, first + i - run, run);
+			run = 0;
+		}
+	}
+
+	if (rc == 0) {
+		lcz_erase_ahead_mark_erased(map, first, count);
+	}
+
+	return rc;
+}
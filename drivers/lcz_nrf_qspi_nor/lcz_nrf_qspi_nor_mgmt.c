@@ -0,0 +1,222 @@
+/**
+ * @file lcz_nrf_qspi_nor_mgmt.c
+ * @brief SMP read of QSPI NOR flash telemetry
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <init.h>
+#include <device.h>
+#include <string.h>
+#include <zcbor_common.h>
+#include <zcbor_decode.h>
+#include <zcbor_encode.h>
+#include <zcbor_bulk/zcbor_bulk_priv.h>
+#include <mgmt/mgmt.h>
+
+#include "lcz_nrf_qspi_nor.h"
+#include "lcz_nrf_qspi_nor_mgmt.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define QSPI_NOR_NODE DT_INST(0, nordic_qspi_nor)
+
+/* count, errors, bytes, max_us, histogram */
+#define OP_STATS_ITEMS (4 + LCZ_NRF_QSPI_NOR_HISTOGRAM_BINS)
+/* entries, wakes, time, predicted gap, cool down period */
+#define DPM_STATS_ITEMS 5
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int get_stats(struct mgmt_ctxt *ctxt);
+static int get_wear(struct mgmt_ctxt *ctxt);
+static int reset_stats(struct mgmt_ctxt *ctxt);
+
+static int qspi_nor_mgmt_init(const struct device *device);
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const struct mgmt_handler QSPI_NOR_MGMT_HANDLERS[] = {
+	[QSPI_NOR_MGMT_ID_GET_STATS] = {
+		.mh_write = NULL,
+		.mh_read = get_stats
+	},
+	[QSPI_NOR_MGMT_ID_GET_WEAR] = {
+		.mh_write = NULL,
+		.mh_read = get_wear
+	},
+	[QSPI_NOR_MGMT_ID_RESET_STATS] = {
+		.mh_write = reset_stats,
+		.mh_read = NULL
+	}
+};
+
+static struct mgmt_group qspi_nor_mgmt_group = {
+	.mg_handlers = QSPI_NOR_MGMT_HANDLERS,
+	.mg_handlers_count = QSPI_NOR_MGMT_HANDLER_CNT,
+	.mg_group_id = CONFIG_MGMT_GROUP_ID_QSPI_NOR,
+};
+
+/* Keys match the order of enum lcz_nrf_qspi_nor_op */
+static const char *const op_keys[LCZ_NRF_QSPI_NOR_OP_COUNT] = {
+	"rd", "wr", "se", "be", "ce"
+};
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+SYS_INIT(qspi_nor_mgmt_init, APPLICATION, 99);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int qspi_nor_mgmt_init(const struct device *device)
+{
+	ARG_UNUSED(device);
+
+	mgmt_register_group(&qspi_nor_mgmt_group);
+
+	return 0;
+}
+
+static bool encode_op_stats(zcbor_state_t *zse, const char *key,
+			    const struct lcz_nrf_qspi_nor_op_stats *stats)
+{
+	bool ok;
+	int i;
+
+	ok = zcbor_tstr_put_term(zse, key)				&&
+	     zcbor_list_start_encode(zse, OP_STATS_ITEMS)		&&
+	     zcbor_uint32_put(zse, stats->count)			&&
+	     zcbor_uint32_put(zse, stats->errors)			&&
+	     zcbor_uint64_put(zse, stats->bytes)			&&
+	     zcbor_uint32_put(zse, stats->max_us);
+
+	for (i = 0; ok && i < LCZ_NRF_QSPI_NOR_HISTOGRAM_BINS; i++) {
+		ok = zcbor_uint32_put(zse, stats->histogram[i]);
+	}
+
+	return ok && zcbor_list_end_encode(zse, OP_STATS_ITEMS);
+}
+
+static int get_stats(struct mgmt_ctxt *ctxt)
+{
+	const struct device *dev = DEVICE_DT_GET(QSPI_NOR_NODE);
+	struct lcz_nrf_qspi_nor_op_stats stats;
+	struct lcz_nrf_qspi_nor_dpm_stats dpm;
+	zcbor_state_t *zse = ctxt->cnbe->zs;
+	int r = 0;
+	bool ok = true;
+	int op;
+
+	for (op = 0; ok && r == 0 && op < LCZ_NRF_QSPI_NOR_OP_COUNT; op++) {
+		r = lcz_nrf_qspi_nor_get_op_stats(dev, op, &stats);
+		if (r == 0) {
+			ok = encode_op_stats(zse, op_keys[op], &stats);
+		}
+	}
+
+	if (ok && r == 0) {
+		r = lcz_nrf_qspi_nor_get_dpm_stats(dev, &dpm);
+		if (r == 0) {
+			ok = zcbor_tstr_put_lit(zse, "dpm")			&&
+			     zcbor_list_start_encode(zse, DPM_STATS_ITEMS)	&&
+			     zcbor_uint32_put(zse, dpm.entries)			&&
+			     zcbor_uint32_put(zse, dpm.wakes)			&&
+			     zcbor_uint32_put(zse, dpm.time)			&&
+			     zcbor_uint32_put(zse, dpm.predicted_gap)		&&
+			     zcbor_uint32_put(zse, dpm.cool_down_period)	&&
+			     zcbor_list_end_encode(zse, DPM_STATS_ITEMS);
+		}
+	}
+
+	/* Cbor encode result */
+	ok = ok && zcbor_tstr_put_lit(zse, "r") && zcbor_int32_put(zse, r);
+
+	/* Exit with result */
+	return ok ? MGMT_ERR_EOK : MGMT_ERR_ENOMEM;
+}
+
+static int get_wear(struct mgmt_ctxt *ctxt)
+{
+	const struct device *dev = DEVICE_DT_GET(QSPI_NOR_NODE);
+	uint32_t counts[CONFIG_QSPI_NOR_MGMT_MAX_WEAR_COUNTS];
+	uint32_t count = ARRAY_SIZE(counts);
+	uint32_t first = 0;
+	uint32_t unit_size = 0;
+	uint32_t units;
+	zcbor_state_t *zse = ctxt->cnbe->zs;
+	zcbor_state_t *zsd = ctxt->cnbd->zs;
+	size_t decoded;
+	int n = 0;
+	int i;
+	bool ok;
+
+	/* Both parameters are optional */
+	struct zcbor_map_decode_key_val qspi_get_wear_decode[] = {
+		ZCBOR_MAP_DECODE_KEY_VAL(p1, zcbor_uint32_decode, &first),
+		ZCBOR_MAP_DECODE_KEY_VAL(p2, zcbor_uint32_decode, &count),
+	};
+
+	ok = zcbor_map_decode_bulk(zsd, qspi_get_wear_decode,
+				   ARRAY_SIZE(qspi_get_wear_decode), &decoded) == 0;
+
+	if (!ok) {
+		return MGMT_ERR_EINVAL;
+	}
+
+	units = lcz_nrf_qspi_nor_get_wear_units(dev, &unit_size);
+	if (units == 0) {
+		n = -ENOTSUP;
+	} else if (first >= units) {
+		n = -EINVAL;
+	} else {
+		n = lcz_nrf_qspi_nor_get_wear(dev, first, counts,
+					      MIN(count, ARRAY_SIZE(counts)));
+	}
+
+	/* Cbor encode result */
+	ok = zcbor_tstr_put_lit(zse, "r")	&&
+	     zcbor_int32_put(zse, MIN(n, 0))	&&
+	     zcbor_tstr_put_lit(zse, "u")	&&
+	     zcbor_uint32_put(zse, unit_size)	&&
+	     zcbor_tstr_put_lit(zse, "n")	&&
+	     zcbor_uint32_put(zse, units)	&&
+	     zcbor_tstr_put_lit(zse, "f")	&&
+	     zcbor_uint32_put(zse, first)	&&
+	     zcbor_tstr_put_lit(zse, "w")	&&
+	     zcbor_list_start_encode(zse, ARRAY_SIZE(counts));
+
+	for (i = 0; ok && i < n; i++) {
+		ok = zcbor_uint32_put(zse, counts[i]);
+	}
+
+	ok = ok && zcbor_list_end_encode(zse, ARRAY_SIZE(counts));
+
+	/* Exit with result */
+	return ok ? MGMT_ERR_EOK : MGMT_ERR_ENOMEM;
+}
+
+static int reset_stats(struct mgmt_ctxt *ctxt)
+{
+	zcbor_state_t *zse = ctxt->cnbe->zs;
+	bool ok;
+
+	lcz_nrf_qspi_nor_reset_op_stats(DEVICE_DT_GET(QSPI_NOR_NODE));
+
+	/* Cbor encode result */
+	ok = zcbor_tstr_put_lit(zse, "r")	&&
+	     zcbor_int32_put(zse, 0);
+
+	/* Exit with result */
+	return ok ? MGMT_ERR_EOK : MGMT_ERR_ENOMEM;
+}
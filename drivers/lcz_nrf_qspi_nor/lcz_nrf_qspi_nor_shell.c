@@ -0,0 +1,180 @@
+/**
+ * @file lcz_nrf_qspi_nor_shell.c
+ * @brief Shell commands for QSPI NOR flash telemetry
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <device.h>
+#include <shell/shell.h>
+#include <stdlib.h>
+
+#include "lcz_nrf_qspi_nor.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define QSPI_NOR_NODE DT_INST(0, nordic_qspi_nor)
+
+/* Counts are read from the driver in chunks to limit stack use */
+#define WEAR_CHUNK 16
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const char *const op_names[LCZ_NRF_QSPI_NOR_OP_COUNT] = {
+	[LCZ_NRF_QSPI_NOR_OP_READ] = "read",
+	[LCZ_NRF_QSPI_NOR_OP_WRITE] = "write",
+	[LCZ_NRF_QSPI_NOR_OP_ERASE_SECTOR] = "sector erase",
+	[LCZ_NRF_QSPI_NOR_OP_ERASE_BLOCK] = "block erase",
+	[LCZ_NRF_QSPI_NOR_OP_ERASE_CHIP] = "chip erase",
+};
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int shell_qspi_stats_cmd(const struct shell *shell, size_t argc,
+				char **argv)
+{
+	const struct device *dev = DEVICE_DT_GET(QSPI_NOR_NODE);
+	struct lcz_nrf_qspi_nor_op_stats stats;
+	struct lcz_nrf_qspi_nor_dpm_stats dpm;
+	uint32_t limit;
+	int op;
+	int bin;
+	int r;
+
+	for (op = 0; op < LCZ_NRF_QSPI_NOR_OP_COUNT; op++) {
+		r = lcz_nrf_qspi_nor_get_op_stats(dev, op, &stats);
+		if (r < 0) {
+			shell_error(shell, "Unable to get stats: %d", r);
+			return r;
+		}
+
+		shell_print(shell, "%s: count %u errors %u bytes %llu max %u us",
+			    op_names[op], stats.count, stats.errors,
+			    stats.bytes, stats.max_us);
+
+		limit = LCZ_NRF_QSPI_NOR_HISTOGRAM_FIRST_US;
+		for (bin = 0; bin < LCZ_NRF_QSPI_NOR_HISTOGRAM_BINS; bin++) {
+			if (stats.histogram[bin] == 0) {
+				/* Only bins that have been used are shown */
+			} else if (bin < (LCZ_NRF_QSPI_NOR_HISTOGRAM_BINS - 1)) {
+				shell_print(shell, "  < %u us: %u", limit,
+					    stats.histogram[bin]);
+			} else {
+				shell_print(shell, "  >= %u us: %u", limit >> 2,
+					    stats.histogram[bin]);
+			}
+			limit <<= 2;
+		}
+	}
+
+	if (lcz_nrf_qspi_nor_get_dpm_stats(dev, &dpm) == 0) {
+		shell_print(shell,
+			    "dpm: entries %u wakes %u time %u ms "
+			    "predicted gap %u ms cool down %u ms",
+			    dpm.entries, dpm.wakes, dpm.time, dpm.predicted_gap,
+			    dpm.cool_down_period);
+	}
+
+	return 0;
+}
+
+static int shell_qspi_reset_cmd(const struct shell *shell, size_t argc,
+				char **argv)
+{
+	lcz_nrf_qspi_nor_reset_op_stats(DEVICE_DT_GET(QSPI_NOR_NODE));
+
+	return 0;
+}
+
+static int shell_qspi_wear_cmd(const struct shell *shell, size_t argc,
+			       char **argv)
+{
+	const struct device *dev = DEVICE_DT_GET(QSPI_NOR_NODE);
+	uint32_t counts[WEAR_CHUNK];
+	uint32_t unit_size;
+	uint32_t units;
+	uint32_t first = 0;
+	uint32_t last;
+	uint32_t min = UINT32_MAX;
+	uint32_t max = 0;
+	uint32_t max_unit = 0;
+	uint64_t total = 0;
+	uint32_t i;
+	bool list;
+	int n;
+
+	units = lcz_nrf_qspi_nor_get_wear_units(dev, &unit_size);
+	if (units == 0) {
+		shell_error(shell, "Erase counts not available");
+		return -ENOTSUP;
+	}
+
+	/* With a range the counts are listed, otherwise summarised */
+	list = (argc > 1);
+	last = units;
+	if (argc > 1) {
+		first = MIN(strtoul(argv[1], NULL, 0), units);
+		last = first + 1;
+	}
+	if (argc > 2) {
+		last = MIN(first + strtoul(argv[2], NULL, 0), units);
+	}
+
+	for (i = first; i < last; i += n) {
+		n = lcz_nrf_qspi_nor_get_wear(dev, i, counts,
+					      MIN(ARRAY_SIZE(counts), last - i));
+		if (n <= 0) {
+			shell_error(shell, "Unable to get erase counts: %d", n);
+			return (n < 0) ? n : -EIO;
+		}
+
+		for (int j = 0; j < n; j++) {
+			if (list) {
+				shell_print(shell, "0x%08x: %u", (i + j) * unit_size,
+					    counts[j]);
+			}
+			if (counts[j] > max) {
+				max = counts[j];
+				max_unit = i + j;
+			}
+			min = MIN(min, counts[j]);
+			total += counts[j];
+		}
+	}
+
+	if (!list) {
+		shell_print(shell, "%u regions of %u bytes", units, unit_size);
+		shell_print(shell, "erases: min %u max %u (at 0x%08x) mean %llu",
+			    min, max, max_unit * unit_size, total / units);
+	}
+
+	return 0;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(qspi_cmds,
+			       SHELL_CMD(stats, NULL,
+					 "Operation counts, times and DPM",
+					 shell_qspi_stats_cmd),
+			       SHELL_CMD(reset, NULL,
+					 "Clear operation counts and times",
+					 shell_qspi_reset_cmd),
+			       SHELL_CMD(wear, NULL,
+					 "Erase count summary or "
+					 "<first region> [count] to list",
+					 shell_qspi_wear_cmd),
+			       SHELL_SUBCMD_SET_END /* Array terminated. */
+);
+
+SHELL_CMD_REGISTER(qspi, &qspi_cmds, "QSPI flash telemetry", NULL);
@@ -0,0 +1,83 @@
+/**
+ * @file lcz_flash_sim.h
+ * @brief Flash simulator with a NOR timing model
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_FLASH_SIM_H__
+#define __LCZ_FLASH_SIM_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/**
+ * Write amplification of a storage layer is the flash bytes programmed
+ * (write_bytes) or erased (erase_bytes) divided by the bytes it was asked
+ * to store.
+ *
+ * @param reads number of read calls
+ * @param read_bytes bytes read
+ * @param writes number of write calls
+ * @param write_bytes bytes programmed
+ * @param page_programs number of (partial) pages programmed
+ * @param sector_erases number of 4 KiB sector erases
+ * @param block_erases number of 64 KiB block erases
+ * @param chip_erases number of chip erases
+ * @param erase_bytes bytes erased
+ * @param dpm_wakes number of accesses that woke the part from DPM
+ * @param busy_us total simulated operation time in microseconds
+ * @param max_us longest simulated operation in microseconds
+ */
+struct lcz_flash_sim_stats {
+	uint32_t reads;
+	uint64_t read_bytes;
+	uint32_t writes;
+	uint64_t write_bytes;
+	uint32_t page_programs;
+	uint32_t sector_erases;
+	uint32_t block_erases;
+	uint32_t chip_erases;
+	uint64_t erase_bytes;
+	uint32_t dpm_wakes;
+	uint64_t busy_us;
+	uint32_t max_us;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Get operation counts since boot or the last reset.
+ *
+ * @param dev "lcz,flash-sim" device
+ * @param stats copy of the counts
+ *
+ * @retval 0 on success, -EINVAL if stats is NULL
+ */
+int lcz_flash_sim_get_stats(const struct device *dev,
+			    struct lcz_flash_sim_stats *stats);
+
+/**
+ * @brief Clear operation counts (the flash contents aren't changed).
+ *
+ * @param dev "lcz,flash-sim" device
+ */
+void lcz_flash_sim_reset_stats(const struct device *dev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_FLASH_SIM_H__ */
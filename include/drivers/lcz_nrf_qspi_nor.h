@@ -0,0 +1,154 @@
+/**
+ * @file lcz_nrf_qspi_nor.h
+ * @brief Laird Connectivity QSPI NOR driver extensions
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_NRF_QSPI_NOR_H__
+#define __LCZ_NRF_QSPI_NOR_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/**
+ * @param entries number of times DPM has been entered
+ * @param wakes number of times the flash was woken from DPM
+ * @param time total milliseconds spent in DPM
+ * @param predicted_gap expected milliseconds between accesses
+ * @param cool_down_period idle milliseconds before DPM is entered
+ */
+struct lcz_nrf_qspi_nor_dpm_stats {
+	uint32_t entries;
+	uint32_t wakes;
+	uint32_t time;
+	uint32_t predicted_gap;
+	uint32_t cool_down_period;
+};
+
+enum lcz_nrf_qspi_nor_op {
+	LCZ_NRF_QSPI_NOR_OP_READ = 0,
+	LCZ_NRF_QSPI_NOR_OP_WRITE,
+	LCZ_NRF_QSPI_NOR_OP_ERASE_SECTOR,
+	LCZ_NRF_QSPI_NOR_OP_ERASE_BLOCK,
+	LCZ_NRF_QSPI_NOR_OP_ERASE_CHIP,
+
+	LCZ_NRF_QSPI_NOR_OP_COUNT
+};
+
+/* Bin n counts operations that took less than (64 << (2 * n)) microseconds,
+ * the last bin counts the rest.
+ */
+#define LCZ_NRF_QSPI_NOR_HISTOGRAM_BINS 8
+#define LCZ_NRF_QSPI_NOR_HISTOGRAM_FIRST_US 64
+
+/**
+ * @param count number of operations
+ * @param errors number of operations that failed
+ * @param bytes bytes read, written or erased by successful operations
+ * @param max_us longest operation in microseconds
+ * @param histogram operation time
+ */
+struct lcz_nrf_qspi_nor_op_stats {
+	uint32_t count;
+	uint32_t errors;
+	uint64_t bytes;
+	uint32_t max_us;
+	uint32_t histogram[LCZ_NRF_QSPI_NOR_HISTOGRAM_BINS];
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Get statistics for an operation since boot or the last reset
+ * (CONFIG_LCZ_NRF_QSPI_NOR_TELEMETRY).
+ *
+ * @param dev flash device
+ * @param op operation
+ * @param stats filled in
+ *
+ * @retval 0 on success, -EINVAL on invalid parameter,
+ * -ENOTSUP if telemetry isn't enabled.
+ */
+int lcz_nrf_qspi_nor_get_op_stats(const struct device *dev,
+				  enum lcz_nrf_qspi_nor_op op,
+				  struct lcz_nrf_qspi_nor_op_stats *stats);
+
+/**
+ * @brief Clear operation statistics (erase counts aren't cleared).
+ *
+ * @param dev flash device
+ */
+void lcz_nrf_qspi_nor_reset_op_stats(const struct device *dev);
+
+/**
+ * @param dev flash device
+ * @param unit_size size of region that each erase count is for
+ *
+ * @retval number of erase counts, 0 if telemetry isn't enabled
+ */
+uint32_t lcz_nrf_qspi_nor_get_wear_units(const struct device *dev,
+					 uint32_t *unit_size);
+
+/**
+ * @brief Get erase counts since boot.
+ *
+ * @param dev flash device
+ * @param first index of first unit
+ * @param counts filled in
+ * @param count maximum number of counts
+ *
+ * @retval number of counts copied, negative errno on error
+ */
+int lcz_nrf_qspi_nor_get_wear(const struct device *dev, uint32_t first,
+			      uint32_t *counts, size_t count);
+
+/**
+ * @brief Get deep power-down statistics.
+ *
+ * @param dev flash device
+ * @param stats filled in
+ *
+ * @retval 0 on success, -EINVAL on invalid parameter
+ */
+int lcz_nrf_qspi_nor_get_dpm_stats(const struct device *dev,
+				   struct lcz_nrf_qspi_nor_dpm_stats *stats);
+
+/**
+ * @brief Tell the driver that sectors don't contain data that is needed.
+ * They are added to the pool of sectors that are erased in the background
+ * (CONFIG_LCZ_NRF_QSPI_NOR_ERASE_AHEAD).
+ * A sector is removed from the pool when it is written or erased. Erasing
+ * a sector that is known to be erased returns without erasing it.
+ * The file system utilities call this for free littlefs blocks
+ * (CONFIG_FSU_LFS_ERASE_AHEAD).
+ *
+ * @param dev flash device
+ * @param addr sector aligned address
+ * @param size multiple of the sector size
+ *
+ * @retval 0 on success, -ENODEV if dev isn't the QSPI flash, -EINVAL if the
+ * region isn't sector aligned or is outside of the device, -ENOTSUP if
+ * erase-ahead isn't enabled.
+ */
+int lcz_nrf_qspi_nor_mark_free(const struct device *dev, off_t addr,
+			       size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_NRF_QSPI_NOR_H__ */
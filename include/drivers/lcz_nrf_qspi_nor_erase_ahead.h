@@ -0,0 +1,95 @@
+/**
+ * @file lcz_nrf_qspi_nor_erase_ahead.h
+ * @brief Free and erased sector bookkeeping for the QSPI NOR erase-ahead
+ * pool. It doesn't access the flash, the caller serializes calls.
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_NRF_QSPI_NOR_ERASE_AHEAD_H__
+#define __LCZ_NRF_QSPI_NOR_ERASE_AHEAD_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <sys/atomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/**
+ * @param free sectors the file system doesn't need that haven't been erased
+ * @param erased sectors known to be erased
+ * @param sectors number of sectors
+ */
+struct lcz_erase_ahead_map {
+	atomic_t *free;
+	atomic_t *erased;
+	uint32_t sectors;
+};
+
+#define LCZ_ERASE_AHEAD_MAP_DEFINE(name, count)                                \
+	static ATOMIC_DEFINE(name##_free, count);                              \
+	static ATOMIC_DEFINE(name##_erased, count);                            \
+	static struct lcz_erase_ahead_map name = { .free = name##_free,        \
+						   .erased = name##_erased,    \
+						   .sectors = count }
+
+/**
+ * @brief Erase sectors first to (first + count - 1)
+ *
+ * @retval 0 on success, negative errno otherwise
+ */
+typedef int (*lcz_erase_ahead_erase_t)(void *context, uint32_t first,
+				       uint32_t count);
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Add sectors that aren't already erased to the free pool.
+ */
+void lcz_erase_ahead_mark_free(struct lcz_erase_ahead_map *map, uint32_t first,
+			       uint32_t count);
+
+/**
+ * @brief Remove the lowest free sector from the pool.
+ *
+ * @retval sector, -ENOENT if the pool is empty
+ */
+int lcz_erase_ahead_take_free(struct lcz_erase_ahead_map *map);
+
+/**
+ * @brief Sectors have been erased; they are no longer free.
+ */
+void lcz_erase_ahead_mark_erased(struct lcz_erase_ahead_map *map,
+				 uint32_t first, uint32_t count);
+
+/**
+ * @brief Sectors are being written; they are neither free nor erased.
+ */
+void lcz_erase_ahead_mark_written(struct lcz_erase_ahead_map *map,
+				  uint32_t first, uint32_t count);
+
+/**
+ * @brief Erase the runs of sectors in the range that aren't known to be
+ * erased, then mark the range as erased.
+ *
+ * @retval 0 on success, the error of the first erase that failed
+ */
+int lcz_erase_ahead_erase(struct lcz_erase_ahead_map *map, uint32_t first,
+			  uint32_t count, lcz_erase_ahead_erase_t erase,
+			  void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_NRF_QSPI_NOR_ERASE_AHEAD_H__ */
@@ -0,0 +1,47 @@
+/**
+ * @file lcz_nrf_qspi_nor_mgmt.h
+ *
+ * @brief SMP interface for QSPI NOR flash telemetry Command Group
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __LCZ_NRF_QSPI_NOR_MGMT_H__
+#define __LCZ_NRF_QSPI_NOR_MGMT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+/**
+ * Command IDs for QSPI NOR management group.
+ *
+ * @note IDs cannot be changed or re-ordered once set and all handlers must
+ * exist in all products, even if they are not used, if a handler is not
+ * available for a particular product and/or configuration then it should
+ * return MGMT_ERR_ENOTSUP
+ */
+typedef enum {
+	QSPI_NOR_MGMT_ID_GET_STATS,
+	QSPI_NOR_MGMT_ID_GET_WEAR,
+	QSPI_NOR_MGMT_ID_RESET_STATS
+} QSPI_NOR_MGMT_id_t;
+
+#define QSPI_NOR_MGMT_HANDLER_CNT                                              \
+	(sizeof QSPI_NOR_MGMT_HANDLERS / sizeof QSPI_NOR_MGMT_HANDLERS[0])
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_NRF_QSPI_NOR_MGMT_H__ */
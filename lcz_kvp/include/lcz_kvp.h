@@ -40,6 +40,17 @@ typedef struct lcz_kvp {
  */
 #define LCZ_KVP_EMPTY_VALUE_STR "\"\""
 
+/**
+ * @brief Called by lcz_kvp_parse_stream for each key-value pair found.
+ *
+ * @param kvp key-value pair. The key and value point into the parser's line buffer
+ * and are only valid for the duration of the callback.
+ * @param context user context passed to lcz_kvp_parse_stream
+ *
+ * @retval negative error code to stop parsing, otherwise 0.
+ */
+typedef int (*lcz_kvp_pair_cb_t)(const lcz_kvp_t *kvp, void *context);
+
 /**************************************************************************************************/
 /* Global Function Prototypes                                                                     */
 /**************************************************************************************************/
@@ -96,6 +107,25 @@ int lcz_kvp_delete(char *name);
 int lcz_kvp_parse_from_file(const lcz_kvp_cfg_t *cfg, const char *fname, size_t *fsize, char **fstr,
 			    lcz_kvp_t **kv);
 
+/**
+ * @brief Parses a file in fixed size chunks without loading the entire file into RAM.
+ * Each line is validated and tokenized in a single pass and pairs are handed to the
+ * callback as they are found.
+ *
+ * @note Memory use is bounded by CONFIG_LCZ_KVP_STREAM_CHUNK_SIZE plus
+ * CONFIG_LCZ_KVP_STREAM_MAX_LINE_SIZE. Lines that don't fit are rejected.
+ * Pairs found before an error has been detected have already been passed to the callback.
+ *
+ * @param cfg file configuration
+ * @param fname absolute path name of file
+ * @param cb function called for each key-value pair
+ * @param context passed to callback
+ *
+ * @retval negative error code or number of key-value pairs found.
+ */
+int lcz_kvp_parse_stream(const lcz_kvp_cfg_t *cfg, const char *fname, lcz_kvp_pair_cb_t cb,
+			 void *context);
+
 /**
  * @brief Validate a file.
  *
@@ -122,6 +152,33 @@ int lcz_kvp_validate_file(const lcz_kvp_cfg_t *cfg, const char *str, size_t size
  */
 int lcz_kvp_generate_file(const lcz_kvp_cfg_t *cfg, const lcz_kvp_t *kvp, char **fstr);
 
+/**
+ * @brief Update a single key by appending a line to a file. When a key occurs more
+ * than once in a file, the last occurrence is the current value. The file is compacted
+ * in the background once it is larger than CONFIG_LCZ_KVP_COMPACT_THRESHOLD.
+ *
+ * @param cfg file configuration
+ * @param fname absolute path name of file (created if it doesn't exist)
+ * @param kvp key-value pair. A value length of zero is written as an empty string.
+ *
+ * @retval negative error code, 0 on success.
+ */
+int lcz_kvp_update(const lcz_kvp_cfg_t *cfg, const char *fname, const lcz_kvp_t *kvp);
+
+/**
+ * @brief Rewrite a file so that it contains only the last occurrence of each key.
+ * Comments and blank lines are removed when the file is rewritten. A file in which no
+ * key occurs more than once isn't rewritten. The new file is written to <fname>.cpt
+ * first, so a power loss leaves either the old or the new file. Encrypted files also use
+ * a <fname>.cpc marker; an interrupted rewrite is finished when the file is next used.
+ *
+ * @param cfg file configuration. The compacted file must fit in max_file_out_size.
+ * @param fname absolute path name of file
+ *
+ * @retval negative error code, otherwise number of key-value pairs in the file.
+ */
+int lcz_kvp_compact(const lcz_kvp_cfg_t *cfg, const char *fname);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,139 @@
+/**
+ * @file lcz_kvp_scan.h
+ * @brief Word-at-a-time (SWAR) scanning used by the key-value pair parser.
+ * Four characters are checked with a few integer operations instead of a branch per
+ * character. Loads use memcpy so the string doesn't need to be aligned.
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_KVP_SCAN_H__
+#define __LCZ_KVP_SCAN_H__
+
+/**************************************************************************************************/
+/* Includes                                                                                       */
+/**************************************************************************************************/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************/
+/* Global Constants, Macros and Type Definitions                                                  */
+/**************************************************************************************************/
+#define LCZ_KVP_SCAN_ONES 0x01010101U
+#define LCZ_KVP_SCAN_HIGHS 0x80808080U
+
+#define LCZ_KVP_SCAN_DELIMITER '='
+#define LCZ_KVP_SCAN_COMMENT '#'
+#define LCZ_KVP_SCAN_PRINT_MIN 0x20
+#define LCZ_KVP_SCAN_PRINT_MAX 0x7E
+
+/**************************************************************************************************/
+/* Global Function Definitions                                                                    */
+/**************************************************************************************************/
+/* Non-zero if any byte of w is less than n (n <= 128) */
+static inline uint32_t lcz_kvp_scan_has_less(uint32_t w, uint8_t n)
+{
+	return (w - (LCZ_KVP_SCAN_ONES * n)) & ~w & LCZ_KVP_SCAN_HIGHS;
+}
+
+/* Non-zero if any byte of w is greater than n (n <= 127) */
+static inline uint32_t lcz_kvp_scan_has_more(uint32_t w, uint8_t n)
+{
+	return ((w + (LCZ_KVP_SCAN_ONES * (127 - n))) | w) & LCZ_KVP_SCAN_HIGHS;
+}
+
+/* Non-zero if any byte of w is equal to c */
+static inline uint32_t lcz_kvp_scan_has_byte(uint32_t w, uint8_t c)
+{
+	uint32_t x = w ^ (LCZ_KVP_SCAN_ONES * c);
+
+	return (x - LCZ_KVP_SCAN_ONES) & ~x & LCZ_KVP_SCAN_HIGHS;
+}
+
+/* Non-zero if any byte of w is the delimiter, the comment character, or isn't printable
+ * (this includes the newline).
+ */
+static inline uint32_t lcz_kvp_scan_special(uint32_t w)
+{
+	return lcz_kvp_scan_has_less(w, LCZ_KVP_SCAN_PRINT_MIN) |
+	       lcz_kvp_scan_has_more(w, LCZ_KVP_SCAN_PRINT_MAX) |
+	       lcz_kvp_scan_has_byte(w, LCZ_KVP_SCAN_DELIMITER) |
+	       lcz_kvp_scan_has_byte(w, LCZ_KVP_SCAN_COMMENT);
+}
+
+static inline uint32_t lcz_kvp_scan_load(const char *str)
+{
+	uint32_t w;
+
+	memcpy(&w, str, sizeof(w));
+	return w;
+}
+
+/**
+ * @brief Get the number of leading characters that are printable and aren't
+ * the delimiter or the comment character.
+ *
+ * @param str string (doesn't need to be null terminated)
+ * @param size length of string
+ *
+ * @retval index of first special character or size if there isn't one
+ */
+static inline size_t lcz_kvp_scan_plain(const char *str, size_t size)
+{
+	size_t i = 0;
+	char c;
+
+	while ((size - i) >= sizeof(uint32_t) &&
+	       lcz_kvp_scan_special(lcz_kvp_scan_load(&str[i])) == 0) {
+		i += sizeof(uint32_t);
+	}
+
+	for (; i < size; i++) {
+		c = str[i];
+		if (c < LCZ_KVP_SCAN_PRINT_MIN || c > LCZ_KVP_SCAN_PRINT_MAX ||
+		    c == LCZ_KVP_SCAN_DELIMITER || c == LCZ_KVP_SCAN_COMMENT) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+/**
+ * @brief Find the first occurrence of a character.
+ *
+ * @param str string (doesn't need to be null terminated)
+ * @param size length of string
+ * @param c character to find
+ *
+ * @retval pointer to character or NULL if not found
+ */
+static inline const char *lcz_kvp_scan_find(const char *str, size_t size, char c)
+{
+	size_t i = 0;
+
+	while ((size - i) >= sizeof(uint32_t) &&
+	       lcz_kvp_scan_has_byte(lcz_kvp_scan_load(&str[i]), (uint8_t)c) == 0) {
+		i += sizeof(uint32_t);
+	}
+
+	for (; i < size; i++) {
+		if (str[i] == c) {
+			return &str[i];
+		}
+	}
+
+	return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_KVP_SCAN_H__ */
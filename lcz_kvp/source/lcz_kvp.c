@@ -24,6 +24,7 @@ LOG_MODULE_REGISTER(lcz_kvp, CONFIG_LCZ_KVP_LOG_LEVEL);
 #endif
 #include "file_system_utilities.h"
 #include "lcz_kvp.h"
+#include "lcz_kvp_scan.h"
 
 /**************************************************************************************************/
 /* Local Constant, Macro and Type Definitions                                                     */
@@ -43,6 +44,7 @@ LOG_MODULE_REGISTER(lcz_kvp, CONFIG_LCZ_KVP_LOG_LEVEL);
 typedef struct func_context {
 	ssize_t (*get_size)(const char *abs_path);
 	ssize_t (*read)(const char *abs_path, void *data, size_t size);
+	ssize_t (*read_block)(const char *abs_path, uint32_t offset, void *data, size_t size);
 	ssize_t (*write)(const char *abs_path, void *data, size_t size);
 	ssize_t (*append)(const char *abs_path, void *data, size_t size);
 	const char *msg;
@@ -54,6 +56,22 @@ typedef struct func_context {
 #define CR_CHAR '\r'
 #define EOL_CHAR '\n'
 
+BUILD_ASSERT(DELIMITER == LCZ_KVP_SCAN_DELIMITER && COMMENT_CHAR == LCZ_KVP_SCAN_COMMENT,
+	     "Scanner and parser characters must match");
+
+/* A compacted file is written to <file>.cpt. Cleartext files are then renamed over the
+ * original. Encrypted files can't be renamed because the authentication data of each block
+ * includes a hash of the file name, so <file>.cpc marks the copy as complete until the
+ * original has been rewritten.
+ */
+#define COMPACT_JOURNAL_SUFFIX ".cpt"
+#define COMPACT_COMMIT_SUFFIX ".cpc"
+
+/* Compaction is retried if the file is appended to while its output is being built */
+#define COMPACT_ATTEMPTS 3
+
+#define STREAM_BUFFER_SIZE (CONFIG_LCZ_KVP_STREAM_MAX_LINE_SIZE + CONFIG_LCZ_KVP_STREAM_CHUNK_SIZE)
+
 #define APPEND(k, l)                                                                               \
 	memcpy(&str[length], (k), (l));                                                            \
 	length += (l)
@@ -65,22 +83,59 @@ typedef struct func_context {
 /**************************************************************************************************/
 static bool kvp_ready;
 
+/* Updates and compaction of log-structured files are serialized so that an append
+ * can't be lost when the file is rewritten.
+ */
+static K_MUTEX_DEFINE(kvp_log_lock);
+
+static struct {
+	lcz_kvp_cfg_t cfg;
+	char abs_path[FSU_MAX_ABS_PATH_SIZE + 1];
+	atomic_t busy;
+	/* Size of the most recently compacted file when compaction finished (kvp_log_lock) */
+	char last_path[FSU_MAX_ABS_PATH_SIZE + 1];
+	ssize_t last_size;
+} compaction;
+
 /**************************************************************************************************/
 /* Local Function Prototypes                                                                      */
 /**************************************************************************************************/
 static func_context_t get_func_context(bool encrypted);
+#if defined(CONFIG_FSU_ENCRYPTED_FILES)
+static ssize_t efs_read_chunk(const char *abs_path, uint32_t offset, void *data, size_t size);
+#endif
 
 static int read_text(const func_context_t *ctx, const char *fname, char **fstr, size_t fsize);
 
-static char *parse_kvp(char *start, lcz_kvp_t *kvp);
+static char *parse_kvp(char *start, char *end, lcz_kvp_t *kvp);
 static int parse_kvp_file(const char *str, size_t length, int pairs, lcz_kvp_t *kv);
 
+static size_t strip_cr(char *str, size_t length);
+static int parse_line(char *line, size_t length, size_t line_number, lcz_kvp_t *kvp);
+static int parse_lines(char *str, size_t *length, size_t *lines, lcz_kvp_pair_cb_t cb,
+		       void *context);
+
 static int append_kvp_line(const lcz_kvp_cfg_t *cfg, const lcz_kvp_t *kvp, char *str);
 
+static bool superseded(const lcz_kvp_t *kv, int i, int pairs);
+static int compact_attempt(const lcz_kvp_cfg_t *cfg, const func_context_t *ctx,
+			   const char *fname);
+static int compaction_path(char *result, size_t max_size, const char *fname,
+			   const char *suffix);
+static int commit_compacted(const lcz_kvp_cfg_t *cfg, const char *fname, char *data,
+			    size_t size);
+static int recover_compaction(const lcz_kvp_cfg_t *cfg, const char *fname);
+static bool needs_compaction(const char *fname, ssize_t file_size);
+static void compaction_done(const func_context_t *ctx, const char *fname);
+static void schedule_compaction(const lcz_kvp_cfg_t *cfg, const char *fname);
+static void compaction_handler(struct k_work *work);
+
 static bool valid_cfg(const lcz_kvp_cfg_t *cfg);
 static bool valid_kvp(const lcz_kvp_t *kvp);
 static ssize_t space_avail(const lcz_kvp_cfg_t *cfg, const lcz_kvp_t *kvp, size_t start_len);
 
+static K_WORK_DEFINE(compaction_work, compaction_handler);
+
 /**************************************************************************************************/
 /* SYS INIT                                                                                       */
 /**************************************************************************************************/
@@ -112,7 +167,7 @@ SYS_INIT(lcz_kvp_init, APPLICATION, CONFIG_LCZ_KVP_INIT_PRIORITY);
 /**************************************************************************************************/
 ssize_t lcz_kvp_write(bool encrypted, char *name, void *data, size_t size)
 {
-	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	char abs_path[FSU_MAX_ABS_PATH_SIZE + 1];
 	func_context_t ctx;
 	int r;
 
@@ -133,7 +188,7 @@ ssize_t lcz_kvp_write(bool encrypted, char *name, void *data, size_t size)
 
 ssize_t lcz_kvp_read(bool encrypted, char *name, void *data, size_t size)
 {
-	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	char abs_path[FSU_MAX_ABS_PATH_SIZE + 1];
 	func_context_t ctx;
 	int r;
 
@@ -182,6 +237,11 @@ int lcz_kvp_parse_from_file(const lcz_kvp_cfg_t *cfg, const char *fname, size_t
 		return -ENOTSUP;
 	}
 
+	r = recover_compaction(cfg, fname);
+	if (r < 0) {
+		return r;
+	}
+
 	do {
 		r = file_size = ctx.get_size(fname);
 		LOG_DBG("'%s' %s kvp file size bytes: %d", fname, ctx.msg, file_size);
@@ -234,6 +294,223 @@ int lcz_kvp_parse_from_file(const lcz_kvp_cfg_t *cfg, const char *fname, size_t
 	return r;
 }
 
+int lcz_kvp_parse_stream(const lcz_kvp_cfg_t *cfg, const char *fname, lcz_kvp_pair_cb_t cb,
+			 void *context)
+{
+	int r = -EPERM;
+	ssize_t file_size;
+	func_context_t ctx;
+	char *buf = NULL;
+	size_t offset = 0;
+	size_t used = 0;
+	size_t lines = 0;
+	size_t chunk;
+	int pairs = 0;
+
+	if (!valid_cfg(cfg) || fname == NULL || cb == NULL) {
+		LOG_ERR("Invalid kvp config");
+		return -EINVAL;
+	}
+
+	ctx = get_func_context(cfg->encrypted);
+	if (ctx.get_size == NULL || ctx.read_block == NULL) {
+		return -ENOTSUP;
+	}
+
+	r = recover_compaction(cfg, fname);
+	if (r < 0) {
+		return r;
+	}
+
+	do {
+		r = file_size = ctx.get_size(fname);
+		LOG_DBG("'%s' %s kvp file size bytes: %d", fname, ctx.msg, file_size);
+		if (file_size < 0) {
+			break;
+		} else if (file_size == 0) {
+			r = -ENOENT;
+			LOG_ERR("%s kvp file %s is empty", ctx.msg, fname);
+			break;
+		}
+
+		buf = k_malloc(STREAM_BUFFER_SIZE);
+		if (buf == NULL) {
+			r = -ENOMEM;
+			break;
+		}
+
+		/* The unparsed end of the previous chunk (a partial line) is kept at the
+		 * front of the buffer and the next chunk is read in behind it.
+		 */
+		while (offset < file_size) {
+			chunk = MIN(CONFIG_LCZ_KVP_STREAM_CHUNK_SIZE, file_size - offset);
+			r = ctx.read_block(fname, offset, &buf[used], chunk);
+			if (r != chunk) {
+				LOG_ERR("Could not read %s kvp file %s at %u: %d", ctx.msg, fname,
+					offset, r);
+				if (r >= 0) {
+					r = -EIO;
+				}
+				break;
+			}
+			offset += chunk;
+			used += strip_cr(&buf[used], chunk);
+
+			r = parse_lines(buf, &used, &lines, cb, context);
+			if (r < 0) {
+				break;
+			}
+			pairs += r;
+
+			if (used >= CONFIG_LCZ_KVP_STREAM_MAX_LINE_SIZE) {
+				LOG_ERR("Line %u is longer than %u", lines + 1,
+					CONFIG_LCZ_KVP_STREAM_MAX_LINE_SIZE);
+				r = -E2BIG;
+				break;
+			}
+		}
+		if (r < 0) {
+			break;
+		}
+
+		if (used != 0) {
+			LOG_ERR("Newline not found at end of kvp file");
+			r = -EINVAL;
+			break;
+		}
+
+		r = pairs;
+	} while (0);
+
+	/* Clear encrypted file data */
+	if (buf != NULL) {
+		memset(buf, 0, STREAM_BUFFER_SIZE);
+		k_free(buf);
+	}
+
+	LOG_DBG("Found %u pairs status: %d", pairs, r);
+
+	return r;
+}
+
+int lcz_kvp_update(const lcz_kvp_cfg_t *cfg, const char *fname, const lcz_kvp_t *kvp)
+{
+	int r = 0;
+	func_context_t ctx;
+	ssize_t file_size = 0;
+	bool compact = false;
+	const char *val;
+	size_t val_len;
+	size_t length;
+	char *line = NULL;
+	lcz_kvp_t check;
+
+	if (!valid_cfg(cfg) || fname == NULL || !valid_kvp(kvp) || kvp->key_len <= 0 ||
+	    kvp->val_len < 0) {
+		LOG_ERR("Invalid kvp update");
+		return -EINVAL;
+	}
+
+	ctx = get_func_context(cfg->encrypted);
+	if (ctx.append == NULL) {
+		return -ENOTSUP;
+	}
+
+	if (kvp->val_len == 0) {
+		val = LCZ_KVP_EMPTY_VALUE_STR;
+		val_len = strlen(LCZ_KVP_EMPTY_VALUE_STR);
+	} else {
+		val = kvp->val;
+		val_len = kvp->val_len;
+	}
+
+	do {
+		/* key=value\n */
+		length = kvp->key_len + 1 + val_len + 1;
+		line = k_malloc(length);
+		if (line == NULL) {
+			r = -ENOMEM;
+			break;
+		}
+
+		memcpy(line, kvp->key, kvp->key_len);
+		line[kvp->key_len] = DELIMITER;
+		memcpy(&line[kvp->key_len + 1], val, val_len);
+		line[length - 1] = EOL_CHAR;
+
+		/* The line must parse back to the same key */
+		r = parse_line(line, length - 1, 1, &check);
+		if (r <= 0 || check.key_len != kvp->key_len) {
+			LOG_ERR("Invalid kvp for update");
+			r = -EINVAL;
+			break;
+		}
+
+		/* Don't append to a file whose compaction was interrupted */
+		r = recover_compaction(cfg, fname);
+		if (r < 0) {
+			break;
+		}
+
+		k_mutex_lock(&kvp_log_lock, K_FOREVER);
+		r = ctx.append(fname, line, length);
+		if (r >= 0) {
+			file_size = ctx.get_size(fname);
+			compact = needs_compaction(fname, file_size);
+		}
+		k_mutex_unlock(&kvp_log_lock);
+
+		if (r < 0) {
+			LOG_ERR("Unable to append to %s kvp file %s: %d", ctx.msg, fname, r);
+			break;
+		}
+		r = 0;
+
+		if (compact) {
+			schedule_compaction(cfg, fname);
+		}
+	} while (0);
+
+	if (line != NULL) {
+		memset(line, 0, length);
+		k_free(line);
+	}
+
+	return r;
+}
+
+int lcz_kvp_compact(const lcz_kvp_cfg_t *cfg, const char *fname)
+{
+	func_context_t ctx;
+	int attempt;
+	int r;
+
+	if (!valid_cfg(cfg) || fname == NULL) {
+		LOG_ERR("Invalid kvp config");
+		return -EINVAL;
+	}
+
+	ctx = get_func_context(cfg->encrypted);
+	if (ctx.write == NULL) {
+		return -ENOTSUP;
+	}
+
+	r = recover_compaction(cfg, fname);
+	if (r < 0) {
+		return r;
+	}
+
+	for (attempt = 0; attempt < COMPACT_ATTEMPTS; attempt++) {
+		r = compact_attempt(cfg, &ctx, fname);
+		if (r != -EAGAIN) {
+			break;
+		}
+		LOG_DBG("%s was updated during compaction", fname);
+	}
+
+	return r;
+}
+
 int lcz_kvp_generate_file(const lcz_kvp_cfg_t *cfg, const lcz_kvp_t *kvp, char **fstr)
 {
 	int r = 0;
@@ -277,9 +554,18 @@ int lcz_kvp_validate_file(const lcz_kvp_cfg_t *cfg, const char *str, size_t size
 	bool comment = false;
 	bool in_value = false;
 	size_t distance = 0;
-	size_t i;
+	size_t plain;
+	size_t i = 0;
+
+	while (i < size) {
+		/* Skip runs of ordinary characters a word at a time */
+		plain = lcz_kvp_scan_plain(&str[i], size - i);
+		distance += plain;
+		i += plain;
+		if (i >= size) {
+			break;
+		}
 
-	for (i = 0; i < size; i++) {
 		if (str[i] == DELIMITER && !in_value) {
 			delimiters += 1;
 			in_value = true;
@@ -321,6 +607,7 @@ int lcz_kvp_validate_file(const lcz_kvp_cfg_t *cfg, const char *str, size_t size
 		} else {
 			distance += 1;
 		}
+		i++;
 	}
 
 	KVP_HEXDUMP(str, size, "kvp str");
@@ -336,21 +623,21 @@ int lcz_kvp_validate_file(const lcz_kvp_cfg_t *cfg, const char *str, size_t size
 /**************************************************************************************************/
 /* Local Function Definitions                                                                     */
 /**************************************************************************************************/
-static char *parse_kvp(char *start, lcz_kvp_t *kvp)
+static char *parse_kvp(char *start, char *end, lcz_kvp_t *kvp)
 {
 	char *next = NULL;
 	char *delimiter;
 	char *newline;
 
-	delimiter = strchr(start, DELIMITER);
-	newline = strchr(delimiter, EOL_CHAR);
-
 	do {
+		delimiter = (char *)lcz_kvp_scan_find(start, end - start, DELIMITER);
 		if (delimiter == NULL) {
 			LOG_ERR("Delimiter not found");
 			break;
 		}
 
+		newline = (char *)lcz_kvp_scan_find(delimiter, end - delimiter, EOL_CHAR);
+
 		/* Strings cannot contain eol or newlines */
 		if (newline == NULL) {
 			LOG_ERR("Newline not found");
@@ -391,7 +678,7 @@ static int parse_kvp_file(const char *str, size_t length, int pairs, lcz_kvp_t *
 			break;
 		}
 
-		next = parse_kvp(next, &kv[i]);
+		next = parse_kvp(next, end, &kv[i]);
 		if (next == NULL) {
 			pairs = -EINVAL;
 			break;
@@ -401,6 +688,143 @@ static int parse_kvp_file(const char *str, size_t length, int pairs, lcz_kvp_t *
 	return pairs;
 }
 
+/**
+ * @retval length of string with carriage returns removed.
+ */
+static size_t strip_cr(char *str, size_t length)
+{
+	size_t i;
+	size_t j = 0;
+
+	for (i = 0; i < length; i++) {
+		if (str[i] != CR_CHAR) {
+			str[j++] = str[i];
+		}
+	}
+
+	return j;
+}
+
+/**
+ * @brief Validate and tokenize a single line (without newline).
+ * Blank lines and comment lines are skipped.
+ *
+ * @retval negative on error, 1 if kvp was found, otherwise 0.
+ */
+static int parse_line(char *line, size_t length, size_t line_number, lcz_kvp_t *kvp)
+{
+	char *delimiter = NULL;
+	size_t i;
+
+	if (length == 0 || line[0] == COMMENT_CHAR) {
+		return 0;
+	}
+
+	for (i = 0; i < length; i++) {
+		i += lcz_kvp_scan_plain(&line[i], length - i);
+		if (i >= length) {
+			break;
+		}
+
+		if (line[i] == DELIMITER) {
+			if (delimiter == NULL) {
+				delimiter = &line[i];
+			}
+		} else if (line[i] == COMMENT_CHAR) {
+			LOG_ERR("Comment character must start line: %u pos: %u", line_number, i);
+			return -EINVAL;
+		} else if (!isprint((int)line[i])) {
+			LOG_ERR("Non-printable char 0x%x at line: %u pos: %u", line[i],
+				line_number, i);
+			return -EINVAL;
+		}
+	}
+
+	if (delimiter == NULL) {
+		LOG_ERR("Delimiter not found line: %u", line_number);
+		return -EINVAL;
+	}
+
+	kvp->key = line;
+	kvp->key_len = delimiter - line;
+	kvp->val = delimiter + 1;
+	kvp->val_len = (line + length) - kvp->val;
+
+	if (kvp->key_len <= 0) {
+		LOG_ERR("Invalid key length: %d line: %u", kvp->key_len, line_number);
+		return -EINVAL;
+	}
+
+	if (kvp->val_len <= 0) {
+		LOG_ERR("Invalid value length: %d line: %u", kvp->val_len, line_number);
+		return -EINVAL;
+	}
+
+	/* If the value matches "", then this is any empty string */
+	if (kvp->val_len == strlen(LCZ_KVP_EMPTY_VALUE_STR)) {
+		if (memcmp(LCZ_KVP_EMPTY_VALUE_STR, kvp->val, kvp->val_len) == 0) {
+			kvp->val_len = 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Parse the complete lines in a buffer and move any partial line
+ * to the start of the buffer.
+ *
+ * @param[in] str buffer
+ * @param[in/out] length number of bytes in buffer, updated to size of partial line
+ * @param[in/out] lines number of lines processed
+ *
+ * @retval negative on error, otherwise number of key-value pairs found.
+ */
+static int parse_lines(char *str, size_t *length, size_t *lines, lcz_kvp_pair_cb_t cb,
+		       void *context)
+{
+	char *start = str;
+	char *end = str + *length;
+	char *newline;
+	lcz_kvp_t kvp;
+	int pairs = 0;
+	int r = 0;
+
+	while (start < end) {
+		newline = (char *)lcz_kvp_scan_find(start, end - start, EOL_CHAR);
+		if (newline == NULL) {
+			break;
+		}
+
+		*lines += 1;
+		if ((newline - start) >= CONFIG_LCZ_KVP_STREAM_MAX_LINE_SIZE) {
+			LOG_ERR("Line %u is longer than %u", *lines,
+				CONFIG_LCZ_KVP_STREAM_MAX_LINE_SIZE);
+			r = -E2BIG;
+			break;
+		}
+
+		r = parse_line(start, newline - start, *lines, &kvp);
+		if (r > 0) {
+			r = cb(&kvp, context);
+			if (r < 0) {
+				LOG_DBG("Parsing stopped by callback line: %u", *lines);
+				break;
+			}
+			pairs += 1;
+		} else if (r < 0) {
+			break;
+		}
+
+		start = newline + 1;
+	}
+
+	*length = end - start;
+	memmove(str, start, *length);
+
+	return (r < 0) ? r : pairs;
+}
+
 /**
  * @brief Read the text file from the filesystem into a buffer in RAM.
  *
@@ -520,6 +944,324 @@ static int read_text(const func_context_t *ctx, const char *fname, char **fstr,
 	}
 }
 
+/**
+ * @retval true if a later pair in the file has the same key
+ */
+static bool superseded(const lcz_kvp_t *kv, int i, int pairs)
+{
+	int j;
+
+	for (j = i + 1; j < pairs; j++) {
+		if (kv[j].key_len == kv[i].key_len &&
+		    memcmp(kv[j].key, kv[i].key, kv[i].key_len) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief A file is compacted when it grows past the threshold. After that it isn't parsed
+ * again until it has grown by another threshold, so a file whose pairs are all current
+ * isn't compacted on every update. Called with kvp_log_lock held.
+ */
+static bool needs_compaction(const char *fname, ssize_t file_size)
+{
+	ssize_t limit = CONFIG_LCZ_KVP_COMPACT_THRESHOLD;
+
+	if (CONFIG_LCZ_KVP_COMPACT_THRESHOLD <= 0 || file_size < 0) {
+		return false;
+	}
+
+	/* A file that is smaller than after its last compaction has been rewritten */
+	if (strcmp(fname, compaction.last_path) == 0 && file_size >= compaction.last_size) {
+		limit += compaction.last_size;
+	}
+
+	return file_size > limit;
+}
+
+/* The output is built without holding kvp_log_lock so that updates aren't blocked while
+ * the file is read, decrypted and encrypted. It is only committed if the file hasn't been
+ * appended to in the meantime.
+ */
+static int compact_attempt(const lcz_kvp_cfg_t *cfg, const func_context_t *ctx,
+			   const char *fname)
+{
+	int r;
+	int pairs;
+	int kept = 0;
+	ssize_t file_size;
+	size_t fsize = 0;
+	char *fstr = NULL;
+	char *out = NULL;
+	lcz_kvp_t *kv = NULL;
+	lcz_kvp_t kvp;
+	int i;
+
+	do {
+		r = file_size = ctx->get_size(fname);
+		if (r < 0) {
+			break;
+		}
+
+		r = pairs = lcz_kvp_parse_from_file(cfg, fname, &fsize, &fstr, &kv);
+		if (r < 0) {
+			break;
+		}
+
+		for (i = 0; i < pairs; i++) {
+			if (superseded(kv, i, pairs)) {
+				continue;
+			}
+
+			kvp = kv[i];
+			if (kvp.val_len == 0) {
+				kvp.val = LCZ_KVP_EMPTY_VALUE_STR;
+				kvp.val_len = strlen(LCZ_KVP_EMPTY_VALUE_STR);
+			}
+
+			r = lcz_kvp_generate_file(cfg, &kvp, &out);
+			if (r < 0) {
+				LOG_ERR("Compacted %s kvp file does not fit", ctx->msg);
+				break;
+			}
+			kept += 1;
+		}
+		if (r < 0) {
+			break;
+		}
+
+		k_mutex_lock(&kvp_log_lock, K_FOREVER);
+		if (ctx->get_size(fname) != file_size) {
+			r = -EAGAIN;
+		} else {
+			/* If nothing was superseded the file is left as it is (including any
+			 * comments and blank lines).
+			 */
+			r = 0;
+			if (kept < pairs) {
+				r = commit_compacted(cfg, fname, out, strlen(out));
+			}
+			if (r == 0) {
+				compaction_done(ctx, fname);
+				LOG_DBG("Compacted %s from %d to %d pairs", fname, pairs, kept);
+				r = kept;
+			}
+		}
+		k_mutex_unlock(&kvp_log_lock);
+	} while (0);
+
+	/* Clear (possibly encrypted) file data */
+	if (fstr != NULL) {
+		memset(fstr, 0, fsize);
+		k_free(fstr);
+	}
+	if (out != NULL) {
+		memset(out, 0, cfg->max_file_out_size);
+		k_free(out);
+	}
+	k_free(kv);
+
+	return r;
+}
+
+static int compaction_path(char *result, size_t max_size, const char *fname,
+			   const char *suffix)
+{
+	if ((strlen(fname) + strlen(suffix)) >= max_size) {
+		return -ENAMETOOLONG;
+	}
+
+	strcpy(result, fname);
+	strcat(result, suffix);
+
+	return 0;
+}
+
+/* Replace a file so that it is either the old or the new version after a power loss.
+ * Called with kvp_log_lock held.
+ */
+static int commit_compacted(const lcz_kvp_cfg_t *cfg, const char *fname, char *data,
+			    size_t size)
+{
+	char journal[FSU_MAX_ABS_PATH_SIZE + 1];
+#if defined(CONFIG_FSU_ENCRYPTED_FILES)
+	char marker[FSU_MAX_ABS_PATH_SIZE + 1];
+#endif
+	int r;
+
+	do {
+		r = compaction_path(journal, sizeof(journal), fname, COMPACT_JOURNAL_SUFFIX);
+		if (r < 0) {
+			break;
+		}
+
+		if (!cfg->encrypted) {
+			r = fsu_write_abs(journal, data, size);
+			if (r < 0) {
+				(void)fsu_delete_abs(journal);
+				break;
+			}
+
+			/* Replaces the existing file */
+			r = fsu_rename_abs(journal, fname);
+			break;
+		}
+
+#if defined(CONFIG_FSU_ENCRYPTED_FILES)
+		r = compaction_path(marker, sizeof(marker), fname, COMPACT_COMMIT_SUFFIX);
+		if (r < 0) {
+			break;
+		}
+
+		r = efs_write(journal, data, size);
+		if (r < 0) {
+			(void)fsu_delete_abs(journal);
+			break;
+		}
+
+		r = fsu_write_abs(marker, data, 0);
+		if (r < 0) {
+			(void)fsu_delete_abs(journal);
+			break;
+		}
+
+		/* If this is interrupted the journal is replayed by the next access */
+		r = efs_write(fname, data, size);
+		if (r < 0) {
+			break;
+		}
+
+		(void)fsu_delete_abs(marker);
+		(void)fsu_delete_abs(journal);
+#else
+		r = -ENOTSUP;
+#endif
+	} while (0);
+
+	if (r < 0) {
+		LOG_ERR("Unable to write compacted kvp file %s: %d", fname, r);
+		return r;
+	}
+
+	return 0;
+}
+
+/* Finish an encrypted compaction that was interrupted after its output was marked complete
+ * and remove output that wasn't (the original is still intact). If a replay fails, then the
+ * marker and journal are kept and the file can't be used until a replay succeeds.
+ * A cleartext file is replaced by a rename, so it is always intact.
+ */
+static int recover_compaction(const lcz_kvp_cfg_t *cfg, const char *fname)
+{
+#if defined(CONFIG_FSU_ENCRYPTED_FILES)
+	char journal[FSU_MAX_ABS_PATH_SIZE + 1];
+	char marker[FSU_MAX_ABS_PATH_SIZE + 1];
+	char *str = NULL;
+	ssize_t size = 0;
+	int r;
+
+	if (!cfg->encrypted ||
+	    compaction_path(journal, sizeof(journal), fname, COMPACT_JOURNAL_SUFFIX) < 0 ||
+	    compaction_path(marker, sizeof(marker), fname, COMPACT_COMMIT_SUFFIX) < 0) {
+		return 0;
+	}
+
+	k_mutex_lock(&kvp_log_lock, K_FOREVER);
+	do {
+		r = fsu_get_file_size_abs(journal);
+		if (r == -ENOENT) {
+			r = 0;
+			break;
+		}
+
+		if (fsu_get_file_size_abs(marker) == -ENOENT) {
+			LOG_WRN("Removing incomplete compaction of %s", fname);
+			r = fsu_delete_abs(journal);
+			break;
+		}
+
+		r = size = efs_get_file_size(journal);
+		if (r <= 0) {
+			r = (r < 0) ? r : -EINVAL;
+			break;
+		}
+
+		str = k_malloc(size);
+		if (str == NULL) {
+			r = -ENOMEM;
+			break;
+		}
+
+		r = efs_read(journal, str, size);
+		if (r != size) {
+			r = (r < 0) ? r : -EIO;
+			break;
+		}
+
+		r = efs_write(fname, str, size);
+		if (r >= 0) {
+			(void)fsu_delete_abs(marker);
+			(void)fsu_delete_abs(journal);
+			r = 0;
+		}
+		LOG_WRN("Replayed compaction of %s: %d", fname, r);
+	} while (0);
+	k_mutex_unlock(&kvp_log_lock);
+
+	if (str != NULL) {
+		memset(str, 0, size);
+		k_free(str);
+	}
+
+	return r;
+#else
+	ARG_UNUSED(cfg);
+	ARG_UNUSED(fname);
+	return 0;
+#endif
+}
+
+/* Called with kvp_log_lock held */
+static void compaction_done(const func_context_t *ctx, const char *fname)
+{
+	if (strlen(fname) < sizeof(compaction.last_path)) {
+		strcpy(compaction.last_path, fname);
+		compaction.last_size = MAX(ctx->get_size(fname), 0);
+	}
+}
+
+/* Only one file can be waiting for compaction. If another file needs to be compacted,
+ * then it is picked up by the next update after the current compaction completes.
+ */
+static void schedule_compaction(const lcz_kvp_cfg_t *cfg, const char *fname)
+{
+	if (strlen(fname) >= sizeof(compaction.abs_path)) {
+		return;
+	}
+
+	if (atomic_cas(&compaction.busy, 0, 1)) {
+		compaction.cfg = *cfg;
+		strcpy(compaction.abs_path, fname);
+		k_work_submit(&compaction_work);
+	}
+}
+
+static void compaction_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+	int r;
+
+	r = lcz_kvp_compact(&compaction.cfg, compaction.abs_path);
+	if (r < 0) {
+		LOG_ERR("Background compaction of %s failed: %d", compaction.abs_path, r);
+	}
+
+	atomic_clear(&compaction.busy);
+}
+
 static bool valid_cfg(const lcz_kvp_cfg_t *cfg)
 {
 	if (cfg == NULL) {
@@ -603,12 +1345,14 @@ static func_context_t get_func_context(bool encrypted)
 #if defined(CONFIG_FSU_ENCRYPTED_FILES)
 		ctx.get_size = efs_get_file_size;
 		ctx.read = efs_read;
+		ctx.read_block = efs_read_chunk;
 		ctx.write = efs_write;
 		ctx.append = efs_append;
 		ctx.msg = "encrypted";
 #else
 		ctx.get_size = NULL;
 		ctx.read = NULL;
+		ctx.read_block = NULL;
 		ctx.write = NULL;
 		ctx.append = NULL;
 		ctx.msg = "encrypted key-value pair files not supported";
@@ -617,6 +1361,7 @@ static func_context_t get_func_context(bool encrypted)
 	} else {
 		ctx.get_size = fsu_get_file_size_abs;
 		ctx.read = fsu_read_abs;
+		ctx.read_block = fsu_read_abs_block;
 		ctx.write = fsu_write_abs;
 		ctx.append = fsu_append_abs;
 		ctx.msg = "cleartext";
@@ -624,3 +1369,10 @@ static func_context_t get_func_context(bool encrypted)
 
 	return ctx;
 }
+
+#if defined(CONFIG_FSU_ENCRYPTED_FILES)
+static ssize_t efs_read_chunk(const char *abs_path, uint32_t offset, void *data, size_t size)
+{
+	return efs_read_block(abs_path, offset, data, size);
+}
+#endif
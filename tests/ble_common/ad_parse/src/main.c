@@ -0,0 +1,26 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "test_ad_parse.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_main(void)
+{
+	ztest_test_suite(ad_parse_test, ztest_unit_test(test_ad_parse_elements),
+			 ztest_unit_test(test_ad_parse_malformed),
+			 ztest_unit_test(test_ad_parse_max_elements),
+			 ztest_unit_test(test_ad_parse_match_table),
+			 ztest_unit_test(test_ad_parse_match_adv));
+	ztest_run_test_suite(ad_parse_test);
+}
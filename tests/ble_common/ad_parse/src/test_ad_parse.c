@@ -0,0 +1,375 @@
+/**
+ * @file test_ad_parse.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+#include <sys/byteorder.h>
+#include <bluetooth/bluetooth.h>
+#include "test_ad_parse.h"
+#include "ad_find.h"
+#include "lcz_sensor_adv_format.h"
+#include "lcz_sensor_adv_match.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define ADV_SIZE 64
+#define MAX_ELEMENTS CONFIG_LCZ_AD_PARSE_MAX_ELEMENTS
+
+#define LAIRD_ID1 LAIRD_CONNECTIVITY_MANUFACTURER_SPECIFIC_COMPANY_ID1
+#define LAIRD_ID2 LAIRD_CONNECTIVITY_MANUFACTURER_SPECIFIC_COMPANY_ID2
+#define LYNKZ_ID1 LYNKZ_INSTRUMENT_MANUFACTURER_SPECIFIC_COMPANY_ID1
+#define LYNKZ_ID2 LYNKZ_INSTRUMENT_MANUFACTURER_SPECIFIC_COMPANY_ID2
+
+#define ADV(count, ...)                                                        \
+	{ (const uint8_t[]){ __VA_ARGS__ },                                    \
+	  sizeof((const uint8_t[]){ __VA_ARGS__ }), count }
+
+#define FLAGS 0x02, BT_DATA_FLAGS, 0x06
+
+enum match_class { CLASS_1M = 0, CLASS_RSP, CLASS_CODED };
+
+struct adv_case {
+	const uint8_t *data;
+	size_t size;
+	size_t count;
+};
+
+/* A size of zero is any payload that contains the header */
+struct sensor_format {
+	uint16_t company_id;
+	uint16_t protocol_id;
+	uint8_t size;
+	enum match_class class;
+};
+
+struct header {
+	uint16_t company_id;
+	uint16_t protocol_id;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static uint8_t adv[ADV_SIZE];
+static AdTable_t table;
+
+static const struct adv_case malformed[] = {
+	ADV(1, FLAGS),
+	/* A zero length element ends the data */
+	ADV(0, 0x00),
+	ADV(0, 0x00, FLAGS),
+	ADV(1, FLAGS, 0x00, FLAGS),
+	/* An element without a type or without a value */
+	ADV(0, 0x01),
+	ADV(0, 0x01, BT_DATA_NAME_COMPLETE),
+	ADV(1, FLAGS, 0x01, BT_DATA_NAME_COMPLETE, FLAGS),
+	/* Lengths that run past the end */
+	ADV(0, 0x02),
+	ADV(0, 0x02, BT_DATA_FLAGS),
+	ADV(0, 0x03, BT_DATA_FLAGS, 0x06),
+	ADV(0, 0xFF, BT_DATA_FLAGS, 0x06),
+	ADV(1, FLAGS, 0x05, BT_DATA_MANUFACTURER_DATA, 0x77, 0x00, 0x01),
+	ADV(1, FLAGS, 0x04),
+	/* Elements that end at the end of the data */
+	ADV(2, FLAGS, 0x04, BT_DATA_MANUFACTURER_DATA, 0x77, 0x00, 0x01),
+	ADV(2, FLAGS, 0x02, BT_DATA_NAME_SHORTENED, 'a'),
+};
+
+static const struct sensor_format formats[] = {
+	{ LAIRD_ID1, BTXXX_1M_PHY_AD_PROTOCOL_ID,
+	  LCZ_SENSOR_MSD_AD_PAYLOAD_LENGTH, CLASS_1M },
+	{ LAIRD_ID1, BTXXX_CODED_PHY_AD_PROTOCOL_ID,
+	  LCZ_SENSOR_MSD_CODED_PAYLOAD_LENGTH, CLASS_CODED },
+	{ LAIRD_ID1, BTXXX_1M_PHY_RSP_PROTOCOL_ID,
+	  LCZ_SENSOR_MSD_RSP_PAYLOAD_LENGTH, CLASS_RSP },
+	{ LAIRD_ID2, BTXXX_1M_PHY_RSP_PROTOCOL_ID,
+	  LCZ_SENSOR_MSD_RSP_PAYLOAD_LENGTH, CLASS_RSP },
+	{ LAIRD_ID1, BTXXX_DM_1M_PHY_AD_PROTOCOL_ID,
+	  LCZ_SENSOR_MSD_DM_UNENCR_PAYLOAD_LENGTH, CLASS_1M },
+	{ LAIRD_ID1, BTXXX_DM_CODED_PHY_AD_PROTOCOL_ID,
+	  LCZ_SENSOR_MSD_DM_UNENCR_PAYLOAD_LENGTH, CLASS_CODED },
+	{ LAIRD_ID1, BTXXX_DM_ENC_CODED_PHY_AD_PROTOCOL_ID,
+	  LCZ_SENSOR_MSD_DM_ENCR_PAYLOAD_LENGTH, CLASS_CODED },
+	{ LYNKZ_ID1, LYNKZ_1M_PHY_AD_PROTOCOL_ID, 0, CLASS_1M },
+	{ LYNKZ_ID1, LYNKZ_1M_PHY_RSP_PROTOCOL_ID, 0, CLASS_RSP },
+};
+
+/* Headers below, between and above the entries of the match table */
+static const struct header unknown[] = {
+	{ 0x0000, 0x0000 },
+	{ LAIRD_ID1, RESERVED_AD_PROTOCOL_ID },
+	{ LAIRD_ID1, RS1XX_BOOTLOADER_AD_PROTOCOL_ID },
+	{ LAIRD_ID1, RS1XX_SENSOR_AD_PROTOCOL_ID },
+	{ LAIRD_ID1, BTXXX_DM_1M_PHY_RSP_PROTOCOL_ID },
+	{ LAIRD_ID1, CT_TRACKER_AD_PROTOCOL_ID },
+	{ LAIRD_ID2, BTXXX_1M_PHY_AD_PROTOCOL_ID },
+	{ LAIRD_ID2, BTXXX_CODED_PHY_AD_PROTOCOL_ID },
+	{ LYNKZ_ID1, BTXXX_1M_PHY_AD_PROTOCOL_ID },
+	{ LYNKZ_ID2, LYNKZ_1M_PHY_AD_PROTOCOL_ID },
+	{ LYNKZ_ID2, LYNKZ_1M_PHY_RSP_PROTOCOL_ID },
+	{ BTXXX_1M_PHY_AD_PROTOCOL_ID, LAIRD_ID1 },
+	{ 0xFFFF, 0xFFFF },
+};
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static size_t parse(const uint8_t *data, size_t size);
+static AdHandle_t msd(uint16_t company_id, uint16_t protocol_id, size_t size);
+static uint16_t expected_id(const struct sensor_format *format, size_t size,
+			    bool match_1m, bool match_rsp, bool match_coded);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_ad_parse_elements(void)
+{
+	static const uint8_t data[] = {
+		FLAGS,
+		0x05, BT_DATA_NAME_COMPLETE, 'a', 'b', 'c', 'd',
+		0x05, BT_DATA_MANUFACTURER_DATA, 0x77, 0x00, 0x01, 0x00,
+		0x02, 0x00, 0xAA,
+	};
+	AdHandle_t handle;
+
+	zassert_equal(parse(data, sizeof(data)), 4, "Unexpected count");
+	zassert_equal(table.elements[0].type, BT_DATA_FLAGS, "Unexpected type");
+	zassert_equal(table.elements[0].size, 1, "Unexpected size");
+	zassert_equal_ptr(table.elements[0].pPayload, &adv[2],
+			  "Unexpected payload");
+	zassert_equal(table.elements[1].type, BT_DATA_NAME_COMPLETE,
+		      "Unexpected type");
+	zassert_equal(table.elements[1].size, 4, "Unexpected size");
+	zassert_equal_ptr(table.elements[1].pPayload, &adv[5],
+			  "Unexpected payload");
+
+	/* The first of the two types */
+	handle = ad_parse_find(&table, BT_DATA_NAME_SHORTENED,
+			       BT_DATA_NAME_COMPLETE);
+	zassert_equal_ptr(handle.pPayload, &adv[5], "Name not found");
+	zassert_equal(handle.size, 4, "Unexpected size");
+	handle = ad_parse_find(&table, BT_DATA_MANUFACTURER_DATA,
+			       BT_DATA_INVALID);
+	zassert_equal_ptr(handle.pPayload, &adv[11], "MSD not found");
+	zassert_equal(handle.size, 4, "Unexpected size");
+
+	/* A type of zero is never found */
+	handle = ad_parse_find(&table, BT_DATA_INVALID, BT_DATA_INVALID);
+	zassert_is_null(handle.pPayload, "Invalid type found");
+	zassert_equal(handle.size, 0, "Unexpected size");
+	handle = ad_parse_find(&table, BT_DATA_TX_POWER, BT_DATA_INVALID);
+	zassert_is_null(handle.pPayload, "Missing type found");
+	zassert_equal(handle.size, 0, "Unexpected size");
+
+	/* The table is the same as a walk of the advertisement */
+	handle = AdFind_Type(adv, sizeof(data), BT_DATA_MANUFACTURER_DATA,
+			     BT_DATA_INVALID);
+	zassert_equal_ptr(handle.pPayload, &adv[11], "MSD not found");
+
+	zassert_equal(parse(data, 0), 0, "Unexpected count");
+}
+
+void test_ad_parse_malformed(void)
+{
+	size_t i;
+	size_t j;
+
+	for (i = 0; i < ARRAY_SIZE(malformed); i++) {
+		zassert_equal(parse(malformed[i].data, malformed[i].size),
+			      malformed[i].count, "Unexpected count case %u",
+			      (unsigned int)i);
+
+		/* Each payload is inside the advertisement */
+		for (j = 0; j < table.count; j++) {
+			zassert_true(table.elements[j].size >= 1,
+				     "Empty element case %u", (unsigned int)i);
+			zassert_true(table.elements[j].pPayload >= &adv[2],
+				     "Payload before data case %u",
+				     (unsigned int)i);
+			zassert_true((table.elements[j].pPayload +
+				      table.elements[j].size) <=
+					     &adv[malformed[i].size],
+				     "Payload past end case %u",
+				     (unsigned int)i);
+		}
+	}
+}
+
+void test_ad_parse_max_elements(void)
+{
+	uint8_t data[3 * (MAX_ELEMENTS + 1)];
+	AdHandle_t handle;
+	size_t i;
+
+	/* The last element is past the end of the table */
+	for (i = 0; i <= MAX_ELEMENTS; i++) {
+		data[3 * i] = 0x02;
+		data[(3 * i) + 1] = BT_DATA_FLAGS;
+		data[(3 * i) + 2] = i;
+	}
+	data[(3 * MAX_ELEMENTS) + 1] = BT_DATA_TX_POWER;
+
+	zassert_equal(parse(data, sizeof(data) - 3), MAX_ELEMENTS,
+		      "Unexpected count");
+	zassert_equal(parse(data, sizeof(data)), MAX_ELEMENTS,
+		      "Unexpected count");
+	zassert_equal(*table.elements[MAX_ELEMENTS - 1].pPayload,
+		      MAX_ELEMENTS - 1, "Unexpected payload");
+	handle = ad_parse_find(&table, BT_DATA_TX_POWER, BT_DATA_INVALID);
+	zassert_is_null(handle.pPayload, "Ignored element found");
+}
+
+void test_ad_parse_match_table(void)
+{
+	const struct sensor_format *format;
+	AdHandle_t handle;
+	uint16_t expected;
+	size_t size;
+	size_t i;
+
+	/* Only the exact size of each format matches */
+	for (i = 0; i < ARRAY_SIZE(formats); i++) {
+		format = &formats[i];
+		for (size = 0; size < ADV_SIZE; size++) {
+			handle = msd(format->company_id, format->protocol_id,
+				     size);
+
+			expected = expected_id(format, size, true, false, false);
+			zassert_equal(lcz_sensor_adv_match_msd(&handle, false,
+							       false),
+				      expected, "Format %u size %u",
+				      (unsigned int)i, (unsigned int)size);
+			expected = expected_id(format, size, true, true, false);
+			zassert_equal(lcz_sensor_adv_match_msd(&handle, true,
+							       false),
+				      expected, "Format %u size %u rsp",
+				      (unsigned int)i, (unsigned int)size);
+			expected = expected_id(format, size, true, false, true);
+			zassert_equal(lcz_sensor_adv_match_msd(&handle, false,
+							       true),
+				      expected, "Format %u size %u coded",
+				      (unsigned int)i, (unsigned int)size);
+
+			expected = expected_id(format, size, true, false, false);
+			zassert_equal(lcz_sensor_adv_match_1m(&handle),
+				      expected, "Format %u size %u 1M",
+				      (unsigned int)i, (unsigned int)size);
+			expected = expected_id(format, size, false, true, false);
+			zassert_equal(lcz_sensor_adv_match_rsp(&handle),
+				      expected, "Format %u size %u rsp only",
+				      (unsigned int)i, (unsigned int)size);
+			expected = expected_id(format, size, false, false, true);
+			zassert_equal(lcz_sensor_adv_match_coded(&handle),
+				      expected, "Format %u size %u coded only",
+				      (unsigned int)i, (unsigned int)size);
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(unknown); i++) {
+		for (size = 0; size < ADV_SIZE; size++) {
+			handle = msd(unknown[i].company_id,
+				     unknown[i].protocol_id, size);
+			zassert_equal(lcz_sensor_adv_match_msd(&handle, true,
+							       true),
+				      RESERVED_AD_PROTOCOL_ID,
+				      "Unknown header %u size %u matched",
+				      (unsigned int)i, (unsigned int)size);
+		}
+	}
+
+	handle.pPayload = NULL;
+	handle.size = LCZ_SENSOR_MSD_AD_PAYLOAD_LENGTH;
+	zassert_equal(lcz_sensor_adv_match_msd(&handle, true, true),
+		      RESERVED_AD_PROTOCOL_ID, "Missing payload matched");
+}
+
+void test_ad_parse_match_adv(void)
+{
+	struct net_buf_simple ad;
+	AdHandle_t handle;
+	size_t size;
+
+	/* Flags and a 1M sensor advertisement fill a legacy advertisement */
+	memset(adv, 0, sizeof(adv));
+	adv[0] = 0x02;
+	adv[1] = BT_DATA_FLAGS;
+	adv[2] = 0x06;
+	adv[3] = LCZ_SENSOR_MSD_AD_FIELD_LENGTH;
+	adv[4] = BT_DATA_MANUFACTURER_DATA;
+	sys_put_le16(LAIRD_ID1, &adv[5]);
+	sys_put_le16(BTXXX_1M_PHY_AD_PROTOCOL_ID, &adv[7]);
+	size = 4 + LCZ_SENSOR_MSD_AD_FIELD_LENGTH;
+	zassert_equal(size, 31, "Unexpected advertisement size");
+
+	net_buf_simple_init_with_data(&ad, adv, size);
+	zassert_equal(lcz_sensor_adv_match(&ad, false, false),
+		      BTXXX_1M_PHY_AD_PROTOCOL_ID, "Advertisement not matched");
+	zassert_equal(ad_parse(adv, size, &table), 2, "Unexpected count");
+	handle = ad_parse_find(&table, BT_DATA_MANUFACTURER_DATA,
+			       BT_DATA_INVALID);
+	zassert_equal(lcz_sensor_adv_match_msd(&handle, false, false),
+		      BTXXX_1M_PHY_AD_PROTOCOL_ID, "Advertisement not matched");
+
+	/* Neither matches when the data ends inside the element */
+	net_buf_simple_init_with_data(&ad, adv, size - 1);
+	zassert_equal(lcz_sensor_adv_match(&ad, false, false),
+		      RESERVED_AD_PROTOCOL_ID, "Truncated advertisement matched");
+	zassert_equal(ad_parse(adv, size - 1, &table), 1, "Unexpected count");
+	handle = ad_parse_find(&table, BT_DATA_MANUFACTURER_DATA,
+			       BT_DATA_INVALID);
+	zassert_equal(lcz_sensor_adv_match_msd(&handle, false, false),
+		      RESERVED_AD_PROTOCOL_ID, "Truncated advertisement matched");
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* The table is filled with garbage first so that stale elements are found */
+static size_t parse(const uint8_t *data, size_t size)
+{
+	memset(&table, 0xA5, sizeof(table));
+	memset(adv, 0, sizeof(adv));
+	memcpy(adv, data, size);
+
+	return ad_parse(adv, size, &table);
+}
+
+static AdHandle_t msd(uint16_t company_id, uint16_t protocol_id, size_t size)
+{
+	AdHandle_t handle = { adv, size };
+
+	memset(adv, 0, sizeof(adv));
+	sys_put_le16(company_id, &adv[0]);
+	sys_put_le16(protocol_id, &adv[2]);
+
+	return handle;
+}
+
+static uint16_t expected_id(const struct sensor_format *format, size_t size,
+			    bool match_1m, bool match_rsp, bool match_coded)
+{
+	if (size < LCZ_SENSOR_AD_HEADER_SIZE) {
+		return RESERVED_AD_PROTOCOL_ID;
+	}
+
+	if (format->size != 0 && format->size != size) {
+		return RESERVED_AD_PROTOCOL_ID;
+	}
+
+	if ((format->class == CLASS_1M && match_1m) ||
+	    (format->class == CLASS_RSP && match_rsp) ||
+	    (format->class == CLASS_CODED && match_coded)) {
+		return format->protocol_id;
+	}
+
+	return RESERVED_AD_PROTOCOL_ID;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file test_ad_parse.h
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __TEST_AD_PARSE_H__
+#define __TEST_AD_PARSE_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/util.h>
+#include <ztest.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+void test_ad_parse_elements(void);
+void test_ad_parse_malformed(void);
+void test_ad_parse_max_elements(void);
+void test_ad_parse_match_table(void);
+void test_ad_parse_match_adv(void);
+
+#endif /* __TEST_AD_PARSE_H__ */
@@ -0,0 +1,26 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "test_lcz_bt_scan_dedup.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_main(void)
+{
+	ztest_test_suite(lcz_bt_scan_dedup_test,
+			 ztest_unit_test(test_lcz_bt_scan_dedup_repeat),
+			 ztest_unit_test(test_lcz_bt_scan_dedup_rssi),
+			 ztest_unit_test(test_lcz_bt_scan_dedup_record_id),
+			 ztest_unit_test(test_lcz_bt_scan_dedup_eviction));
+	ztest_run_test_suite(lcz_bt_scan_dedup_test);
+}
@@ -0,0 +1,382 @@
+/**
+ * @file test_lcz_bt_scan_dedup.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+#include <bluetooth/bluetooth.h>
+#include <net/buf.h>
+#include "test_lcz_bt_scan_dedup.h"
+#include "lcz_bt_scan.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define TIMEOUT CONFIG_LCZ_BT_SCAN_DEDUP_TIMEOUT_MS
+#define WAYS CONFIG_LCZ_BT_SCAN_DEDUP_WAYS
+
+/* Each advertisement in the eviction test is seen at a different time */
+#define SPACING_MS 20
+
+#define COMPANY_A 0x0077
+#define COMPANY_B 0x00E4
+#define PROTOCOL 0x0001
+#define RSSI -60
+
+#define ADDR_1 1
+#define ADDR_2 2
+
+/* The record ID is the two bytes after the protocol ID */
+#define ID_OFFSET 4
+#define ID_SIZE 2
+
+enum users {
+	/* Record ID with an RSSI change of 5 */
+	USER_ID_5 = 0,
+	/* Record ID with an RSSI change of 10 */
+	USER_ID_10,
+	/* No duplicate cache */
+	USER_ALL,
+	/* Whole manufacturer specific data from COMPANY_B only */
+	USER_MSD,
+	USERS
+};
+
+struct received {
+	int count;
+	bool duplicate;
+};
+
+BUILD_ASSERT(USERS <= CONFIG_LCZ_BT_SCAN_MAX_USERS, "Not enough users");
+BUILD_ASSERT((2 * sizeof(uint16_t)) >= CONFIG_LCZ_BT_SCAN_DEDUP_ID_SIZE,
+	     "Whole MSD record ID must be longer than the cache keeps");
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const uint16_t company_b[] = { COMPANY_B };
+
+static const struct lcz_bt_scan_filter filters[USERS] = {
+	[USER_ID_5] = { .dedup = true,
+			.dedup_id_offset = ID_OFFSET,
+			.dedup_id_size = ID_SIZE,
+			.dedup_rssi_delta = 5 },
+	[USER_ID_10] = { .dedup = true,
+			 .dedup_id_offset = ID_OFFSET,
+			 .dedup_id_size = ID_SIZE,
+			 .dedup_rssi_delta = 10 },
+	[USER_ALL] = { .dedup = false },
+	[USER_MSD] = { .company_ids = company_b,
+		       .num_company_ids = ARRAY_SIZE(company_b),
+		       .dedup = true,
+		       .dedup_id_size = 0 },
+};
+
+static bt_le_scan_cb_t *scan_cb;
+static struct received received[USERS];
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void reset(void);
+static void deliver(const uint8_t *data, size_t size, uint8_t addr,
+		    int8_t rssi);
+static void msd(uint16_t company, uint16_t protocol, uint16_t id,
+		uint8_t extra, uint8_t addr, int8_t rssi);
+static void expect(int id_5, int id_10, int all, int whole_msd);
+static void receive(enum users user, const struct lcz_bt_scan_adv *adv);
+static void receive_id_5(const struct lcz_bt_scan_adv *adv);
+static void receive_id_10(const struct lcz_bt_scan_adv *adv);
+static void receive_all(const struct lcz_bt_scan_adv *adv);
+static void receive_msd(const struct lcz_bt_scan_adv *adv);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+/* Replace the Bluetooth host so that the test gives the advertisements */
+int bt_le_scan_start(const struct bt_le_scan_param *param, bt_le_scan_cb_t cb)
+{
+	ARG_UNUSED(param);
+
+	scan_cb = cb;
+	return 0;
+}
+
+int bt_le_scan_stop(void)
+{
+	return 0;
+}
+
+void test_lcz_bt_scan_dedup_repeat(void)
+{
+	uint32_t duplicates;
+
+	reset();
+	duplicates = lcz_bt_scan_get_num_duplicates();
+
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	zassert_false(received[USER_ID_5].duplicate, "First marked duplicate");
+	expect(1, 1, 1, 0);
+
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	expect(0, 0, 1, 0);
+	zassert_equal(lcz_bt_scan_get_num_duplicates(), duplicates + 2,
+		      "Unexpected duplicate count");
+
+	/* Only the record ID is compared */
+	msd(COMPANY_A, PROTOCOL, 1, 1, ADDR_1, RSSI);
+	expect(0, 0, 1, 0);
+
+	/* Any byte of the record ID, the address or the protocol ID */
+	msd(COMPANY_A, PROTOCOL, 0x0100, 0, ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_2, RSSI);
+	expect(1, 1, 1, 0);
+	msd(COMPANY_A, PROTOCOL + 1, 1, 0, ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+
+	/* The timeout starts with the first copy */
+	k_sleep(K_MSEC(TIMEOUT));
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	zassert_false(received[USER_ID_5].duplicate,
+		      "Expired repeat marked duplicate");
+	expect(1, 1, 1, 0);
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	expect(0, 0, 1, 0);
+}
+
+void test_lcz_bt_scan_dedup_rssi(void)
+{
+	reset();
+
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI + 4);
+	expect(0, 0, 1, 0);
+
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI + 5);
+	zassert_true(received[USER_ID_5].duplicate, "Repeat not marked");
+	expect(1, 0, 1, 0);
+
+	/* The second user's change is from the RSSI it was last given */
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI + 10);
+	zassert_true(received[USER_ID_5].duplicate, "Repeat not marked");
+	zassert_true(received[USER_ID_10].duplicate, "Repeat not marked");
+	expect(1, 1, 1, 0);
+
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI + 15);
+	expect(1, 0, 1, 0);
+
+	/* Either direction */
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI + 1);
+	expect(0, 0, 1, 0);
+}
+
+void test_lcz_bt_scan_dedup_record_id(void)
+{
+	/* MSD is 5 bytes, too short for the record ID */
+	static const uint8_t short_msd[] = { 2,
+					     BT_DATA_FLAGS,
+					     BT_LE_AD_NO_BREDR,
+					     6,
+					     BT_DATA_MANUFACTURER_DATA,
+					     (uint8_t)COMPANY_A,
+					     (uint8_t)(COMPANY_A >> 8),
+					     (uint8_t)PROTOCOL,
+					     (uint8_t)(PROTOCOL >> 8),
+					     0x01 };
+	static const uint8_t name[] = {
+		2, BT_DATA_FLAGS, BT_LE_AD_NO_BREDR,
+		5, BT_DATA_NAME_COMPLETE, 't', 'e', 's', 't'
+	};
+	static const uint8_t other_name[] = {
+		2, BT_DATA_FLAGS, BT_LE_AD_NO_BREDR,
+		5, BT_DATA_NAME_COMPLETE, 't', 'e', 's', 'u'
+	};
+
+	reset();
+
+	/* The whole MSD is longer than the cache keeps, the bytes that
+	 * differ are only in the hash.
+	 */
+	msd(COMPANY_B, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	expect(1, 1, 1, 1);
+	msd(COMPANY_B, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	expect(0, 0, 1, 0);
+	msd(COMPANY_B, PROTOCOL, 1, 1, ADDR_1, RSSI);
+	expect(0, 0, 1, 1);
+	msd(COMPANY_B, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	expect(0, 0, 1, 0);
+
+	/* Record IDs that aren't there are never duplicates */
+	deliver(short_msd, sizeof(short_msd), ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+	deliver(short_msd, sizeof(short_msd), ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+
+	/* Without MSD the whole advertisement is the record ID */
+	deliver(name, sizeof(name), ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+	deliver(name, sizeof(name), ADDR_1, RSSI);
+	expect(0, 0, 1, 0);
+	deliver(other_name, sizeof(other_name), ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+}
+
+void test_lcz_bt_scan_dedup_eviction(void)
+{
+	uint16_t id;
+
+	reset();
+
+	/* Fill the bucket */
+	for (id = 0; id < WAYS; id++) {
+		msd(COMPANY_A, PROTOCOL, id, 0, ADDR_1, RSSI);
+		expect(1, 1, 1, 0);
+		k_sleep(K_MSEC(SPACING_MS));
+	}
+
+	/* A repeat makes the first entry the most recently seen */
+	msd(COMPANY_A, PROTOCOL, 0, 0, ADDR_1, RSSI);
+	expect(0, 0, 1, 0);
+	k_sleep(K_MSEC(SPACING_MS));
+
+	/* Replaces the second entry */
+	msd(COMPANY_A, PROTOCOL, WAYS, 0, ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+	k_sleep(K_MSEC(SPACING_MS));
+
+	msd(COMPANY_A, PROTOCOL, 0, 0, ADDR_1, RSSI);
+	expect(0, 0, 1, 0);
+	k_sleep(K_MSEC(SPACING_MS));
+
+	msd(COMPANY_A, PROTOCOL, WAYS, 0, ADDR_1, RSSI);
+	expect(0, 0, 1, 0);
+	k_sleep(K_MSEC(SPACING_MS));
+
+	/* The replaced entry is given again and replaces the third */
+	msd(COMPANY_A, PROTOCOL, 1, 0, ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+	k_sleep(K_MSEC(SPACING_MS));
+
+	for (id = 3; id < WAYS; id++) {
+		msd(COMPANY_A, PROTOCOL, id, 0, ADDR_1, RSSI);
+		expect(0, 0, 1, 0);
+	}
+
+	msd(COMPANY_A, PROTOCOL, 2, 0, ADDR_1, RSSI);
+	expect(1, 1, 1, 0);
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* Users can't be removed so they are registered once. Waiting for the
+ * timeout empties the cache.
+ */
+static void reset(void)
+{
+	static lcz_bt_scan_adv_cb_t *const callbacks[USERS] = {
+		receive_id_5, receive_id_10, receive_all, receive_msd
+	};
+	static bool registered;
+	int id;
+	size_t i;
+
+	if (!registered) {
+		for (i = 0; i < USERS; i++) {
+			zassert_true(lcz_bt_scan_register_filtered(
+					     &id, callbacks[i], &filters[i]),
+				     "Register failed");
+			zassert_equal(id, i, "Unexpected user ID");
+			zassert_equal(lcz_bt_scan_start(id), 0,
+				      "Start failed");
+		}
+		registered = true;
+	}
+	zassert_not_null(scan_cb, "Scanning not started");
+
+	k_sleep(K_MSEC(TIMEOUT));
+	memset(received, 0, sizeof(received));
+}
+
+static void deliver(const uint8_t *data, size_t size, uint8_t addr,
+		    int8_t rssi)
+{
+	bt_addr_le_t le_addr = { .type = BT_ADDR_LE_RANDOM };
+	struct net_buf_simple ad;
+
+	le_addr.a.val[0] = addr;
+	net_buf_simple_init_with_data(&ad, (void *)data, size);
+	scan_cb(&le_addr, rssi, BT_GAP_ADV_TYPE_ADV_IND, &ad);
+}
+
+/* The byte after the record ID isn't part of it */
+static void msd(uint16_t company, uint16_t protocol, uint16_t id,
+		uint8_t extra, uint8_t addr, int8_t rssi)
+{
+	const uint8_t data[] = { 2,
+				 BT_DATA_FLAGS,
+				 BT_LE_AD_NO_BREDR,
+				 8,
+				 BT_DATA_MANUFACTURER_DATA,
+				 (uint8_t)company,
+				 (uint8_t)(company >> 8),
+				 (uint8_t)protocol,
+				 (uint8_t)(protocol >> 8),
+				 (uint8_t)id,
+				 (uint8_t)(id >> 8),
+				 extra };
+
+	deliver(data, sizeof(data), addr, rssi);
+}
+
+/* Number of advertisements each user was given since the last check */
+static void expect(int id_5, int id_10, int all, int whole_msd)
+{
+	const int counts[USERS] = { id_5, id_10, all, whole_msd };
+	size_t i;
+
+	for (i = 0; i < USERS; i++) {
+		zassert_equal(received[i].count, counts[i],
+			      "User %u given %d expected %d", (unsigned int)i,
+			      received[i].count, counts[i]);
+	}
+	memset(received, 0, sizeof(received));
+}
+
+static void receive(enum users user, const struct lcz_bt_scan_adv *adv)
+{
+	received[user].count += 1;
+	received[user].duplicate = adv->duplicate;
+}
+
+static void receive_id_5(const struct lcz_bt_scan_adv *adv)
+{
+	receive(USER_ID_5, adv);
+}
+
+static void receive_id_10(const struct lcz_bt_scan_adv *adv)
+{
+	receive(USER_ID_10, adv);
+}
+
+static void receive_all(const struct lcz_bt_scan_adv *adv)
+{
+	receive(USER_ALL, adv);
+}
+
+static void receive_msd(const struct lcz_bt_scan_adv *adv)
+{
+	receive(USER_MSD, adv);
+}
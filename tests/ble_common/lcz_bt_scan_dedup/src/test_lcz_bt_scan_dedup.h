@@ -0,0 +1,27 @@
+/**
+ * @file test_lcz_bt_scan_dedup.h
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __TEST_LCZ_BT_SCAN_DEDUP_H__
+#define __TEST_LCZ_BT_SCAN_DEDUP_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/util.h>
+#include <ztest.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+void test_lcz_bt_scan_dedup_repeat(void);
+void test_lcz_bt_scan_dedup_rssi(void);
+void test_lcz_bt_scan_dedup_record_id(void);
+void test_lcz_bt_scan_dedup_eviction(void);
+
+#endif /* __TEST_LCZ_BT_SCAN_DEDUP_H__ */
@@ -0,0 +1,26 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "test_lcz_no_init_ram_ring.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_main(void)
+{
+	ztest_test_suite(lcz_no_init_ram_ring_test,
+			 ztest_unit_test(test_lcz_no_init_ram_ring_put_get),
+			 ztest_unit_test(test_lcz_no_init_ram_ring_batch),
+			 ztest_unit_test(test_lcz_no_init_ram_ring_recover),
+			 ztest_unit_test(test_lcz_no_init_ram_ring_corrupt));
+	ztest_run_test_suite(lcz_no_init_ram_ring_test);
+}
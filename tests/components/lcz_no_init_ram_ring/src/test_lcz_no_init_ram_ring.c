@@ -0,0 +1,196 @@
+/**
+ * @file test_lcz_no_init_ram_ring.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+#include "test_lcz_no_init_ram_ring.h"
+#include "lcz_no_init_ram_ring.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define DATA_SIZE 128
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static uint8_t mem[LCZ_NO_INIT_RAM_RING_MEM_SIZE(DATA_SIZE)] __aligned(4);
+static struct lcz_no_init_ram_ring ring;
+static uint8_t buf[DATA_SIZE];
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void fresh(void);
+static void record(uint8_t *dest, uint8_t id, size_t length);
+static void check_get(uint8_t id, size_t length);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_lcz_no_init_ram_ring_put_get(void)
+{
+	uint8_t rec[32];
+	int i;
+
+	fresh();
+
+	zassert_equal(lcz_no_init_ram_ring_get(&ring, buf, sizeof(buf)), -ENODATA,
+		      "Empty ring returned data");
+	zassert_equal(lcz_no_init_ram_ring_put(&ring, rec, 0), -EINVAL,
+		      "Empty record allowed");
+	zassert_equal(lcz_no_init_ram_ring_put(&ring, buf, DATA_SIZE), -EINVAL,
+		      "Record larger than ring allowed");
+
+	/* 5 byte records use 12 bytes so the ring wraps part way through one */
+	for (i = 0; i < 40; i++) {
+		record(rec, i, 5);
+		if (lcz_no_init_ram_ring_put(&ring, rec, 5) == -ENOSPC) {
+			check_get(i - lcz_no_init_ram_ring_count(&ring), 5);
+			zassert_equal(lcz_no_init_ram_ring_put(&ring, rec, 5), 0,
+				      "Put failed after get");
+		}
+	}
+
+	zassert_equal(lcz_no_init_ram_ring_count(&ring), DATA_SIZE / 12,
+		      "Unexpected count");
+	zassert_equal(lcz_no_init_ram_ring_get(&ring, buf, 4), -ENOMEM,
+		      "Short buffer allowed");
+	for (i = 40 - (DATA_SIZE / 12); i < 40; i++) {
+		check_get(i, 5);
+	}
+	zassert_equal(lcz_no_init_ram_ring_used(&ring), 0, "Ring not empty");
+}
+
+void test_lcz_no_init_ram_ring_batch(void)
+{
+	struct lcz_no_init_ram_ring_cursor cursor = { 0 };
+	uint8_t rec[16];
+	int i;
+
+	fresh();
+
+	for (i = 0; i < 4; i++) {
+		record(rec, i, 16);
+		zassert_equal(lcz_no_init_ram_ring_put(&ring, rec, 16), 0,
+			      "Put failed");
+	}
+
+	/* Read a batch of two, then remove only those */
+	zassert_equal(lcz_no_init_ram_ring_peek(&ring, &cursor, buf, sizeof(buf)),
+		      16, "Peek failed");
+	zassert_equal(lcz_no_init_ram_ring_peek(&ring, &cursor, buf, sizeof(buf)),
+		      16, "Peek failed");
+	zassert_equal(lcz_no_init_ram_ring_count(&ring), 4,
+		      "Peek removed records");
+	lcz_no_init_ram_ring_consume(&ring, &cursor);
+	zassert_equal(lcz_no_init_ram_ring_count(&ring), 2, "Consume failed");
+
+	check_get(2, 16);
+	check_get(3, 16);
+}
+
+void test_lcz_no_init_ram_ring_recover(void)
+{
+	uint8_t rec[20];
+	int i;
+
+	fresh();
+
+	/* Move the tail so that recovered records wrap */
+	for (i = 0; i < 3; i++) {
+		record(rec, i, 20);
+		zassert_equal(lcz_no_init_ram_ring_put(&ring, rec, 20), 0,
+			      "Put failed");
+	}
+	check_get(0, 20);
+	check_get(1, 20);
+	for (i = 3; i < 6; i++) {
+		record(rec, i, 20);
+		zassert_equal(lcz_no_init_ram_ring_put(&ring, rec, 20), 0,
+			      "Put failed");
+	}
+
+	/* Warm reset */
+	zassert_equal(lcz_no_init_ram_ring_init(&ring, mem, sizeof(mem)), 4,
+		      "Records not recovered");
+	for (i = 2; i < 6; i++) {
+		check_get(i, 20);
+	}
+
+	/* Losing one control block falls back to the other */
+	record(rec, 6, 20);
+	zassert_equal(lcz_no_init_ram_ring_put(&ring, rec, 20), 0, "Put failed");
+	record(rec, 7, 20);
+	zassert_equal(lcz_no_init_ram_ring_put(&ring, rec, 20), 0, "Put failed");
+	ring.ctrl[ring.state.seq % 2].header.crc ^= 1;
+	zassert_equal(lcz_no_init_ram_ring_init(&ring, mem, sizeof(mem)), 1,
+		      "Previous control block not used");
+	check_get(6, 20);
+}
+
+void test_lcz_no_init_ram_ring_corrupt(void)
+{
+	uint8_t rec[8];
+	int i;
+
+	fresh();
+
+	for (i = 0; i < 4; i++) {
+		record(rec, i, 8);
+		zassert_equal(lcz_no_init_ram_ring_put(&ring, rec, 8), 0,
+			      "Put failed");
+	}
+
+	/* Corrupt the third record, the ring is truncated before it */
+	ring.data[(2 * 12) + LCZ_NO_INIT_RAM_RING_RECORD_HEADER_SIZE] ^= 0xFF;
+	zassert_equal(lcz_no_init_ram_ring_init(&ring, mem, sizeof(mem)), 2,
+		      "Corrupt record recovered");
+	check_get(0, 8);
+	check_get(1, 8);
+	zassert_equal(lcz_no_init_ram_ring_get(&ring, buf, sizeof(buf)), -ENODATA,
+		      "Corrupt record returned");
+
+	/* Power on reset */
+	memset(mem, 0xA5, sizeof(mem));
+	zassert_equal(lcz_no_init_ram_ring_init(&ring, mem, sizeof(mem)), 0,
+		      "Records found in random memory");
+	zassert_equal(lcz_no_init_ram_ring_used(&ring), 0, "Ring not empty");
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void fresh(void)
+{
+	memset(mem, 0, sizeof(mem));
+	zassert_equal(lcz_no_init_ram_ring_init(&ring, mem, sizeof(mem)), 0,
+		      "Init failed");
+}
+
+static void record(uint8_t *dest, uint8_t id, size_t length)
+{
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		dest[i] = id + i;
+	}
+}
+
+static void check_get(uint8_t id, size_t length)
+{
+	uint8_t expected[DATA_SIZE];
+
+	record(expected, id, length);
+	zassert_equal(lcz_no_init_ram_ring_get(&ring, buf, sizeof(buf)), length,
+		      "Unexpected length");
+	zassert_mem_equal(buf, expected, length, "Unexpected record %u", id);
+}
@@ -0,0 +1,27 @@
+/**
+ * @file test_lcz_no_init_ram_ring.h
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __TEST_LCZ_NO_INIT_RAM_RING_H__
+#define __TEST_LCZ_NO_INIT_RAM_RING_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/util.h>
+#include <ztest.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+void test_lcz_no_init_ram_ring_put_get(void);
+void test_lcz_no_init_ram_ring_batch(void);
+void test_lcz_no_init_ram_ring_recover(void);
+void test_lcz_no_init_ram_ring_corrupt(void);
+
+#endif /* __TEST_LCZ_NO_INIT_RAM_RING_H__ */
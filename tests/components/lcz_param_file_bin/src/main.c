@@ -0,0 +1,28 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "test_lcz_param_file_bin.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_main(void)
+{
+	ztest_test_suite(lcz_param_file_bin_test,
+			 ztest_unit_test(test_lcz_param_file_bin_generate),
+			 ztest_unit_test(test_lcz_param_file_bin_header),
+			 ztest_unit_test(test_lcz_param_file_bin_truncated),
+			 ztest_unit_test(test_lcz_param_file_bin_items),
+			 ztest_unit_test(test_lcz_param_file_bin_max_value),
+			 ztest_unit_test(test_lcz_param_file_bin_parse));
+	ztest_run_test_suite(lcz_param_file_bin_test);
+}
@@ -0,0 +1,349 @@
+/**
+ * @file test_lcz_param_file_bin.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include <fs/fs.h>
+#include "test_lcz_param_file_bin.h"
+#include "file_system_utilities.h"
+#include "lcz_param_file.h"
+#include "lcz_ramdisk.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define MNT "/tmp"
+#define PARAM_FILE MNT "/params.bin"
+#define MAX_VALUE CONFIG_LCZ_PARAM_FILE_MAX_VALUE_LENGTH
+#define FILE_SIZE 256
+
+#define MAGIC 0xD9, 0xD9, 0xF7
+/* Map with a count of one, as written by lcz_param_file_generate_bin */
+#define MAP_1 MAGIC, 0xB9, 0x00, 0x01
+
+#define MAJOR_BSTR 2
+#define MAJOR_TSTR 3
+
+#define BIN(result, ...)                                                       \
+	{ (const uint8_t[]){ __VA_ARGS__ },                                    \
+	  sizeof((const uint8_t[]){ __VA_ARGS__ }), result }
+
+struct bin_case {
+	const uint8_t *data;
+	size_t size;
+	int result;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static struct fs_mount_t mnt = { .type = LCZ_RAMDISK_FS_TYPE,
+				 .mnt_point = MNT };
+
+static uint8_t file[FILE_SIZE];
+static const uint8_t bin_value[] = { 0x0A, 0x00 };
+static const char str_value[] = "Laird Connectivity";
+
+static const struct bin_case headers[] = {
+	BIN(0, MAGIC, 0xB9, 0x00, 0x00),
+	BIN(0, MAGIC, 0xBA, 0x00, 0x00, 0x00, 0x00),
+	/* Magic */
+	BIN(-EINVAL, 0xD9, 0xD9, 0xF6, 0xB9, 0x00, 0x00),
+	BIN(-EINVAL, 0xF7, 0xD9, 0xD9, 0xB9, 0x00, 0x00),
+	/* Shorter than a header */
+	BIN(-EINVAL, MAGIC, 0xB9, 0x00),
+	BIN(-EINVAL, MAGIC, 0xB8, 0x00),
+	BIN(-EINVAL, MAGIC, 0xA0, 0x00),
+	BIN(-EINVAL, MAGIC),
+	/* Not a map */
+	BIN(-EINVAL, MAGIC, 0x99, 0x00, 0x00),
+	BIN(-EINVAL, MAGIC, 0x19, 0x00, 0x00),
+	/* Count truncated, reserved, indefinite and too large */
+	BIN(-EINVAL, MAGIC, 0xBA, 0x00, 0x00),
+	BIN(-EINVAL, MAGIC, 0xBC, 0x00, 0x00),
+	BIN(-EINVAL, MAGIC, 0xBF, 0xFF, 0x00),
+	BIN(-EINVAL, MAGIC, 0xBA, 0x80, 0x00, 0x00, 0x00),
+	/* Count without items, items without count */
+	BIN(-EINVAL, MAP_1),
+	BIN(-EINVAL, MAGIC, 0xA0, 0x00, 0x40),
+};
+
+static const struct bin_case items[] = {
+	BIN(1, MAP_1, 0x00, 0x40),
+	BIN(1, MAP_1, 0x17, 0x60),
+	BIN(1, MAP_1, 0x19, 0xFF, 0xFF, 0x42, 0x0A, 0x00),
+	BIN(1, MAP_1, 0x1A, 0x00, 0x00, 0xFF, 0xFF, 0x61, 'a'),
+	/* Id isn't an unsigned integer or doesn't fit */
+	BIN(-EINVAL, MAP_1, 0x61, 'a', 0x40),
+	BIN(-EINVAL, MAP_1, 0x20, 0x40),
+	BIN(-EINVAL, MAP_1, 0x40, 0x40),
+	BIN(-EINVAL, MAP_1, 0x1A, 0x00, 0x01, 0x00, 0x00, 0x40),
+	BIN(-EINVAL, MAP_1, 0x1B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	    0x00, 0x40),
+	/* Id without a value */
+	BIN(-EINVAL, MAP_1, 0x00),
+	BIN(-EINVAL, MAP_1, 0x19, 0x00),
+	/* Value isn't a string */
+	BIN(-EINVAL, MAP_1, 0x00, 0x00),
+	BIN(-EINVAL, MAP_1, 0x00, 0xA0),
+	BIN(-EINVAL, MAP_1, 0x00, 0x80),
+	BIN(-EINVAL, MAP_1, 0x00, 0x5F, 0xFF),
+	/* Value runs past the end */
+	BIN(-EINVAL, MAP_1, 0x00, 0x42, 0x0A),
+	BIN(-EINVAL, MAP_1, 0x00, 0x78, 0x01),
+	BIN(-EINVAL, MAP_1, 0x00, 0x58),
+	BIN(-EINVAL, MAP_1, 0x00, 0x5A, 0xFF, 0xFF, 0xFF, 0xFF, 0x00),
+	/* Count doesn't match the items */
+	BIN(-EINVAL, MAP_1, 0x00, 0x40, 0x01, 0x40),
+	BIN(-EINVAL, MAGIC, 0xB9, 0x00, 0x02, 0x00, 0x40),
+	BIN(-EINVAL, MAP_1, 0x00, 0x40, 0x00),
+};
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void fresh(void);
+static void check_cases(const struct bin_case *cases, size_t count);
+static size_t generate(uint8_t **fbin);
+static size_t one_value(uint8_t major, size_t size);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_lcz_param_file_bin_generate(void)
+{
+	static const uint8_t expected[] = { MAP_1, 0x19, 0x12, 0x34,
+					    0x42, 0x0A, 0x00 };
+	uint8_t *fbin = NULL;
+	size_t length = 0;
+
+	zassert_equal(lcz_param_file_generate_bin(0x1234, PARAM_BIN, bin_value,
+						  sizeof(bin_value), &fbin,
+						  &length),
+		      6, "Unexpected item size");
+	zassert_equal(length, sizeof(expected), "Unexpected length");
+	zassert_mem_equal(fbin, expected, sizeof(expected),
+			  "Unexpected contents");
+
+	/* An empty string */
+	zassert_equal(lcz_param_file_generate_bin(1, PARAM_STR, NULL, 0, &fbin,
+						  &length),
+		      2, "Unexpected item size");
+	zassert_equal(lcz_param_file_validate_bin(fbin, length), 2,
+		      "Unexpected pair count");
+
+	zassert_equal(lcz_param_file_generate_bin(1, PARAM_STR + 1, str_value,
+						  1, &fbin, &length),
+		      -EINVAL, "Unknown type accepted");
+	zassert_equal(lcz_param_file_generate_bin(1, PARAM_STR, NULL, 1, &fbin,
+						  &length),
+		      -EPERM, "Missing data accepted");
+	zassert_equal(lcz_param_file_generate_bin(1, PARAM_STR, str_value, 1,
+						  NULL, &length),
+		      -EPERM, "Missing buffer accepted");
+	zassert_equal(lcz_param_file_validate_bin(fbin, length), 2,
+		      "File changed by failed generate");
+
+	k_free(fbin);
+}
+
+void test_lcz_param_file_bin_header(void)
+{
+	zassert_equal(lcz_param_file_validate_bin(NULL, 0), -EINVAL,
+		      "Missing data accepted");
+
+	check_cases(headers, ARRAY_SIZE(headers));
+}
+
+void test_lcz_param_file_bin_truncated(void)
+{
+	uint8_t *fbin = NULL;
+	size_t length;
+	size_t size;
+
+	length = generate(&fbin);
+	zassert_equal(lcz_param_file_validate_bin(fbin, length), 4,
+		      "Unexpected pair count");
+
+	/* Every shorter file is missing part of an item */
+	for (size = 0; size < length; size++) {
+		zassert_equal(lcz_param_file_validate_bin(fbin, size), -EINVAL,
+			      "File truncated to %u accepted",
+			      (unsigned int)size);
+	}
+
+	memcpy(file, fbin, length);
+	file[length] = 0;
+	zassert_equal(lcz_param_file_validate_bin(file, length + 1), -EINVAL,
+		      "Trailing data accepted");
+
+	k_free(fbin);
+}
+
+void test_lcz_param_file_bin_items(void)
+{
+	check_cases(items, ARRAY_SIZE(items));
+}
+
+void test_lcz_param_file_bin_max_value(void)
+{
+	uint8_t *fbin = NULL;
+	size_t length = 0;
+
+	/* A byte string is limited by the size of its hex form */
+	zassert_equal(lcz_param_file_validate_bin(
+			      file, one_value(MAJOR_BSTR, MAX_VALUE / 2)),
+		      1, "Longest byte string rejected");
+	zassert_equal(lcz_param_file_validate_bin(
+			      file, one_value(MAJOR_BSTR, (MAX_VALUE / 2) + 1)),
+		      -EINVAL, "Long byte string accepted");
+	zassert_equal(lcz_param_file_validate_bin(
+			      file, one_value(MAJOR_TSTR, MAX_VALUE)),
+		      1, "Longest string rejected");
+	zassert_equal(lcz_param_file_validate_bin(
+			      file, one_value(MAJOR_TSTR, MAX_VALUE + 1)),
+		      -EINVAL, "Long string accepted");
+
+	/* The same limits apply when generating */
+	memset(file, 'x', sizeof(file));
+	zassert_true(lcz_param_file_generate_bin(0, PARAM_BIN, file,
+						 MAX_VALUE / 2, &fbin,
+						 &length) > 0,
+		     "Longest byte string rejected");
+	zassert_equal(lcz_param_file_generate_bin(1, PARAM_BIN, file,
+						  (MAX_VALUE / 2) + 1, &fbin,
+						  &length),
+		      -ENOMEM, "Long byte string accepted");
+	zassert_true(lcz_param_file_generate_bin(2, PARAM_STR, file, MAX_VALUE,
+						 &fbin, &length) > 0,
+		     "Longest string rejected");
+	zassert_equal(lcz_param_file_generate_bin(3, PARAM_STR, file,
+						  MAX_VALUE + 1, &fbin,
+						  &length),
+		      -ENOMEM, "Long string accepted");
+	zassert_equal(lcz_param_file_validate_bin(fbin, length), 2,
+		      "Unexpected pair count");
+
+	k_free(fbin);
+}
+
+void test_lcz_param_file_bin_parse(void)
+{
+	uint8_t value[sizeof(bin_value)];
+	uint8_t *fbin = NULL;
+	param_kvp_t *kv = NULL;
+	char *fstr = NULL;
+	size_t fsize;
+	size_t length;
+
+	fresh();
+	length = generate(&fbin);
+	zassert_equal(fsu_write_abs(PARAM_FILE, fbin, length), length,
+		      "Write failed");
+
+	/* Byte strings are hex encoded */
+	zassert_equal(lcz_param_file_parse_from_file(PARAM_FILE, &fsize, &fstr,
+						     &kv),
+		      4, "Unexpected pair count");
+	zassert_equal(kv[0].id, 1, "Unexpected id");
+	zassert_false(kv[0].raw, "Value not converted");
+	zassert_equal(kv[0].length, 2 * sizeof(bin_value),
+		      "Unexpected hex length");
+	zassert_equal(hex2bin(kv[0].keystr, kv[0].length, value, sizeof(value)),
+		      sizeof(value), "Value isn't hex");
+	zassert_mem_equal(value, bin_value, sizeof(bin_value),
+			  "Unexpected value");
+	zassert_equal(kv[1].id, 2, "Unexpected id");
+	zassert_equal(kv[1].length, strlen(str_value), "Unexpected length");
+	zassert_mem_equal(kv[1].keystr, str_value, strlen(str_value),
+			  "Unexpected value");
+	zassert_equal(kv[2].id, 3, "Unexpected id");
+	zassert_equal(kv[2].length, 0, "Unexpected length");
+	zassert_equal(kv[3].id, UINT16_MAX, "Unexpected id");
+	zassert_equal(kv[3].length, 0, "Unexpected length");
+	zassert_equal(fsize, (2 * sizeof(bin_value)) + strlen(str_value) + 1,
+		      "Unexpected size");
+	k_free(fstr);
+	k_free(kv);
+
+	/* A truncated file isn't parsed */
+	zassert_equal(fsu_write_abs(PARAM_FILE, fbin, length - 1), length - 1,
+		      "Write failed");
+	zassert_equal(lcz_param_file_parse_from_file(PARAM_FILE, &fsize, &fstr,
+						     &kv),
+		      -EINVAL, "Truncated file accepted");
+	zassert_is_null(fstr, "Buffer not freed");
+	zassert_is_null(kv, "Pairs not freed");
+
+	k_free(fbin);
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* Mounting empties the file system */
+static void fresh(void)
+{
+	(void)fs_unmount(&mnt);
+	zassert_equal(fs_mount(&mnt), 0, "Mount failed");
+}
+
+static void check_cases(const struct bin_case *cases, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		zassert_equal(lcz_param_file_validate_bin(cases[i].data,
+							  cases[i].size),
+			      cases[i].result, "Unexpected result for case %u",
+			      (unsigned int)i);
+	}
+}
+
+/* A byte string, a string and empty values of each type */
+static size_t generate(uint8_t **fbin)
+{
+	size_t length = 0;
+
+	zassert_true(lcz_param_file_generate_bin(1, PARAM_BIN, bin_value,
+						 sizeof(bin_value), fbin,
+						 &length) > 0,
+		     "Generate failed");
+	zassert_true(lcz_param_file_generate_bin(2, PARAM_STR, str_value,
+						 strlen(str_value), fbin,
+						 &length) > 0,
+		     "Generate failed");
+	zassert_true(lcz_param_file_generate_bin(3, PARAM_BIN, NULL, 0, fbin,
+						 &length) > 0,
+		     "Generate failed");
+	zassert_true(lcz_param_file_generate_bin(UINT16_MAX, PARAM_STR, NULL, 0,
+						 fbin, &length) > 0,
+		     "Generate failed");
+
+	return length;
+}
+
+/* A file with a single value of size bytes in the file buffer */
+static size_t one_value(uint8_t major, size_t size)
+{
+	static const uint8_t head[] = { MAP_1, 0x00 };
+
+	zassert_true(size <= UINT8_MAX && (sizeof(head) + 2 + size) <= sizeof(file),
+		     "Value too large");
+
+	memcpy(file, head, sizeof(head));
+	file[sizeof(head)] = (major << 5) | 24;
+	file[sizeof(head) + 1] = size;
+	memset(&file[sizeof(head) + 2], 'x', size);
+
+	return sizeof(head) + 2 + size;
+}
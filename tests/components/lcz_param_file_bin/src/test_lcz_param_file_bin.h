@@ -0,0 +1,29 @@
+/**
+ * @file test_lcz_param_file_bin.h
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __TEST_LCZ_PARAM_FILE_BIN_H__
+#define __TEST_LCZ_PARAM_FILE_BIN_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/util.h>
+#include <ztest.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+void test_lcz_param_file_bin_generate(void);
+void test_lcz_param_file_bin_header(void);
+void test_lcz_param_file_bin_truncated(void);
+void test_lcz_param_file_bin_items(void);
+void test_lcz_param_file_bin_max_value(void);
+void test_lcz_param_file_bin_parse(void);
+
+#endif /* __TEST_LCZ_PARAM_FILE_BIN_H__ */
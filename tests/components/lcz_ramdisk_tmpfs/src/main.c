@@ -0,0 +1,28 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "test_lcz_ramdisk_tmpfs.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_main(void)
+{
+	ztest_test_suite(lcz_ramdisk_tmpfs_test,
+			 ztest_unit_test(test_lcz_ramdisk_tmpfs_write),
+			 ztest_unit_test(test_lcz_ramdisk_tmpfs_extents),
+			 ztest_unit_test(test_lcz_ramdisk_tmpfs_map),
+			 ztest_unit_test(test_lcz_ramdisk_tmpfs_rename_dir),
+			 ztest_unit_test(test_lcz_ramdisk_tmpfs_busy),
+			 ztest_unit_test(test_lcz_ramdisk_tmpfs_statvfs));
+	ztest_run_test_suite(lcz_ramdisk_tmpfs_test);
+}
@@ -0,0 +1,307 @@
+/**
+ * @file test_lcz_ramdisk_tmpfs.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+#include <fs/fs.h>
+#include "test_lcz_ramdisk_tmpfs.h"
+#include "lcz_ramdisk.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define MNT "/tmp"
+#define BLOCK_SIZE CONFIG_LCZ_RAMDISK_TMPFS_BLOCK_SIZE
+#define BLOCKS (CONFIG_LCZ_RAMDISK_TMPFS_SIZE / BLOCK_SIZE)
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static struct fs_mount_t mnt = { .type = LCZ_RAMDISK_FS_TYPE,
+				 .mnt_point = MNT };
+static uint8_t data[CONFIG_LCZ_RAMDISK_TMPFS_SIZE];
+static uint8_t buf[CONFIG_LCZ_RAMDISK_TMPFS_SIZE];
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void fresh(void);
+static void pattern(uint8_t *dest, uint8_t seed, size_t size);
+static ssize_t write_file(const char *path, uint8_t seed, size_t size);
+static uint32_t free_blocks(void);
+static ssize_t file_size(const char *path);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_lcz_ramdisk_tmpfs_write(void)
+{
+	struct fs_file_t f;
+	size_t i;
+
+	fresh();
+	pattern(data, 1, 400);
+
+	fs_file_t_init(&f);
+	zassert_equal(fs_open(&f, MNT "/a", FS_O_CREATE | FS_O_RDWR), 0,
+		      "Open failed");
+	zassert_equal(fs_write(&f, data, 100), 100, "Write failed");
+	zassert_equal(free_blocks(), BLOCKS - 1, "Unexpected free blocks");
+
+	/* Extend the file */
+	zassert_equal(fs_write(&f, &data[100], 300), 300, "Write failed");
+	zassert_equal(free_blocks(), BLOCKS - 2, "Unexpected free blocks");
+	zassert_equal(fs_seek(&f, 0, FS_SEEK_SET), 0, "Seek failed");
+	zassert_equal(fs_read(&f, buf, sizeof(buf)), 400, "Read failed");
+	zassert_mem_equal(buf, data, 400, "Contents differ");
+
+	/* Writing past the end fills the gap with zero */
+	zassert_equal(fs_seek(&f, 600, FS_SEEK_SET), 0, "Seek failed");
+	zassert_equal(fs_write(&f, data, 4), 4, "Write failed");
+	zassert_equal(free_blocks(), BLOCKS - 3, "Unexpected free blocks");
+	zassert_equal(fs_seek(&f, 400, FS_SEEK_SET), 0, "Seek failed");
+	zassert_equal(fs_read(&f, buf, sizeof(buf)), 204, "Read failed");
+	for (i = 0; i < 200; i++) {
+		zassert_equal(buf[i], 0, "Gap isn't zero at %u",
+			      (unsigned int)i);
+	}
+	zassert_mem_equal(&buf[200], data, 4, "Contents differ");
+
+	zassert_equal(fs_truncate(&f, 100), 0, "Truncate failed");
+	zassert_equal(free_blocks(), BLOCKS - 1, "Blocks not released");
+	zassert_equal(fs_close(&f), 0, "Close failed");
+	zassert_equal(file_size(MNT "/a"), 100, "Unexpected size");
+}
+
+void test_lcz_ramdisk_tmpfs_extents(void)
+{
+	struct fs_file_t f;
+
+	fresh();
+
+	/* Leave single free blocks between files */
+	zassert_equal(write_file(MNT "/a", 0, BLOCK_SIZE), BLOCK_SIZE,
+		      "Write failed");
+	zassert_equal(write_file(MNT "/b", 0, BLOCK_SIZE), BLOCK_SIZE,
+		      "Write failed");
+	zassert_equal(write_file(MNT "/c", 0, BLOCK_SIZE), BLOCK_SIZE,
+		      "Write failed");
+	zassert_equal(write_file(MNT "/d", 0, BLOCK_SIZE), BLOCK_SIZE,
+		      "Write failed");
+	zassert_equal(write_file(MNT "/e", 0, BLOCK_SIZE), BLOCK_SIZE,
+		      "Write failed");
+	zassert_equal(fs_unlink(MNT "/a"), 0, "Unlink failed");
+	zassert_equal(fs_unlink(MNT "/c"), 0, "Unlink failed");
+	zassert_equal(free_blocks(), BLOCKS - 3, "Unexpected free blocks");
+
+	/* Each write needs a new extent, the third one has none left */
+	fs_file_t_init(&f);
+	zassert_equal(fs_open(&f, MNT "/f", FS_O_CREATE | FS_O_RDWR), 0,
+		      "Open failed");
+	zassert_equal(fs_write(&f, data, BLOCK_SIZE), BLOCK_SIZE,
+		      "Write failed");
+	zassert_equal(fs_write(&f, data, BLOCK_SIZE), BLOCK_SIZE,
+		      "Write failed");
+	zassert_equal(fs_write(&f, data, BLOCK_SIZE), -ENOSPC,
+		      "Write without an extent allowed");
+	zassert_equal(fs_close(&f), 0, "Close failed");
+	zassert_equal(file_size(MNT "/f"), 2 * BLOCK_SIZE, "Unexpected size");
+	zassert_equal(free_blocks(), BLOCKS - 5, "Unexpected free blocks");
+
+	/* Blocks taken by a write or truncate that fails are given back */
+	fs_file_t_init(&f);
+	zassert_equal(fs_open(&f, MNT "/g", FS_O_CREATE | FS_O_RDWR), 0,
+		      "Open failed");
+	zassert_equal(fs_seek(&f, sizeof(data), FS_SEEK_SET), 0, "Seek failed");
+	zassert_equal(fs_write(&f, data, 4), -ENOSPC, "Write allowed");
+	zassert_equal(free_blocks(), BLOCKS - 5, "Blocks not released");
+	zassert_equal(fs_truncate(&f, sizeof(data)), -ENOSPC,
+		      "Truncate allowed");
+	zassert_equal(free_blocks(), BLOCKS - 5, "Blocks not released");
+
+	/* The rest of the arena is one run, which is a short write */
+	zassert_equal(fs_seek(&f, 0, FS_SEEK_SET), 0, "Seek failed");
+	zassert_equal(fs_write(&f, data, sizeof(data)),
+		      (BLOCKS - 5) * BLOCK_SIZE, "Unexpected write size");
+	zassert_equal(free_blocks(), 0, "Unexpected free blocks");
+	zassert_equal(fs_close(&f), 0, "Close failed");
+}
+
+void test_lcz_ramdisk_tmpfs_map(void)
+{
+	struct lcz_ramdisk_map map;
+	struct lcz_ramdisk_map other;
+	struct fs_file_t f;
+
+	fresh();
+	pattern(data, 2, 600);
+	zassert_equal(write_file(MNT "/m", 2, 600), 600, "Write failed");
+
+	zassert_equal(lcz_ramdisk_map(MNT "/m", 0, &map), 0, "Map failed");
+	zassert_equal(map.size, 600, "Unexpected map size");
+	zassert_mem_equal(map.data, data, 600, "Contents differ");
+	zassert_equal(lcz_ramdisk_map(MNT "/m", 600, &other), -EINVAL,
+		      "Map past the end allowed");
+	zassert_equal(lcz_ramdisk_map(MNT "/none", 0, &other), -ENOENT,
+		      "Map of missing file allowed");
+
+	/* Mapped contents can't change */
+	fs_file_t_init(&f);
+	zassert_equal(fs_open(&f, MNT "/m", FS_O_RDWR), 0, "Open failed");
+	zassert_equal(fs_write(&f, data, 4), -EBUSY, "Overwrite allowed");
+	zassert_equal(fs_truncate(&f, 100), -EBUSY, "Truncate allowed");
+	zassert_equal(fs_close(&f), 0, "Close failed");
+	zassert_equal(fs_unlink(MNT "/m"), -EBUSY, "Unlink allowed");
+
+	/* but they can be appended to */
+	fs_file_t_init(&f);
+	zassert_equal(fs_open(&f, MNT "/m", FS_O_WRITE | FS_O_APPEND), 0,
+		      "Open failed");
+	zassert_equal(fs_write(&f, data, 100), 100, "Append failed");
+	zassert_equal(fs_close(&f), 0, "Close failed");
+	zassert_equal(file_size(MNT "/m"), 700, "Unexpected size");
+	zassert_mem_equal(map.data, data, 600, "Mapped contents moved");
+
+	lcz_ramdisk_unmap(&map);
+	zassert_is_null(map.data, "Map not cleared");
+
+	fs_file_t_init(&f);
+	zassert_equal(fs_open(&f, MNT "/m", FS_O_RDWR), 0, "Open failed");
+	zassert_equal(fs_write(&f, data, 4), 4, "Overwrite failed");
+	zassert_equal(fs_close(&f), 0, "Close failed");
+}
+
+void test_lcz_ramdisk_tmpfs_rename_dir(void)
+{
+	struct fs_dirent entry;
+	struct fs_dir_t dir;
+
+	fresh();
+	zassert_equal(fs_mkdir(MNT "/d"), 0, "Mkdir failed");
+	zassert_equal(fs_mkdir(MNT "/d/sub"), 0, "Mkdir failed");
+	zassert_equal(write_file(MNT "/d/sub/x", 3, 10), 10, "Write failed");
+
+	/* The contents move with the directory */
+	zassert_equal(fs_rename(MNT "/d", MNT "/e"), 0, "Rename failed");
+	zassert_equal(file_size(MNT "/e/sub/x"), 10, "File not moved");
+	zassert_equal(file_size(MNT "/d/sub/x"), -ENOENT, "File left behind");
+	zassert_equal(fs_stat(MNT "/d", &entry), -ENOENT,
+		      "Directory left behind");
+
+	zassert_equal(fs_rename(MNT "/e", MNT "/e/sub/f"), -EINVAL,
+		      "Directory moved into itself");
+
+	fs_dir_t_init(&dir);
+	zassert_equal(fs_opendir(&dir, MNT "/e"), 0, "Opendir failed");
+	zassert_equal(fs_readdir(&dir, &entry), 0, "Readdir failed");
+	zassert_equal(strcmp(entry.name, "sub"), 0, "Unexpected entry");
+	zassert_equal(entry.type, FS_DIR_ENTRY_DIR, "Unexpected type");
+	zassert_equal(fs_readdir(&dir, &entry), 0, "Readdir failed");
+	zassert_equal(entry.name[0], '\0', "Unexpected entry");
+	zassert_equal(fs_closedir(&dir), 0, "Closedir failed");
+}
+
+void test_lcz_ramdisk_tmpfs_busy(void)
+{
+	struct fs_file_t f;
+	struct fs_dir_t dir;
+
+	fresh();
+
+	fs_file_t_init(&f);
+	zassert_equal(fs_open(&f, MNT "/o", FS_O_CREATE | FS_O_RDWR), 0,
+		      "Open failed");
+	zassert_equal(fs_unlink(MNT "/o"), -EBUSY, "Unlink of open file allowed");
+	zassert_equal(fs_unmount(&mnt), -EBUSY, "Unmount with open file allowed");
+	zassert_equal(fs_close(&f), 0, "Close failed");
+	zassert_equal(fs_unlink(MNT "/o"), 0, "Unlink failed");
+
+	fs_dir_t_init(&dir);
+	zassert_equal(fs_opendir(&dir, MNT), 0, "Opendir failed");
+	zassert_equal(fs_unmount(&mnt), -EBUSY,
+		      "Unmount with open directory allowed");
+	zassert_equal(fs_closedir(&dir), 0, "Closedir failed");
+	zassert_equal(fs_unmount(&mnt), 0, "Unmount failed");
+}
+
+void test_lcz_ramdisk_tmpfs_statvfs(void)
+{
+	struct fs_statvfs stat;
+
+	fresh();
+
+	zassert_equal(fs_statvfs(MNT, &stat), 0, "Statvfs failed");
+	zassert_equal(stat.f_bsize, BLOCK_SIZE, "Unexpected block size");
+	zassert_equal(stat.f_frsize, BLOCK_SIZE, "Unexpected fragment size");
+	zassert_equal(stat.f_blocks, BLOCKS, "Unexpected block count");
+	zassert_equal(stat.f_bfree, BLOCKS, "Unexpected free blocks");
+
+	zassert_equal(write_file(MNT "/s", 4, BLOCK_SIZE + 1), BLOCK_SIZE + 1,
+		      "Write failed");
+	zassert_equal(free_blocks(), BLOCKS - 2, "Unexpected free blocks");
+	zassert_equal(fs_unlink(MNT "/s"), 0, "Unlink failed");
+	zassert_equal(free_blocks(), BLOCKS, "Blocks not released");
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* Mounting empties the file system */
+static void fresh(void)
+{
+	(void)fs_unmount(&mnt);
+	zassert_equal(fs_mount(&mnt), 0, "Mount failed");
+}
+
+static void pattern(uint8_t *dest, uint8_t seed, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		dest[i] = seed + (i * 7);
+	}
+}
+
+static ssize_t write_file(const char *path, uint8_t seed, size_t size)
+{
+	struct fs_file_t f;
+	ssize_t r;
+
+	pattern(data, seed, size);
+
+	fs_file_t_init(&f);
+	r = fs_open(&f, path, FS_O_CREATE | FS_O_RDWR);
+	if (r == 0) {
+		r = fs_write(&f, data, size);
+		(void)fs_close(&f);
+	}
+
+	return r;
+}
+
+static uint32_t free_blocks(void)
+{
+	struct fs_statvfs stat;
+
+	zassert_equal(fs_statvfs(MNT, &stat), 0, "Statvfs failed");
+
+	return stat.f_bfree;
+}
+
+static ssize_t file_size(const char *path)
+{
+	struct fs_dirent entry;
+	int r;
+
+	r = fs_stat(path, &entry);
+
+	return (r < 0) ? r : (ssize_t)entry.size;
+}
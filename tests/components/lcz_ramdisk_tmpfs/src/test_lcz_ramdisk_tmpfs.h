@@ -0,0 +1,29 @@
+/**
+ * @file test_lcz_ramdisk_tmpfs.h
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __TEST_LCZ_RAMDISK_TMPFS_H__
+#define __TEST_LCZ_RAMDISK_TMPFS_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/util.h>
+#include <ztest.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+void test_lcz_ramdisk_tmpfs_write(void);
+void test_lcz_ramdisk_tmpfs_extents(void);
+void test_lcz_ramdisk_tmpfs_map(void);
+void test_lcz_ramdisk_tmpfs_rename_dir(void);
+void test_lcz_ramdisk_tmpfs_busy(void);
+void test_lcz_ramdisk_tmpfs_statvfs(void);
+
+#endif /* __TEST_LCZ_RAMDISK_TMPFS_H__ */
@@ -0,0 +1,26 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "test_lcz_flash_sim.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_main(void)
+{
+	ztest_test_suite(lcz_flash_sim_test,
+			 ztest_unit_test(test_lcz_flash_sim_program),
+			 ztest_unit_test(test_lcz_flash_sim_erase),
+			 ztest_unit_test(test_lcz_flash_sim_timing),
+			 ztest_unit_test(test_lcz_flash_sim_dpm));
+	ztest_run_test_suite(lcz_flash_sim_test);
+}
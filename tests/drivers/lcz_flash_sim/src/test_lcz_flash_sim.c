@@ -0,0 +1,174 @@
+/**
+ * @file test_lcz_flash_sim.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <ztest.h>
+#include <device.h>
+#include <drivers/flash.h>
+#include "test_lcz_flash_sim.h"
+#include "lcz_flash_sim.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define FLASH_SIM_NODE DT_NODELABEL(flash_sim0)
+#define FLASH_SIM_SIZE (DT_PROP(FLASH_SIM_NODE, size) / 8)
+#define T_PAGE_PROGRAM DT_PROP(FLASH_SIM_NODE, t_page_program)
+#define T_SECTOR_ERASE DT_PROP(FLASH_SIM_NODE, t_sector_erase)
+#define T_EXIT_DPD_US (DT_PROP(FLASH_SIM_NODE, t_exit_dpd) / 1000)
+
+#define SECTOR_SIZE 4096
+#define BLOCK_SIZE 65536
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const struct device *dev = DEVICE_DT_GET(FLASH_SIM_NODE);
+static uint8_t buf[1024];
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int64_t now_us(void);
+static void wake(void);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_lcz_flash_sim_program(void)
+{
+	struct lcz_flash_sim_stats stats;
+	uint32_t word;
+
+	zassert_true(device_is_ready(dev), "Flash simulator not ready");
+	zassert_equal(flash_erase(dev, 0, SECTOR_SIZE), 0, "Erase failed");
+
+	lcz_flash_sim_reset_stats(dev);
+
+	/* Programming can only clear bits */
+	word = 0x0F0F0F0F;
+	zassert_equal(flash_write(dev, 0, &word, sizeof(word)), 0, "Write failed");
+	word = 0x00FF00FF;
+	zassert_equal(flash_write(dev, 0, &word, sizeof(word)), 0, "Write failed");
+	zassert_equal(flash_read(dev, 0, &word, sizeof(word)), 0, "Read failed");
+	zassert_equal(word, 0x000F000F, "Program didn't AND");
+
+	/* Each page touched is a page program */
+	memset(buf, 0x55, sizeof(buf));
+	zassert_equal(flash_write(dev, 128, buf, 512), 0, "Write failed");
+
+	zassert_equal(lcz_flash_sim_get_stats(dev, &stats), 0, "Stats failed");
+	zassert_equal(stats.writes, 3, "Unexpected write count");
+	zassert_equal(stats.page_programs, 2 + 3, "Unexpected page programs");
+	zassert_equal(stats.write_bytes, 8 + 512, "Unexpected bytes written");
+	zassert_equal(stats.reads, 1, "Unexpected read count");
+
+	zassert_equal(flash_write(dev, FLASH_SIM_SIZE - 4, buf, 8), -EINVAL,
+		      "Write past end allowed");
+	zassert_equal(flash_write(dev, 2, buf, 4), -EINVAL,
+		      "Unaligned address allowed");
+	zassert_equal(flash_write(dev, 0, buf, 6), -EINVAL,
+		      "Size that isn't a multiple of 4 allowed");
+	zassert_equal(flash_write(dev, 0, buf, 0), -EINVAL, "Empty write allowed");
+}
+
+void test_lcz_flash_sim_erase(void)
+{
+	struct lcz_flash_sim_stats stats;
+	uint32_t word;
+
+	lcz_flash_sim_reset_stats(dev);
+
+	/* Two blocks */
+	zassert_equal(flash_erase(dev, 0, 2 * BLOCK_SIZE), 0, "Erase failed");
+	/* Up to the block boundary in sectors, then the remaining sectors */
+	zassert_equal(flash_erase(dev, SECTOR_SIZE, BLOCK_SIZE + SECTOR_SIZE), 0,
+		      "Erase failed");
+	zassert_equal(flash_erase(dev, 0, FLASH_SIM_SIZE), 0, "Erase failed");
+
+	zassert_equal(lcz_flash_sim_get_stats(dev, &stats), 0, "Stats failed");
+	zassert_equal(stats.block_erases, 2, "Unexpected block erases");
+	zassert_equal(stats.sector_erases, 15 + 2, "Unexpected sector erases");
+	zassert_equal(stats.chip_erases, 1, "Unexpected chip erases");
+	zassert_equal(stats.erase_bytes,
+		      (3 * BLOCK_SIZE) + SECTOR_SIZE + FLASH_SIM_SIZE,
+		      "Unexpected bytes erased");
+
+	zassert_equal(flash_read(dev, 0, &word, sizeof(word)), 0, "Read failed");
+	zassert_equal(word, 0xFFFFFFFF, "Not erased");
+
+	zassert_equal(flash_erase(dev, 1, SECTOR_SIZE), -EINVAL,
+		      "Unaligned erase allowed");
+	zassert_equal(flash_erase(dev, 0, 100), -EINVAL,
+		      "Partial sector erase allowed");
+}
+
+void test_lcz_flash_sim_timing(void)
+{
+	struct lcz_flash_sim_stats stats;
+	int64_t start;
+	int64_t elapsed;
+
+	wake();
+	lcz_flash_sim_reset_stats(dev);
+
+	start = now_us();
+	zassert_equal(flash_write(dev, 0, buf, sizeof(buf)), 0, "Write failed");
+	zassert_equal(flash_erase(dev, SECTOR_SIZE, SECTOR_SIZE), 0,
+		      "Erase failed");
+	elapsed = now_us() - start;
+
+	zassert_equal(lcz_flash_sim_get_stats(dev, &stats), 0, "Stats failed");
+	zassert_equal(stats.busy_us,
+		      (4 * T_PAGE_PROGRAM) + T_SECTOR_ERASE,
+		      "Unexpected busy time");
+	zassert_equal(stats.max_us, T_SECTOR_ERASE, "Unexpected max time");
+	zassert_true(elapsed >= stats.busy_us, "Operations too fast");
+
+	TC_PRINT("1 KiB program and sector erase took %u us\n",
+		 (uint32_t)elapsed);
+}
+
+void test_lcz_flash_sim_dpm(void)
+{
+	struct lcz_flash_sim_stats stats;
+	uint32_t word;
+
+	wake();
+	lcz_flash_sim_reset_stats(dev);
+
+	zassert_equal(flash_read(dev, 0, &word, sizeof(word)), 0, "Read failed");
+	k_msleep(CONFIG_LCZ_FLASH_SIM_COOL_DOWN_PERIOD * 2);
+	zassert_equal(flash_read(dev, 0, &word, sizeof(word)), 0, "Read failed");
+	zassert_equal(flash_read(dev, 0, &word, sizeof(word)), 0, "Read failed");
+
+	zassert_equal(lcz_flash_sim_get_stats(dev, &stats), 0, "Stats failed");
+	zassert_equal(stats.reads, 3, "Unexpected read count");
+	zassert_equal(stats.dpm_wakes, 1, "Unexpected DPM wakes");
+	zassert_true(stats.max_us >= T_EXIT_DPD_US, "DPM exit not modelled");
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int64_t now_us(void)
+{
+	return (int64_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+/* Take the part out of DPM so that it doesn't affect the measurement */
+static void wake(void)
+{
+	uint32_t word;
+
+	zassert_equal(flash_read(dev, 0, &word, sizeof(word)), 0, "Read failed");
+}
@@ -0,0 +1,27 @@
+/**
+ * @file test_lcz_flash_sim.h
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __TEST_LCZ_FLASH_SIM_H__
+#define __TEST_LCZ_FLASH_SIM_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/util.h>
+#include <ztest.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+void test_lcz_flash_sim_program(void);
+void test_lcz_flash_sim_erase(void);
+void test_lcz_flash_sim_timing(void);
+void test_lcz_flash_sim_dpm(void);
+
+#endif /* __TEST_LCZ_FLASH_SIM_H__ */
@@ -0,0 +1,28 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "test_lcz_erase_ahead.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_main(void)
+{
+	ztest_test_suite(lcz_erase_ahead_test,
+			 ztest_unit_test(test_lcz_erase_ahead_skip_erased),
+			 ztest_unit_test(test_lcz_erase_ahead_write),
+			 ztest_unit_test(test_lcz_erase_ahead_take_free),
+			 ztest_unit_test(test_lcz_erase_ahead_free_erased),
+			 ztest_unit_test(test_lcz_erase_ahead_boundary),
+			 ztest_unit_test(test_lcz_erase_ahead_error));
+	ztest_run_test_suite(lcz_erase_ahead_test);
+}
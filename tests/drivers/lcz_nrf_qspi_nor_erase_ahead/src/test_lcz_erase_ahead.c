@@ -0,0 +1,227 @@
+/**
+ * @file test_lcz_erase_ahead.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <ztest.h>
+#include <string.h>
+#include "test_lcz_erase_ahead.h"
+#include "lcz_nrf_qspi_nor_erase_ahead.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+/* Not a multiple of the atomic size so that the last word is partial */
+#define SECTORS 70
+#define MAX_RUNS 8
+
+struct erase_run {
+	uint32_t first;
+	uint32_t count;
+};
+
+struct fake_flash {
+	struct erase_run runs[MAX_RUNS];
+	size_t num_runs;
+	uint32_t sectors_erased;
+	int result;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+LCZ_ERASE_AHEAD_MAP_DEFINE(map, SECTORS);
+
+static struct fake_flash flash;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void reset(void);
+static int fake_erase(void *context, uint32_t first, uint32_t count);
+static void erase_ahead(void);
+static void check_run(size_t index, uint32_t first, uint32_t count);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_lcz_erase_ahead_skip_erased(void)
+{
+	reset();
+
+	/* Sectors 4 and 5 are erased while the flash is idle */
+	lcz_erase_ahead_mark_free(&map, 4, 2);
+	erase_ahead();
+	erase_ahead();
+	zassert_equal(flash.sectors_erased, 2, "Free sectors weren't erased");
+
+	/* The file system erases 2 to 7, only the sectors around them are
+	 * erased.
+	 */
+	memset(&flash, 0, sizeof(flash));
+	zassert_equal(lcz_erase_ahead_erase(&map, 2, 6, fake_erase, &flash), 0,
+		      "Erase failed");
+	zassert_equal(flash.num_runs, 2, "Unexpected number of erases");
+	check_run(0, 2, 2);
+	check_run(1, 6, 2);
+
+	/* A pre-erased range doesn't need an erase */
+	memset(&flash, 0, sizeof(flash));
+	zassert_equal(lcz_erase_ahead_erase(&map, 2, 6, fake_erase, &flash), 0,
+		      "Erase failed");
+	zassert_equal(flash.num_runs, 0, "Erased sectors were erased again");
+}
+
+void test_lcz_erase_ahead_write(void)
+{
+	reset();
+
+	zassert_equal(lcz_erase_ahead_erase(&map, 10, 4, fake_erase, &flash), 0,
+		      "Erase failed");
+	lcz_erase_ahead_mark_written(&map, 11, 1);
+
+	memset(&flash, 0, sizeof(flash));
+	zassert_equal(lcz_erase_ahead_erase(&map, 10, 4, fake_erase, &flash), 0,
+		      "Erase failed");
+	zassert_equal(flash.num_runs, 1, "Written sector wasn't erased");
+	check_run(0, 11, 1);
+}
+
+void test_lcz_erase_ahead_take_free(void)
+{
+	reset();
+
+	zassert_equal(lcz_erase_ahead_take_free(&map), -ENOENT,
+		      "Empty pool returned a sector");
+
+	lcz_erase_ahead_mark_free(&map, 40, 1);
+	lcz_erase_ahead_mark_free(&map, 3, 1);
+	lcz_erase_ahead_mark_free(&map, 33, 1);
+	zassert_equal(lcz_erase_ahead_take_free(&map), 3, "Not lowest sector");
+	zassert_equal(lcz_erase_ahead_take_free(&map), 33, "Not lowest sector");
+	zassert_equal(lcz_erase_ahead_take_free(&map), 40, "Not lowest sector");
+	zassert_equal(lcz_erase_ahead_take_free(&map), -ENOENT,
+		      "Sector taken twice");
+
+	/* A sector that is written before it is erased isn't free */
+	lcz_erase_ahead_mark_free(&map, 20, 2);
+	lcz_erase_ahead_mark_written(&map, 20, 1);
+	zassert_equal(lcz_erase_ahead_take_free(&map), 21,
+		      "Written sector still free");
+	zassert_equal(lcz_erase_ahead_take_free(&map), -ENOENT,
+		      "Written sector still free");
+}
+
+void test_lcz_erase_ahead_free_erased(void)
+{
+	reset();
+
+	zassert_equal(lcz_erase_ahead_erase(&map, 0, 2, fake_erase, &flash), 0,
+		      "Erase failed");
+	lcz_erase_ahead_mark_free(&map, 0, 3);
+	zassert_equal(lcz_erase_ahead_take_free(&map), 2,
+		      "Erased sector added to the pool");
+	zassert_equal(lcz_erase_ahead_take_free(&map), -ENOENT,
+		      "Erased sector added to the pool");
+}
+
+void test_lcz_erase_ahead_boundary(void)
+{
+	reset();
+
+	/* Sectors past the end aren't added */
+	lcz_erase_ahead_mark_free(&map, SECTORS - 1, 4);
+	zassert_equal(lcz_erase_ahead_take_free(&map), SECTORS - 1,
+		      "Last sector not free");
+	zassert_equal(lcz_erase_ahead_take_free(&map), -ENOENT,
+		      "Sector past the end is free");
+
+	zassert_equal(lcz_erase_ahead_erase(&map, SECTORS - 1, 1, fake_erase,
+					    &flash),
+		      0, "Erase of last sector failed");
+	check_run(0, SECTORS - 1, 1);
+
+	zassert_equal(lcz_erase_ahead_erase(&map, SECTORS - 1, 2, fake_erase,
+					    &flash),
+		      -EINVAL, "Erase past the end accepted");
+	zassert_equal(lcz_erase_ahead_erase(&map, 0, SECTORS + 1, fake_erase,
+					    &flash),
+		      -EINVAL, "Erase past the end accepted");
+	zassert_equal(flash.num_runs, 1, "Invalid range erased");
+
+	memset(&flash, 0, sizeof(flash));
+	zassert_equal(lcz_erase_ahead_erase(&map, 0, SECTORS, fake_erase,
+					    &flash),
+		      0, "Erase of all sectors failed");
+	zassert_equal(flash.num_runs, 1, "Unexpected number of erases");
+	check_run(0, 0, SECTORS - 1);
+}
+
+void test_lcz_erase_ahead_error(void)
+{
+	reset();
+
+	lcz_erase_ahead_mark_free(&map, 8, 1);
+	flash.result = -EIO;
+	zassert_equal(lcz_erase_ahead_erase(&map, 8, 1, fake_erase, &flash),
+		      -EIO, "Error not returned");
+
+	/* The sector still needs an erase */
+	flash.result = 0;
+	zassert_equal(lcz_erase_ahead_erase(&map, 8, 1, fake_erase, &flash), 0,
+		      "Erase failed");
+	zassert_equal(flash.num_runs, 2, "Failed erase not retried");
+	check_run(1, 8, 1);
+
+	/* and is no longer free */
+	zassert_equal(lcz_erase_ahead_take_free(&map), -ENOENT,
+		      "Erased sector still free");
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void reset(void)
+{
+	lcz_erase_ahead_mark_written(&map, 0, SECTORS);
+	memset(&flash, 0, sizeof(flash));
+}
+
+static int fake_erase(void *context, uint32_t first, uint32_t count)
+{
+	struct fake_flash *f = context;
+
+	zassert_true(f->num_runs < MAX_RUNS, "Too many erases");
+	zassert_true(count > 0, "Empty erase");
+	f->runs[f->num_runs].first = first;
+	f->runs[f->num_runs].count = count;
+	f->num_runs += 1;
+	f->sectors_erased += count;
+
+	return f->result;
+}
+
+/* What the driver's work handler does with a free sector */
+static void erase_ahead(void)
+{
+	int sector = lcz_erase_ahead_take_free(&map);
+
+	zassert_true(sector >= 0, "No free sector");
+	zassert_equal(lcz_erase_ahead_erase(&map, sector, 1, fake_erase, &flash),
+		      0, "Erase failed");
+}
+
+static void check_run(size_t index, uint32_t first, uint32_t count)
+{
+	zassert_true(index < flash.num_runs, "Missing erase");
+	zassert_equal(flash.runs[index].first, first, "Unexpected first sector");
+	zassert_equal(flash.runs[index].count, count, "Unexpected sector count");
+}
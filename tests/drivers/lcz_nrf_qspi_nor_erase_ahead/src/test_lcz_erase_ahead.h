@@ -0,0 +1,29 @@
+/**
+ * @file test_lcz_erase_ahead.h
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __TEST_LCZ_ERASE_AHEAD_H__
+#define __TEST_LCZ_ERASE_AHEAD_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/util.h>
+#include <ztest.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+void test_lcz_erase_ahead_skip_erased(void);
+void test_lcz_erase_ahead_write(void);
+void test_lcz_erase_ahead_take_free(void);
+void test_lcz_erase_ahead_free_erased(void);
+void test_lcz_erase_ahead_boundary(void);
+void test_lcz_erase_ahead_error(void);
+
+#endif /* __TEST_LCZ_ERASE_AHEAD_H__ */
@@ -0,0 +1,26 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "test_lcz_kvp_scan.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_main(void)
+{
+	ztest_test_suite(lcz_kvp_scan_test,
+			 ztest_unit_test(test_lcz_kvp_scan_plain),
+			 ztest_unit_test(test_lcz_kvp_scan_find),
+			 ztest_unit_test(test_lcz_kvp_scan_validate),
+			 ztest_unit_test(test_lcz_kvp_scan_benchmark));
+	ztest_run_test_suite(lcz_kvp_scan_test);
+}
@@ -0,0 +1,287 @@
+/**
+ * @file test_lcz_kvp_scan.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <ztest.h>
+#include <ctype.h>
+#include <stdio.h>
+#include "test_lcz_kvp_scan.h"
+#include "lcz_kvp.h"
+#include "lcz_kvp_scan.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define RANDOM_STR_SIZE 64
+#define RANDOM_ITERATIONS 2000
+#define CERT_FILE_SIZE 4096
+#define BENCHMARK_ITERATIONS 200
+#define MUTATIONS 4
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static uint32_t seed = 0x4C43545A;
+
+/* Characters that the scanner must stop on are over-represented */
+static const char alphabet[] = "ab=#\n\r\x1F\x7E\x7F\x80\xFF 0123456789";
+
+static char random_str[RANDOM_STR_SIZE + sizeof(uint32_t)];
+static char cert_file[CERT_FILE_SIZE];
+static char mutated_file[CERT_FILE_SIZE];
+
+static const lcz_kvp_cfg_t cfg = { .max_file_out_size = CERT_FILE_SIZE, .encrypted = false };
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static uint32_t next_random(void);
+static void fill_random(char *str, size_t size);
+static size_t fill_cert_file(char *str, size_t size);
+static size_t byte_plain(const char *str, size_t size);
+static const char *byte_find(const char *str, size_t size, char c);
+static int byte_validate(const char *str, size_t size);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_lcz_kvp_scan_plain(void)
+{
+	size_t offset;
+	size_t size;
+	int i;
+
+	for (i = 0; i < RANDOM_ITERATIONS; i++) {
+		fill_random(random_str, RANDOM_STR_SIZE);
+		/* Cover unaligned starts and lengths that aren't a multiple of the word size */
+		for (offset = 0; offset < sizeof(uint32_t); offset++) {
+			for (size = 0; size <= RANDOM_STR_SIZE - offset; size++) {
+				zassert_equal(lcz_kvp_scan_plain(&random_str[offset], size),
+					      byte_plain(&random_str[offset], size),
+					      "Plain span mismatch");
+			}
+		}
+	}
+}
+
+void test_lcz_kvp_scan_find(void)
+{
+	size_t offset;
+	size_t size;
+	int i;
+
+	for (i = 0; i < RANDOM_ITERATIONS; i++) {
+		fill_random(random_str, RANDOM_STR_SIZE);
+		for (offset = 0; offset < sizeof(uint32_t); offset++) {
+			for (size = 0; size <= RANDOM_STR_SIZE - offset; size++) {
+				zassert_equal_ptr(lcz_kvp_scan_find(&random_str[offset], size, '='),
+						  byte_find(&random_str[offset], size, '='),
+						  "Delimiter position mismatch");
+				zassert_equal_ptr(lcz_kvp_scan_find(&random_str[offset], size, '\n'),
+						  byte_find(&random_str[offset], size, '\n'),
+						  "Newline position mismatch");
+			}
+		}
+	}
+}
+
+void test_lcz_kvp_scan_validate(void)
+{
+	size_t offset;
+	size_t size;
+	size_t pos;
+	int i;
+	int j;
+
+	/* Mostly invalid files, with special characters at every alignment */
+	for (i = 0; i < RANDOM_ITERATIONS; i++) {
+		fill_random(random_str, RANDOM_STR_SIZE);
+		for (offset = 0; offset < sizeof(uint32_t); offset++) {
+			for (size = 0; size <= RANDOM_STR_SIZE - offset; size++) {
+				zassert_equal(lcz_kvp_validate_file(&cfg, &random_str[offset], size),
+					      byte_validate(&random_str[offset], size),
+					      "Validation mismatch");
+			}
+		}
+	}
+
+	/* Valid files with a few characters changed */
+	size = fill_cert_file(cert_file, sizeof(cert_file));
+	zassert_equal(lcz_kvp_validate_file(&cfg, cert_file, size), byte_validate(cert_file, size),
+		      "Validation mismatch");
+	for (i = 0; i < RANDOM_ITERATIONS; i++) {
+		memcpy(mutated_file, cert_file, size);
+		for (j = 0; j < MUTATIONS; j++) {
+			pos = next_random() % size;
+			mutated_file[pos] = alphabet[next_random() % (sizeof(alphabet) - 1)];
+		}
+		zassert_equal(lcz_kvp_validate_file(&cfg, mutated_file, size),
+			      byte_validate(mutated_file, size), "Validation mismatch");
+	}
+}
+
+void test_lcz_kvp_scan_benchmark(void)
+{
+	int byte_result;
+	int word_result;
+	uint32_t byte_cycles;
+	uint32_t word_cycles;
+	uint32_t start;
+	size_t size;
+	int i;
+
+	size = fill_cert_file(cert_file, sizeof(cert_file));
+
+	start = k_cycle_get_32();
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		byte_result = byte_validate(cert_file, size);
+	}
+	byte_cycles = k_cycle_get_32() - start;
+
+	start = k_cycle_get_32();
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		word_result = lcz_kvp_validate_file(&cfg, cert_file, size);
+	}
+	word_cycles = k_cycle_get_32() - start;
+
+	zassert_equal(byte_result, word_result, "Validation results don't match");
+	zassert_true(word_result > 0, "Benchmark file has no pairs");
+
+	TC_PRINT("Scanned %zu bytes %u times\n", size, BENCHMARK_ITERATIONS);
+	TC_PRINT("byte loop: %u cycles\n", byte_cycles);
+	TC_PRINT("lcz_kvp_validate_file: %u cycles\n", word_cycles);
+	if (word_cycles != 0) {
+		TC_PRINT("speedup: %u.%02u\n", byte_cycles / word_cycles,
+			 ((byte_cycles % word_cycles) * 100) / word_cycles);
+	}
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static uint32_t next_random(void)
+{
+	/* xorshift32 so that failures are repeatable */
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static void fill_random(char *str, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		str[i] = alphabet[next_random() % (sizeof(alphabet) - 1)];
+	}
+}
+
+/* Settings file with a few short values and PEM-like certificate values */
+static size_t fill_cert_file(char *str, size_t size)
+{
+	static const char b64[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t length = 0;
+	size_t value_len;
+	int line = 0;
+	int n;
+
+	while (length < size) {
+		n = snprintf(&str[length], size - length, "%skey%d=",
+			     (line % 8) == 0 ? "# comment\n" : "", line);
+		if (n < 0 || (length + n) >= size) {
+			break;
+		}
+		length += n;
+
+		value_len = ((line % 4) == 0) ? 900 : 12;
+		while (value_len-- > 0 && length < (size - 1)) {
+			str[length++] = b64[next_random() % (sizeof(b64) - 1)];
+		}
+		str[length++] = '\n';
+		line += 1;
+	}
+
+	return length;
+}
+
+static size_t byte_plain(const char *str, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (str[i] == '=' || str[i] == '#' || !isprint((int)(uint8_t)str[i])) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+static const char *byte_find(const char *str, size_t size, char c)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (str[i] == c) {
+			return &str[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* lcz_kvp_validate_file before the word loop was added */
+static int byte_validate(const char *str, size_t size)
+{
+	size_t delimiters = 0;
+	size_t pairs = 0;
+	bool comment = false;
+	bool in_value = false;
+	size_t distance = 0;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (str[i] == '=' && !in_value) {
+			delimiters += 1;
+			in_value = true;
+			if (distance == 0) {
+				return -EINVAL;
+			}
+			distance = 0;
+		} else if (str[i] == '\n') {
+			in_value = false;
+			if (!comment) {
+				pairs += 1;
+				if (distance == 0) {
+					return -EINVAL;
+				}
+			}
+			comment = false;
+			distance = 0;
+		} else if (str[i] == '#') {
+			if (!comment) {
+				comment = true;
+				if (distance != 0) {
+					return -EINVAL;
+				}
+			}
+		} else if (!isprint((int)str[i])) {
+			return -EINVAL;
+		} else {
+			distance += 1;
+		}
+	}
+
+	return (delimiters != pairs) ? -EINVAL : (int)pairs;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file test_lcz_kvp_scan.h
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __TEST_LCZ_KVP_SCAN_H__
+#define __TEST_LCZ_KVP_SCAN_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/util.h>
+#include <ztest.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+void test_lcz_kvp_scan_plain(void);
+void test_lcz_kvp_scan_find(void);
+void test_lcz_kvp_scan_validate(void);
+void test_lcz_kvp_scan_benchmark(void);
+
+#endif /* __TEST_LCZ_KVP_SCAN_H__ */
@@ -0,0 +1,28 @@
+/**
+ * @file main.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "test_lcz_kvp_stream.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_main(void)
+{
+	ztest_test_suite(lcz_kvp_stream_test,
+			 ztest_unit_test(test_lcz_kvp_stream_pairs),
+			 ztest_unit_test(test_lcz_kvp_stream_chunk_boundary),
+			 ztest_unit_test(test_lcz_kvp_stream_malformed),
+			 ztest_unit_test(test_lcz_kvp_stream_truncated),
+			 ztest_unit_test(test_lcz_kvp_stream_line_size),
+			 ztest_unit_test(test_lcz_kvp_stream_callback));
+	ztest_run_test_suite(lcz_kvp_stream_test);
+}
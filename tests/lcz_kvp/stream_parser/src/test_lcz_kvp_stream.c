@@ -0,0 +1,306 @@
+/**
+ * @file test_lcz_kvp_stream.c
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+#include <fs/fs.h>
+#include "test_lcz_kvp_stream.h"
+#include "file_system_utilities.h"
+#include "lcz_kvp.h"
+#include "lcz_ramdisk.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define MNT "/tmp"
+#define KVP_FILE MNT "/test.kvp"
+#define CHUNK CONFIG_LCZ_KVP_STREAM_CHUNK_SIZE
+#define MAX_LINE CONFIG_LCZ_KVP_STREAM_MAX_LINE_SIZE
+#define FILE_SIZE 512
+#define PAIRS_SIZE 512
+
+/* Pairs passed to the callback are recorded as "key=value;" */
+struct pairs {
+	int count;
+	int stop_at;
+	char text[PAIRS_SIZE];
+};
+
+struct malformed {
+	const char *contents;
+	int count;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static struct fs_mount_t mnt = { .type = LCZ_RAMDISK_FS_TYPE,
+				 .mnt_point = MNT };
+
+static const lcz_kvp_cfg_t cfg = { .max_file_out_size = FILE_SIZE,
+				   .encrypted = false };
+
+static struct pairs found;
+static char contents[FILE_SIZE];
+
+/* Each is rejected with -EINVAL after count pairs have been passed */
+static const struct malformed malformed[] = {
+	{ "key\n", 0 },
+	{ "=value\n", 0 },
+	{ "key=\n", 0 },
+	{ "=\n", 0 },
+	{ "key=value#\n", 0 },
+	{ " #comment\n", 0 },
+	{ "key=val\tue\n", 0 },
+	{ "key=\x7F\n", 0 },
+	{ "a=1\nb=2\nc\n", 2 },
+	{ "a=1\n\n#c\nb=2\n=3\nd=4\n", 2 },
+};
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void fresh(void);
+static void write_file(const char *str, size_t size);
+static void reset(int stop_at);
+static int parse(const char *str);
+static int record(const lcz_kvp_t *kvp, void *context);
+static size_t fill_line(char *str, size_t length, const char *eol);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void test_lcz_kvp_stream_pairs(void)
+{
+	fresh();
+
+	zassert_equal(parse("# comment=ignored\n"
+			    "\n"
+			    "key1=value1\r\n"
+			    "\r\n"
+			    "key2=\"\"\n"
+			    "key3=a=b\n"
+			    "#\n"
+			    "k=\"x\"\n"),
+		      4, "Unexpected pair count");
+	zassert_equal(found.count, 4, "Unexpected callback count");
+	zassert_equal(strcmp(found.text, "key1=value1;key2=;key3=a=b;k=\"x\";"),
+		      0, "Unexpected pairs %s", found.text);
+
+	/* Comments and blank lines aren't pairs */
+	zassert_equal(parse("#only a comment\n\n\r\n"), 0,
+		      "Unexpected pair count");
+	zassert_equal(found.count, 0, "Callback called");
+}
+
+void test_lcz_kvp_stream_chunk_boundary(void)
+{
+	static const char *const eols[] = { "\n", "\r\n" };
+	size_t pad;
+	size_t i;
+	int r;
+
+	fresh();
+
+	/* Blank lines move the pairs across each position of the first two
+	 * chunks, so the key, delimiter, value, CR and LF are each split from
+	 * the rest of their line.
+	 */
+	for (i = 0; i < ARRAY_SIZE(eols); i++) {
+		for (pad = 0; pad <= (2 * CHUNK); pad++) {
+			memset(contents, '\n', pad);
+			strcpy(&contents[pad], "key=value");
+			strcat(contents, eols[i]);
+			strcat(contents, "k2=v2");
+			strcat(contents, eols[i]);
+
+			write_file(contents, strlen(contents));
+			reset(0);
+			r = lcz_kvp_parse_stream(&cfg, KVP_FILE, record, &found);
+			zassert_equal(r, 2, "Unexpected pair count %d pad %u", r,
+				      (unsigned int)pad);
+			zassert_equal(strcmp(found.text, "key=value;k2=v2;"), 0,
+				      "Unexpected pairs %s pad %u", found.text,
+				      (unsigned int)pad);
+		}
+	}
+}
+
+void test_lcz_kvp_stream_malformed(void)
+{
+	size_t i;
+
+	fresh();
+
+	for (i = 0; i < ARRAY_SIZE(malformed); i++) {
+		zassert_equal(parse(malformed[i].contents), -EINVAL,
+			      "Malformed file %u accepted", (unsigned int)i);
+		zassert_equal(found.count, malformed[i].count,
+			      "Unexpected callback count file %u",
+			      (unsigned int)i);
+	}
+}
+
+void test_lcz_kvp_stream_truncated(void)
+{
+	fresh();
+
+	/* The last line must end with a newline */
+	zassert_equal(parse("a=1\nb=2"), -EINVAL, "Missing newline accepted");
+	zassert_equal(found.count, 1, "Unexpected callback count");
+	zassert_equal(parse("a=1\r"), -EINVAL, "Missing newline accepted");
+	zassert_equal(found.count, 0, "Callback called");
+	zassert_equal(parse("#comment"), -EINVAL, "Missing newline accepted");
+
+	/* A file that is only line endings has no pairs */
+	zassert_equal(parse("\n"), 0, "Unexpected pair count");
+	zassert_equal(parse("\r\n\r\n"), 0, "Unexpected pair count");
+
+	zassert_equal(parse(""), -ENOENT, "Empty file accepted");
+	zassert_equal(found.count, 0, "Callback called");
+
+	zassert_true(lcz_kvp_parse_stream(&cfg, MNT "/missing.kvp", record,
+					  &found) < 0,
+		     "Missing file accepted");
+}
+
+void test_lcz_kvp_stream_line_size(void)
+{
+	size_t size;
+	size_t pad;
+
+	fresh();
+
+	/* The longest line that fits, CR isn't counted */
+	size = fill_line(contents, MAX_LINE - 1, "\n");
+	write_file(contents, size);
+	reset(0);
+	zassert_equal(lcz_kvp_parse_stream(&cfg, KVP_FILE, record, &found), 1,
+		      "Longest line rejected");
+
+	size = fill_line(contents, MAX_LINE - 1, "\r\n");
+	write_file(contents, size);
+	reset(0);
+	zassert_equal(lcz_kvp_parse_stream(&cfg, KVP_FILE, record, &found), 1,
+		      "Longest line with CR rejected");
+
+	/* One byte longer, found whether or not the newline is in the
+	 * chunk that completes the line.
+	 */
+	for (pad = 0; pad < CHUNK; pad++) {
+		memset(contents, '\n', pad);
+		size = pad + fill_line(&contents[pad], MAX_LINE, "\n");
+		write_file(contents, size);
+		reset(0);
+		zassert_equal(lcz_kvp_parse_stream(&cfg, KVP_FILE, record,
+						   &found),
+			      -E2BIG, "Long line accepted pad %u",
+			      (unsigned int)pad);
+	}
+
+	/* A line that never ends */
+	memset(contents, 'v', 4 * MAX_LINE);
+	memcpy(contents, "a=1\nk=", 6);
+	write_file(contents, 4 * MAX_LINE);
+	reset(0);
+	zassert_equal(lcz_kvp_parse_stream(&cfg, KVP_FILE, record, &found),
+		      -E2BIG, "Unterminated line accepted");
+	zassert_equal(found.count, 1, "Unexpected callback count");
+}
+
+void test_lcz_kvp_stream_callback(void)
+{
+	fresh();
+
+	/* The error from the callback is returned */
+	write_file("a=1\nb=2\nc=3\n", 12);
+	reset(2);
+	zassert_equal(lcz_kvp_parse_stream(&cfg, KVP_FILE, record, &found),
+		      -ECANCELED, "Callback error not returned");
+	zassert_equal(found.count, 2, "Parsing not stopped");
+	zassert_equal(strcmp(found.text, "a=1;"), 0, "Unexpected pairs %s",
+		      found.text);
+
+	zassert_equal(lcz_kvp_parse_stream(&cfg, KVP_FILE, NULL, NULL), -EINVAL,
+		      "Missing callback accepted");
+	zassert_equal(lcz_kvp_parse_stream(&cfg, NULL, record, &found), -EINVAL,
+		      "Missing name accepted");
+	zassert_equal(lcz_kvp_parse_stream(NULL, KVP_FILE, record, &found),
+		      -EINVAL, "Missing config accepted");
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* Mounting empties the file system */
+static void fresh(void)
+{
+	(void)fs_unmount(&mnt);
+	zassert_equal(fs_mount(&mnt), 0, "Mount failed");
+}
+
+static void write_file(const char *str, size_t size)
+{
+	zassert_equal(fsu_write_abs(KVP_FILE, (void *)str, size), size,
+		      "Write failed");
+}
+
+static void reset(int stop_at)
+{
+	found.count = 0;
+	found.stop_at = stop_at;
+	found.text[0] = '\0';
+}
+
+static int parse(const char *str)
+{
+	write_file(str, strlen(str));
+	reset(0);
+
+	return lcz_kvp_parse_stream(&cfg, KVP_FILE, record, &found);
+}
+
+/* Stops parsing on the pair numbered stop_at (starting at 1) */
+static int record(const lcz_kvp_t *kvp, void *context)
+{
+	struct pairs *p = context;
+	size_t used = strlen(p->text);
+
+	p->count += 1;
+	if (p->count == p->stop_at) {
+		return -ECANCELED;
+	}
+
+	zassert_true(kvp->key_len > 0, "Empty key");
+	zassert_true(kvp->val_len >= 0, "Negative value length");
+	zassert_true(used + kvp->key_len + kvp->val_len + 3 <= sizeof(p->text),
+		     "Too many pairs");
+
+	memcpy(&p->text[used], kvp->key, kvp->key_len);
+	used += kvp->key_len;
+	p->text[used++] = '=';
+	memcpy(&p->text[used], kvp->val, kvp->val_len);
+	used += kvp->val_len;
+	p->text[used++] = ';';
+	p->text[used] = '\0';
+
+	return 0;
+}
+
+/* A pair of length bytes (without the line ending) */
+static size_t fill_line(char *str, size_t length, const char *eol)
+{
+	memset(str, 'v', length);
+	memcpy(str, "k=", 2);
+	strcpy(&str[length], eol);
+
+	return length + strlen(eol);
+}
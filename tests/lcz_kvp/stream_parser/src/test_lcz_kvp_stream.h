@@ -0,0 +1,29 @@
+/**
+ * @file test_lcz_kvp_stream.h
+ * @brief
+ *
+ * Copyright (c) 2022 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __TEST_LCZ_KVP_STREAM_H__
+#define __TEST_LCZ_KVP_STREAM_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/util.h>
+#include <ztest.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+void test_lcz_kvp_stream_pairs(void);
+void test_lcz_kvp_stream_chunk_boundary(void);
+void test_lcz_kvp_stream_malformed(void);
+void test_lcz_kvp_stream_truncated(void);
+void test_lcz_kvp_stream_line_size(void);
+void test_lcz_kvp_stream_callback(void);
+
+#endif /* __TEST_LCZ_KVP_STREAM_H__ */
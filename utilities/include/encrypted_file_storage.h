@@ -15,6 +15,10 @@
 #include <stddef.h>
 #include <fs/fs.h>
 
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+#include <mbedtls/sha256.h>
+#endif
+
 #include "file_system_utilities.h"
 
 #ifdef __cplusplus
@@ -24,6 +28,48 @@ extern "C" {
 /**************************************************************************************************/
 /* Global Constants, Macros and Type Definitions                                                  */
 /**************************************************************************************************/
+#define EFS_FILE_NAME_HASH_SIZE FSU_HASH_SIZE
+
+/* Version 1 files are a sequence of 1024 byte blocks. Version 2 files start with a short
+ * prefix that selects the block size of the file.
+ */
+#define EFS_FORMAT_V1 1
+#define EFS_FORMAT_V2 2
+
+/* Version 2 file options */
+#define EFS_FLAG_HASH BIT(0) /* Each block holds the SHA256 of the data up to its end */
+
+/* Geometry of an encrypted file */
+struct efs_format {
+	uint8_t version;
+	uint8_t flags;
+	uint16_t data_offset; /* offset of the first block in the file */
+	uint16_t header_size; /* IV and authenticated data at the start of each block */
+	uint32_t file_block_size;
+	uint32_t user_block_size;
+	uint32_t payload_size; /* encrypted part of a block: user data and trailer */
+};
+
+/* Buffered append session. The partial trailing block is kept in plaintext in RAM and only
+ * full blocks are encrypted and written to the file until the session is flushed or closed.
+ * The structure is owned by the caller, but its members are private to this module.
+ */
+struct efs_writer {
+	char abs_path[FSU_MAX_ABS_PATH_SIZE + 1];
+	struct fs_file_t f;
+	struct efs_format fmt;
+	bool is_open;
+	bool tail_loaded;
+	bool dirty;
+	uint32_t block_number;
+	size_t block_size;
+	uint8_t file_name_hash[EFS_FILE_NAME_HASH_SIZE];
+	uint8_t *user_block;
+	uint8_t *file_block;
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+	mbedtls_sha256_context hash_ctx;
+#endif
+};
 
 /**************************************************************************************************/
 /* Global Function Prototypes                                                                     */
@@ -89,6 +135,9 @@ ssize_t efs_get_file_size(const char *abs_path);
  *
  * Hash is zeroed on start.
  *
+ * For files with EFS_FLAG_HASH, the hash of the entire file is taken from the last block
+ * without decrypting the rest of the file.
+ *
  * @param hash result
  * @param abs_path absolute file name
  * @param size of file in bytes
@@ -97,6 +146,79 @@ ssize_t efs_get_file_size(const char *abs_path);
  */
 int efs_sha256(uint8_t hash[FSU_HASH_SIZE], const char *abs_path, size_t size);
 
+/** @brief Open a buffered append session on an encrypted file
+ *
+ * The file is created if it does not exist. A new (or emptied) file uses the default format,
+ * otherwise the format of the existing file is kept. Data appended through the session is held in RAM
+ * until a full block is available, so small appends do not re-encrypt the last block of the
+ * file each time. Other readers of the file will not see buffered data until
+ * efs_writer_flush() or efs_writer_close() is called.
+ *
+ * @param writer session to initialize
+ * @param abs_path directory path and name
+ * @param truncate true to empty the file before appending
+ *
+ * @retval 0 on success, otherwise negative system error code.
+ */
+int efs_writer_open(struct efs_writer *writer, const char *abs_path, bool truncate);
+
+/** @brief Empty an encrypted file and open a buffered append session on it using the version 2
+ * format with the specified block size.
+ *
+ * Large blocks reduce the storage overhead and the number of encryption operations for bulk
+ * files. Small blocks reduce the cost of appending to and reading small files.
+ *
+ * @param writer session to initialize
+ * @param abs_path directory path and name
+ * @param block_size power of two from 512 to CONFIG_FSU_ENCRYPTED_FILES_MAX_BLOCK_SIZE,
+ * or 0 for CONFIG_FSU_ENCRYPTED_FILES_BLOCK_SIZE
+ * @param flags EFS_FLAG_HASH to keep the hash of the file up to date as it is appended
+ * (requires CONFIG_FSU_ENCRYPTED_FILES_HASH)
+ *
+ * @retval 0 on success, otherwise negative system error code.
+ */
+int efs_writer_create(struct efs_writer *writer, const char *abs_path, size_t block_size,
+		      uint8_t flags);
+
+/** @brief Append data to an open session
+ *
+ * @param writer open session
+ * @param vdata to be written
+ * @param size in bytes
+ *
+ * @retval negative error code, number of bytes accepted on success.
+ */
+int efs_writer_append(struct efs_writer *writer, const void *vdata, size_t size);
+
+/** @brief Write any buffered partial block to the file
+ *
+ * The session remains open. A later append will re-encrypt the partial block once.
+ *
+ * @param writer open session
+ *
+ * @retval 0 on success, otherwise negative system error code.
+ */
+int efs_writer_flush(struct efs_writer *writer);
+
+/** @brief Flush and close a session
+ *
+ * Buffered plaintext is cleared from the session structure.
+ *
+ * @param writer open session
+ *
+ * @retval 0 on success, otherwise negative system error code.
+ */
+int efs_writer_close(struct efs_writer *writer);
+
+/** @brief Forget the cached plaintext and size of a file
+ *
+ * Must be called when an encrypted file is changed without using this module
+ * (deleted, renamed or replaced). fsu_delete_abs, fsu_delete_files and fsu_rename_abs do this.
+ *
+ * @param abs_path directory path and name
+ */
+void efs_invalidate(const char *abs_path);
+
 #ifdef __cplusplus
 }
 #endif
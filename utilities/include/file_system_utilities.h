@@ -48,6 +48,32 @@ BUILD_ASSERT(CONFIG_FSU_MAX_FILE_NAME_SIZE < MAX_FILE_NAME,
 /* An empty string will match everything */
 #define FSU_EMPTY_STRING ""
 
+/* Fixed-block pools used instead of the heap for per-call buffers */
+enum fsu_pool {
+	FSU_POOL_DIRENT = 0,
+	FSU_POOL_CHUNK,
+	FSU_POOL_EFS_BLOCK,
+
+	FSU_POOL_COUNT
+};
+
+/**
+ * @param block_size size of each block in bytes
+ * @param blocks number of blocks
+ * @param used blocks currently allocated
+ * @param max_used largest number of blocks allocated at once
+ * @param allocs number of successful allocations
+ * @param failures number of allocations that timed out
+ */
+struct fsu_pool_stats {
+	size_t block_size;
+	uint32_t blocks;
+	uint32_t used;
+	uint32_t max_used;
+	uint32_t allocs;
+	uint32_t failures;
+};
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -67,7 +93,8 @@ void fsu_list_directory(const char *path);
  * @brief Find files that match name.
  *
  * @note Uses at least MAX_FILE_NAME bytes of stack.
- * Malloc requires (MAX_FILE_NAME * number of matching files) bytes.
+ * Malloc requires (MAX_FILE_NAME * number of matching files) bytes. The
+ * entry used while counting is taken from the FSU_POOL_DIRENT pool.
  *
  * Reduce memory requirements by limiting file name size with
  * CONFIG_FILE_SYSTEM_MAX_FILE_NAME. Alternatively,
@@ -164,7 +191,8 @@ int fsu_build_full_name(char *result, size_t max_size, const char *path,
  * if there is more than one matching file.
  *
  * @note This function uses stack for the directory entry struct.
- * The function fsu_get_file_size_abs uses malloc.  Using it is more efficient
+ * The function fsu_get_file_size_abs uses the directory entry pool.  Using it
+ * is more efficient
  * to determine if a file exists.
  *
  * @param path directory path
@@ -256,6 +284,16 @@ int fsu_delete_abs(const char *abs_path);
  */
 int fsu_delete_files(const char *path, const char *name);
 
+/**
+ * @brief Rename a file. An existing file with the new name is replaced.
+ *
+ * @param from absolute path of the file
+ * @param to new absolute path
+ *
+ * @retval negative error code, 0 on success
+ */
+int fsu_rename_abs(const char *from, const char *to);
+
 /**
  * @brief Creates a directory if it doesn't exist.
  *
@@ -315,8 +353,8 @@ ssize_t fsu_read_abs_block(const char *abs_path, uint32_t offset, void *data, si
 /**
  * @brief Get size of file
  *
- * @note Directory entry structure is allocated using malloc
- * which is at least MAX_FILE_NAME bytes.
+ * @note Directory entry structure is taken from the FSU_POOL_DIRENT pool
+ * (at least MAX_FILE_NAME bytes per entry).
  *
  * @param abs_path directory path and name
  *
@@ -327,8 +365,8 @@ ssize_t fsu_get_file_size_abs(const char *abs_path);
 /**
  * @brief Get size of file
  *
- * @note Directory entry structure is allocated using malloc
- * which is at least MAX_FILE_NAME bytes.
+ * @note Directory entry structure is taken from the FSU_POOL_DIRENT pool
+ * (at least MAX_FILE_NAME bytes per entry).
  *
  * @param path directory path
  * @param name file name
@@ -352,6 +390,37 @@ int fsu_simplify_path(const char *path_in, char *path_out);
 
 int fsu_get_last_history_file(const char *path);
 
+/**
+ * @brief Take a block from one of the fixed-block pools used by the file
+ * system utilities and encrypted file storage. Waits up to
+ * CONFIG_FSU_POOL_TIMEOUT milliseconds for a free block.
+ *
+ * @param pool pool to allocate from
+ *
+ * @retval pointer to block, NULL if none is free or the pool isn't
+ * configured
+ */
+void *fsu_pool_alloc(enum fsu_pool pool);
+
+/**
+ * @brief Return a block taken with fsu_pool_alloc.
+ *
+ * @param pool pool the block was taken from
+ * @param block block to free, may be NULL
+ */
+void fsu_pool_free(enum fsu_pool pool, void *block);
+
+/**
+ * @brief Get the size and usage of a pool.
+ *
+ * @param pool pool
+ * @param stats copy of the usage
+ *
+ * @retval 0 on success, -EINVAL for invalid parameters, -ENOTSUP if the pool
+ * isn't configured
+ */
+int fsu_pool_get_stats(enum fsu_pool pool, struct fsu_pool_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
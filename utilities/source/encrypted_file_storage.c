@@ -5,19 +5,47 @@
  *
  * SPDX-License-Identifier: LicenseRef-LairdConnectivity-Clause
  *
- * Encrypted files are stored using a block size of 1024 bytes (EFS_FILE_BLOCK_SIZE). Of this
- * 1024 bytes, 960 bytes are used to store encrypted "user" data (EFS_USER_BLOCK_SIZE). The
- * remaining 64 bytes are divided up into a block header of 48 bytes and a MAC of 16 bytes.
- * The header contains the initialization vector, the block number in the file, the number of
- * user bytes of data held by the block, and a SHA256 hash of the file name.
+ * Version 1 encrypted files are stored using a block size of 1024 bytes (EFS_V1_FILE_BLOCK_SIZE).
+ * Of this 1024 bytes, 960 bytes are used to store encrypted "user" data. The remaining 64 bytes
+ * are divided up into a block header of 48 bytes and a MAC of 16 bytes. The header contains the
+ * initialization vector, the block number in the file, the number of user bytes of data held by
+ * the block, and a SHA256 hash of the file name.
  *
- * A portion of the block header (defined in struct auth_data) is authenticated along with the
- * encrypted user data using the 16 byte MAC. This is done in order to prevent a block from
- * one file from being substituted into another file.
+ * Version 2 encrypted files start with a 16 byte prefix (struct efs_file_prefix) that holds a
+ * magic value and the block size of the file, followed by blocks of that size. The block size is
+ * a power of two of at least 512 bytes, so the size of a version 2 file is never a multiple of
+ * 1024 bytes and the two formats can't be confused. The block header is 56 bytes and also holds
+ * the format version and block size.
  *
- * File blocks are always full size. Plaintext user data is padded up to the 960 byte size to
+ * A portion of the block header (defined in struct efs_auth_data and struct efs_auth_data_v2) is
+ * authenticated along with the encrypted user data using the 16 byte MAC. This is done in order
+ * to prevent a block from one file from being substituted into another file. In version 2 files
+ * the block size is authenticated too, so the prefix can't be altered to change how the blocks
+ * of a file are interpreted.
+ *
+ * Version 2 files created with EFS_FLAG_HASH reserve a trailer at the end of the encrypted part
+ * of each block. The trailer (struct efs_hash_trailer) holds a magic value, a version and the
+ * SHA256 of all user data up to the end of that block, so the hash of the file is read from the
+ * last block alone. A writer session keeps the running hash in RAM; a session that appends to an
+ * existing file rehashes it once when the last block is loaded. Trailers that don't have the
+ * expected magic and version (such as those written before the trailer was versioned) are
+ * ignored and the hash is computed from the data.
+ *
+ * File blocks are always full size. Plaintext user data is padded up to the user block size to
  * ensure this. The data size in the header is always the actual number of real user bytes, not
  * including padding.
+ *
+ * Appends are made through a writer session (struct efs_writer). The session keeps the partial
+ * last block in RAM so that a stream of small appends only encrypts each full block once.
+ * efs_append() and efs_write() are single-use sessions.
+ *
+ * Decrypted blocks read by efs_read_block() are kept in a small LRU cache keyed by the file name
+ * hash and block number, so a file read in chunks smaller than a block is decrypted once per
+ * block. Writing to a file drops its cached blocks.
+ *
+ * The user size of a file is determined by the block_size of its last block. Once that block has
+ * been authenticated (or written by this module) its header is remembered, so later size queries
+ * only read the header of the last block and compare it instead of decrypting the block.
  */
 
 /**************************************************************************************************/
@@ -34,6 +62,9 @@ LOG_MODULE_REGISTER(lcz_efs, CONFIG_FSU_LOG_LEVEL);
 #include <init.h>
 #include <psa/crypto.h>
 #include <lcz_hw_key.h>
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+#include <mbedtls/sha256.h>
+#endif
 #include "file_system_utilities.h"
 #include "encrypted_file_storage.h"
 
@@ -42,34 +73,192 @@ LOG_MODULE_REGISTER(lcz_efs, CONFIG_FSU_LOG_LEVEL);
 /**************************************************************************************************/
 #define FSE_FILE_NAME_HASH_ALG PSA_ALG_SHA_256
 
-struct auth_data {
+BUILD_ASSERT(EFS_FILE_NAME_HASH_SIZE == PSA_HASH_LENGTH(FSE_FILE_NAME_HASH_ALG),
+	     "File name hash size mismatch");
+
+struct efs_auth_data {
 	uint16_t block_number; /* 960 bytes per block = maximum file size of 60 Mbytes */
 	uint16_t block_size; /* values between 1 and 960 bytes */
-	uint8_t file_name_hash[PSA_HASH_LENGTH(FSE_FILE_NAME_HASH_ALG)];
+	uint8_t file_name_hash[EFS_FILE_NAME_HASH_SIZE];
 };
 
 struct efs_block_header {
 	uint8_t iv[LCZ_HW_KEY_IV_LEN];
-	struct auth_data auth_data;
+	struct efs_auth_data auth_data;
+};
+
+struct efs_auth_data_v2 {
+	uint8_t version;
+	uint8_t block_shift; /* file block size is (1 << block_shift) */
+	uint16_t flags;
+	uint32_t block_number;
+	uint32_t block_size; /* number of user bytes in the block */
+	uint8_t file_name_hash[EFS_FILE_NAME_HASH_SIZE];
+};
+
+struct efs_block_header_v2 {
+	uint8_t iv[LCZ_HW_KEY_IV_LEN];
+	struct efs_auth_data_v2 auth_data;
+};
+
+struct efs_file_prefix {
+	uint8_t magic[4];
+	uint8_t version;
+	uint8_t block_shift;
+	uint8_t flags;
+	uint8_t reserved[9];
 };
 
-#define EFS_FILE_BLOCK_SIZE 1024
-#define EFS_USER_BLOCK_SIZE                                                                        \
-	(EFS_FILE_BLOCK_SIZE - (sizeof(struct efs_block_header) + LCZ_HW_KEY_MAC_LEN))
+/* The authenticated data directly follows the IV in both block header versions */
+BUILD_ASSERT(offsetof(struct efs_block_header, auth_data) == LCZ_HW_KEY_IV_LEN,
+	     "Unexpected v1 header layout");
+BUILD_ASSERT(offsetof(struct efs_block_header_v2, auth_data) == LCZ_HW_KEY_IV_LEN,
+	     "Unexpected v2 header layout");
+
+#define EFS_V1_FILE_BLOCK_SIZE 1024
+
+#define EFS_V2_MIN_BLOCK_SHIFT 9
+#define EFS_V2_MIN_BLOCK_SIZE (1 << EFS_V2_MIN_BLOCK_SHIFT)
+
+BUILD_ASSERT(sizeof(struct efs_file_prefix) < EFS_V2_MIN_BLOCK_SIZE &&
+		     (EFS_V1_FILE_BLOCK_SIZE % EFS_V2_MIN_BLOCK_SIZE) == 0,
+	     "Version 2 file sizes must not be a multiple of the version 1 block size");
+
+#define EFS_MAX_FILE_BLOCK_SIZE CONFIG_FSU_ENCRYPTED_FILES_MAX_BLOCK_SIZE
+#define EFS_MAX_HEADER_SIZE (sizeof(struct efs_block_header_v2))
+#define EFS_MAX_USER_BLOCK_SIZE                                                                    \
+	(EFS_MAX_FILE_BLOCK_SIZE - (sizeof(struct efs_block_header) + LCZ_HW_KEY_MAC_LEN))
+
+BUILD_ASSERT(EFS_MAX_FILE_BLOCK_SIZE >= EFS_V1_FILE_BLOCK_SIZE,
+	     "Maximum block size must hold a version 1 block");
+BUILD_ASSERT((EFS_MAX_FILE_BLOCK_SIZE % 16) == 0,
+	     "Maximum block size must be a multiple of the AES block size");
+BUILD_ASSERT(CONFIG_FSU_ENCRYPTED_FILES_BLOCK_SIZE >= EFS_V2_MIN_BLOCK_SIZE &&
+		     CONFIG_FSU_ENCRYPTED_FILES_BLOCK_SIZE <= EFS_MAX_FILE_BLOCK_SIZE &&
+		     (CONFIG_FSU_ENCRYPTED_FILES_BLOCK_SIZE &
+		      (CONFIG_FSU_ENCRYPTED_FILES_BLOCK_SIZE - 1)) == 0,
+	     "Default block size must be a power of two from 512 to the maximum block size");
+
+/* The trailer size is fixed so that files remain readable when hashing isn't enabled. The
+ * unused part of the trailer is zero.
+ */
+#define EFS_HASH_TRAILER_SIZE 128
+
+#define EFS_HASH_TRAILER_MAGIC 0x48534645 /* "EFSH" */
+#define EFS_HASH_TRAILER_VERSION 1
+
+struct efs_hash_trailer {
+	uint32_t magic;
+	uint8_t version;
+	uint8_t reserved[3];
+	uint8_t hash[FSU_HASH_SIZE];
+} __packed;
 
-#define EFS_FILE_BLOCK_ENC_OFFSET (sizeof(struct efs_block_header))
+BUILD_ASSERT(sizeof(struct efs_hash_trailer) <= EFS_HASH_TRAILER_SIZE,
+	     "Hash trailer doesn't fit in the block");
+
+#define EFS_SUPPORTED_FLAGS (EFS_FLAG_HASH)
+
+#define EFS_BLOCK_CACHE_SIZE CONFIG_FSU_ENCRYPTED_FILES_BLOCK_CACHE_SIZE
+
+#define EFS_SIZE_MEMO_SIZE CONFIG_FSU_ENCRYPTED_FILES_SIZE_CACHE_SIZE
+
+#if EFS_SIZE_MEMO_SIZE > 0
+/* The last block header (random IV and authenticated data) of a file as it was when its MAC
+ * was last verified or when this module wrote it.
+ */
+struct efs_size_memo {
+	bool valid;
+	uint32_t last_used;
+	uint8_t file_name_hash[EFS_FILE_NAME_HASH_SIZE];
+	off_t file_size;
+	ssize_t user_size;
+	uint16_t header_size;
+	uint8_t last_hdr[EFS_MAX_HEADER_SIZE];
+};
+#endif
+
+#if EFS_BLOCK_CACHE_SIZE > 0
+struct efs_cache_entry {
+	bool valid;
+	uint32_t block_number;
+	uint32_t block_size;
+	uint32_t user_block_size;
+	uint32_t last_used;
+	uint8_t file_name_hash[EFS_FILE_NAME_HASH_SIZE];
+	uint8_t user_block[EFS_MAX_USER_BLOCK_SIZE];
+};
+#endif
 
 /**************************************************************************************************/
 /* Local Function Prototypes                                                                      */
 /**************************************************************************************************/
 static int file_name_hash_gen(const char *abs_path, uint8_t *hash, uint8_t hash_len);
-static int file_name_hash_comp(const char *abs_path, uint8_t *hash, uint8_t hash_len);
-static int encrypt_block(struct efs_block_header *hdr, uint8_t *user_data, ssize_t user_data_len,
-			 uint8_t *out);
-static int decrypt_block(const char *abs_path, int block_number, struct efs_block_header *hdr,
-			 uint8_t *in_data, int in_data_len, uint8_t *out_data, int out_data_len);
+static int format_init(struct efs_format *fmt, uint8_t version, size_t block_size,
+		       uint8_t flags);
+static int format_writable(const struct efs_format *fmt);
+static int format_default(struct efs_format *fmt);
+static int format_probe(struct fs_file_t *f, off_t file_size, struct efs_format *fmt);
+static int format_write_prefix(struct fs_file_t *f, const struct efs_format *fmt);
+static off_t block_position(const struct efs_format *fmt, uint32_t block_number);
+static int file_open(struct fs_file_t *f, const char *abs_path, fs_mode_t flags,
+		     struct efs_format *fmt, off_t *file_size);
+static int encrypt_block(const struct efs_format *fmt, const uint8_t *name_hash,
+			 uint32_t block_number, const uint8_t *user_data, size_t block_size,
+			 uint8_t *file_block);
+static int decrypt_block(const struct efs_format *fmt, const uint8_t *name_hash,
+			 uint32_t block_number, uint8_t *file_block, uint8_t *user_data,
+			 size_t *block_size);
+static int read_block(struct fs_file_t *f, const struct efs_format *fmt, const uint8_t *name_hash,
+		      uint32_t block_number, uint8_t *file_block, uint8_t *user_data,
+		      size_t *block_size);
+static int writer_open(struct efs_writer *writer, const char *abs_path, bool truncate,
+		       size_t block_size, uint8_t flags);
+static int append_session(const char *abs_path, const void *data, size_t size, bool truncate);
+static int writer_load_tail(struct efs_writer *writer);
+static int writer_rehash(struct efs_writer *writer);
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+static int writer_hash_update(struct efs_writer *writer, const uint8_t *data, size_t size);
+static int writer_trailer(struct efs_writer *writer, uint8_t *trailer);
+#endif
+static int writer_write_block(struct efs_writer *writer, const uint8_t *user_data,
+			      size_t user_data_len);
+static int hash_from_trailer(const struct efs_format *fmt, const uint8_t *payload,
+			     uint8_t hash[FSU_HASH_SIZE]);
+static uint8_t *buffers_alloc(uint8_t **user_block);
+static void buffers_free(const struct efs_format *fmt, uint8_t *file_block, uint8_t *user_block);
+static int cache_read(const uint8_t *name_hash, uint32_t offset, uint8_t *out, size_t out_len,
+		      size_t *copied, bool *full);
+static void cache_write(const uint8_t *name_hash, const struct efs_format *fmt,
+			uint32_t block_number, const uint8_t *user_block, size_t block_size);
+static void cache_invalidate(const uint8_t *name_hash);
+static void cache_invalidate_blocks(const uint8_t *name_hash);
+static ssize_t size_memo_read(const uint8_t *name_hash, off_t file_size,
+			      const struct efs_format *fmt, const uint8_t *last_hdr);
+static void size_memo_write(const uint8_t *name_hash, off_t file_size,
+			    const struct efs_format *fmt, const uint8_t *last_hdr,
+			    ssize_t user_size);
 static int lcz_enc_fs_init(const struct device *device);
 
+/**************************************************************************************************/
+/* Local Data Definitions                                                                         */
+/**************************************************************************************************/
+static K_MUTEX_DEFINE(efs_cache_lock);
+
+#if EFS_BLOCK_CACHE_SIZE > 0 || EFS_SIZE_MEMO_SIZE > 0
+static uint32_t efs_cache_use_count;
+#endif
+
+#if EFS_BLOCK_CACHE_SIZE > 0
+static struct efs_cache_entry efs_cache[EFS_BLOCK_CACHE_SIZE];
+#endif
+
+#if EFS_SIZE_MEMO_SIZE > 0
+static struct efs_size_memo efs_size_memo[EFS_SIZE_MEMO_SIZE];
+#endif
+
+static const uint8_t efs_v2_magic[] = { 'L', 'E', 'F', 'S' };
+
 /**************************************************************************************************/
 /* Global Function Definitions                                                                    */
 /**************************************************************************************************/
@@ -94,73 +283,188 @@ bool efs_is_encrypted_path(const char *abs_path)
 }
 
 int efs_write(const char *abs_path, void *vdata, size_t size)
+{
+	return append_session(abs_path, vdata, size, true);
+}
+
+int efs_append(const char *abs_path, void *vdata, size_t size)
+{
+	return append_session(abs_path, vdata, size, false);
+}
+
+ssize_t efs_read(const char *abs_path, void *vdata, size_t size)
+{
+	return efs_read_block(abs_path, 0, vdata, size);
+}
+
+ssize_t efs_read_block(const char *abs_path, int offset, void *vdata, size_t size)
 {
 	char *data = (char *)vdata;
+	char simple_path[FSU_MAX_ABS_PATH_SIZE + 1];
+	uint8_t name_hash[EFS_FILE_NAME_HASH_SIZE];
+	struct efs_format fmt;
+	uint32_t block_num;
+	size_t block_offset;
+	size_t block_size;
+	size_t this_size;
+	bool full = false;
+	int copied = 0;
+	off_t file_size = 0;
+	uint8_t *file_block = NULL;
+	uint8_t *user_block = NULL;
+	struct fs_file_t f;
+	bool opened = false;
 	int ret = 0;
 	int ret2;
-	struct fs_file_t f;
 
 	/* Validate the input parameters */
-	if (abs_path == NULL) {
-		LOG_ERR("efs_write: invalid path");
+	if (abs_path == NULL || data == NULL || size == 0 || offset < 0) {
 		ret = -EINVAL;
 	}
 
-	/* Open the file for writing */
-	fs_file_t_init(&f);
+	/* Remove any extra slashes in the path */
 	if (ret == 0) {
-		ret = fs_open(&f, abs_path, FS_O_WRITE | FS_O_CREATE);
+		ret = fsu_simplify_path(abs_path, simple_path);
 		if (ret < 0) {
-			LOG_ERR("efs_write: fs_open failed %d", ret);
+			LOG_ERR("efs_read_block: Invalid input path: %s", abs_path);
+		} else {
+			ret = 0;
+		}
+	}
+
+	/* Make sure the file still exists before using any cached blocks */
+	if (ret == 0) {
+		ret2 = fsu_get_file_size_abs(simple_path);
+		if (ret2 < 0) {
+			ret = ret2;
 		}
 	}
 
-	/* Empty the file */
+	/* Cached blocks are keyed by the same hash that is authenticated in the block header */
 	if (ret == 0) {
-		ret = fs_truncate(&f, 0);
+		ret = file_name_hash_gen(simple_path, name_hash, sizeof(name_hash));
 		if (ret < 0) {
-			LOG_ERR("efs_write: Could not truncate file: %d", ret);
+			LOG_ERR("efs_read_block: Couldn't hash filename: %d", ret);
 		}
 	}
 
-	/* Close the file */
-	ret2 = fs_close(&f);
-	if (ret2 < 0) {
-		LOG_ERR("efs_write: Could not close file: %d", ret2);
+	/* Read the block(s) of the file */
+	while (ret == 0 && size > 0) {
+		/* Try the cache first. The file is only opened if a block must be decrypted. */
+		if (cache_read(name_hash, offset, data, size, &this_size, &full) != 0) {
+			/* Open the file and determine its format */
+			if (!opened) {
+				ret = file_open(&f, simple_path, FS_O_READ, &fmt, &file_size);
+				if (ret == 0) {
+					opened = true;
+				}
+			}
+
+			/* Allocate memory for the file and output blocks */
+			if (ret == 0 && file_block == NULL) {
+				file_block = buffers_alloc(&user_block);
+				if (file_block == NULL) {
+					LOG_ERR("efs_read_block: Could not allocate memory for the blocks");
+					ret = -ENOMEM;
+				}
+			}
+
+			/* Compute which encrypted block the offset should be in */
+			if (ret == 0) {
+				block_num = offset / fmt.user_block_size;
+				block_offset = offset % fmt.user_block_size;
+			}
+
+			/* Make sure that the file is large enough to contain the requested block */
+			if (ret == 0 &&
+			    (block_position(&fmt, block_num) + fmt.file_block_size) > file_size) {
+				if (copied == 0) {
+					LOG_ERR("efs_read_block: File is not large enough (%d) for requested offset (%d)",
+						file_size, offset);
+					ret = -EINVAL;
+				}
+				break;
+			}
+
+			/* Read and decrypt the block */
+			if (ret == 0) {
+				ret = read_block(&f, &fmt, name_hash, block_num, file_block,
+						 user_block, &block_size);
+				if (ret < 0) {
+					LOG_ERR("efs_read_block: read failed for block %d",
+						block_num);
+				}
+			}
+
+			/* Copy the decrypted data to the user's buffer */
+			if (ret == 0) {
+				cache_write(name_hash, &fmt, block_num, user_block, block_size);
+
+				/* Limit the data size to what is in this block */
+				this_size = 0;
+				if (block_offset < block_size) {
+					this_size = MIN(size, block_size - block_offset);
+					memcpy(data, user_block + block_offset, this_size);
+				}
+				full = (block_size == fmt.user_block_size);
+			}
+		}
+
+		/* Update pointers/counters */
 		if (ret == 0) {
-			ret = ret2;
+			data += this_size;
+			size -= this_size;
+			offset += this_size;
+			copied += this_size;
+
+			/* There shouldn't be another block after one that isn't "full" */
+			if (!full || this_size == 0) {
+				break;
+			}
 		}
 	}
 
-	/* Now append the new data */
-	if (ret == 0) {
-		ret = efs_append(abs_path, data, size);
+	/* Close the file */
+	if (opened) {
+		ret2 = fs_close(&f);
+		if (ret2 < 0) {
+			LOG_ERR("efs_read_block: Could not close file: %d", ret2);
+			if (ret >= 0) {
+				ret = ret2;
+			}
+		}
 	}
 
+	/* Free any memory that we allocated */
+	buffers_free(&fmt, file_block, user_block);
+
+	/* Return error or the number of bytes copied */
+	if (ret == 0) {
+		ret = copied;
+	}
 	return ret;
 }
 
-int efs_append(const char *abs_path, void *vdata, size_t size)
+ssize_t efs_get_file_size(const char *abs_path)
 {
-	char *data = (char *)vdata;
 	char simple_path[FSU_MAX_ABS_PATH_SIZE + 1];
+	uint8_t name_hash[EFS_FILE_NAME_HASH_SIZE];
+	uint8_t last_hdr[EFS_MAX_HEADER_SIZE];
+	struct efs_format fmt;
+	off_t file_size = 0;
+	uint32_t num_blocks = 0;
+	uint32_t block_offset = 0;
+	size_t block_size;
+	ssize_t user_size;
 	int ret = 0;
 	int ret2;
-	ssize_t file_size = 0;
-	int this_size;
-	struct fs_file_t f;
 	uint8_t *file_block = NULL;
 	uint8_t *user_block = NULL;
-	int block_offset = 0;
-	int copied = 0;
-	struct efs_block_header *hdr = NULL;
+	struct fs_file_t f;
+	bool opened = false;
 
-	/* Validate input parameters */
+	/* Validate the input parameters */
 	if (abs_path == NULL) {
-		LOG_ERR("efs_append: invalid path");
-		ret = -EINVAL;
-	} else if (size != 0 && data == NULL) {
-		LOG_ERR("efs_append: null data pointer for size %d", size);
 		ret = -EINVAL;
 	}
 
@@ -168,522 +472,643 @@ int efs_append(const char *abs_path, void *vdata, size_t size)
 	if (ret == 0) {
 		ret = fsu_simplify_path(abs_path, simple_path);
 		if (ret < 0) {
-			LOG_ERR("efs_append: Invalid input path: %s", abs_path);
+			LOG_ERR("efs_get_file_size: Invalid input path: %s", abs_path);
 		} else {
 			ret = 0;
 		}
 	}
 
-	/* Check current file size */
-	if (ret == 0) {
-		file_size = fsu_get_file_size_abs(simple_path);
-		if (file_size < 0) {
-			/* Assume file doesn't exist */
-			file_size = 0;
-		}
-	}
-
-	/* Encrypted files must be a multiple of the block size */
-	if (ret == 0) {
-		if ((file_size % EFS_FILE_BLOCK_SIZE) != 0) {
-			LOG_ERR("efs_append: File is not multiple of block size");
-			ret = -EINVAL;
-		}
-	}
-
-	/* Allocate memory for the file block */
-	if (ret == 0) {
-		file_block = (uint8_t *)k_malloc(EFS_FILE_BLOCK_SIZE);
-		if (file_block == NULL) {
-			LOG_ERR("efs_append: Could not allocate memory for the file block");
-			ret = -ENOMEM;
-		}
-		hdr = (struct efs_block_header *)file_block;
-	}
-
-	/* Allocate memory for the output block */
+	/* Open the file and determine its format */
 	if (ret == 0) {
-		user_block = (uint8_t *)k_malloc(EFS_USER_BLOCK_SIZE);
-		if (user_block == NULL) {
-			LOG_ERR("efs_append: Could not allocate memory for the user block");
-			ret = -ENOMEM;
+		ret = file_open(&f, simple_path, FS_O_READ, &fmt, &file_size);
+		if (ret < 0) {
+			LOG_ERR("efs_get_file_size: Could not open file: %d", ret);
+		} else {
+			opened = true;
 		}
 	}
 
-	/* Open the file for read and write */
-	fs_file_t_init(&f);
+	/* Get the number of file blocks */
 	if (ret == 0) {
-		ret = fs_open(&f, simple_path, FS_O_RDWR | FS_O_CREATE);
-		if (ret < 0) {
-			LOG_ERR("efs_append: fs_open failed %d", ret);
-		}
+		num_blocks = (file_size - fmt.data_offset) / fmt.file_block_size;
 	}
 
-	/* If the file is not empty, try to fill up the last block first */
-	if (ret == 0 && size > 0 && file_size > 0) {
-		/* Seek to the start of the last encrypted block */
-		block_offset = (file_size / EFS_FILE_BLOCK_SIZE) - 1;
-		ret = fs_seek(&f, block_offset * EFS_FILE_BLOCK_SIZE, FS_SEEK_SET);
+	/* Read only the header of the last block */
+	if (ret == 0 && num_blocks > 0) {
+		block_offset = num_blocks - 1;
+		ret = fs_seek(&f, block_position(&fmt, block_offset), FS_SEEK_SET);
 		if (ret < 0) {
-			LOG_ERR("efs_append: seek failed to block %d: %d", block_offset, ret);
-		}
-
-		/* Read the encrypted block */
-		if (ret == 0) {
-			ret = fs_read(&f, file_block, EFS_FILE_BLOCK_SIZE);
+			LOG_ERR("efs_get_file_size: seek failed to block %d: %d", block_offset,
+				ret);
+		} else {
+			ret = fs_read(&f, last_hdr, fmt.header_size);
 			if (ret < 0) {
-				LOG_ERR("efs_append: read failed for block %d: %d", block_offset,
-					ret);
-			} else if (ret != EFS_FILE_BLOCK_SIZE) {
-				LOG_ERR("efs_append: Read only returned %d bytes", ret);
+				LOG_ERR("efs_get_file_size: read failed for block %d: %d",
+					block_offset, ret);
+			} else if (ret != fmt.header_size) {
+				LOG_ERR("efs_get_file_size: Read only returned %d bytes", ret);
 				ret = -EIO;
 			} else {
 				/* Good read */
 				ret = 0;
 			}
 		}
-
-		/* Decrypt the block */
-		if (ret == 0) {
-			ret = decrypt_block(simple_path, block_offset, hdr,
-					    file_block + EFS_FILE_BLOCK_ENC_OFFSET,
-					    EFS_FILE_BLOCK_SIZE - EFS_FILE_BLOCK_ENC_OFFSET,
-					    user_block, EFS_USER_BLOCK_SIZE);
-			if (ret < 0) {
-				LOG_ERR("efs_append: decrypt failed for block %d: %d", block_offset,
-					ret);
-			}
-		}
-
-		if (ret == 0) {
-			/* If there is space, add all or part of the new data to the end of the block */
-			if (hdr->auth_data.block_size < EFS_USER_BLOCK_SIZE) {
-				/* Figure out how much data can fit */
-				this_size = size;
-				if (this_size > (EFS_USER_BLOCK_SIZE - hdr->auth_data.block_size)) {
-					this_size = EFS_USER_BLOCK_SIZE - hdr->auth_data.block_size;
-				}
-
-				/* Copy what we can */
-				memcpy(user_block + hdr->auth_data.block_size, data, this_size);
-
-				/* Update pointers and lengths */
-				data += this_size;
-				size -= this_size;
-				copied += this_size;
-				hdr->auth_data.block_size += this_size;
-
-				/* Zero out the rest */
-				if (hdr->auth_data.block_size != EFS_USER_BLOCK_SIZE) {
-					memset(user_block + hdr->auth_data.block_size, 0,
-					       EFS_USER_BLOCK_SIZE - hdr->auth_data.block_size);
-				}
-
-				/* Re-encrypt the block */
-				ret = encrypt_block(hdr, user_block, EFS_USER_BLOCK_SIZE,
-						    file_block + EFS_FILE_BLOCK_ENC_OFFSET);
-				if (ret < 0) {
-					LOG_ERR("efs_append: encrypt failed for block %d: %d",
-						block_offset, ret);
-				}
-
-				/* Reset the file pointer */
-				if (ret == 0) {
-					ret = fs_seek(&f, block_offset * EFS_FILE_BLOCK_SIZE,
-						      FS_SEEK_SET);
-					if (ret < 0) {
-						LOG_ERR("efs_append: seek failed to block %d: %d",
-							block_offset, ret);
-					}
-				}
-
-				/* Write the block back to the file */
-				if (ret == 0) {
-					ret = fs_write(&f, file_block, EFS_FILE_BLOCK_SIZE);
-					if (ret < 0) {
-						LOG_ERR("efs_append: write failed to block %d: %d",
-							block_offset, ret);
-					} else if (ret != EFS_FILE_BLOCK_SIZE) {
-						LOG_ERR("efs_append: write only wrote %d bytes",
-							ret);
-						ret = -EIO;
-					} else {
-						/* Good write */
-						ret = 0;
-					}
-				}
-				/* File pointer should now be at the end of the file */
-
-				/* Update block offset */
-				block_offset++;
-			}
-		}
 	}
 
-	/* Start to fill in the block header */
-	if (ret == 0) {
-		ret = file_name_hash_gen(simple_path, hdr->auth_data.file_name_hash,
-					 sizeof(hdr->auth_data.file_name_hash));
+	if (ret == 0 && num_blocks > 0) {
+		ret = file_name_hash_gen(simple_path, name_hash, sizeof(name_hash));
 		if (ret < 0) {
-			LOG_ERR("efs_append: Couldn't hash filename: %d", ret);
+			LOG_ERR("efs_get_file_size: Couldn't hash filename: %d", ret);
 		}
 	}
 
-	/* Chunk the data into EFS_USER_BLOCK_SIZE bytes to write into the file */
-	while (ret == 0 && size > 0) {
-		this_size = size;
-		if (this_size > EFS_USER_BLOCK_SIZE) {
-			this_size = EFS_USER_BLOCK_SIZE;
+	/* If the last block is the one that was previously authenticated, the size is known */
+	if (ret == 0 && num_blocks > 0) {
+		user_size = size_memo_read(name_hash, file_size, &fmt, last_hdr);
+		if (user_size >= 0) {
+			(void)fs_close(&f);
+			return user_size;
 		}
+	}
 
-		/* Populate the header for this block */
-		hdr->auth_data.block_number = block_offset;
-		hdr->auth_data.block_size = this_size;
-
-		/* Encrypt the block */
-		if (this_size == EFS_USER_BLOCK_SIZE) {
-			/* For a full block, don't make a copy of the user data first */
-			ret = encrypt_block(hdr, data, this_size,
-					    file_block + EFS_FILE_BLOCK_ENC_OFFSET);
-		} else {
-			/* For a block needing padding, copy the user data and then pad */
-			memcpy(user_block, data, this_size);
-			memset(user_block + this_size, 0, EFS_USER_BLOCK_SIZE - this_size);
-			ret = encrypt_block(hdr, user_block, EFS_USER_BLOCK_SIZE,
-					    file_block + EFS_FILE_BLOCK_ENC_OFFSET);
+	/* Allocate memory for the file and output blocks */
+	if (ret == 0 && num_blocks > 0) {
+		file_block = buffers_alloc(&user_block);
+		if (file_block == NULL) {
+			LOG_ERR("efs_get_file_size: Could not allocate memory for the blocks");
+			ret = -ENOMEM;
 		}
+	}
+
+	/* Read and decrypt the last block */
+	if (ret == 0 && num_blocks > 0) {
+		ret = read_block(&f, &fmt, name_hash, block_offset, file_block, user_block,
+				 &block_size);
 		if (ret < 0) {
-			LOG_ERR("efs_append: encrypt failed for new block %d: %d", block_offset,
-				ret);
+			LOG_ERR("efs_get_file_size: decrypt failed for block %d", block_offset);
 		}
+	}
 
-		/* Write the block back to the file */
-		if (ret == 0) {
-			ret = fs_write(&f, file_block, EFS_FILE_BLOCK_SIZE);
-			if (ret < 0) {
-				LOG_ERR("efs_append: write failed to new block %d: %d",
-					block_offset, ret);
-			} else if (ret != EFS_FILE_BLOCK_SIZE) {
-				LOG_ERR("efs_append: new write only wrote %d bytes", ret);
-				ret = -EIO;
-			} else {
-				/* Good write */
-				ret = 0;
+	/* Close the file */
+	if (opened) {
+		ret2 = fs_close(&f);
+		if (ret2 < 0) {
+			LOG_ERR("efs_get_file_size: Could not close file: %d", ret2);
+			if (ret == 0) {
+				ret = ret2;
 			}
 		}
-
-		/* Update pointers/counters */
-		if (ret == 0) {
-			block_offset++;
-			data += this_size;
-			size -= this_size;
-			copied += this_size;
-		}
 	}
 
-	/* Close the file */
-	ret2 = fs_close(&f);
-	if (ret2 < 0) {
-		LOG_ERR("efs_append: Could not close file: %d", ret2);
-		if (ret >= 0) {
-			ret = ret2;
-		}
+	/* Compute the file size and remember the header it was authenticated with */
+	if (ret == 0 && num_blocks > 0) {
+		user_size = ((num_blocks - 1) * fmt.user_block_size) + block_size;
+		size_memo_write(name_hash, file_size, &fmt, file_block, user_size);
+		ret = user_size;
 	}
 
 	/* Free any memory that we allocated */
-	if (file_block != NULL) {
-		memset(file_block, 0, EFS_FILE_BLOCK_SIZE);
-		k_free(file_block);
-	}
-	if (user_block != NULL) {
-		memset(user_block, 0, EFS_USER_BLOCK_SIZE);
-		k_free(user_block);
-	}
+	buffers_free(&fmt, file_block, user_block);
 
-	/* Return the error or the number of bytes written */
-	if (ret == 0) {
-		ret = copied;
-	}
 	return ret;
 }
 
-ssize_t efs_read(const char *abs_path, void *vdata, size_t size)
-{
-	return efs_read_block(abs_path, 0, vdata, size);
-}
-
-ssize_t efs_read_block(const char *abs_path, int offset, void *vdata, size_t size)
+int efs_sha256(uint8_t hash[FSU_HASH_SIZE], const char *abs_path, size_t size)
 {
-	char *data = (char *)vdata;
 	char simple_path[FSU_MAX_ABS_PATH_SIZE + 1];
-	int block_num;
-	int block_offset;
-	int this_size;
-	int copied = 0;
-	ssize_t file_size = 0;
+	uint8_t name_hash[EFS_FILE_NAME_HASH_SIZE];
+	struct efs_format fmt;
+	uint32_t block_offset = 0;
+	size_t block_size;
+	size_t this_size;
+	off_t file_size;
 	uint8_t *file_block = NULL;
 	uint8_t *user_block = NULL;
-	struct efs_block_header *hdr;
 	struct fs_file_t f;
+	bool opened = false;
+	bool from_trailer = false;
 	int ret = 0;
 	int ret2;
+	psa_hash_operation_t operation = PSA_HASH_OPERATION_INIT;
+	psa_status_t psa_ret;
+	size_t hash_out_len = 0;
+
+	/* Start the hash operation */
+	psa_ret = psa_hash_setup(&operation, PSA_ALG_SHA_256);
+	if (psa_ret != PSA_SUCCESS) {
+		LOG_ERR("efs_sha256: Failed to setup hash operation: %d", psa_ret);
+		ret = psa_ret;
+	}
 
 	/* Validate the input parameters */
-	if (abs_path == NULL || data == NULL || size == 0) {
-		ret = -EINVAL;
+	if (ret == 0) {
+		if (abs_path == NULL || hash == NULL || size == 0) {
+			LOG_ERR("efs_sha256: Invalid input parameters");
+			ret = -EINVAL;
+		}
 	}
 
 	/* Remove any extra slashes in the path */
 	if (ret == 0) {
 		ret = fsu_simplify_path(abs_path, simple_path);
 		if (ret < 0) {
-			LOG_ERR("efs_read_block: Invalid input path: %s", abs_path);
+			LOG_ERR("efs_sha256: Invalid input path: %s", abs_path);
 		} else {
 			ret = 0;
 		}
 	}
 
-	/* Compute which encrypted block the offset should be in */
-	block_num = offset / EFS_USER_BLOCK_SIZE;
-	block_offset = offset % EFS_USER_BLOCK_SIZE;
-
-	/* Read the file size */
 	if (ret == 0) {
-		file_size = fsu_get_file_size_abs(simple_path);
-		if (file_size < 0) {
-			ret = file_size;
+		ret = file_name_hash_gen(simple_path, name_hash, sizeof(name_hash));
+		if (ret < 0) {
+			LOG_ERR("efs_sha256: Couldn't hash filename: %d", ret);
 		}
 	}
 
-	/* Make sure that the file is a mulitple of the encrypted block size */
+	/* Open the file and determine its format */
 	if (ret == 0) {
-		if ((file_size % EFS_FILE_BLOCK_SIZE) != 0) {
-			LOG_ERR("efs_read_block: File is not multiple of block size (%d)",
-				file_size);
-			ret = -EINVAL;
+		ret = file_open(&f, simple_path, FS_O_READ, &fmt, &file_size);
+		if (ret < 0) {
+			LOG_ERR("efs_sha256: Could not open file: %d", ret);
+		} else {
+			opened = true;
 		}
 	}
 
-	/* Make sure that the file is large enough to contain the requested block */
+	/* Allocate memory for the file and output blocks */
 	if (ret == 0) {
-		if (((block_num * EFS_FILE_BLOCK_SIZE) + EFS_FILE_BLOCK_SIZE) > file_size) {
-			LOG_ERR("efs_read_block: File is not large enough (%d) for requested offset (%d)",
-				file_size, offset);
-			ret = -EINVAL;
+		file_block = buffers_alloc(&user_block);
+		if (file_block == NULL) {
+			LOG_ERR("efs_sha256: Could not allocate memory for the blocks");
+			ret = -ENOMEM;
 		}
 	}
 
-	/* Open the file */
-	fs_file_t_init(&f);
-	if (ret == 0) {
-		ret = fs_open(&f, simple_path, FS_O_READ);
+	/* The hash of an entire file that carries its hash state is in the last block */
+	if (ret == 0 && (fmt.flags & EFS_FLAG_HASH) && file_size > fmt.data_offset) {
+		block_offset = ((file_size - fmt.data_offset) / fmt.file_block_size) - 1;
+		ret = read_block(&f, &fmt, name_hash, block_offset, file_block, user_block,
+				 &block_size);
 		if (ret < 0) {
-			LOG_ERR("efs_read_block: fs_open failed %d", ret);
+			LOG_ERR("efs_sha256: read failed for block %d", block_offset);
+		} else if (((block_offset * fmt.user_block_size) + block_size) == size) {
+			/* Otherwise the hash is computed from the data */
+			from_trailer = (hash_from_trailer(&fmt, user_block, hash) == 0);
 		}
-	}
-
-	/* Allocate memory for the file block */
-	file_block = (uint8_t *)k_malloc(EFS_FILE_BLOCK_SIZE);
-	if (file_block == NULL) {
-		LOG_ERR("efs_read_block: Could not allocate memory for the file block");
-		ret = -ENOMEM;
-	}
-
-	/* Allocate memory for the output block */
-	user_block = (uint8_t *)k_malloc(EFS_USER_BLOCK_SIZE);
-	if (user_block == NULL) {
-		LOG_ERR("efs_read_block: Could not allocate memory for the user block");
-		ret = -ENOMEM;
-	}
-
-	/* Seek to the first block */
-	ret = fs_seek(&f, block_num * EFS_FILE_BLOCK_SIZE, FS_SEEK_SET);
-	if (ret < 0) {
-		LOG_ERR("efs_read_block: seek failed to block %d", block_num);
+		block_offset = 0;
 	}
 
 	/* Read the block(s) of the file */
-	while (ret == 0 && size > 0 &&
-	       ((block_num * EFS_FILE_BLOCK_SIZE) + EFS_FILE_BLOCK_SIZE) <= file_size) {
-		/* Seek to the start of the encrypted block */
+	while (ret == 0 && !from_trailer && size > 0 &&
+	       (block_position(&fmt, block_offset) + fmt.file_block_size) <= file_size) {
+		/* Read and decrypt the block */
+		ret = read_block(&f, &fmt, name_hash, block_offset, file_block, user_block,
+				 &block_size);
+		if (ret < 0) {
+			LOG_ERR("efs_sha256: read failed for block %d", block_offset);
+		}
 
-		/* Read the encrypted block */
-		if (ret == 0) {
-			ret = fs_read(&f, file_block, EFS_FILE_BLOCK_SIZE);
-			if (ret < 0) {
-				LOG_ERR("efs_read_block: read failed for block %d", block_num);
-			} else if (ret != EFS_FILE_BLOCK_SIZE) {
-				LOG_ERR("efs_read_block: Read only returned %d bytes", ret);
-				ret = -EIO;
-			} else {
-				/* Good read */
-				ret = 0;
-			}
-		}
-
-		/* Decrypt the block */
-		if (ret == 0) {
-			hdr = (struct efs_block_header *)file_block;
-			ret = decrypt_block(simple_path, block_num, hdr,
-					    file_block + EFS_FILE_BLOCK_ENC_OFFSET,
-					    EFS_FILE_BLOCK_SIZE - EFS_FILE_BLOCK_ENC_OFFSET,
-					    user_block, EFS_USER_BLOCK_SIZE);
-			if (ret < 0) {
-				LOG_ERR("efs_read_block: decrypt failed for block %d", block_num);
-			}
-		}
-
-		/* Copy the decrypted data to the user's buffer */
+		/* Copy the decrypted data to the user's buffer */
 		if (ret == 0) {
 			/* Limit the data size to what is in this block */
-			this_size = size;
-			if (this_size > hdr->auth_data.block_size) {
-				this_size = hdr->auth_data.block_size;
-			}
-
-			/* Adjust size taking the offset into account */
-			this_size -= block_offset;
+			this_size = MIN(size, block_size);
 
-			/* Copy the data into the caller's buffer */
-			memcpy(data, user_block + block_offset, this_size);
+			/* Update the hash with this data */
+			psa_ret = psa_hash_update(&operation, user_block, this_size);
+			if (psa_ret != PSA_SUCCESS) {
+				LOG_ERR("efa_sha256: Hash update failed: %d", psa_ret);
+				ret = -EFAULT;
+			}
 
-			/* Update pointers/counters */
-			block_offset = 0;
-			data += this_size;
+			/* Update counters */
 			size -= this_size;
-			copied += this_size;
 		}
 
 		/* Move to the next block */
 		if (ret == 0 && size > 0) {
-			if (hdr->auth_data.block_size == EFS_USER_BLOCK_SIZE) {
-				/* Try the next block only if the current block was "full" */
-				block_num++;
-			} else {
-				/* There shouldn't be another block after this one */
+			/* Don't try the next block if the current block is not full */
+			if (block_size != fmt.user_block_size) {
 				break;
+			} else {
+				/* Try the next block */
+				block_offset++;
 			}
 		}
 	}
 
 	/* Close the file */
-	ret2 = fs_close(&f);
-	if (ret2 < 0) {
-		LOG_ERR("efs_read_block: Could not close file: %d", ret2);
-		if (ret >= 0) {
-			ret = ret2;
+	if (opened) {
+		ret2 = fs_close(&f);
+		if (ret2 < 0) {
+			LOG_ERR("efs_sha256: Could not close file: %d", ret2);
+			if (ret >= 0) {
+				ret = ret2;
+			}
 		}
 	}
 
 	/* Free any memory that we allocated */
-	if (file_block != NULL) {
-		memset(file_block, 0, EFS_FILE_BLOCK_SIZE);
-		k_free(file_block);
+	buffers_free(&fmt, file_block, user_block);
+
+	/* Finish the hash operation */
+	if (ret == 0 && !from_trailer) {
+		psa_ret = psa_hash_finish(&operation, hash, FSU_HASH_SIZE, &hash_out_len);
+		if (psa_ret != PSA_SUCCESS) {
+			LOG_ERR("efs_sha256: Hash finish failed: %d", psa_ret);
+			ret = psa_ret;
+		} else if (hash_out_len != FSU_HASH_SIZE) {
+			LOG_ERR("efs_sha256: Hash output not expected length (%d)", hash_out_len);
+			ret = -EFAULT;
+		}
+	} else {
+		/* The operation isn't needed if the hash came from the trailer */
+		psa_ret = psa_hash_abort(&operation);
+		if (psa_ret != PSA_SUCCESS) {
+			LOG_ERR("efa_sha256: Hash abort failed: %d", psa_ret);
+		}
 	}
-	if (user_block != NULL) {
-		memset(user_block, 0, EFS_USER_BLOCK_SIZE);
-		k_free(user_block);
+
+	/* Return any error */
+	return ret;
+}
+
+int efs_writer_open(struct efs_writer *writer, const char *abs_path, bool truncate)
+{
+	return writer_open(writer, abs_path, truncate, 0, 0);
+}
+
+int efs_writer_create(struct efs_writer *writer, const char *abs_path, size_t block_size,
+		      uint8_t flags)
+{
+	if (block_size == 0) {
+		block_size = CONFIG_FSU_ENCRYPTED_FILES_BLOCK_SIZE;
 	}
 
-	/* Return error or the number of bytes copied */
+	return writer_open(writer, abs_path, true, block_size, flags);
+}
+
+int efs_writer_append(struct efs_writer *writer, const void *vdata, size_t size)
+{
+	const uint8_t *data = (const uint8_t *)vdata;
+	size_t user_block_size;
+	size_t this_size;
+	bool block_done;
+	int copied = 0;
+	int ret = 0;
+
+	/* Validate the input parameters */
+	if (writer == NULL || !writer->is_open) {
+		LOG_ERR("efs_writer_append: session is not open");
+		return -EINVAL;
+	} else if (size != 0 && data == NULL) {
+		LOG_ERR("efs_writer_append: null data pointer for size %d", size);
+		return -EINVAL;
+	}
+
+	user_block_size = writer->fmt.user_block_size;
+
+	/* Bring the partial last block of the file into RAM the first time it is needed */
+	if (size > 0 && !writer->tail_loaded) {
+		ret = writer_load_tail(writer);
+	}
+
+	while (ret == 0 && size > 0) {
+		if (writer->block_size == 0 && size >= user_block_size &&
+		    writer->fmt.payload_size == user_block_size) {
+			/* For a full block without a trailer, don't make a copy of the user data */
+			this_size = user_block_size;
+			ret = writer_write_block(writer, data, this_size);
+			block_done = true;
+		} else {
+			this_size = MIN(size, user_block_size - writer->block_size);
+
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+			/* The trailer holds the hash of everything up to the end of the block.
+			 * The session only takes data that has been hashed.
+			 */
+			if (writer->fmt.flags & EFS_FLAG_HASH) {
+				ret = writer_hash_update(writer, data, this_size);
+				if (ret < 0) {
+					LOG_ERR("efs_writer_append: Hash update failed: %d", ret);
+					break;
+				}
+			}
+#endif
+
+			/* Buffer what fits in the partial block */
+			memcpy(writer->user_block + writer->block_size, data, this_size);
+			writer->block_size += this_size;
+			writer->dirty = true;
+
+			/* Only full blocks are emitted until the session is flushed */
+			block_done = (writer->block_size == user_block_size);
+			if (block_done) {
+				ret = writer_write_block(writer, writer->user_block,
+							 user_block_size);
+			}
+		}
+
+		/* Update pointers/counters */
+		if (ret == 0) {
+			if (block_done) {
+				writer->block_number++;
+				writer->block_size = 0;
+				writer->dirty = false;
+			}
+			data += this_size;
+			size -= this_size;
+			copied += this_size;
+		}
+	}
+
+	/* Return the error or the number of bytes accepted */
 	if (ret == 0) {
 		ret = copied;
 	}
 	return ret;
 }
 
-ssize_t efs_get_file_size(const char *abs_path)
+int efs_writer_flush(struct efs_writer *writer)
 {
-	char simple_path[FSU_MAX_ABS_PATH_SIZE + 1];
-	ssize_t file_size = 0;
-	int num_blocks;
-	int block_offset;
 	int ret = 0;
-	int ret2;
-	uint8_t *file_block = NULL;
-	uint8_t *user_block = NULL;
-	struct efs_block_header *hdr = NULL;
-	struct fs_file_t f;
 
-	/* Validate the input parameters */
-	if (abs_path == NULL) {
+	if (writer == NULL || !writer->is_open) {
+		LOG_ERR("efs_writer_flush: session is not open");
 		ret = -EINVAL;
 	}
 
-	/* Remove any extra slashes in the path */
+	/* Pad and write the partial block. It stays in RAM for subsequent appends. */
+	if (ret == 0 && writer->dirty && writer->block_size > 0) {
+		ret = writer_write_block(writer, writer->user_block, writer->block_size);
+		if (ret == 0) {
+			writer->dirty = false;
+		}
+	}
+
 	if (ret == 0) {
-		ret = fsu_simplify_path(abs_path, simple_path);
+		ret = fs_sync(&writer->f);
 		if (ret < 0) {
-			LOG_ERR("efs_get_file_size: Invalid input path: %s", abs_path);
-		} else {
-			ret = 0;
+			LOG_ERR("efs_writer_flush: Could not sync file: %d", ret);
 		}
+		/* A reader may have cached blocks that were read before the file was synced */
+		cache_invalidate_blocks(writer->file_name_hash);
 	}
 
-	/* Get the encrypted size */
-	if (ret == 0) {
-		file_size = fsu_get_file_size_abs(simple_path);
-		if (file_size < 0) {
-			LOG_ERR("efs_get_file_size: Could not read flash file size: %d", file_size);
-			ret = file_size;
+	return ret;
+}
+
+int efs_writer_close(struct efs_writer *writer)
+{
+	int ret;
+	int ret2;
+
+	if (writer == NULL || !writer->is_open) {
+		LOG_ERR("efs_writer_close: session is not open");
+		return -EINVAL;
+	}
+
+	ret = efs_writer_flush(writer);
+
+	/* Close the file */
+	ret2 = fs_close(&writer->f);
+	if (ret2 < 0) {
+		LOG_ERR("efs_writer_close: Could not close file: %d", ret2);
+		if (ret == 0) {
+			ret = ret2;
 		}
 	}
+	cache_invalidate_blocks(writer->file_name_hash);
+
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+	if (writer->fmt.flags & EFS_FLAG_HASH) {
+		mbedtls_sha256_free(&writer->hash_ctx);
+	}
+#endif
 
-	/* If the file is empty, shortcut this entire function */
+	/* Don't leave plaintext behind */
+	buffers_free(&writer->fmt, writer->file_block, writer->user_block);
+	writer->user_block = NULL;
+	writer->file_block = NULL;
+	writer->is_open = false;
+
+	return ret;
+}
+
+void efs_invalidate(const char *abs_path)
+{
+	char simple_path[FSU_MAX_ABS_PATH_SIZE + 1];
+	uint8_t name_hash[EFS_FILE_NAME_HASH_SIZE];
+
+	if (abs_path == NULL || fsu_simplify_path(abs_path, simple_path) < 0) {
+		return;
+	}
+
+	if (file_name_hash_gen(simple_path, name_hash, sizeof(name_hash)) == 0) {
+		cache_invalidate(name_hash);
+	}
+}
+
+/**************************************************************************************************/
+/* Local Function Definitions                                                                     */
+/**************************************************************************************************/
+static int format_init(struct efs_format *fmt, uint8_t version, size_t block_size,
+		       uint8_t flags)
+{
+	size_t trailer_size = 0;
+
+	if (version == EFS_FORMAT_V1 && flags == 0) {
+		fmt->data_offset = 0;
+		fmt->header_size = sizeof(struct efs_block_header);
+		block_size = EFS_V1_FILE_BLOCK_SIZE;
+	} else if (version == EFS_FORMAT_V2 && block_size >= EFS_V2_MIN_BLOCK_SIZE &&
+		   block_size <= EFS_MAX_FILE_BLOCK_SIZE && (block_size & (block_size - 1)) == 0 &&
+		   (flags & ~EFS_SUPPORTED_FLAGS) == 0) {
+		fmt->data_offset = sizeof(struct efs_file_prefix);
+		fmt->header_size = sizeof(struct efs_block_header_v2);
+		if (flags & EFS_FLAG_HASH) {
+			trailer_size = EFS_HASH_TRAILER_SIZE;
+		}
+	} else {
+		LOG_ERR("Unsupported format %d block size %d flags 0x%02x", version, block_size,
+			flags);
+		return -EINVAL;
+	}
+
+	fmt->version = version;
+	fmt->flags = flags;
+	fmt->file_block_size = block_size;
+	fmt->payload_size = block_size - (fmt->header_size + LCZ_HW_KEY_MAC_LEN);
+	fmt->user_block_size = fmt->payload_size - trailer_size;
+
+	return 0;
+}
+
+/* The block trailers of a hashed file can only be maintained if hashing is enabled */
+static int format_writable(const struct efs_format *fmt)
+{
+	if ((fmt->flags & EFS_FLAG_HASH) && !IS_ENABLED(CONFIG_FSU_ENCRYPTED_FILES_HASH)) {
+		LOG_ERR("efs_writer_open: Hashed files require CONFIG_FSU_ENCRYPTED_FILES_HASH");
+		return -ENOTSUP;
+	}
+
+	return 0;
+}
+
+static int format_default(struct efs_format *fmt)
+{
+	uint8_t flags = 0;
+
+	if (IS_ENABLED(CONFIG_FSU_ENCRYPTED_FILES_V2)) {
+		if (IS_ENABLED(CONFIG_FSU_ENCRYPTED_FILES_HASH)) {
+			flags |= EFS_FLAG_HASH;
+		}
+		return format_init(fmt, EFS_FORMAT_V2, CONFIG_FSU_ENCRYPTED_FILES_BLOCK_SIZE,
+				   flags);
+	} else {
+		return format_init(fmt, EFS_FORMAT_V1, 0, 0);
+	}
+}
+
+static int format_probe(struct fs_file_t *f, off_t file_size, struct efs_format *fmt)
+{
+	struct efs_file_prefix prefix;
+	int ret;
+
+	/* An empty file can be written in any format */
 	if (file_size == 0) {
+		return format_default(fmt);
+	}
+
+	/* Version 1 files are always a multiple of the version 1 block size */
+	if ((file_size % EFS_V1_FILE_BLOCK_SIZE) == 0) {
+		return format_init(fmt, EFS_FORMAT_V1, 0, 0);
+	}
+
+	/* Otherwise this must be a version 2 file */
+	if ((file_size % EFS_V2_MIN_BLOCK_SIZE) != sizeof(struct efs_file_prefix)) {
+		LOG_ERR("File is not multiple of block size (%d)", file_size);
+		return -EINVAL;
+	}
+
+	ret = fs_seek(f, 0, FS_SEEK_SET);
+	if (ret == 0) {
+		ret = fs_read(f, &prefix, sizeof(prefix));
+		if (ret == sizeof(prefix)) {
+			ret = 0;
+		} else if (ret >= 0) {
+			ret = -EIO;
+		}
+	}
+	if (ret < 0) {
+		LOG_ERR("Could not read file prefix: %d", ret);
+		return ret;
+	}
+
+	if (memcmp(prefix.magic, efs_v2_magic, sizeof(prefix.magic)) != 0 ||
+	    prefix.version != EFS_FORMAT_V2 || prefix.block_shift >= 32) {
+		LOG_ERR("Invalid file prefix");
+		return -EINVAL;
+	}
+
+	ret = format_init(fmt, EFS_FORMAT_V2, 1UL << prefix.block_shift, prefix.flags);
+	if (ret == 0 && ((file_size - fmt->data_offset) % fmt->file_block_size) != 0) {
+		LOG_ERR("File is not multiple of block size (%d)", file_size);
+		ret = -EINVAL;
+	}
+
+	return ret;
+}
+
+static int format_write_prefix(struct fs_file_t *f, const struct efs_format *fmt)
+{
+	struct efs_file_prefix prefix;
+	int ret;
+
+	if (fmt->version == EFS_FORMAT_V1) {
 		return 0;
 	}
 
-	/* Get the number of file blocks */
-	num_blocks = file_size / EFS_FILE_BLOCK_SIZE;
+	memset(&prefix, 0, sizeof(prefix));
+	memcpy(prefix.magic, efs_v2_magic, sizeof(prefix.magic));
+	prefix.version = fmt->version;
+	prefix.block_shift = find_lsb_set(fmt->file_block_size) - 1;
+	prefix.flags = fmt->flags;
 
-	/* Make sure that the file is a mulitple of the encrypted block size */
+	ret = fs_seek(f, 0, FS_SEEK_SET);
 	if (ret == 0) {
-		if ((file_size % EFS_FILE_BLOCK_SIZE) != 0) {
-			LOG_ERR("efs_get_file_size: File is not multiple of block size (%d)",
-				file_size);
-			ret = -EINVAL;
+		ret = fs_write(f, &prefix, sizeof(prefix));
+		if (ret == sizeof(prefix)) {
+			ret = 0;
+		} else if (ret >= 0) {
+			ret = -EIO;
 		}
 	}
+	if (ret < 0) {
+		LOG_ERR("Could not write file prefix: %d", ret);
+	}
+
+	return ret;
+}
+
+static off_t block_position(const struct efs_format *fmt, uint32_t block_number)
+{
+	return fmt->data_offset + ((off_t)block_number * fmt->file_block_size);
+}
+
+static int file_open(struct fs_file_t *f, const char *abs_path, fs_mode_t flags,
+		     struct efs_format *fmt, off_t *file_size)
+{
+	int ret;
+
+	fs_file_t_init(f);
+	ret = fs_open(f, abs_path, flags);
+	if (ret < 0) {
+		LOG_ERR("fs_open failed %d", ret);
+		return ret;
+	}
 
-	/* Open the file */
-	fs_file_t_init(&f);
+	/* Find the current size */
+	ret = fs_seek(f, 0, FS_SEEK_END);
 	if (ret == 0) {
-		ret = fs_open(&f, simple_path, FS_O_READ);
-		if (ret < 0) {
-			LOG_ERR("efs_get_file_size: fs_open failed %d", ret);
+		*file_size = fs_tell(f);
+		if (*file_size < 0) {
+			ret = *file_size;
 		}
 	}
+	if (ret < 0) {
+		LOG_ERR("Could not read file size: %d", ret);
+	}
 
-	/* Allocate memory for the file block */
-	file_block = (uint8_t *)k_malloc(EFS_FILE_BLOCK_SIZE);
-	if (file_block == NULL) {
-		LOG_ERR("efs_get_file_size: Could not allocate memory for the file block");
-		ret = -ENOMEM;
+	if (ret == 0) {
+		ret = format_probe(f, *file_size, fmt);
 	}
 
-	/* Allocate memory for the output block */
-	user_block = (uint8_t *)k_malloc(EFS_USER_BLOCK_SIZE);
-	if (user_block == NULL) {
-		LOG_ERR("efs_get_file_size: Could not allocate memory for the user block");
-		ret = -ENOMEM;
+	if (ret < 0) {
+		(void)fs_close(f);
 	}
 
-	/* Seek to the start of the last encrypted block */
-	block_offset = num_blocks - 1;
-	ret = fs_seek(&f, block_offset * EFS_FILE_BLOCK_SIZE, FS_SEEK_SET);
+	return ret;
+}
+
+static int read_block(struct fs_file_t *f, const struct efs_format *fmt, const uint8_t *name_hash,
+		      uint32_t block_number, uint8_t *file_block, uint8_t *user_data,
+		      size_t *block_size)
+{
+	int ret;
+
+	/* Seek to the start of the encrypted block */
+	ret = fs_seek(f, block_position(fmt, block_number), FS_SEEK_SET);
 	if (ret < 0) {
-		LOG_ERR("efs_get_file_size: seek failed to block %d: %d", block_offset, ret);
+		LOG_ERR("read_block: seek failed to block %d: %d", block_number, ret);
 	}
 
 	/* Read the encrypted block */
 	if (ret == 0) {
-		ret = fs_read(&f, file_block, EFS_FILE_BLOCK_SIZE);
+		ret = fs_read(f, file_block, fmt->file_block_size);
 		if (ret < 0) {
-			LOG_ERR("efs_get_file_size: read failed for block %d: %d", block_offset,
-				ret);
-		} else if (ret != EFS_FILE_BLOCK_SIZE) {
-			LOG_ERR("efs_get_file_size: Read only returned %d bytes", ret);
+			LOG_ERR("read_block: read failed for block %d: %d", block_number, ret);
+		} else if (ret != fmt->file_block_size) {
+			LOG_ERR("read_block: Read only returned %d bytes", ret);
 			ret = -EIO;
 		} else {
 			/* Good read */
@@ -693,224 +1118,578 @@ ssize_t efs_get_file_size(const char *abs_path)
 
 	/* Decrypt the block */
 	if (ret == 0) {
-		hdr = (struct efs_block_header *)file_block;
-		ret = decrypt_block(simple_path, block_offset, hdr,
-				    file_block + EFS_FILE_BLOCK_ENC_OFFSET,
-				    EFS_FILE_BLOCK_SIZE - EFS_FILE_BLOCK_ENC_OFFSET, user_block,
-				    EFS_USER_BLOCK_SIZE);
+		ret = decrypt_block(fmt, name_hash, block_number, file_block, user_data,
+				    block_size);
+	}
+
+	return ret;
+}
+
+static int writer_open(struct efs_writer *writer, const char *abs_path, bool truncate,
+		       size_t block_size, uint8_t flags)
+{
+	off_t file_size = 0;
+	uint32_t num_blocks;
+	bool opened = false;
+	int ret = 0;
+	int ret2;
+
+	/* Validate the input parameters */
+	if (writer == NULL || abs_path == NULL) {
+		LOG_ERR("efs_writer_open: invalid parameters");
+		return -EINVAL;
+	}
+
+	memset(writer, 0, sizeof(struct efs_writer));
+
+	/* Remove any extra slashes in the path */
+	ret = fsu_simplify_path(abs_path, writer->abs_path);
+	if (ret < 0) {
+		LOG_ERR("efs_writer_open: Invalid input path: %s", abs_path);
+	} else {
+		ret = 0;
+	}
+
+	/* The file name hash is the same for every block written by the session */
+	if (ret == 0) {
+		ret = file_name_hash_gen(writer->abs_path, writer->file_name_hash,
+					 sizeof(writer->file_name_hash));
 		if (ret < 0) {
-			LOG_ERR("efs_get_file_size: decrypt failed for block %d", block_offset);
+			LOG_ERR("efs_writer_open: Couldn't hash filename: %d", ret);
 		}
 	}
 
-	/* Close the file */
-	ret2 = fs_close(&f);
-	if (ret2 < 0) {
-		LOG_ERR("efs_get_file_size: Could not close file: %d", ret2);
+	/* Validate a requested format before touching the file */
+	if (ret == 0 && block_size != 0) {
+		ret = format_init(&writer->fmt, EFS_FORMAT_V2, block_size, flags);
 		if (ret == 0) {
-			ret = ret2;
+			ret = format_writable(&writer->fmt);
 		}
 	}
 
-	/* Compute the file size */
+	/* Open the file for read and write and determine its format */
 	if (ret == 0) {
-		ret = ((num_blocks - 1) * EFS_USER_BLOCK_SIZE) + hdr->auth_data.block_size;
+		if (block_size != 0) {
+			fs_file_t_init(&writer->f);
+			ret = fs_open(&writer->f, writer->abs_path, FS_O_RDWR | FS_O_CREATE);
+			if (ret < 0) {
+				LOG_ERR("efs_writer_open: fs_open failed %d", ret);
+			}
+		} else {
+			ret = file_open(&writer->f, writer->abs_path, FS_O_RDWR | FS_O_CREATE,
+					&writer->fmt, &file_size);
+		}
+		if (ret == 0) {
+			opened = true;
+		}
 	}
 
-	/* Free any memory that we allocated */
-	if (file_block != NULL) {
-		memset(file_block, 0, EFS_FILE_BLOCK_SIZE);
-		k_free(file_block);
+	/* An existing file that can't be appended to is left untouched, even when it would be
+	 * emptied.
+	 */
+	if (ret == 0 && block_size == 0) {
+		ret = format_writable(&writer->fmt);
 	}
-	if (user_block != NULL) {
-		memset(user_block, 0, EFS_USER_BLOCK_SIZE);
-		k_free(user_block);
+
+	/* Empty the file. Version 2 files keep their block size unless a new one is requested. */
+	if (ret == 0 && truncate) {
+		if (block_size == 0 && writer->fmt.version != EFS_FORMAT_V2) {
+			ret = format_default(&writer->fmt);
+		}
+		if (ret == 0) {
+			ret = fs_truncate(&writer->f, 0);
+			if (ret < 0) {
+				LOG_ERR("efs_writer_open: Could not truncate file: %d", ret);
+			}
+			cache_invalidate(writer->file_name_hash);
+		}
+		file_size = 0;
+	}
+
+	/* New files start with the prefix for their format */
+	if (ret == 0 && file_size == 0) {
+		ret = format_write_prefix(&writer->f, &writer->fmt);
+		file_size = writer->fmt.data_offset;
+	}
+
+	/* Allocate memory for the file and user blocks */
+	if (ret == 0) {
+		writer->file_block = buffers_alloc(&writer->user_block);
+		if (writer->file_block == NULL) {
+			LOG_ERR("efs_writer_open: Could not allocate memory for the blocks");
+			ret = -ENOMEM;
+		}
+	}
+
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+	/* The hash of an existing file is computed when its last block is loaded */
+	if (ret == 0 && (writer->fmt.flags & EFS_FLAG_HASH)) {
+		mbedtls_sha256_init(&writer->hash_ctx);
+		ret = mbedtls_sha256_starts(&writer->hash_ctx, 0);
+		if (ret != 0) {
+			LOG_ERR("efs_writer_open: Could not start hash: %d", ret);
+			ret = -EFAULT;
+		}
+	}
+#endif
+
+	/* The last block of a non-empty file is only read if data is appended */
+	if (ret == 0) {
+		num_blocks = (file_size - writer->fmt.data_offset) / writer->fmt.file_block_size;
+		if (num_blocks == 0) {
+			writer->block_number = 0;
+			writer->tail_loaded = true;
+		} else {
+			writer->block_number = num_blocks - 1;
+			writer->tail_loaded = false;
+		}
+		writer->is_open = true;
+	} else {
+		fsu_pool_free(FSU_POOL_EFS_BLOCK, writer->file_block);
+		writer->file_block = NULL;
+		writer->user_block = NULL;
+		if (opened) {
+			ret2 = fs_close(&writer->f);
+			if (ret2 < 0) {
+				LOG_ERR("efs_writer_open: Could not close file: %d", ret2);
+			}
+		}
 	}
 
 	return ret;
 }
 
-int efs_sha256(uint8_t hash[FSU_HASH_SIZE], const char *abs_path, size_t size)
+static int append_session(const char *abs_path, const void *data, size_t size, bool truncate)
 {
-	char simple_path[FSU_MAX_ABS_PATH_SIZE + 1];
-	int block_offset = 0;
-	int this_size;
-	ssize_t file_size;
-	uint8_t *file_block = NULL;
-	uint8_t *user_block = NULL;
-	struct efs_block_header *hdr;
-	struct fs_file_t f;
+	struct efs_writer writer;
 	int ret = 0;
 	int ret2;
-	psa_hash_operation_t operation = PSA_HASH_OPERATION_INIT;
-	psa_status_t psa_ret;
-	size_t hash_out_len = 0;
 
-	/* Start the hash operation */
-	psa_ret = psa_hash_setup(&operation, PSA_ALG_SHA_256);
-	if (psa_ret != PSA_SUCCESS) {
-		LOG_ERR("efs_sha256: Failed to setup hash operation: %d", psa_ret);
-		ret = psa_ret;
+	/* Validate input parameters */
+	if (abs_path == NULL) {
+		LOG_ERR("efs_append: invalid path");
+		ret = -EINVAL;
+	} else if (size != 0 && data == NULL) {
+		LOG_ERR("efs_append: null data pointer for size %d", size);
+		ret = -EINVAL;
 	}
 
-	/* Validate the input parameters */
 	if (ret == 0) {
-		if (abs_path == NULL || hash == NULL || size == 0) {
-			LOG_ERR("efs_sha256: Invalid input parameters");
-			ret = -EINVAL;
+		ret = efs_writer_open(&writer, abs_path, truncate);
+		if (ret == 0) {
+			ret = efs_writer_append(&writer, data, size);
+			ret2 = efs_writer_close(&writer);
+			if (ret >= 0 && ret2 < 0) {
+				ret = ret2;
+			}
 		}
 	}
 
-	/* Remove any extra slashes in the path */
+	return ret;
+}
+
+static int writer_load_tail(struct efs_writer *writer)
+{
+	size_t block_size;
+	int ret = 0;
+
+	/* Hash the full blocks before the last one */
+	if (writer->fmt.flags & EFS_FLAG_HASH) {
+		ret = writer_rehash(writer);
+	}
+
+	/* Read and decrypt the last block */
 	if (ret == 0) {
-		ret = fsu_simplify_path(abs_path, simple_path);
+		ret = read_block(&writer->f, &writer->fmt, writer->file_name_hash,
+				 writer->block_number, writer->file_block, writer->user_block,
+				 &block_size);
 		if (ret < 0) {
-			LOG_ERR("efs_sha256: Invalid input path: %s", abs_path);
-		} else {
-			ret = 0;
+			LOG_ERR("efs_writer: read failed for block %d: %d", writer->block_number,
+				ret);
 		}
 	}
 
-	/* Get the size of the encrypted file */
-	if (ret == 0) {
-		file_size = fsu_get_file_size_abs(simple_path);
-		if (file_size < 0) {
-			LOG_ERR("efs_sha256: Could not read flash file size: %d", file_size);
-			ret = file_size;
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+	/* Continue hashing from the end of the last block */
+	if (ret == 0 && (writer->fmt.flags & EFS_FLAG_HASH)) {
+		ret = writer_hash_update(writer, writer->user_block, block_size);
+		if (ret < 0) {
+			LOG_ERR("efs_writer: Hash update failed: %d", ret);
 		}
 	}
+#endif
 
-	/* Make sure that the file is a mulitple of the encrypted block size */
+	/* A full last block is left alone; new data starts a new block */
 	if (ret == 0) {
-		if ((file_size % EFS_FILE_BLOCK_SIZE) != 0) {
-			LOG_ERR("efs_sha256: File is not multiple of block size (%d)", file_size);
-			ret = -EINVAL;
+		if (block_size >= writer->fmt.user_block_size) {
+			writer->block_number++;
+			writer->block_size = 0;
+		} else {
+			writer->block_size = block_size;
 		}
+		writer->tail_loaded = true;
 	}
 
-	/* Open the file */
-	fs_file_t_init(&f);
-	if (ret == 0) {
-		ret = fs_open(&f, simple_path, FS_O_READ);
+	return ret;
+}
+
+static int writer_write_block(struct efs_writer *writer, const uint8_t *user_data,
+			      size_t user_data_len)
+{
+	const struct efs_format *fmt = &writer->fmt;
+	off_t position = block_position(fmt, writer->block_number);
+	int ret;
+
+	/* Blocks are always full size. Partial blocks are buffered in user_block, so pad there. */
+	if (user_data_len != fmt->user_block_size) {
+		memset(writer->user_block + user_data_len, 0,
+		       fmt->user_block_size - user_data_len);
+	}
+
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+	/* Blocks with a trailer are always built in user_block */
+	if (fmt->flags & EFS_FLAG_HASH) {
+		ret = writer_trailer(writer, writer->user_block + fmt->user_block_size);
 		if (ret < 0) {
-			LOG_ERR("efs_sha256: fs_open failed %d", ret);
+			return ret;
 		}
 	}
+#endif
 
-	/* Allocate memory for the file block */
-	file_block = (uint8_t *)k_malloc(EFS_FILE_BLOCK_SIZE);
-	if (file_block == NULL) {
-		LOG_ERR("efs_sha256: Could not allocate memory for the file block");
-		ret = -ENOMEM;
+	/* Encrypt the block */
+	ret = encrypt_block(fmt, writer->file_name_hash, writer->block_number, user_data,
+			    user_data_len, writer->file_block);
+	if (ret < 0) {
+		LOG_ERR("efs_writer: encrypt failed for block %d: %d", writer->block_number, ret);
 	}
 
-	/* Allocate memory for the output block */
-	user_block = (uint8_t *)k_malloc(EFS_USER_BLOCK_SIZE);
-	if (user_block == NULL) {
-		LOG_ERR("efs_sha256: Could not allocate memory for the user block");
-		ret = -ENOMEM;
+	/* Seek to the block, which may be rewriting a previously flushed partial block */
+	if (ret == 0) {
+		ret = fs_seek(&writer->f, position, FS_SEEK_SET);
+		if (ret < 0) {
+			LOG_ERR("efs_writer: seek failed to block %d: %d", writer->block_number,
+				ret);
+		}
 	}
 
-	/* Read the block(s) of the file */
-	while (ret == 0 && size > 0) {
-		/* Read the encrypted block */
-		ret = fs_read(&f, file_block, EFS_FILE_BLOCK_SIZE);
+	/* Write the block to the file */
+	if (ret == 0) {
+		ret = fs_write(&writer->f, writer->file_block, fmt->file_block_size);
 		if (ret < 0) {
-			LOG_ERR("efs_sha256: read failed for block %d", block_offset);
-		} else if (ret != EFS_FILE_BLOCK_SIZE) {
-			LOG_ERR("efs_sha256: Read only returned %d bytes", ret);
+			LOG_ERR("efs_writer: write failed to block %d: %d", writer->block_number,
+				ret);
+		} else if (ret != fmt->file_block_size) {
+			LOG_ERR("efs_writer: write only wrote %d bytes", ret);
 			ret = -EIO;
 		} else {
-			/* Good read */
+			/* Good write */
 			ret = 0;
 		}
+	}
 
-		/* Decrypt the block */
-		if (ret == 0) {
-			hdr = (struct efs_block_header *)file_block;
-			ret = decrypt_block(simple_path, block_offset, hdr,
-					    file_block + EFS_FILE_BLOCK_ENC_OFFSET,
-					    EFS_FILE_BLOCK_SIZE - EFS_FILE_BLOCK_ENC_OFFSET,
-					    user_block, EFS_USER_BLOCK_SIZE);
+	/* Cached plaintext of this file is stale once the block has been (partly) written */
+	cache_invalidate(writer->file_name_hash);
+
+	/* Sessions only append, so this is now the last block of the file */
+	if (ret == 0) {
+		size_memo_write(writer->file_name_hash, position + fmt->file_block_size, fmt,
+				writer->file_block,
+				(writer->block_number * fmt->user_block_size) + user_data_len);
+	}
+
+	return ret;
+}
+
+/* Rehash the full blocks that precede the last block of the file. The buffers are free
+ * because the last block hasn't been loaded yet.
+ */
+static int writer_rehash(struct efs_writer *writer)
+{
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+	size_t block_size;
+	uint32_t i;
+	int ret = 0;
+
+	for (i = 0; ret == 0 && i < writer->block_number; i++) {
+		ret = read_block(&writer->f, &writer->fmt, writer->file_name_hash, i,
+				 writer->file_block, writer->user_block, &block_size);
+		if (ret < 0) {
+			LOG_ERR("efs_writer: read failed for block %d: %d", i, ret);
+		} else if (block_size != writer->fmt.user_block_size) {
+			LOG_ERR("efs_writer: block %d isn't full", i);
+			ret = -EIO;
+		} else {
+			ret = writer_hash_update(writer, writer->user_block, block_size);
 			if (ret < 0) {
-				LOG_ERR("efs_sha256: decrypt failed for block %d", block_offset);
+				LOG_ERR("efs_writer: Hash update failed: %d", ret);
 			}
 		}
+	}
 
-		/* Copy the decrypted data to the user's buffer */
-		if (ret == 0) {
-			/* Limit the data size to what is in this block */
-			this_size = size;
-			if (this_size > hdr->auth_data.block_size) {
-				this_size = hdr->auth_data.block_size;
-			}
+	return ret;
+#else
+	return -ENOTSUP;
+#endif
+}
 
-			/* Update the hash with this data */
-			psa_ret = psa_hash_update(&operation, user_block, this_size);
-			if (psa_ret != PSA_SUCCESS) {
-				LOG_ERR("efa_sha256: Hash update failed: %d", psa_ret);
-				ret = -EFAULT;
-			}
+#if defined(CONFIG_FSU_ENCRYPTED_FILES_HASH)
+/* The hash is only advanced if the update succeeds, so a failed append leaves the session
+ * unchanged.
+ */
+static int writer_hash_update(struct efs_writer *writer, const uint8_t *data, size_t size)
+{
+	mbedtls_sha256_context ctx;
+	int ret;
 
-			/* Update counters */
-			size -= this_size;
-		}
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_clone(&ctx, &writer->hash_ctx);
+	ret = mbedtls_sha256_update(&ctx, data, size);
+	if (ret == 0) {
+		mbedtls_sha256_clone(&writer->hash_ctx, &ctx);
+	}
+	mbedtls_sha256_free(&ctx);
 
-		/* Move to the next block */
-		if (ret == 0 && size > 0) {
-			/* Don't try the next block if the current block is not full */
-			if (hdr->auth_data.block_size != EFS_USER_BLOCK_SIZE) {
-				break;
-			} else {
-				/* Try the next block */
-				block_offset++;
+	return (ret == 0) ? 0 : -EFAULT;
+}
+
+/* Finish a copy of the running hash into the trailer so that the session can continue */
+static int writer_trailer(struct efs_writer *writer, uint8_t *trailer)
+{
+	struct efs_hash_trailer t = { .magic = EFS_HASH_TRAILER_MAGIC,
+				      .version = EFS_HASH_TRAILER_VERSION };
+	mbedtls_sha256_context ctx;
+	int ret;
+
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_clone(&ctx, &writer->hash_ctx);
+	ret = mbedtls_sha256_finish(&ctx, t.hash);
+	mbedtls_sha256_free(&ctx);
+	if (ret != 0) {
+		LOG_ERR("efs_writer: Hash finish failed: %d", ret);
+		return -EFAULT;
+	}
+
+	memset(trailer, 0, EFS_HASH_TRAILER_SIZE);
+	memcpy(trailer, &t, sizeof(t));
+
+	return 0;
+}
+#endif
+
+/* The encrypted block and the plaintext of an operation share one pool block, so an
+ * operation never waits for a buffer while it holds another.
+ *
+ * @retval encrypted (file) block, NULL if none is free
+ */
+static uint8_t *buffers_alloc(uint8_t **user_block)
+{
+	uint8_t *file_block = (uint8_t *)fsu_pool_alloc(FSU_POOL_EFS_BLOCK);
+
+	*user_block = (file_block != NULL) ? (file_block + EFS_MAX_FILE_BLOCK_SIZE) : NULL;
+
+	return file_block;
+}
+
+static void buffers_free(const struct efs_format *fmt, uint8_t *file_block, uint8_t *user_block)
+{
+	if (file_block != NULL) {
+		memset(file_block, 0, fmt->file_block_size);
+		memset(user_block, 0, fmt->payload_size);
+		fsu_pool_free(FSU_POOL_EFS_BLOCK, file_block);
+	}
+}
+
+static int hash_from_trailer(const struct efs_format *fmt, const uint8_t *payload,
+			     uint8_t hash[FSU_HASH_SIZE])
+{
+	struct efs_hash_trailer t;
+
+	memcpy(&t, payload + fmt->user_block_size, sizeof(t));
+	if (t.magic != EFS_HASH_TRAILER_MAGIC || t.version != EFS_HASH_TRAILER_VERSION) {
+		LOG_DBG("efs_sha256: Unknown hash trailer");
+		return -ENOENT;
+	}
+
+	memcpy(hash, t.hash, FSU_HASH_SIZE);
+
+	return 0;
+}
+
+static int cache_read(const uint8_t *name_hash, uint32_t offset, uint8_t *out, size_t out_len,
+		      size_t *copied, bool *full)
+{
+	int ret = -ENOENT;
+#if EFS_BLOCK_CACHE_SIZE > 0
+	struct efs_cache_entry *entry;
+	uint32_t block_offset;
+	int i;
+
+	k_mutex_lock(&efs_cache_lock, K_FOREVER);
+	for (i = 0; i < EFS_BLOCK_CACHE_SIZE; i++) {
+		entry = &efs_cache[i];
+		if (entry->valid && entry->block_number == (offset / entry->user_block_size) &&
+		    memcmp(entry->file_name_hash, name_hash, EFS_FILE_NAME_HASH_SIZE) == 0) {
+			block_offset = offset % entry->user_block_size;
+			*copied = 0;
+			if (block_offset < entry->block_size) {
+				*copied = MIN(out_len, entry->block_size - block_offset);
+				memcpy(out, entry->user_block + block_offset, *copied);
 			}
+			*full = (entry->block_size == entry->user_block_size);
+			entry->last_used = ++efs_cache_use_count;
+			ret = 0;
+			break;
 		}
 	}
+	k_mutex_unlock(&efs_cache_lock);
+#endif
+	return ret;
+}
 
-	/* Close the file */
-	ret2 = fs_close(&f);
-	if (ret2 < 0) {
-		LOG_ERR("efs_sha256: Could not close file: %d", ret2);
-		if (ret >= 0) {
-			ret = ret2;
+static void cache_write(const uint8_t *name_hash, const struct efs_format *fmt,
+			uint32_t block_number, const uint8_t *user_block, size_t block_size)
+{
+#if EFS_BLOCK_CACHE_SIZE > 0
+	struct efs_cache_entry *entry = &efs_cache[0];
+	int i;
+
+	k_mutex_lock(&efs_cache_lock, K_FOREVER);
+
+	/* Use a free entry, otherwise replace the least recently used one */
+	for (i = 0; i < EFS_BLOCK_CACHE_SIZE; i++) {
+		if (!efs_cache[i].valid) {
+			entry = &efs_cache[i];
+			break;
+		}
+		if (efs_cache[i].last_used < entry->last_used) {
+			entry = &efs_cache[i];
 		}
 	}
 
-	/* Free any memory that we allocated */
-	if (file_block != NULL) {
-		memset(file_block, 0, EFS_FILE_BLOCK_SIZE);
-		k_free(file_block);
+	entry->block_number = block_number;
+	entry->block_size = block_size;
+	entry->user_block_size = fmt->user_block_size;
+	memcpy(entry->file_name_hash, name_hash, EFS_FILE_NAME_HASH_SIZE);
+	memcpy(entry->user_block, user_block, block_size);
+	entry->last_used = ++efs_cache_use_count;
+	entry->valid = true;
+
+	k_mutex_unlock(&efs_cache_lock);
+#endif
+}
+
+static void cache_invalidate(const uint8_t *name_hash)
+{
+#if EFS_SIZE_MEMO_SIZE > 0
+	int i;
+#endif
+
+	cache_invalidate_blocks(name_hash);
+
+	k_mutex_lock(&efs_cache_lock, K_FOREVER);
+#if EFS_SIZE_MEMO_SIZE > 0
+	for (i = 0; i < EFS_SIZE_MEMO_SIZE; i++) {
+		if (efs_size_memo[i].valid && memcmp(efs_size_memo[i].file_name_hash, name_hash,
+						     EFS_FILE_NAME_HASH_SIZE) == 0) {
+			efs_size_memo[i].valid = false;
+		}
 	}
-	if (user_block != NULL) {
-		memset(user_block, 0, EFS_USER_BLOCK_SIZE);
-		k_free(user_block);
+#endif
+	k_mutex_unlock(&efs_cache_lock);
+}
+
+/* The size memo checks the last block header itself, so it survives a sync or close */
+static void cache_invalidate_blocks(const uint8_t *name_hash)
+{
+#if EFS_BLOCK_CACHE_SIZE > 0
+	int i;
+
+	k_mutex_lock(&efs_cache_lock, K_FOREVER);
+	for (i = 0; i < EFS_BLOCK_CACHE_SIZE; i++) {
+		if (efs_cache[i].valid && memcmp(efs_cache[i].file_name_hash, name_hash,
+						 EFS_FILE_NAME_HASH_SIZE) == 0) {
+			memset(&efs_cache[i], 0, sizeof(struct efs_cache_entry));
+		}
 	}
+	k_mutex_unlock(&efs_cache_lock);
+#endif
+}
 
-	/* Finish the hash operation */
-	if (ret == 0) {
-		psa_ret = psa_hash_finish(&operation, hash, FSU_HASH_SIZE, &hash_out_len);
-		if (psa_ret != PSA_SUCCESS) {
-			LOG_ERR("efs_sha256: Hash finish failed: %d", psa_ret);
-			ret = psa_ret;
-		} else if (hash_out_len != FSU_HASH_SIZE) {
-			LOG_ERR("efs_sha256: Hash output not expected length (%d)", hash_out_len);
-			ret = -EFAULT;
+static ssize_t size_memo_read(const uint8_t *name_hash, off_t file_size,
+			      const struct efs_format *fmt, const uint8_t *last_hdr)
+{
+	ssize_t size = -ENOENT;
+#if EFS_SIZE_MEMO_SIZE > 0
+	struct efs_size_memo *memo;
+	int i;
+
+	/* The IV is regenerated every time a block is encrypted, so a matching header means
+	 * the block is the one that was authenticated.
+	 */
+	k_mutex_lock(&efs_cache_lock, K_FOREVER);
+	for (i = 0; i < EFS_SIZE_MEMO_SIZE; i++) {
+		memo = &efs_size_memo[i];
+		if (memo->valid &&
+		    memcmp(memo->file_name_hash, name_hash, EFS_FILE_NAME_HASH_SIZE) == 0) {
+			if (memo->file_size == file_size && memo->header_size == fmt->header_size &&
+			    memcmp(memo->last_hdr, last_hdr, fmt->header_size) == 0) {
+				size = memo->user_size;
+				memo->last_used = ++efs_cache_use_count;
+			}
+			break;
 		}
-	} else {
-		psa_ret = psa_hash_abort(&operation);
-		if (psa_ret != PSA_SUCCESS) {
-			LOG_ERR("efa_sha256: Hash abort failed: %d", psa_ret);
+	}
+	k_mutex_unlock(&efs_cache_lock);
+#endif
+	return size;
+}
+
+static void size_memo_write(const uint8_t *name_hash, off_t file_size,
+			    const struct efs_format *fmt, const uint8_t *last_hdr,
+			    ssize_t user_size)
+{
+#if EFS_SIZE_MEMO_SIZE > 0
+	struct efs_size_memo *memo = NULL;
+	int i;
+
+	k_mutex_lock(&efs_cache_lock, K_FOREVER);
+
+	/* Reuse the entry for this file */
+	for (i = 0; i < EFS_SIZE_MEMO_SIZE; i++) {
+		if (efs_size_memo[i].valid &&
+		    memcmp(efs_size_memo[i].file_name_hash, name_hash, EFS_FILE_NAME_HASH_SIZE) ==
+			    0) {
+			memo = &efs_size_memo[i];
+			break;
 		}
 	}
 
-	/* Return any error */
-	return ret;
+	/* Otherwise use a free entry or replace the least recently used one */
+	if (memo == NULL) {
+		memo = &efs_size_memo[0];
+		for (i = 0; i < EFS_SIZE_MEMO_SIZE; i++) {
+			if (!efs_size_memo[i].valid) {
+				memo = &efs_size_memo[i];
+				break;
+			}
+			if (efs_size_memo[i].last_used < memo->last_used) {
+				memo = &efs_size_memo[i];
+			}
+		}
+	}
+
+	memcpy(memo->file_name_hash, name_hash, EFS_FILE_NAME_HASH_SIZE);
+	memcpy(memo->last_hdr, last_hdr, fmt->header_size);
+	memo->header_size = fmt->header_size;
+	memo->file_size = file_size;
+	memo->user_size = user_size;
+	memo->last_used = ++efs_cache_use_count;
+	memo->valid = true;
+
+	k_mutex_unlock(&efs_cache_lock);
+#endif
 }
 
-/**************************************************************************************************/
-/* Local Function Definitions                                                                     */
-/**************************************************************************************************/
 static int file_name_hash_gen(const char *abs_path, uint8_t *hash, uint8_t hash_len)
 {
 	int ret = 0;
@@ -936,57 +1715,59 @@ static int file_name_hash_gen(const char *abs_path, uint8_t *hash, uint8_t hash_
 	return ret;
 }
 
-static int file_name_hash_comp(const char *abs_path, uint8_t *hash, uint8_t hash_len)
+static int encrypt_block(const struct efs_format *fmt, const uint8_t *name_hash,
+			 uint32_t block_number, const uint8_t *user_data, size_t block_size,
+			 uint8_t *file_block)
 {
+	uint8_t *iv = file_block;
+	uint8_t *aad = file_block + LCZ_HW_KEY_IV_LEN;
+	size_t aad_len = fmt->header_size - LCZ_HW_KEY_IV_LEN;
+	struct efs_auth_data *auth;
+	struct efs_auth_data_v2 *auth_v2;
+	uint32_t enc_size = 0;
 	int ret = 0;
-	psa_status_t s;
 
-	/* Make sure that the hash buffer is the right size */
-	if (hash_len != PSA_HASH_LENGTH(FSE_FILE_NAME_HASH_ALG)) {
+	/* Validate the input */
+	if (user_data == NULL || block_size == 0 || block_size > fmt->user_block_size) {
 		ret = -EINVAL;
 	}
 
-	/* Compute the hash */
+	/* Populate the authenticated part of the header */
 	if (ret == 0) {
-		s = psa_hash_compare(FSE_FILE_NAME_HASH_ALG, abs_path, strlen(abs_path), hash,
-				     hash_len);
-		ret = s;
-	}
-
-	return ret;
-}
-
-static int encrypt_block(struct efs_block_header *hdr, uint8_t *user_data, ssize_t user_data_len,
-			 uint8_t *out)
-{
-	uint32_t enc_size = 0;
-	int ret = 0;
-
-	/* Validate the input */
-	if (hdr == NULL || user_data == NULL || user_data_len == 0 ||
-	    user_data_len > EFS_USER_BLOCK_SIZE) {
-		ret = -EINVAL;
+		if (fmt->version == EFS_FORMAT_V1) {
+			auth = (struct efs_auth_data *)aad;
+			auth->block_number = block_number;
+			auth->block_size = block_size;
+			memcpy(auth->file_name_hash, name_hash, EFS_FILE_NAME_HASH_SIZE);
+		} else {
+			auth_v2 = (struct efs_auth_data_v2 *)aad;
+			auth_v2->version = fmt->version;
+			auth_v2->block_shift = find_lsb_set(fmt->file_block_size) - 1;
+			auth_v2->flags = fmt->flags;
+			auth_v2->block_number = block_number;
+			auth_v2->block_size = block_size;
+			memcpy(auth_v2->file_name_hash, name_hash, EFS_FILE_NAME_HASH_SIZE);
+		}
 	}
 
 	/* Generate a new IV for this block */
 	if (ret == 0) {
-		ret = lcz_hw_key_generate_iv(hdr->iv, LCZ_HW_KEY_IV_LEN);
+		ret = lcz_hw_key_generate_iv(iv, LCZ_HW_KEY_IV_LEN);
 		if (ret != 0) {
 			LOG_ERR("Block encrypt failed to generate IV: %d", ret);
 		}
 	}
 
-	/* Encrypt the block */
+	/* Encrypt the (padded) block and any trailer */
 	if (ret == 0) {
-		ret = lcz_hw_key_encrypt_data(hdr->iv, sizeof(hdr->iv),
-					      (const uint8_t *)&(hdr->auth_data),
-					      sizeof(hdr->auth_data), user_data, user_data_len, out,
-					      EFS_USER_BLOCK_SIZE + LCZ_HW_KEY_MAC_LEN, &enc_size);
+		ret = lcz_hw_key_encrypt_data(iv, LCZ_HW_KEY_IV_LEN, aad, aad_len, user_data,
+					      fmt->payload_size, file_block + fmt->header_size,
+					      fmt->payload_size + LCZ_HW_KEY_MAC_LEN, &enc_size);
 		if (ret != 0) {
 			LOG_ERR("Block encrypt failed: %d", ret);
-		} else if (enc_size != (LCZ_HW_KEY_MAC_LEN + user_data_len)) {
+		} else if (enc_size != (LCZ_HW_KEY_MAC_LEN + fmt->payload_size)) {
 			LOG_ERR("Block encrypt output not expected length (%d != %d)", enc_size,
-				LCZ_HW_KEY_MAC_LEN + user_data_len);
+				LCZ_HW_KEY_MAC_LEN + fmt->payload_size);
 			ret = -EFAULT;
 		}
 	}
@@ -994,30 +1775,55 @@ static int encrypt_block(struct efs_block_header *hdr, uint8_t *user_data, ssize
 	return ret;
 }
 
-static int decrypt_block(const char *abs_path, int block_number, struct efs_block_header *hdr,
-			 uint8_t *in_data, int in_data_len, uint8_t *out_data, int out_data_len)
+static int decrypt_block(const struct efs_format *fmt, const uint8_t *name_hash,
+			 uint32_t block_number, uint8_t *file_block, uint8_t *user_data,
+			 size_t *block_size)
 {
-	int ret;
+	uint8_t *iv = file_block;
+	uint8_t *aad = file_block + LCZ_HW_KEY_IV_LEN;
+	size_t aad_len = fmt->header_size - LCZ_HW_KEY_IV_LEN;
+	struct efs_auth_data *auth;
+	struct efs_auth_data_v2 *auth_v2;
 	uint32_t out_data_len_ret = 0;
+	bool valid;
+	int ret;
 
 	/* Decrypt and authenticate the block */
-	ret = lcz_hw_key_decrypt_data(hdr->iv, sizeof(hdr->iv), (const uint8_t *)&(hdr->auth_data),
-				      sizeof(hdr->auth_data), in_data, in_data_len, out_data,
-				      out_data_len, &out_data_len_ret);
+	ret = lcz_hw_key_decrypt_data(iv, LCZ_HW_KEY_IV_LEN, aad, aad_len,
+				      file_block + fmt->header_size,
+				      fmt->file_block_size - fmt->header_size, user_data,
+				      fmt->payload_size, &out_data_len_ret);
 
 	/* Compare provided data with authenticated header data */
 	if (ret != 0) {
 		LOG_ERR("decrypt_block: Decrypt failed: %d", ret);
-	} else if (out_data_len_ret != out_data_len) {
+	} else if (out_data_len_ret != fmt->payload_size) {
 		LOG_ERR("decrypt_block: Decrypt output not expected length (%d != %d)",
-			out_data_len_ret, out_data_len);
+			out_data_len_ret, fmt->payload_size);
 		ret = -EFAULT;
-	} else if (hdr->auth_data.block_number != block_number ||
-		   file_name_hash_comp(abs_path, hdr->auth_data.file_name_hash,
-				       sizeof(hdr->auth_data.file_name_hash)) != 0) {
-		LOG_ERR("decrypt_block: Decryption succeeded, but metadata is incorrect");
-		memset(out_data, 0, out_data_len);
-		ret = -EINVAL;
+	} else {
+		if (fmt->version == EFS_FORMAT_V1) {
+			auth = (struct efs_auth_data *)aad;
+			*block_size = auth->block_size;
+			valid = (auth->block_number == block_number &&
+				 memcmp(auth->file_name_hash, name_hash,
+					EFS_FILE_NAME_HASH_SIZE) == 0);
+		} else {
+			auth_v2 = (struct efs_auth_data_v2 *)aad;
+			*block_size = auth_v2->block_size;
+			valid = (auth_v2->version == fmt->version &&
+				 (1UL << auth_v2->block_shift) == fmt->file_block_size &&
+				 auth_v2->flags == fmt->flags &&
+				 auth_v2->block_number == block_number &&
+				 memcmp(auth_v2->file_name_hash, name_hash,
+					EFS_FILE_NAME_HASH_SIZE) == 0);
+		}
+
+		if (!valid || *block_size > fmt->user_block_size) {
+			LOG_ERR("decrypt_block: Decryption succeeded, but metadata is incorrect");
+			memset(user_data, 0, fmt->payload_size);
+			ret = -EINVAL;
+		}
 	}
 
 	return ret;
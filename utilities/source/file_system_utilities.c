@@ -27,6 +27,13 @@ LOG_MODULE_REGISTER(fsu, CONFIG_FSU_LOG_LEVEL);
 #endif
 
 #include "file_system_utilities.h"
+#ifdef CONFIG_FSU_ENCRYPTED_FILES
+#include "encrypted_file_storage.h"
+#endif
+#ifdef CONFIG_FSU_LFS_ERASE_AHEAD
+#include <storage/flash_map.h>
+#include "lcz_nrf_qspi_nor.h"
+#endif
 
 /**************************************************************************************************/
 /* Local Constant, Macro and Type Definitions                                                     */
@@ -36,6 +43,44 @@ LOG_MODULE_REGISTER(fsu, CONFIG_FSU_LOG_LEVEL);
 		break;                                                                             \
 	}
 
+#ifdef CONFIG_FSU_HASH
+struct fsu_hash_work {
+	mbedtls_sha256_context ctx;
+	uint8_t buffer[CONFIG_FSU_HASH_CHUNK_SIZE];
+};
+#define FSU_HASH_WORK_SIZE sizeof(struct fsu_hash_work)
+#else
+#define FSU_HASH_WORK_SIZE 0
+#endif
+
+#ifdef CONFIG_FSU_CHECKSUM
+#define FSU_CHECKSUM_WORK_SIZE CONFIG_FSU_CHECKSUM_CHUNK_SIZE
+#else
+#define FSU_CHECKSUM_WORK_SIZE 0
+#endif
+
+/* Slab blocks must be a multiple of the alignment */
+#define FSU_POOL_ALIGN 8
+#define FSU_POOL_BLOCK_SIZE(size) ROUND_UP(size, FSU_POOL_ALIGN)
+
+#define FSU_POOL_TIMEOUT K_MSEC(CONFIG_FSU_POOL_TIMEOUT)
+
+#ifdef CONFIG_FSU_LFS_ERASE_AHEAD
+#define FSU_LFS_AREA_SIZE                                                                          \
+	COND_CODE_1(FLASH_AREA_LABEL_EXISTS(lfs_storage), (FLASH_AREA_SIZE(lfs_storage)),         \
+		    (FLASH_AREA_SIZE(littlefs_storage)))
+
+/* A block is at least one 4 kB flash sector */
+#define FSU_LFS_MAX_BLOCKS (FSU_LFS_AREA_SIZE / 4096)
+#endif
+
+struct fsu_pool_info {
+	struct k_mem_slab *slab;
+	uint32_t max_used;
+	uint32_t allocs;
+	uint32_t failures;
+};
+
 /**************************************************************************************************/
 /* Local Data Definitions                                                                         */
 /**************************************************************************************************/
@@ -55,6 +100,43 @@ static struct fs_mount_t littlefs_mnt = { .type = FS_LITTLEFS,
 static bool lfs_mounted;
 #endif
 
+#ifdef CONFIG_FSU_LFS_ERASE_AHEAD
+static void lfs_free_handler(struct k_work *item);
+
+static K_WORK_DELAYABLE_DEFINE(lfs_free_work, lfs_free_handler);
+
+/* Blocks found by the last traversal of littlefs */
+static ATOMIC_DEFINE(lfs_used, FSU_LFS_MAX_BLOCKS);
+#endif
+
+K_MEM_SLAB_DEFINE(fsu_dirent_slab, FSU_POOL_BLOCK_SIZE(sizeof(struct fs_dirent)),
+		  CONFIG_FSU_POOL_DIRENT_COUNT, FSU_POOL_ALIGN);
+
+#ifdef CONFIG_FSU_POOL_CHUNK_COUNT
+K_MEM_SLAB_DEFINE(fsu_chunk_slab,
+		  FSU_POOL_BLOCK_SIZE(MAX(FSU_HASH_WORK_SIZE, FSU_CHECKSUM_WORK_SIZE)),
+		  CONFIG_FSU_POOL_CHUNK_COUNT, FSU_POOL_ALIGN);
+#endif
+
+#ifdef CONFIG_FSU_POOL_EFS_USER_COUNT
+/* An encrypted file operation takes one block for the encrypted block and the plaintext */
+K_MEM_SLAB_DEFINE(fsu_efs_block_slab,
+		  FSU_POOL_BLOCK_SIZE(2 * CONFIG_FSU_ENCRYPTED_FILES_MAX_BLOCK_SIZE),
+		  CONFIG_FSU_POOL_EFS_USER_COUNT, FSU_POOL_ALIGN);
+#endif
+
+static struct k_spinlock fsu_pool_lock;
+
+static struct fsu_pool_info fsu_pools[FSU_POOL_COUNT] = {
+	[FSU_POOL_DIRENT] = { .slab = &fsu_dirent_slab },
+#ifdef CONFIG_FSU_POOL_CHUNK_COUNT
+	[FSU_POOL_CHUNK] = { .slab = &fsu_chunk_slab },
+#endif
+#ifdef CONFIG_FSU_POOL_EFS_USER_COUNT
+	[FSU_POOL_EFS_BLOCK] = { .slab = &fsu_efs_block_slab },
+#endif
+};
+
 /**************************************************************************************************/
 /* Local Function Prototypes                                                                      */
 /**************************************************************************************************/
@@ -62,6 +144,8 @@ static ssize_t fsu_wa(const char *path, const char *name, void *data, size_t siz
 
 static ssize_t fsu_wa_abs(const char *abs_path, void *data, size_t size, bool append);
 
+static void fsu_lfs_freed(const char *abs_path);
+
 /**************************************************************************************************/
 /* Global Function Definitions                                                                    */
 /**************************************************************************************************/
@@ -77,6 +161,7 @@ int fsu_lfs_mount(void)
 			LOG_ERR("Error mounting littlefs [%d]", rc);
 		} else {
 			lfs_mounted = true;
+			fsu_lfs_freed(littlefs_mnt.mnt_point);
 		}
 
 		if (lfs_mounted) {
@@ -182,8 +267,8 @@ struct fs_dirent *fsu_find(const char *path, const char *name, size_t *count,
 	fs_dir_t_init(&dir);
 	int rc = fs_opendir(&dir, path);
 	LOG_DBG("%s opendir: %d", path, rc);
-	/* Use malloc because entry is 264 bytes when using LFS */
-	struct fs_dirent *entry = k_malloc(sizeof(struct fs_dirent));
+	/* Use a pool because entry is 264 bytes when using LFS */
+	struct fs_dirent *entry = fsu_pool_alloc(FSU_POOL_DIRENT);
 	if (entry == NULL) {
 		LOG_ERR("Unable to allocate directory entry");
 	}
@@ -201,7 +286,7 @@ struct fs_dirent *fsu_find(const char *path, const char *name, size_t *count,
 			(*count)++;
 		}
 	}
-	(void)k_free(entry);
+	fsu_pool_free(FSU_POOL_DIRENT, entry);
 	(void)fs_closedir(&dir);
 
 	/* Make an array of matching items. */
@@ -269,9 +354,11 @@ int fsu_sha256_abs(uint8_t hash[FSU_HASH_SIZE], const char *abs_path, size_t siz
 		return rc;
 	}
 
-	uint8_t *pBuffer = k_malloc(CONFIG_FSU_HASH_CHUNK_SIZE);
-	mbedtls_sha256_context *pCtx = k_malloc(sizeof(mbedtls_sha256_context));
-	if ((pBuffer != NULL) && (pCtx != NULL)) {
+	struct fsu_hash_work *pWork = fsu_pool_alloc(FSU_POOL_CHUNK);
+	if (pWork != NULL) {
+		uint8_t *pBuffer = pWork->buffer;
+		mbedtls_sha256_context *pCtx = &pWork->ctx;
+
 		mbedtls_sha256_init(pCtx);
 		rc = mbedtls_sha256_starts(pCtx, 0);
 
@@ -292,16 +379,12 @@ int fsu_sha256_abs(uint8_t hash[FSU_HASH_SIZE], const char *abs_path, size_t siz
 		if (rc == 0 && rem == 0) {
 			rc = mbedtls_sha256_finish(pCtx, hash);
 		}
+		mbedtls_sha256_free(pCtx);
 	} else {
 		rc = -ENOMEM;
 	}
 
-	if (pBuffer != NULL) {
-		k_free(pBuffer);
-	}
-	if (pCtx != NULL) {
-		k_free(pCtx);
-	}
+	fsu_pool_free(FSU_POOL_CHUNK, pWork);
 	(void)fs_close(&f);
 #endif
 	return rc;
@@ -339,7 +422,7 @@ int fsu_crc32_abs(uint32_t *checksum, const char *abs_path, size_t size)
 		return rc;
 	}
 
-	uint8_t *pBuffer = k_malloc(CONFIG_FSU_CHECKSUM_CHUNK_SIZE);
+	uint8_t *pBuffer = fsu_pool_alloc(FSU_POOL_CHUNK);
 	if (pBuffer != NULL) {
 		size_t rem = size;
 		ssize_t bytes_read;
@@ -358,9 +441,7 @@ int fsu_crc32_abs(uint32_t *checksum, const char *abs_path, size_t size)
 		rc = -ENOMEM;
 	}
 
-	if (pBuffer != NULL) {
-		k_free(pBuffer);
-	}
+	fsu_pool_free(FSU_POOL_CHUNK, pBuffer);
 	(void)fs_close(&f);
 #endif
 	return rc;
@@ -435,8 +516,17 @@ int fsu_delete(const char *path, const char *name)
 
 int fsu_delete_abs(const char *abs_path)
 {
+	int status;
+
 	LOG_DBG("Deleting (unlinking) file %s", abs_path);
-	return fs_unlink(abs_path);
+	status = fs_unlink(abs_path);
+#ifdef CONFIG_FSU_ENCRYPTED_FILES
+	efs_invalidate(abs_path);
+#endif
+	if (status == 0) {
+		fsu_lfs_freed(abs_path);
+	}
+	return status;
 }
 
 int fsu_delete_files(const char *path, const char *name)
@@ -459,17 +549,40 @@ int fsu_delete_files(const char *path, const char *name)
 						  pEntries[i].name);
 			LOG_DBG("Deleting (unlinking) file %s", abs_path);
 			status = fs_unlink(abs_path);
+#ifdef CONFIG_FSU_ENCRYPTED_FILES
+			efs_invalidate(abs_path);
+#endif
 			if (status == 0) {
 				i += 1;
 			} else {
 				break;
 			}
 		}
+		if (i > 0) {
+			fsu_lfs_freed(path);
+		}
 	}
 	fsu_free_found(pEntries);
 	return i;
 }
 
+int fsu_rename_abs(const char *from, const char *to)
+{
+	int status;
+
+	LOG_DBG("Renaming file %s to %s", from, to);
+	status = fs_rename(from, to);
+#ifdef CONFIG_FSU_ENCRYPTED_FILES
+	efs_invalidate(from);
+	efs_invalidate(to);
+#endif
+	/* A file that is replaced is freed */
+	if (status == 0) {
+		fsu_lfs_freed(to);
+	}
+	return status;
+}
+
 int fsu_mkdir(const char *path, const char *name)
 {
 	char abs_path[FSU_MAX_ABS_PATH_SIZE];
@@ -500,7 +613,7 @@ int fsu_mkdir_abs(const char *abs_path, bool recursive)
 	}
 
 	/* Check to see if the path already exists */
-	entry = k_malloc(sizeof(struct fs_dirent));
+	entry = fsu_pool_alloc(FSU_POOL_DIRENT);
 	if (entry == NULL) {
 		LOG_ERR("Unable to allocate file entry");
 		return -ENOMEM;
@@ -508,13 +621,14 @@ int fsu_mkdir_abs(const char *abs_path, bool recursive)
 
 	r = fs_stat(path, entry);
 	if (r == 0) {
-		(void)k_free(entry);
 		if (entry->type == FS_DIR_ENTRY_DIR) {
-			return 0;
+			r = 0;
 		} else {
 			LOG_WRN("%s is file not directory", abs_path);
-			return -ENOTDIR;
+			r = -ENOTDIR;
 		}
+		fsu_pool_free(FSU_POOL_DIRENT, entry);
+		return r;
 	}
 
 	/* Step through each section to create the directories */
@@ -551,7 +665,7 @@ int fsu_mkdir_abs(const char *abs_path, bool recursive)
 		}
 	}
 
-	(void)k_free(entry);
+	fsu_pool_free(FSU_POOL_DIRENT, entry);
 
 	return r;
 }
@@ -595,9 +709,10 @@ ssize_t fsu_read_abs_block(const char *abs_path, uint32_t offset, void *data, si
 			break;
 		}
 
-		entry = k_malloc(sizeof(struct fs_dirent));
+		entry = fsu_pool_alloc(FSU_POOL_DIRENT);
 		if (entry == NULL) {
 			LOG_ERR("Unable to allocate file entry");
+			r = -ENOMEM;
 			break;
 		}
 
@@ -633,7 +748,7 @@ ssize_t fsu_read_abs_block(const char *abs_path, uint32_t offset, void *data, si
 
 	} while (0);
 
-	(void)k_free(entry);
+	fsu_pool_free(FSU_POOL_DIRENT, entry);
 
 	return r;
 }
@@ -641,7 +756,7 @@ ssize_t fsu_read_abs_block(const char *abs_path, uint32_t offset, void *data, si
 ssize_t fsu_get_file_size_abs(const char *abs_path)
 {
 	ssize_t r = -EPERM;
-	struct fs_dirent *entry = k_malloc(sizeof(struct fs_dirent));
+	struct fs_dirent *entry = fsu_pool_alloc(FSU_POOL_DIRENT);
 
 	do {
 		if (entry == NULL) {
@@ -660,7 +775,7 @@ ssize_t fsu_get_file_size_abs(const char *abs_path)
 
 	} while (0);
 
-	k_free(entry);
+	fsu_pool_free(FSU_POOL_DIRENT, entry);
 
 	return r;
 }
@@ -743,6 +858,68 @@ int fsu_simplify_path(const char *path_in, char *path_out)
 	return j;
 }
 
+void *fsu_pool_alloc(enum fsu_pool pool)
+{
+	struct fsu_pool_info *info;
+	k_spinlock_key_t key;
+	void *block = NULL;
+	uint32_t used;
+
+	if (pool >= FSU_POOL_COUNT || fsu_pools[pool].slab == NULL) {
+		return NULL;
+	}
+	info = &fsu_pools[pool];
+
+	if (k_mem_slab_alloc(info->slab, &block, FSU_POOL_TIMEOUT) != 0) {
+		block = NULL;
+	}
+
+	key = k_spin_lock(&fsu_pool_lock);
+	if (block != NULL) {
+		info->allocs += 1;
+		used = k_mem_slab_num_used_get(info->slab);
+		info->max_used = MAX(info->max_used, used);
+	} else {
+		info->failures += 1;
+	}
+	k_spin_unlock(&fsu_pool_lock, key);
+
+	return block;
+}
+
+void fsu_pool_free(enum fsu_pool pool, void *block)
+{
+	if (block != NULL && pool < FSU_POOL_COUNT && fsu_pools[pool].slab != NULL) {
+		k_mem_slab_free(fsu_pools[pool].slab, &block);
+	}
+}
+
+int fsu_pool_get_stats(enum fsu_pool pool, struct fsu_pool_stats *stats)
+{
+	struct fsu_pool_info *info;
+	k_spinlock_key_t key;
+
+	if (pool >= FSU_POOL_COUNT || stats == NULL) {
+		return -EINVAL;
+	}
+	info = &fsu_pools[pool];
+
+	if (info->slab == NULL) {
+		return -ENOTSUP;
+	}
+
+	key = k_spin_lock(&fsu_pool_lock);
+	stats->block_size = info->slab->block_size;
+	stats->blocks = info->slab->num_blocks;
+	stats->used = k_mem_slab_num_used_get(info->slab);
+	stats->max_used = info->max_used;
+	stats->allocs = info->allocs;
+	stats->failures = info->failures;
+	k_spin_unlock(&fsu_pool_lock, key);
+
+	return 0;
+}
+
 /**************************************************************************************************/
 /* Local Function Definitions                                                                     */
 /**************************************************************************************************/
@@ -804,6 +981,11 @@ static ssize_t fsu_wa_abs(const char *abs_path, void *data, size_t size, bool ap
 			}
 		}
 
+		/* The blocks of the previous contents are freed */
+		if (!append) {
+			fsu_lfs_freed(abs_path);
+		}
+
 	} while (0);
 
 #ifdef CONFIG_FSU_REWRITE_SIZE_CHECK
@@ -819,3 +1001,79 @@ static ssize_t fsu_wa_abs(const char *abs_path, void *data, size_t size, bool ap
 
 	return rc;
 }
+
+#ifdef CONFIG_FSU_LFS_ERASE_AHEAD
+/* Blocks freed by a change are found after a delay so that a series of
+ * changes only needs one traversal.
+ */
+static void fsu_lfs_freed(const char *abs_path)
+{
+	if (lfs_mounted &&
+	    strncmp(abs_path, CONFIG_FSU_MOUNT_POINT, strlen(CONFIG_FSU_MOUNT_POINT)) == 0) {
+		k_work_schedule(&lfs_free_work, K_MSEC(CONFIG_FSU_LFS_ERASE_AHEAD_DELAY));
+	}
+}
+
+static int lfs_mark_used(void *data, lfs_block_t block)
+{
+	ARG_UNUSED(data);
+
+	if (block < FSU_LFS_MAX_BLOCKS) {
+		atomic_set_bit(lfs_used, block);
+	}
+	return 0;
+}
+
+/* Give the runs of blocks that littlefs isn't using to the flash driver to
+ * erase. The file system stays locked until they are marked so that a
+ * block can't be allocated in between.
+ */
+static void lfs_free_handler(struct k_work *item)
+{
+	const struct flash_area *fa;
+	const struct device *dev;
+	lfs_size_t block_size;
+	lfs_block_t count;
+	lfs_block_t block;
+	lfs_block_t run = 0;
+	int r;
+
+	r = flash_area_open((uintptr_t)littlefs_mnt.storage_dev, &fa);
+	if (r < 0) {
+		LOG_ERR("Unable to open littlefs flash area: %d", r);
+		return;
+	}
+	dev = device_get_binding(fa->fa_dev_name);
+
+	k_mutex_lock(&cstorage.mutex, K_FOREVER);
+	block_size = cstorage.cfg.block_size;
+	count = cstorage.cfg.block_count;
+	if (count > FSU_LFS_MAX_BLOCKS) {
+		r = -EINVAL;
+	} else {
+		memset(lfs_used, 0, sizeof(lfs_used));
+		r = lfs_fs_traverse(&cstorage.lfs, lfs_mark_used, NULL);
+	}
+
+	for (block = 0; (r == 0) && (block <= count); block++) {
+		if ((block < count) && !atomic_test_bit(lfs_used, block)) {
+			run += 1;
+		} else if (run > 0) {
+			r = lcz_nrf_qspi_nor_mark_free(dev, fa->fa_off + ((block - run) * block_size),
+						       run * block_size);
+			run = 0;
+		}
+	}
+	k_mutex_unlock(&cstorage.mutex);
+	flash_area_close(fa);
+
+	if (r < 0) {
+		LOG_ERR("Unable to mark free littlefs blocks: %d", r);
+	}
+}
+#else
+static void fsu_lfs_freed(const char *abs_path)
+{
+	ARG_UNUSED(abs_path);
+}
+#endif
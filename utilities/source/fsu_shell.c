@@ -78,6 +78,7 @@ static int fsu_crc_cmd(const struct shell *shell, size_t argc, char **argv);
 static int fsu_del_cmd(const struct shell *shell, size_t argc, char **argv);
 #endif
 static int fsu_dump_cmd(const struct shell *shell, size_t argc, char **argv);
+static int fsu_pools_cmd(const struct shell *shell, size_t argc, char **argv);
 #if defined(CONFIG_FSU_ENCRYPTED_FILES)
 static int fsu_enc_create_cmd(const struct shell *shell, size_t argc, char **argv);
 static int fsu_enc_append_cmd(const struct shell *shell, size_t argc, char **argv);
@@ -103,6 +104,7 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 	SHELL_CMD(del, NULL, "Delete file(s) [-f is delete all]", fsu_del_cmd),
 #endif
 	SHELL_CMD(dump, NULL, "Dump the contents of a file", fsu_dump_cmd),
+	SHELL_CMD(pools, NULL, "Buffer pool usage", fsu_pools_cmd),
 #if defined(CONFIG_FSU_ENCRYPTED_FILES)
 	SHELL_CMD(enc_create, NULL, "Create an encrypted file", fsu_enc_create_cmd),
 	SHELL_CMD(enc_append, NULL, "Append to an encrypted file", fsu_enc_append_cmd),
@@ -230,6 +232,30 @@ static int fsu_crc_cmd(const struct shell *shell, size_t argc, char **argv)
 	return 0;
 }
 
+static int fsu_pools_cmd(const struct shell *shell, size_t argc, char **argv)
+{
+	static const char *const names[FSU_POOL_COUNT] = {
+		[FSU_POOL_DIRENT] = "dirent",
+		[FSU_POOL_CHUNK] = "chunk",
+		[FSU_POOL_EFS_BLOCK] = "efs block",
+	};
+	struct fsu_pool_stats stats;
+	int i;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	for (i = 0; i < FSU_POOL_COUNT; i++) {
+		if (fsu_pool_get_stats(i, &stats) == 0) {
+			shell_print(shell,
+				    "%s: %u x %zu bytes used %u max %u allocs %u failures %u",
+				    names[i], stats.blocks, stats.block_size, stats.used,
+				    stats.max_used, stats.allocs, stats.failures);
+		}
+	}
+	return 0;
+}
+
 #if defined(CONFIG_FSU_SHELL_ALLOW_CHANGE)
 static int fsu_del_cmd(const struct shell *shell, size_t argc, char **argv)
 {